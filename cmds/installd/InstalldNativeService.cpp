@@ -36,6 +36,7 @@
 #include <sys/xattr.h>
 #include <unistd.h>
 #include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <functional>
@@ -73,6 +74,7 @@
 
 #include "CacheTracker.h"
 #include "CrateManager.h"
+#include "copy_tree.h"
 #include "MatchExtensionGen.h"
 #include "QuotaUtils.h"
 #include "SysTrace.h"
@@ -98,7 +100,6 @@ static constexpr const char* kTestUuid = "TEST";
 
 static constexpr const mode_t kRollbackFolderMode = 0700;
 
-static constexpr const char* kCpPath = "/system/bin/cp";
 static constexpr const char* kXattrDefault = "user.default";
 
 static constexpr const char* kDataMirrorCePath = "/data_mirror/data_ce";
@@ -108,6 +109,10 @@ static constexpr const char* kMiscMirrorDePath = "/data_mirror/misc_de";
 
 static constexpr const int MIN_RESTRICTED_HOME_SDK_VERSION = 24; // > M
 
+// Upper bound on the threads creating app data in parallel for createAppDataBatched. The work is
+// mostly filesystem metadata updates and restorecon, which stop scaling past a few threads.
+static constexpr const size_t kMaxCreateAppDataThreads = 4;
+
 static constexpr const char* PKG_LIB_POSTFIX = "/lib";
 static constexpr const char* CACHE_DIR_POSTFIX = "/cache";
 static constexpr const char* CODE_CACHE_DIR_POSTFIX = "/code_cache";
@@ -994,15 +999,45 @@ binder::Status InstalldNativeService::createAppDataBatched(
         ENFORCE_VALID_USER(arg.userId);
     }
 
-    // Locking is performed depeer in the callstack.
+    // Locking is performed depeer in the callstack, per package and user, so that independent
+    // packages can be created concurrently.
+    ScopedTrace tracer("create-app-data-batched");
 
-    std::vector<android::os::CreateAppDataResult> results;
-    for (const auto &arg : args) {
-        android::os::CreateAppDataResult result;
-        createAppData(arg, &result);
-        results.push_back(result);
+    std::vector<android::os::CreateAppDataResult> results(args.size());
+    std::atomic<size_t> nextArg = 0;
+    auto createNext = [&]() {
+        for (size_t i; (i = nextArg.fetch_add(1, std::memory_order_relaxed)) < args.size();) {
+            createAppData(args[i], &results[i]);
+        }
+    };
+
+    // The calling thread takes part, so only numThreads - 1 workers are started.
+    const size_t numThreads = std::min<size_t>(
+            {args.size(), std::max(std::thread::hardware_concurrency(), 1u),
+             kMaxCreateAppDataThreads});
+    if (numThreads > 1) {
+        // Workers don't run on a binder thread: hand them the caller's identity, so that the
+        // ENFORCE_UID checks down the callstack see the same calling uid.
+        const int64_t identity = IPCThreadState::self()->clearCallingIdentity();
+        IPCThreadState::self()->restoreCallingIdentity(identity);
+
+        std::vector<std::thread> workers;
+        workers.reserve(numThreads - 1);
+        for (size_t i = 1; i < numThreads; i++) {
+            workers.emplace_back([&createNext, identity]() {
+                IPCThreadState::self()->restoreCallingIdentity(identity);
+                createNext();
+            });
+        }
+        createNext();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    } else {
+        createNext();
     }
-    *_aidl_return = results;
+
+    *_aidl_return = std::move(results);
     return ok();
 }
 
@@ -1563,21 +1598,6 @@ binder::Status InstalldNativeService::fixupAppData(const std::optional<std::stri
     return ok();
 }
 
-static int32_t copy_directory_recursive(const char* from, const char* to) {
-    char* argv[] =
-            {(char*)kCpPath,
-             (char*)"-F", /* delete any existing destination file first (--remove-destination) */
-             (char*)"--preserve=mode,ownership,timestamps,xattr", /* preserve properties */
-             (char*)"-R", /* recurse into subdirectories (DEST must be a directory) */
-             (char*)"-P", /* Do not follow symlinks [default] */
-             (char*)"-d", /* don't dereference symlinks */
-             (char*)from,
-             (char*)to};
-
-    LOG(DEBUG) << "Copying " << from << " to " << to;
-    return logwrap_fork_execvp(ARRAY_SIZE(argv), argv, nullptr, false, LOG_ALOG, false, nullptr);
-}
-
 binder::Status InstalldNativeService::snapshotAppData(const std::optional<std::string>& volumeUuid,
                                                       const std::string& packageName,
                                                       int32_t userId, int32_t snapshotId,
@@ -3638,6 +3658,35 @@ binder::Status InstalldNativeService::hashSecondaryDexFile(
         dexPath, packageName, uid, volumeUuid, storageFlag, _aidl_return);
     return result ? ok() : error();
 }
+
+binder::Status InstalldNativeService::hashSecondaryDexFiles(
+        const std::vector<std::string>& dexPaths, const std::string& packageName, int32_t uid,
+        const std::optional<std::string>& volumeUuid, int32_t storageFlag,
+        std::vector<android::os::SecondaryDexHashResult>* _aidl_return) {
+    ENFORCE_UID(AID_SYSTEM);
+    CHECK_ARGUMENT_UUID(volumeUuid);
+    CHECK_ARGUMENT_PACKAGE_NAME(packageName);
+    for (const auto& dexPath : dexPaths) {
+        CHECK_ARGUMENT_PATH(dexPath);
+    }
+
+    // As for hashSecondaryDexFile, mLock is not taken. All the files are hashed by a single child
+    // process, so the fork is paid once for the whole set.
+    std::vector<android::installd::SecondaryDexHash> hashes;
+    bool result = android::installd::hash_secondary_dex_files(
+        dexPaths, packageName, uid, volumeUuid, storageFlag, &hashes);
+    if (!result) {
+        return error();
+    }
+    _aidl_return->clear();
+    _aidl_return->reserve(hashes.size());
+    for (auto& hash : hashes) {
+        android::os::SecondaryDexHashResult& entry = _aidl_return->emplace_back();
+        entry.success = hash.success;
+        entry.hash = std::move(hash.hash);
+    }
+    return ok();
+}
 /**
  * Returns true if ioctl feature (F2FS_IOC_FS{GET,SET}XATTR) is supported as
  * these were introduced in Linux 4.14, so kernel versions before that will fail
@@ -185,6 +185,9 @@ public:
     binder::Status hashSecondaryDexFile(const std::string& dexPath,
         const std::string& packageName, int32_t uid, const std::optional<std::string>& volumeUuid,
         int32_t storageFlag, std::vector<uint8_t>* _aidl_return);
+    binder::Status hashSecondaryDexFiles(const std::vector<std::string>& dexPaths,
+        const std::string& packageName, int32_t uid, const std::optional<std::string>& volumeUuid,
+        int32_t storageFlag, std::vector<android::os::SecondaryDexHashResult>* _aidl_return);
 
     binder::Status invalidateMounts();
     binder::Status setFirstBoot();
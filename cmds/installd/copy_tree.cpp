@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "copy_tree.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fts.h>
+#include <string.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+
+#include "SysTrace.h"
+
+#ifndef LOG_TAG
+#define LOG_TAG "installd"
+#endif
+
+using android::base::unique_fd;
+
+namespace android {
+namespace installd {
+
+namespace {
+
+// Below this many regular files per thread, starting a thread costs more than it saves.
+constexpr size_t kFilesPerCopyThread = 32;
+
+constexpr size_t kCopyChunkSize = 1 << 20;
+
+struct Entry {
+    std::string from;
+    std::string to;
+    struct stat st;
+};
+
+// Shared by the threads of a single copy_directory_recursive call.
+struct CopyState {
+    // Cleared on the first clone the filesystem does not support, so the remaining files go
+    // straight to copy_file_range.
+    std::atomic<bool> try_clone = true;
+    // The errno of the first failure, or 0.
+    std::atomic<int> error = 0;
+
+    bool failed() const { return error.load(std::memory_order_relaxed) != 0; }
+
+    void fail(const std::string& what, const std::string& path) {
+        int err = errno != 0 ? errno : EIO;
+        PLOG(ERROR) << "Failed to " << what << " " << path;
+        int expected = 0;
+        error.compare_exchange_strong(expected, err);
+    }
+};
+
+bool is_clone_unsupported(int err) {
+    return err == EOPNOTSUPP || err == ENOTTY || err == EXDEV || err == EINVAL;
+}
+
+// Copies all extended attributes of |from| to |to|, without following symlinks.
+bool copy_xattrs(const Entry& entry, CopyState* state) {
+    ssize_t list_size = llistxattr(entry.from.c_str(), nullptr, 0);
+    if (list_size < 0) {
+        if (errno == ENOTSUP) {
+            return true;
+        }
+        state->fail("list xattrs of", entry.from);
+        return false;
+    }
+    if (list_size == 0) {
+        return true;
+    }
+    std::vector<char> names(list_size);
+    list_size = llistxattr(entry.from.c_str(), names.data(), names.size());
+    if (list_size < 0) {
+        state->fail("list xattrs of", entry.from);
+        return false;
+    }
+
+    std::vector<char> value;
+    for (const char* name = names.data(); name < names.data() + list_size;
+         name += strlen(name) + 1) {
+        ssize_t value_size = lgetxattr(entry.from.c_str(), name, nullptr, 0);
+        if (value_size >= 0) {
+            value.resize(value_size);
+            value_size = lgetxattr(entry.from.c_str(), name, value.data(), value.size());
+        }
+        if (value_size < 0) {
+            state->fail(std::string("get xattr ") + name + " of", entry.from);
+            return false;
+        }
+        if (lsetxattr(entry.to.c_str(), name, value.data(), value_size, 0) != 0) {
+            state->fail(std::string("set xattr ") + name + " on", entry.to);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Applies the ownership, xattrs, mode and timestamps of |entry.from| to |entry.to|. Ownership
+// goes first, since chown clears the set-user-ID and set-group-ID bits.
+bool copy_metadata(const Entry& entry, CopyState* state) {
+    if (lchown(entry.to.c_str(), entry.st.st_uid, entry.st.st_gid) != 0) {
+        state->fail("chown", entry.to);
+        return false;
+    }
+    if (!copy_xattrs(entry, state)) {
+        return false;
+    }
+    if (!S_ISLNK(entry.st.st_mode) && chmod(entry.to.c_str(), entry.st.st_mode & 07777) != 0) {
+        state->fail("chmod", entry.to);
+        return false;
+    }
+    const struct timespec times[2] = {entry.st.st_atim, entry.st.st_mtim};
+    if (utimensat(AT_FDCWD, entry.to.c_str(), times, AT_SYMLINK_NOFOLLOW) != 0) {
+        state->fail("set timestamps of", entry.to);
+        return false;
+    }
+    return true;
+}
+
+// Removes whatever is at |path| unless it is a directory, like cp -F does.
+bool remove_non_directory(const std::string& path, CopyState* state) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
+        if (errno == ENOENT) {
+            return true;
+        }
+        state->fail("stat", path);
+        return false;
+    }
+    if (!S_ISDIR(st.st_mode) && unlink(path.c_str()) != 0) {
+        state->fail("remove", path);
+        return false;
+    }
+    return true;
+}
+
+bool copy_file_contents(int from_fd, int to_fd, const Entry& entry, CopyState* state) {
+    if (entry.st.st_size == 0) {
+        return true;
+    }
+    if (state->try_clone.load(std::memory_order_relaxed)) {
+        if (ioctl(to_fd, FICLONE, from_fd) == 0) {
+            return true;
+        }
+        if (!is_clone_unsupported(errno)) {
+            state->fail("clone", entry.from);
+            return false;
+        }
+        state->try_clone.store(false, std::memory_order_relaxed);
+    }
+
+    // Copy until EOF rather than st_size, in case the file changed since it was stat'ed.
+    bool copied_any = false;
+    while (true) {
+        ssize_t copied = copy_file_range(from_fd, nullptr, to_fd, nullptr, kCopyChunkSize, 0);
+        if (copied > 0) {
+            copied_any = true;
+            continue;
+        }
+        if (copied == 0) {
+            return true;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (!copied_any && (errno == ENOSYS || errno == EXDEV || errno == EINVAL)) {
+            break;
+        }
+        state->fail("copy", entry.from);
+        return false;
+    }
+
+    // copy_file_range is not available for these files: fall back to read and write.
+    std::vector<char> buffer(kCopyChunkSize);
+    while (true) {
+        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(from_fd, buffer.data(), buffer.size()));
+        if (bytes_read == 0) {
+            return true;
+        }
+        if (bytes_read < 0 || !android::base::WriteFully(to_fd, buffer.data(), bytes_read)) {
+            state->fail("copy", entry.from);
+            return false;
+        }
+    }
+}
+
+bool copy_regular_file(const Entry& entry, CopyState* state) {
+    unique_fd from_fd(
+            TEMP_FAILURE_RETRY(open(entry.from.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)));
+    if (from_fd == -1) {
+        state->fail("open", entry.from);
+        return false;
+    }
+    if (!remove_non_directory(entry.to, state)) {
+        return false;
+    }
+    unique_fd to_fd(TEMP_FAILURE_RETRY(open(entry.to.c_str(),
+                                            O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOFOLLOW,
+                                            0600)));
+    if (to_fd == -1) {
+        state->fail("create", entry.to);
+        return false;
+    }
+    if (!copy_file_contents(from_fd.get(), to_fd.get(), entry, state)) {
+        return false;
+    }
+    return copy_metadata(entry, state);
+}
+
+bool copy_symlink(const Entry& entry, CopyState* state) {
+    std::string target;
+    if (!android::base::Readlink(entry.from, &target)) {
+        state->fail("read link", entry.from);
+        return false;
+    }
+    if (!remove_non_directory(entry.to, state)) {
+        return false;
+    }
+    if (symlink(target.c_str(), entry.to.c_str()) != 0) {
+        state->fail("create link", entry.to);
+        return false;
+    }
+    return copy_metadata(entry, state);
+}
+
+bool copy_special_file(const Entry& entry, CopyState* state) {
+    if (!remove_non_directory(entry.to, state)) {
+        return false;
+    }
+    if (mknod(entry.to.c_str(), entry.st.st_mode, entry.st.st_rdev) != 0) {
+        state->fail("create node", entry.to);
+        return false;
+    }
+    return copy_metadata(entry, state);
+}
+
+bool create_directory(const Entry& entry, CopyState* state) {
+    if (!remove_non_directory(entry.to, state)) {
+        return false;
+    }
+    // Stay writable while the contents are copied; the final mode is applied afterwards.
+    if (mkdir(entry.to.c_str(), 0700) != 0 && errno != EEXIST) {
+        state->fail("create directory", entry.to);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int copy_directory_recursive(const std::string& from, const std::string& to,
+                             size_t max_threads) {
+    ScopedTrace tracer("copy-tree");
+    LOG(DEBUG) << "Copying " << from << " to " << to;
+
+    std::string root = from;
+    while (root.size() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    const std::string to_root = to + "/" + android::base::Basename(root);
+
+    CopyState state;
+    // Directories in pre-order, and regular files, whose copies are spread over threads.
+    std::vector<Entry> directories;
+    std::vector<Entry> files;
+
+    char* argv[] = {const_cast<char*>(root.c_str()), nullptr};
+    FTS* fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR, nullptr);
+    if (fts == nullptr) {
+        state.fail("open", root);
+        return state.error;
+    }
+    for (FTSENT* p; !state.failed() && (p = fts_read(fts)) != nullptr;) {
+        if (p->fts_info == FTS_DP) {
+            continue;
+        }
+        if (p->fts_info == FTS_DNR || p->fts_info == FTS_ERR || p->fts_info == FTS_NS) {
+            errno = p->fts_errno;
+            state.fail("read", p->fts_path);
+            break;
+        }
+        Entry entry{p->fts_path, to_root + (p->fts_path + root.size()), *p->fts_statp};
+        switch (p->fts_info) {
+            case FTS_D:
+                if (create_directory(entry, &state)) {
+                    directories.push_back(std::move(entry));
+                }
+                break;
+            case FTS_F:
+                files.push_back(std::move(entry));
+                break;
+            case FTS_SL:
+            case FTS_SLNONE:
+                copy_symlink(entry, &state);
+                break;
+            default:
+                copy_special_file(entry, &state);
+                break;
+        }
+    }
+    fts_close(fts);
+
+    if (!state.failed() && !files.empty()) {
+        ScopedTrace tracer("copy-files");
+        std::atomic<size_t> next_file = 0;
+        auto copy_files = [&]() {
+            for (size_t i; !state.failed() &&
+                 (i = next_file.fetch_add(1, std::memory_order_relaxed)) < files.size();) {
+                copy_regular_file(files[i], &state);
+            }
+        };
+        const size_t num_threads = std::clamp<size_t>(files.size() / kFilesPerCopyThread, 1,
+                                                       std::max<size_t>(max_threads, 1));
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < num_threads; i++) {
+            workers.emplace_back(copy_files);
+        }
+        copy_files();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Directory metadata goes last, deepest first, so that creating their contents does not
+    // update the copied timestamps, and read-only directories can still be filled.
+    for (auto it = directories.rbegin(); !state.failed() && it != directories.rend(); ++it) {
+        copy_metadata(*it, &state);
+    }
+    return state.error;
+}
+
+}  // namespace installd
+}  // namespace android
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_INSTALLD_COPY_TREE_H
+#define ANDROID_INSTALLD_COPY_TREE_H
+
+#include <stddef.h>
+
+#include <string>
+
+namespace android {
+namespace installd {
+
+// Upper bound on the threads copying regular files for copy_directory_recursive.
+constexpr size_t kCopyTreeMaxThreads = 4;
+
+// Copies the directory |from| into the existing directory |to|, as to/basename(from), in-process.
+//
+// Behaves like `cp -F -R -P -d --preserve=mode,ownership,timestamps,xattr from to`, which it
+// replaces: existing destination files are removed first, symlinks are copied as symlinks, and
+// mode, ownership, timestamps and all extended attributes (including the SELinux label) of every
+// entry are preserved. Hard links are not preserved.
+//
+// File contents are shared with FICLONE reflinks when the filesystem supports them, and copied
+// with copy_file_range otherwise, by up to |max_threads| threads.
+//
+// Returns 0 on success, or the errno of the first failure.
+int copy_directory_recursive(const std::string& from, const std::string& to,
+                             size_t max_threads = kCopyTreeMaxThreads);
+
+}  // namespace installd
+}  // namespace android
+
+#endif  // ANDROID_INSTALLD_COPY_TREE_H
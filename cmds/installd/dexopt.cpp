@@ -2213,6 +2213,57 @@ bool reconcile_secondary_dex_file(const std::string& dex_path,
     }
 }
 
+// What the hashing child reports back for each secondary dex file: 0, kHashNoFile or one of the
+// kHash* return codes, followed by the hash.
+static constexpr uint8_t kHashNoFile = 1;
+struct SecondaryDexHashRecord {
+    uint8_t code;
+    std::array<uint8_t, SHA256_DIGEST_LENGTH> hash;
+};
+
+// Hashes the secondary dex file at dex_path, in the child of hash_secondary_dex_files. The file is
+// read rather than mapped: the app can truncate it at any time, which would fault on the mapping.
+static uint8_t hash_secondary_dex_file_in_child(const std::string& dex_path,
+        const std::string& pkgname, int uid, const char* volume_uuid, int storage_flag,
+        std::array<uint8_t, SHA256_DIGEST_LENGTH>* out_hash) {
+    if (!validate_secondary_dex_path(pkgname, dex_path, volume_uuid, uid, storage_flag)) {
+        async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
+                "Could not validate secondary dex path %s", dex_path.c_str());
+        return DexoptReturnCodes::kHashValidatePath;
+    }
+
+    unique_fd fd(TEMP_FAILURE_RETRY(open(dex_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)));
+    if (fd == -1) {
+        if (errno == EACCES || errno == ENOENT) {
+            // Not treated as an error.
+            return kHashNoFile;
+        }
+        async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
+                "Failed to open secondary dex %s: %d", dex_path.c_str(), errno);
+        return DexoptReturnCodes::kHashOpenPath;
+    }
+
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+
+    std::vector<uint8_t> buffer(65536);
+    while (true) {
+        ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
+        if (bytes_read == 0) {
+            break;
+        } else if (bytes_read == -1) {
+            async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
+                    "Failed to read secondary dex %s: %d", dex_path.c_str(), errno);
+            return DexoptReturnCodes::kHashReadDex;
+        }
+
+        SHA256_Update(&ctx, buffer.data(), bytes_read);
+    }
+
+    SHA256_Final(out_hash->data(), &ctx);
+    return 0;
+}
+
 // Compute and return the hash (SHA-256) of the secondary dex file at dex_path.
 // Returns true if all parameters are valid and the hash successfully computed and stored in
 // out_secondary_dex_hash.
@@ -2222,17 +2273,32 @@ bool reconcile_secondary_dex_file(const std::string& dex_path,
 bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkgname, int uid,
         const std::optional<std::string>& volume_uuid, int storage_flag,
         std::vector<uint8_t>* out_secondary_dex_hash) {
-    out_secondary_dex_hash->clear();
+    std::vector<SecondaryDexHash> hashes;
+    bool result = hash_secondary_dex_files({dex_path}, pkgname, uid, volume_uuid, storage_flag,
+                                           &hashes);
+    if (!result || !hashes.front().success) {
+        out_secondary_dex_hash->clear();
+        return false;
+    }
+    *out_secondary_dex_hash = std::move(hashes.front().hash);
+    return true;
+}
+
+bool hash_secondary_dex_files(const std::vector<std::string>& dex_paths,
+        const std::string& pkgname, int uid, const std::optional<std::string>& volume_uuid,
+        int storage_flag, std::vector<SecondaryDexHash>* out_hashes) {
+    out_hashes->clear();
+    out_hashes->resize(dex_paths.size());
 
     const char* volume_uuid_cstr = volume_uuid ? volume_uuid->c_str() : nullptr;
 
     if (storage_flag != FLAG_STORAGE_CE && storage_flag != FLAG_STORAGE_DE) {
-        LOG(ERROR) << "hash_secondary_dex_file called with invalid storage_flag: "
+        LOG(ERROR) << "hash_secondary_dex_files called with invalid storage_flag: "
                 << storage_flag;
         return false;
     }
 
-    // Pipe to get the hash result back from our child process.
+    // Pipe to get the hash results back from our child process.
     unique_fd pipe_read, pipe_write;
     if (!Pipe(&pipe_read, &pipe_write)) {
         PLOG(ERROR) << "Failed to create pipe";
@@ -2247,45 +2313,16 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
         drop_capabilities(uid);
         pipe_read.reset();
 
-        if (!validate_secondary_dex_path(pkgname, dex_path, volume_uuid_cstr, uid, storage_flag)) {
-            async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
-                    "Could not validate secondary dex path %s", dex_path.c_str());
-            _exit(DexoptReturnCodes::kHashValidatePath);
-        }
-
-        unique_fd fd(TEMP_FAILURE_RETRY(open(dex_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW)));
-        if (fd == -1) {
-            if (errno == EACCES || errno == ENOENT) {
-                // Not treated as an error.
-                _exit(0);
+        // One file after the other: installd is multithreaded, so the child of its fork must not
+        // start threads of its own.
+        for (const std::string& dex_path : dex_paths) {
+            SecondaryDexHashRecord record = {};
+            record.code = hash_secondary_dex_file_in_child(dex_path, pkgname, uid,
+                    volume_uuid_cstr, storage_flag, &record.hash);
+            if (!WriteFully(pipe_write, &record.code, sizeof(record.code)) ||
+                    !WriteFully(pipe_write, record.hash.data(), record.hash.size())) {
+                _exit(DexoptReturnCodes::kHashWrite);
             }
-            PLOG(ERROR) << "Failed to open secondary dex " << dex_path;
-            async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
-                    "Failed to open secondary dex %s: %d", dex_path.c_str(), errno);
-            _exit(DexoptReturnCodes::kHashOpenPath);
-        }
-
-        SHA256_CTX ctx;
-        SHA256_Init(&ctx);
-
-        std::vector<uint8_t> buffer(65536);
-        while (true) {
-            ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
-            if (bytes_read == 0) {
-                break;
-            } else if (bytes_read == -1) {
-                async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
-                        "Failed to read secondary dex %s: %d", dex_path.c_str(), errno);
-                _exit(DexoptReturnCodes::kHashReadDex);
-            }
-
-            SHA256_Update(&ctx, buffer.data(), bytes_read);
-        }
-
-        std::array<uint8_t, SHA256_DIGEST_LENGTH> hash;
-        SHA256_Final(hash.data(), &ctx);
-        if (!WriteFully(pipe_write, hash.data(), hash.size())) {
-            _exit(DexoptReturnCodes::kHashWrite);
         }
 
         _exit(0);
@@ -2294,11 +2331,24 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
     // parent
     pipe_write.reset();
 
-    out_secondary_dex_hash->resize(SHA256_DIGEST_LENGTH);
-    if (!ReadFully(pipe_read, out_secondary_dex_hash->data(), out_secondary_dex_hash->size())) {
-        out_secondary_dex_hash->clear();
+    bool result = true;
+    for (auto& hash : *out_hashes) {
+        SecondaryDexHashRecord record;
+        if (!ReadFully(pipe_read, &record.code, sizeof(record.code)) ||
+                !ReadFully(pipe_read, record.hash.data(), record.hash.size())) {
+            result = false;
+            break;
+        }
+        hash.success = record.code == 0 || record.code == kHashNoFile;
+        if (record.code == 0) {
+            hash.hash.assign(record.hash.begin(), record.hash.end());
+        }
+    }
+    if (wait_child_with_timeout(pid, kShortTimeoutMs) != 0 || !result) {
+        out_hashes->assign(dex_paths.size(), SecondaryDexHash());
+        return false;
     }
-    return wait_child_with_timeout(pid, kShortTimeoutMs) == 0;
+    return true;
 }
 
 // Helper for move_ab, so that we can have common failure-case cleanup.
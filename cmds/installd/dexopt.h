@@ -119,6 +119,20 @@ bool hash_secondary_dex_file(const std::string& dex_path,
         const std::string& pkgname, int uid, const std::optional<std::string>& volume_uuid,
         int storage_flag, std::vector<uint8_t>* out_secondary_dex_hash);
 
+struct SecondaryDexHash {
+    // False if the dex path is invalid or the file could not be hashed.
+    bool success = false;
+    // The SHA-256 of the file, or empty if it does not exist or is not accessible to the app.
+    std::vector<uint8_t> hash;
+};
+
+// Like hash_secondary_dex_file, for several secondary dex files of the same app. The files are
+// hashed one after the other, in a single child process running as the app. Returns false, with
+// all hashes failed, if the parameters are invalid or the child does not report back.
+bool hash_secondary_dex_files(const std::vector<std::string>& dex_paths,
+        const std::string& pkgname, int uid, const std::optional<std::string>& volume_uuid,
+        int storage_flag, std::vector<SecondaryDexHash>* out_hashes);
+
 // completed pass false if it is canceled. Otherwise it will be true even if there is other
 // error.
 int dexopt(const char *apk_path, uid_t uid, const char *pkgName, const char *instruction_set,
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+#include <cutils/properties.h>
+
+#include "InstalldNativeService.h"
+#include "dexopt.h"
+#include "globals.h"
+#include "utils.h"
+
+using android::base::StringPrintf;
+
+namespace android {
+namespace installd {
+
+// The TEST volume uuid maps to kTestPath, which serves as the data root of the benchmark.
+static constexpr const char* kTestUuid = "TEST";
+static constexpr const char* kTestPath = "/data/local/tmp";
+static constexpr const int32_t kTestUserId = 0;
+static constexpr const int32_t kFirstAppId = 10000;
+
+int get_property(const char* key, char* value, const char* default_value) {
+    return property_get(key, value, default_value);
+}
+
+bool calculate_oat_file_path(char path[PKG_PATH_MAX], const char* oat_dir, const char* apk_path,
+                             const char* instruction_set) {
+    return calculate_oat_file_path_default(path, oat_dir, apk_path, instruction_set);
+}
+
+bool calculate_odex_file_path(char path[PKG_PATH_MAX], const char* apk_path,
+                              const char* instruction_set) {
+    return calculate_odex_file_path_default(path, apk_path, instruction_set);
+}
+
+bool create_cache_path(char path[PKG_PATH_MAX], const char* src, const char* instruction_set) {
+    return create_cache_path_default(path, src, instruction_set);
+}
+
+bool force_compile_without_image() {
+    return false;
+}
+
+namespace {
+
+const std::vector<std::string> kDataDirs = {"user", "user_de", "misc_ce", "misc_de"};
+
+void clearAppData() {
+    for (const auto& dir : kDataDirs) {
+        delete_dir_contents_and_dir(StringPrintf("%s/%s", kTestPath, dir.c_str()), true);
+    }
+}
+
+bool prepareDataRoot() {
+    clearAppData();
+    for (const auto& dir : {"user/0", "user_de/0", "misc_ce/0/sdksandbox",
+                            "misc_de/0/sdksandbox"}) {
+        std::error_code ec;
+        std::filesystem::create_directories(StringPrintf("%s/%s", kTestPath, dir), ec);
+        if (ec) {
+            LOG(ERROR) << "Failed to create " << dir << ": " << ec.message();
+            return false;
+        }
+    }
+    return true;
+}
+
+// A synthetic package set, as PackageManager hands it to installd on user creation.
+std::vector<android::os::CreateAppDataArgs> makePackages(int count) {
+    std::vector<android::os::CreateAppDataArgs> packages;
+    for (int i = 0; i < count; i++) {
+        android::os::CreateAppDataArgs args;
+        args.uuid = kTestUuid;
+        args.packageName = StringPrintf("com.benchmark.package%d", i);
+        args.userId = kTestUserId;
+        args.appId = kFirstAppId + i;
+        args.previousAppId = -1;
+        args.seInfo = "default";
+        args.targetSdkVersion = 34;
+        args.flags = FLAG_STORAGE_CE | FLAG_STORAGE_DE;
+        packages.push_back(args);
+    }
+    return packages;
+}
+
+// Runs create once per iteration over range(0) packages. If range(1) is set, the app data is
+// wiped before every iteration, as on first boot or user creation; otherwise it already exists,
+// as on every later boot and after an OTA.
+template <typename Create>
+void runCreateAppData(benchmark::State& state, Create create) {
+    const auto packages = makePackages(state.range(0));
+    const bool fresh = state.range(1) != 0;
+    if (!prepareDataRoot() || !init_globals_from_data_and_root()) {
+        state.SkipWithError("Could not prepare the data root");
+        return;
+    }
+
+    InstalldNativeService service;
+    if (!fresh && !create(service, packages)) {
+        state.SkipWithError("createAppData failed");
+        return;
+    }
+    for (auto _ : state) {
+        if (fresh) {
+            state.PauseTiming();
+            prepareDataRoot();
+            state.ResumeTiming();
+        }
+        if (!create(service, packages)) {
+            state.SkipWithError("createAppData failed");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * packages.size());
+    clearAppData();
+}
+
+void BM_createAppData_serial(benchmark::State& state) {
+    runCreateAppData(state, [](InstalldNativeService& service, const auto& packages) {
+        for (const auto& args : packages) {
+            android::os::CreateAppDataResult result;
+            service.createAppData(args, &result);
+            if (result.exceptionCode != binder::Status::EX_NONE) {
+                LOG(ERROR) << result.exceptionMessage;
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void BM_createAppDataBatched(benchmark::State& state) {
+    runCreateAppData(state, [](InstalldNativeService& service, const auto& packages) {
+        std::vector<android::os::CreateAppDataResult> results;
+        service.createAppDataBatched(packages, &results);
+        for (const auto& result : results) {
+            if (result.exceptionCode != binder::Status::EX_NONE) {
+                LOG(ERROR) << result.exceptionMessage;
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void packageSets(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"packages", "fresh"});
+    for (int fresh : {1, 0}) {
+        for (int packages : {50, 300}) {
+            b->Args({packages, fresh});
+        }
+    }
+    b->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+BENCHMARK(BM_createAppData_serial)->Apply(packageSets);
+BENCHMARK(BM_createAppDataBatched)->Apply(packageSets);
+
+} // namespace
+} // namespace installd
+} // namespace android
+
+int main(int argc, char** argv) {
+    android::base::InitLogging(argv);
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
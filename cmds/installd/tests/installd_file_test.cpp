@@ -21,7 +21,10 @@
 #include <log/log.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
 
+#include "copy_tree.h"
 #include "restorable_file.h"
 #include "unique_file.h"
 #include "utils.h"
@@ -517,5 +520,68 @@ TEST_F(FileTest, TestRestorableFileRemoveFileAndTmpFileWithContentAndTmpFile) {
     ASSERT_FILE_NOT_EXISTING(backupFile);
 }
 
+TEST_F(FileTest, TestCopyDirectoryRecursivePreservesMetadata) {
+    const std::string from = GetTestFilePath("from");
+    const std::string to = GetTestFilePath("to");
+    ASSERT_EQ(0, mkdir(from.c_str(), 0751));
+    ASSERT_EQ(0, mkdir((from + "/files").c_str(), 02771));
+    ASSERT_EQ(0, mkdir(to.c_str(), 0700));
+    CreateTestFileWithContents(from + "/files/data", "SomeContent");
+    ASSERT_EQ(0, chmod((from + "/files/data").c_str(), 0640));
+    ASSERT_EQ(0, chown((from + "/files/data").c_str(), 10000, 20000));
+    ASSERT_EQ(0, setxattr((from + "/files/data").c_str(), "user.test", "value", 5, 0));
+    ASSERT_EQ(0, symlink("files/data", (from + "/link").c_str()));
+    const struct timespec times[2] = {{1000, 0}, {2000, 0}};
+    ASSERT_EQ(0, utimensat(AT_FDCWD, (from + "/files").c_str(), times, 0));
+
+    ASSERT_EQ(0, copy_directory_recursive(from, to));
+
+    ASSERT_FILE_CONTENT(to + "/from/files/data", "SomeContent");
+    struct stat st;
+    ASSERT_EQ(0, lstat((to + "/from").c_str(), &st));
+    EXPECT_EQ(0751u, st.st_mode & 07777);
+    ASSERT_EQ(0, lstat((to + "/from/files").c_str(), &st));
+    EXPECT_EQ(02771u, st.st_mode & 07777);
+    EXPECT_EQ(2000, st.st_mtim.tv_sec);
+    ASSERT_EQ(0, lstat((to + "/from/files/data").c_str(), &st));
+    EXPECT_EQ(0640u, st.st_mode & 07777);
+    EXPECT_EQ(10000u, st.st_uid);
+    EXPECT_EQ(20000u, st.st_gid);
+    char value[5];
+    ASSERT_EQ(5, getxattr((to + "/from/files/data").c_str(), "user.test", value, sizeof(value)));
+    EXPECT_EQ(0, memcmp("value", value, sizeof(value)));
+
+    std::string target;
+    ASSERT_TRUE(android::base::Readlink(to + "/from/link", &target));
+    EXPECT_EQ("files/data", target);
+}
+
+TEST_F(FileTest, TestCopyDirectoryRecursiveReplacesExistingFiles) {
+    const std::string from = GetTestFilePath("from");
+    const std::string to = GetTestFilePath("to");
+    ASSERT_EQ(0, mkdir(from.c_str(), 0700));
+    ASSERT_EQ(0, mkdir(to.c_str(), 0700));
+    ASSERT_EQ(0, mkdir((to + "/from").c_str(), 0700));
+    for (int i = 0; i < 100; i++) {
+        const std::string name = android::base::StringPrintf("/file%d", i);
+        CreateTestFileWithContents(from + name, "NewContent" + name);
+        CreateTestFileWithContents(to + "/from" + name, "OldContentThatIsLonger");
+        ASSERT_EQ(0, chmod((to + "/from" + name).c_str(), 0400));
+    }
+
+    ASSERT_EQ(0, copy_directory_recursive(from, to));
+
+    for (int i = 0; i < 100; i++) {
+        const std::string name = android::base::StringPrintf("/file%d", i);
+        ASSERT_FILE_CONTENT(to + "/from" + name, "NewContent" + name);
+    }
+}
+
+TEST_F(FileTest, TestCopyDirectoryRecursiveMissingSource) {
+    const std::string to = GetTestFilePath("to");
+    ASSERT_EQ(0, mkdir(to.c_str(), 0700));
+    EXPECT_EQ(ENOENT, copy_directory_recursive(GetTestFilePath("missing"), to));
+}
+
 } // namespace installd
 } // namespace android
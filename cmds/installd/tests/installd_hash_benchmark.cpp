@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <cutils/properties.h>
+#include <openssl/sha.h>
+
+#include "dexopt.h"
+#include "globals.h"
+#include "installd_constants.h"
+#include "utils.h"
+
+using android::base::StringPrintf;
+using android::base::unique_fd;
+
+namespace android {
+namespace installd {
+
+// The TEST volume uuid maps to /data/local/tmp, which serves as the data root of the benchmark.
+static const std::optional<std::string> kTestUuid = "TEST";
+static constexpr const char* kTestPath = "/data/local/tmp";
+static constexpr const char* kPackageName = "com.benchmark.dex";
+static constexpr const int kAppUid = 10000;
+
+int get_property(const char* key, char* value, const char* default_value) {
+    return property_get(key, value, default_value);
+}
+
+bool calculate_oat_file_path(char path[PKG_PATH_MAX], const char* oat_dir, const char* apk_path,
+                             const char* instruction_set) {
+    return calculate_oat_file_path_default(path, oat_dir, apk_path, instruction_set);
+}
+
+bool calculate_odex_file_path(char path[PKG_PATH_MAX], const char* apk_path,
+                              const char* instruction_set) {
+    return calculate_odex_file_path_default(path, apk_path, instruction_set);
+}
+
+bool create_cache_path(char path[PKG_PATH_MAX], const char* src, const char* instruction_set) {
+    return create_cache_path_default(path, src, instruction_set);
+}
+
+bool force_compile_without_image() {
+    return false;
+}
+
+namespace {
+
+std::string packagePath() {
+    return StringPrintf("%s/user/0/%s", kTestPath, kPackageName);
+}
+
+// Creates |count| secondary dex files of |size| bytes each in the app's data directory, readable
+// by the app only.
+bool createDexFiles(int count, int size, std::vector<std::string>* outPaths) {
+    delete_dir_contents_and_dir(StringPrintf("%s/user", kTestPath), true);
+    for (const std::string& dir : {StringPrintf("%s/user", kTestPath),
+                                   StringPrintf("%s/user/0", kTestPath), packagePath()}) {
+        if (mkdir(dir.c_str(), 0751) != 0 || chown(dir.c_str(), kAppUid, kAppUid) != 0) {
+            PLOG(ERROR) << "Failed to create " << dir;
+            return false;
+        }
+    }
+    std::string content(size, '\0');
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < size; j++) {
+            content[j] = static_cast<char>(i + j * 31);
+        }
+        const std::string path = StringPrintf("%s/secondary%d.dex", packagePath().c_str(), i);
+        if (!android::base::WriteStringToFile(content, path, 0600, kAppUid, kAppUid)) {
+            PLOG(ERROR) << "Failed to write " << path;
+            return false;
+        }
+        outPaths->push_back(path);
+    }
+    return true;
+}
+
+// Runs hash over range(0) secondary dex files of range(1) bytes each.
+template <typename Hash>
+void runHash(benchmark::State& state, Hash hash) {
+    const int count = state.range(0);
+    const int size = state.range(1);
+    std::vector<std::string> paths;
+    if (!init_globals_from_data_and_root() || !createDexFiles(count, size, &paths)) {
+        state.SkipWithError("Could not create the secondary dex files");
+        return;
+    }
+    for (auto _ : state) {
+        if (!hash(paths)) {
+            state.SkipWithError("Hashing failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * count * size);
+    delete_dir_contents_and_dir(StringPrintf("%s/user", kTestPath), true);
+}
+
+// The hashing loop the child runs for every file, in-process for reference.
+void BM_hash_readLoop(benchmark::State& state) {
+    runHash(state, [](const std::vector<std::string>& paths) {
+        for (const auto& path : paths) {
+            unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+            if (fd == -1) {
+                return false;
+            }
+            SHA256_CTX ctx;
+            SHA256_Init(&ctx);
+            std::vector<uint8_t> buffer(65536);
+            ssize_t bytes_read;
+            while ((bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()))) > 0) {
+                SHA256_Update(&ctx, buffer.data(), bytes_read);
+            }
+            uint8_t hash[SHA256_DIGEST_LENGTH];
+            SHA256_Final(hash, &ctx);
+            benchmark::DoNotOptimize(hash);
+        }
+        return true;
+    });
+}
+
+// One hashSecondaryDexFile call, and so one child, per file.
+void BM_hashSecondaryDexFile(benchmark::State& state) {
+    runHash(state, [](const std::vector<std::string>& paths) {
+        for (const auto& path : paths) {
+            std::vector<uint8_t> hash;
+            if (!hash_secondary_dex_file(path, kPackageName, kAppUid, kTestUuid, FLAG_STORAGE_CE,
+                                         &hash) ||
+                hash.empty()) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+// All files in one child, hashed one after the other.
+void BM_hashSecondaryDexFiles(benchmark::State& state) {
+    runHash(state, [](const std::vector<std::string>& paths) {
+        std::vector<SecondaryDexHash> hashes;
+        if (!hash_secondary_dex_files(paths, kPackageName, kAppUid, kTestUuid, FLAG_STORAGE_CE,
+                                      &hashes)) {
+            return false;
+        }
+        for (const auto& hash : hashes) {
+            if (!hash.success || hash.hash.empty()) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void dexFileSets(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"files", "size"});
+    b->Args({1, 8 << 20})->Args({8, 8 << 20})->Args({32, 1 << 20});
+    b->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+BENCHMARK(BM_hash_readLoop)->Apply(dexFileSets);
+BENCHMARK(BM_hashSecondaryDexFile)->Apply(dexFileSets);
+BENCHMARK(BM_hashSecondaryDexFiles)->Apply(dexFileSets);
+
+} // namespace
+} // namespace installd
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -465,6 +465,77 @@ TEST_F(ServiceTest, HashSecondaryDex_WrongApp) {
         dexPath, "com.wrong", 10000, testUuid, FLAG_STORAGE_CE, &result));
 }
 
+TEST_F(ServiceTest, HashSecondaryDexFiles) {
+    LOG(INFO) << "HashSecondaryDexFiles";
+
+    mkdir("user/0/com.example", 10000, 10000, 0700);
+    mkdir("user/0/com.example/foo", 10000, 10000, 0700);
+    touch("user/0/com.example/foo/file", 10000, 20000, 0700);
+
+    std::vector<SecondaryDexHash> hashes;
+    EXPECT_TRUE(hash_secondary_dex_files({get_full_path("user/0/com.example/foo/file"),
+                                          get_full_path("user/0/com.example/foo/missing"),
+                                          get_full_path("user/0/com.wrong/foo/file")},
+                                         "com.example", 10000, testUuid, FLAG_STORAGE_CE,
+                                         &hashes));
+    ASSERT_EQ(3U, hashes.size());
+
+    EXPECT_TRUE(hashes[0].success);
+    EXPECT_EQ(32U, hashes[0].hash.size());
+    std::vector<uint8_t> single;
+    EXPECT_BINDER_SUCCESS(service->hashSecondaryDexFile(
+        get_full_path("user/0/com.example/foo/file"), "com.example", 10000, testUuid,
+        FLAG_STORAGE_CE, &single));
+    EXPECT_EQ(single, hashes[0].hash);
+
+    EXPECT_TRUE(hashes[1].success);
+    EXPECT_EQ(0U, hashes[1].hash.size());
+
+    EXPECT_FALSE(hashes[2].success);
+}
+
+TEST_F(ServiceTest, HashSecondaryDexFiles_Binder) {
+    LOG(INFO) << "HashSecondaryDexFiles_Binder";
+
+    mkdir("user/0/com.example", 10000, 10000, 0700);
+    mkdir("user/0/com.example/foo", 10000, 10000, 0700);
+    touch("user/0/com.example/foo/file", 10000, 20000, 0700);
+    touch("user/0/com.example/foo/unreadable", 10000, 20000, 0300);
+
+    std::vector<android::os::SecondaryDexHashResult> results;
+    EXPECT_BINDER_SUCCESS(service->hashSecondaryDexFiles(
+        {get_full_path("user/0/com.example/foo/file"),
+         get_full_path("user/0/com.example/foo/missing"),
+         get_full_path("user/0/com.example/foo/unreadable"),
+         get_full_path("user/0/com.wrong/foo/file")},
+        "com.example", 10000, testUuid, FLAG_STORAGE_CE, &results));
+    ASSERT_EQ(4U, results.size());
+
+    std::vector<uint8_t> single;
+    EXPECT_BINDER_SUCCESS(service->hashSecondaryDexFile(
+        get_full_path("user/0/com.example/foo/file"), "com.example", 10000, testUuid,
+        FLAG_STORAGE_CE, &single));
+    EXPECT_TRUE(results[0].success);
+    EXPECT_EQ(single, results[0].hash);
+
+    EXPECT_TRUE(results[1].success);
+    EXPECT_EQ(0U, results[1].hash.size());
+
+    EXPECT_TRUE(results[2].success);
+    EXPECT_EQ(0U, results[2].hash.size());
+
+    EXPECT_FALSE(results[3].success);
+}
+
+TEST_F(ServiceTest, HashSecondaryDexFiles_InvalidStorageFlag) {
+    LOG(INFO) << "HashSecondaryDexFiles_InvalidStorageFlag";
+
+    std::vector<android::os::SecondaryDexHashResult> results;
+    EXPECT_BINDER_FAIL(service->hashSecondaryDexFiles(
+        {get_full_path("user/0/com.example/foo/file")}, "com.example", 10000, testUuid,
+        FLAG_STORAGE_CE | FLAG_STORAGE_DE, &results));
+}
+
 TEST_F(ServiceTest, CalculateOat) {
     char buf[PKG_PATH_MAX];
 
@@ -1240,6 +1311,31 @@ TEST_F(SdkSandboxDataTest, CreateAppData_CreatesSdkPackageData_WithoutCeFlag) {
     CheckFileAccess("misc_de/0/sdksandbox/com.foo", kSystemUid, kSystemUid, S_IFDIR | 0751);
 }
 
+TEST_F(SdkSandboxDataTest, CreateAppDataBatched_PreservesResultOrder) {
+    std::vector<android::os::CreateAppDataArgs> args;
+    for (int i = 0; i < 16; i++) {
+        args.push_back(createAppDataArgs(StringPrintf("com.foo%d", i)));
+    }
+    // An invalid package name in the middle of the batch fails on its own.
+    args[7].packageName = "../com.invalid";
+
+    std::vector<android::os::CreateAppDataResult> results;
+    ASSERT_BINDER_SUCCESS(service->createAppDataBatched(args, &results));
+    ASSERT_EQ(args.size(), results.size());
+
+    for (size_t i = 0; i < args.size(); i++) {
+        if (i == 7) {
+            EXPECT_EQ(binder::Status::EX_ILLEGAL_ARGUMENT, results[i].exceptionCode);
+            continue;
+        }
+        EXPECT_EQ(binder::Status::EX_NONE, results[i].exceptionCode) << args[i].packageName;
+        const std::string cePath = "/data/local/tmp/user/0/" + args[i].packageName;
+        struct stat st;
+        ASSERT_EQ(0, stat(cePath.c_str(), &st)) << cePath;
+        EXPECT_EQ(static_cast<int64_t>(st.st_ino), results[i].ceDataInode);
+    }
+}
+
 TEST_F(SdkSandboxDataTest, ReconcileSdkData) {
     android::os::ReconcileSdkDataArgs args =
             reconcileSdkDataArgs("com.foo", {"bar@random1", "baz@random2"});
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/macros.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+#include <logwrap/logwrap.h>
+
+#include "copy_tree.h"
+#include "utils.h"
+
+using android::base::StringPrintf;
+
+namespace android {
+namespace installd {
+namespace {
+
+constexpr const char* kBenchmarkDir = "/data/local/tmp/installd_snapshot_benchmark";
+constexpr int kFilesPerDirectory = 50;
+
+std::string sourcePath() {
+    return StringPrintf("%s/com.benchmark.app", kBenchmarkDir);
+}
+
+std::string snapshotPath() {
+    return StringPrintf("%s/snapshot", kBenchmarkDir);
+}
+
+// Creates a synthetic app data tree of |numFiles| files of |fileSize| bytes each, spread over
+// directories of kFilesPerDirectory files.
+bool createAppDataTree(int numFiles, int fileSize) {
+    delete_dir_contents_and_dir(kBenchmarkDir, true);
+    if (mkdir(kBenchmarkDir, 0700) != 0 || mkdir(sourcePath().c_str(), 0700) != 0 ||
+        mkdir(snapshotPath().c_str(), 0700) != 0) {
+        PLOG(ERROR) << "Failed to create " << kBenchmarkDir;
+        return false;
+    }
+    const std::string content(fileSize, 'x');
+    for (int i = 0; i < numFiles; i++) {
+        const std::string dir =
+                StringPrintf("%s/dir%d", sourcePath().c_str(), i / kFilesPerDirectory);
+        if (i % kFilesPerDirectory == 0 && mkdir(dir.c_str(), 0771) != 0) {
+            PLOG(ERROR) << "Failed to create " << dir;
+            return false;
+        }
+        if (!android::base::WriteStringToFile(content, StringPrintf("%s/file%d", dir.c_str(), i))) {
+            PLOG(ERROR) << "Failed to write file " << i;
+            return false;
+        }
+    }
+    return true;
+}
+
+// What snapshotAppData and restoreAppDataSnapshot did before copying in-process.
+int copyWithCp(const char* from, const char* to) {
+    char* argv[] = {(char*)"/system/bin/cp",
+                    (char*)"-F",
+                    (char*)"--preserve=mode,ownership,timestamps,xattr",
+                    (char*)"-R",
+                    (char*)"-P",
+                    (char*)"-d",
+                    (char*)from,
+                    (char*)to};
+    return logwrap_fork_execvp(ARRAY_SIZE(argv), argv, nullptr, false, LOG_ALOG, false, nullptr);
+}
+
+// Snapshots a tree of range(0) files of range(1) bytes each, with |copy|.
+template <typename Copy>
+void runSnapshot(benchmark::State& state, Copy copy) {
+    const int numFiles = state.range(0);
+    const int fileSize = state.range(1);
+    if (!createAppDataTree(numFiles, fileSize)) {
+        state.SkipWithError("Could not create the app data tree");
+        return;
+    }
+    const std::string from = sourcePath();
+    const std::string to = snapshotPath();
+    for (auto _ : state) {
+        state.PauseTiming();
+        delete_dir_contents(to, true);
+        state.ResumeTiming();
+        if (copy(from, to) != 0) {
+            state.SkipWithError("Copy failed");
+            break;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * numFiles * fileSize);
+    delete_dir_contents_and_dir(kBenchmarkDir, true);
+}
+
+void BM_snapshot_cp(benchmark::State& state) {
+    runSnapshot(state, [](const std::string& from, const std::string& to) {
+        return copyWithCp(from.c_str(), to.c_str());
+    });
+}
+
+void BM_snapshot_inProcess(benchmark::State& state) {
+    const size_t maxThreads = state.range(2);
+    runSnapshot(state, [maxThreads](const std::string& from, const std::string& to) {
+        return copy_directory_recursive(from, to, maxThreads);
+    });
+}
+
+void appDataTrees(benchmark::internal::Benchmark* b) {
+    // Many small files, like databases and shared preferences, and fewer large ones, like
+    // downloaded assets.
+    b->Args({2000, 4 * 1024})->Args({100, 4 * 1024 * 1024});
+    b->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+BENCHMARK(BM_snapshot_cp)->ArgNames({"files", "size"})->Apply(appDataTrees);
+BENCHMARK(BM_snapshot_inProcess)
+        ->ArgNames({"files", "size", "threads"})
+        ->Args({2000, 4 * 1024, 1})
+        ->Args({2000, 4 * 1024, kCopyTreeMaxThreads})
+        ->Args({100, 4 * 1024 * 1024, 1})
+        ->Args({100, 4 * 1024 * 1024, kCopyTreeMaxThreads})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+
+} // namespace
+} // namespace installd
+} // namespace android
+
+BENCHMARK_MAIN();
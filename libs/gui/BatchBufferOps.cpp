@@ -20,6 +20,8 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 //#define LOG_NDEBUG 0
 
+#include <gui/BufferItem.h>
+#include <gui/IGraphicBufferConsumer.h>
 #include <gui/IGraphicBufferProducer.h>
 
 namespace android {
@@ -122,4 +124,33 @@ status_t IGraphicBufferProducer::query(const std::vector<int32_t> inputs,
     return NO_ERROR;
 }
 
+status_t IGraphicBufferConsumer::acquireBuffers(int maxBuffers, nsecs_t presentWhen,
+                                                std::vector<BufferItem>* outBuffers) {
+    outBuffers->clear();
+    if (maxBuffers < 1) {
+        return BAD_VALUE;
+    }
+    status_t result = NO_ERROR;
+    while (static_cast<int>(outBuffers->size()) < maxBuffers) {
+        BufferItem buffer;
+        result = acquireBuffer(&buffer, presentWhen);
+        if (result != NO_ERROR) {
+            break;
+        }
+        outBuffers->push_back(std::move(buffer));
+    }
+    return outBuffers->empty() ? result : NO_ERROR;
+}
+
+status_t IGraphicBufferConsumer::releaseBuffers(
+        const std::vector<ReleaseBufferInput>& inputs,
+        std::vector<status_t>* results) {
+    results->clear();
+    results->reserve(inputs.size());
+    for (const ReleaseBufferInput& input : inputs) {
+        results->emplace_back(releaseHelper(input.slot, input.frameNumber, input.fence));
+    }
+    return NO_ERROR;
+}
+
 } // namespace android
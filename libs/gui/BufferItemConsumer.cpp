@@ -105,6 +105,69 @@ status_t BufferItemConsumer::releaseBuffer(const BufferItem &item,
     return err;
 }
 
+status_t BufferItemConsumer::acquireBuffers(std::vector<BufferItem>* items,
+        nsecs_t presentWhen, int maxBuffers, bool waitForFence) {
+    status_t err;
+
+    if (!items) return BAD_VALUE;
+
+    Mutex::Autolock _l(mMutex);
+
+    err = acquireBuffersLocked(items, presentWhen, maxBuffers);
+    if (err != OK) {
+        if (err != NO_BUFFER_AVAILABLE) {
+            BI_LOGE("Error acquiring buffers: %s (%d)", strerror(err), err);
+        }
+        return err;
+    }
+
+    for (BufferItem& item : *items) {
+        if (waitForFence) {
+            err = item.mFence->waitForever("BufferItemConsumer::acquireBuffers");
+            if (err != OK) {
+                BI_LOGE("Failed to wait for fence of acquired buffer: %s (%d)",
+                        strerror(-err), err);
+                return err;
+            }
+        }
+
+        item.mGraphicBuffer = mSlots[item.mSlot].mGraphicBuffer;
+    }
+
+    return OK;
+}
+
+status_t BufferItemConsumer::releaseBuffers(const std::vector<BufferItem>& items,
+        const sp<Fence>& releaseFence) {
+    status_t err;
+
+    Mutex::Autolock _l(mMutex);
+
+    for (const BufferItem& item : items) {
+        err = addReleaseFenceLocked(item.mSlot, item.mGraphicBuffer, releaseFence);
+        if (err != OK) {
+            BI_LOGE("Failed to addReleaseFenceLocked");
+        }
+    }
+
+    std::vector<status_t> results;
+    err = releaseBuffersLocked(items, &results);
+    if (err != OK) {
+        BI_LOGE("Failed to release buffers: %s (%d)", strerror(-err), err);
+        return err;
+    }
+    for (status_t result : results) {
+        if (result != OK) {
+            if (result != IGraphicBufferConsumer::STALE_BUFFER_SLOT) {
+                BI_LOGE("Failed to release buffer: %s (%d)",
+                        strerror(-result), result);
+            }
+            return result;
+        }
+    }
+    return OK;
+}
+
 void BufferItemConsumer::freeBufferLocked(int slotIndex) {
     sp<BufferFreedListener> listener = mBufferFreedListener.promote();
     if (listener != nullptr && mSlots[slotIndex].mGraphicBuffer != nullptr) {
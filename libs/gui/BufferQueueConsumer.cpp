@@ -83,236 +83,313 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
     sp<IProducerListener> listener;
     {
         std::unique_lock<std::mutex> lock(mCore->mMutex);
+        status_t result = acquireBufferLocked(outBuffer, expectedPresent, maxFrameNumber, lock,
+                &numDroppedBuffers, &listener);
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        // We might have freed a slot while dropping old buffers, or the producer
+        // may be blocked waiting for the number of buffers in the queue to
+        // decrease.
+        mCore->mDequeueCondition.notify_all();
+    }
 
-        // Check that the consumer doesn't currently have the maximum number of
-        // buffers acquired. We allow the max buffer count to be exceeded by one
-        // buffer so that the consumer can successfully set up the newly acquired
-        // buffer before releasing the old one.
-        int numAcquiredBuffers = 0;
-        for (int s : mCore->mActiveBuffers) {
-            if (mSlots[s].mBufferState.isAcquired()) {
-                ++numAcquiredBuffers;
+    if (listener != nullptr) {
+        for (int i = 0; i < numDroppedBuffers; ++i) {
+            listener->onBufferReleased();
+        }
+    }
+
+    return NO_ERROR;
+}
+
+status_t BufferQueueConsumer::acquireBuffers(int maxBuffers, nsecs_t expectedPresent,
+        std::vector<BufferItem>* outBuffers) {
+    ATRACE_CALL();
+
+    outBuffers->clear();
+    if (maxBuffers < 1) {
+        BQ_LOGE("acquireBuffers: maxBuffers %d must be positive", maxBuffers);
+        return BAD_VALUE;
+    }
+
+    status_t result = NO_ERROR;
+    int numDroppedBuffers = 0;
+    sp<IProducerListener> listener;
+    {
+        std::unique_lock<std::mutex> lock(mCore->mMutex);
+
+        // Stop before acquireBufferLocked would fail for holding too many buffers, so that a
+        // batch that fills the consumer's quota isn't reported as an error. In shared buffer
+        // mode the same buffer would be returned over and over, so take it only once.
+        const int maxAcquiredBuffers = mCore->mMaxAcquiredBufferCount + 1 +
+                (mCore->mAllowExtraAcquire ? 1 : 0);
+        int numAcquiredBuffers = getAcquiredBufferCountLocked();
+        while (static_cast<int>(outBuffers->size()) < maxBuffers) {
+            if (!outBuffers->empty() &&
+                    (numAcquiredBuffers >= maxAcquiredBuffers || mCore->mSharedBufferMode)) {
+                break;
             }
+            BufferItem& buffer = outBuffers->emplace_back();
+            result = acquireBufferLocked(&buffer, expectedPresent, 0, lock,
+                    &numDroppedBuffers, &listener);
+            if (result != NO_ERROR) {
+                outBuffers->pop_back();
+                break;
+            }
+            ++numAcquiredBuffers;
         }
-        const bool acquireNonDroppableBuffer = mCore->mAllowExtraAcquire &&
-                numAcquiredBuffers == mCore->mMaxAcquiredBufferCount + 1;
-        if (numAcquiredBuffers >= mCore->mMaxAcquiredBufferCount + 1 &&
-            !acquireNonDroppableBuffer) {
-            BQ_LOGE("acquireBuffer: max acquired buffer count reached: %d (max %d)",
-                    numAcquiredBuffers, mCore->mMaxAcquiredBufferCount);
-            return INVALID_OPERATION;
+
+        // Wake up the producer once for the whole batch.
+        if (!outBuffers->empty()) {
+            mCore->mDequeueCondition.notify_all();
         }
+    }
 
-        bool sharedBufferAvailable = mCore->mSharedBufferMode &&
-                mCore->mAutoRefresh && mCore->mSharedBufferSlot !=
-                BufferQueueCore::INVALID_BUFFER_SLOT;
+    if (outBuffers->empty()) {
+        return result;
+    }
 
-        // In asynchronous mode the list is guaranteed to be one buffer deep,
-        // while in synchronous mode we use the oldest buffer.
-        if (mCore->mQueue.empty() && !sharedBufferAvailable) {
-            return NO_BUFFER_AVAILABLE;
+    if (listener != nullptr) {
+        for (int i = 0; i < numDroppedBuffers; ++i) {
+            listener->onBufferReleased();
         }
+    }
 
-        BufferQueueCore::Fifo::iterator front(mCore->mQueue.begin());
-
-        // If expectedPresent is specified, we may not want to return a buffer yet.
-        // If it's specified and there's more than one buffer queued, we may want
-        // to drop a buffer.
-        // Skip this if we're in shared buffer mode and the queue is empty,
-        // since in that case we'll just return the shared buffer.
-        if (expectedPresent != 0 && !mCore->mQueue.empty()) {
-            // The 'expectedPresent' argument indicates when the buffer is expected
-            // to be presented on-screen. If the buffer's desired present time is
-            // earlier (less) than expectedPresent -- meaning it will be displayed
-            // on time or possibly late if we show it as soon as possible -- we
-            // acquire and return it. If we don't want to display it until after the
-            // expectedPresent time, we return PRESENT_LATER without acquiring it.
-            //
-            // To be safe, we don't defer acquisition if expectedPresent is more
-            // than one second in the future beyond the desired present time
-            // (i.e., we'd be holding the buffer for a long time).
-            //
-            // NOTE: Code assumes monotonic time values from the system clock
-            // are positive.
-
-            // Start by checking to see if we can drop frames. We skip this check if
-            // the timestamps are being auto-generated by Surface. If the app isn't
-            // generating timestamps explicitly, it probably doesn't want frames to
-            // be discarded based on them.
-            while (mCore->mQueue.size() > 1 && !mCore->mQueue[0].mIsAutoTimestamp) {
-                const BufferItem& bufferItem(mCore->mQueue[1]);
-
-                // If dropping entry[0] would leave us with a buffer that the
-                // consumer is not yet ready for, don't drop it.
-                if (maxFrameNumber && bufferItem.mFrameNumber > maxFrameNumber) {
-                    break;
-                }
-
-                // If entry[1] is timely, drop entry[0] (and repeat). We apply an
-                // additional criterion here: we only drop the earlier buffer if our
-                // desiredPresent falls within +/- 1 second of the expected present.
-                // Otherwise, bogus desiredPresent times (e.g., 0 or a small
-                // relative timestamp), which normally mean "ignore the timestamp
-                // and acquire immediately", would cause us to drop frames.
-                //
-                // We may want to add an additional criterion: don't drop the
-                // earlier buffer if entry[1]'s fence hasn't signaled yet.
-                nsecs_t desiredPresent = bufferItem.mTimestamp;
-                if (desiredPresent < expectedPresent - MAX_REASONABLE_NSEC ||
-                        desiredPresent > expectedPresent) {
-                    // This buffer is set to display in the near future, or
-                    // desiredPresent is garbage. Either way we don't want to drop
-                    // the previous buffer just to get this on the screen sooner.
-                    BQ_LOGV("acquireBuffer: nodrop desire=%" PRId64 " expect=%"
-                            PRId64 " (%" PRId64 ") now=%" PRId64,
-                            desiredPresent, expectedPresent,
-                            desiredPresent - expectedPresent,
-                            systemTime(CLOCK_MONOTONIC));
-                    break;
-                }
+    BQ_LOGV("acquireBuffers: acquired %zu buffers", outBuffers->size());
+    return NO_ERROR;
+}
 
-                BQ_LOGV("acquireBuffer: drop desire=%" PRId64 " expect=%" PRId64
-                        " size=%zu",
-                        desiredPresent, expectedPresent, mCore->mQueue.size());
-
-                if (!front->mIsStale) {
-                    // Front buffer is still in mSlots, so mark the slot as free
-                    mSlots[front->mSlot].mBufferState.freeQueued();
-
-                    // After leaving shared buffer mode, the shared buffer will
-                    // still be around. Mark it as no longer shared if this
-                    // operation causes it to be free.
-                    if (!mCore->mSharedBufferMode &&
-                            mSlots[front->mSlot].mBufferState.isFree()) {
-                        mSlots[front->mSlot].mBufferState.mShared = false;
-                    }
-
-                    // Don't put the shared buffer on the free list
-                    if (!mSlots[front->mSlot].mBufferState.isShared()) {
-                        mCore->mActiveBuffers.erase(front->mSlot);
-                        mCore->mFreeBuffers.push_back(front->mSlot);
-                    }
-
-                    if (mCore->mBufferReleasedCbEnabled) {
-                        listener = mCore->mConnectedProducerListener;
-                    }
-                    ++numDroppedBuffers;
-                }
+status_t BufferQueueConsumer::acquireBufferLocked(BufferItem* outBuffer,
+        nsecs_t expectedPresent, uint64_t maxFrameNumber,
+        std::unique_lock<std::mutex>& lock, int* outNumDroppedBuffers,
+        sp<IProducerListener>* outListener) {
+    // Check that the consumer doesn't currently have the maximum number of
+    // buffers acquired. We allow the max buffer count to be exceeded by one
+    // buffer so that the consumer can successfully set up the newly acquired
+    // buffer before releasing the old one.
+    const int numAcquiredBuffers = getAcquiredBufferCountLocked();
+    const bool acquireNonDroppableBuffer = mCore->mAllowExtraAcquire &&
+            numAcquiredBuffers == mCore->mMaxAcquiredBufferCount + 1;
+    if (numAcquiredBuffers >= mCore->mMaxAcquiredBufferCount + 1 &&
+        !acquireNonDroppableBuffer) {
+        BQ_LOGE("acquireBuffer: max acquired buffer count reached: %d (max %d)",
+                numAcquiredBuffers, mCore->mMaxAcquiredBufferCount);
+        return INVALID_OPERATION;
+    }
 
-                mCore->mQueue.erase(front);
-                front = mCore->mQueue.begin();
+    bool sharedBufferAvailable = mCore->mSharedBufferMode &&
+            mCore->mAutoRefresh && mCore->mSharedBufferSlot !=
+            BufferQueueCore::INVALID_BUFFER_SLOT;
+
+    // In asynchronous mode the list is guaranteed to be one buffer deep,
+    // while in synchronous mode we use the oldest buffer.
+    if (mCore->mQueue.empty() && !sharedBufferAvailable) {
+        return NO_BUFFER_AVAILABLE;
+    }
+
+    BufferQueueCore::Fifo::iterator front(mCore->mQueue.begin());
+
+    // If expectedPresent is specified, we may not want to return a buffer yet.
+    // If it's specified and there's more than one buffer queued, we may want
+    // to drop a buffer.
+    // Skip this if we're in shared buffer mode and the queue is empty,
+    // since in that case we'll just return the shared buffer.
+    if (expectedPresent != 0 && !mCore->mQueue.empty()) {
+        // The 'expectedPresent' argument indicates when the buffer is expected
+        // to be presented on-screen. If the buffer's desired present time is
+        // earlier (less) than expectedPresent -- meaning it will be displayed
+        // on time or possibly late if we show it as soon as possible -- we
+        // acquire and return it. If we don't want to display it until after the
+        // expectedPresent time, we return PRESENT_LATER without acquiring it.
+        //
+        // To be safe, we don't defer acquisition if expectedPresent is more
+        // than one second in the future beyond the desired present time
+        // (i.e., we'd be holding the buffer for a long time).
+        //
+        // NOTE: Code assumes monotonic time values from the system clock
+        // are positive.
+
+        // Start by checking to see if we can drop frames. We skip this check if
+        // the timestamps are being auto-generated by Surface. If the app isn't
+        // generating timestamps explicitly, it probably doesn't want frames to
+        // be discarded based on them.
+        while (mCore->mQueue.size() > 1 && !mCore->mQueue[0].mIsAutoTimestamp) {
+            const BufferItem& bufferItem(mCore->mQueue[1]);
+
+            // If dropping entry[0] would leave us with a buffer that the
+            // consumer is not yet ready for, don't drop it.
+            if (maxFrameNumber && bufferItem.mFrameNumber > maxFrameNumber) {
+                break;
             }
 
-            // See if the front buffer is ready to be acquired
-            nsecs_t desiredPresent = front->mTimestamp;
-            bool bufferIsDue = desiredPresent <= expectedPresent ||
-                    desiredPresent > expectedPresent + MAX_REASONABLE_NSEC;
-            bool consumerIsReady = maxFrameNumber > 0 ?
-                    front->mFrameNumber <= maxFrameNumber : true;
-            if (!bufferIsDue || !consumerIsReady) {
-                BQ_LOGV("acquireBuffer: defer desire=%" PRId64 " expect=%" PRId64
-                        " (%" PRId64 ") now=%" PRId64 " frame=%" PRIu64
-                        " consumer=%" PRIu64,
+            // If entry[1] is timely, drop entry[0] (and repeat). We apply an
+            // additional criterion here: we only drop the earlier buffer if our
+            // desiredPresent falls within +/- 1 second of the expected present.
+            // Otherwise, bogus desiredPresent times (e.g., 0 or a small
+            // relative timestamp), which normally mean "ignore the timestamp
+            // and acquire immediately", would cause us to drop frames.
+            //
+            // We may want to add an additional criterion: don't drop the
+            // earlier buffer if entry[1]'s fence hasn't signaled yet.
+            nsecs_t desiredPresent = bufferItem.mTimestamp;
+            if (desiredPresent < expectedPresent - MAX_REASONABLE_NSEC ||
+                    desiredPresent > expectedPresent) {
+                // This buffer is set to display in the near future, or
+                // desiredPresent is garbage. Either way we don't want to drop
+                // the previous buffer just to get this on the screen sooner.
+                BQ_LOGV("acquireBuffer: nodrop desire=%" PRId64 " expect=%"
+                        PRId64 " (%" PRId64 ") now=%" PRId64,
                         desiredPresent, expectedPresent,
                         desiredPresent - expectedPresent,
-                        systemTime(CLOCK_MONOTONIC),
-                        front->mFrameNumber, maxFrameNumber);
-                ATRACE_NAME("PRESENT_LATER");
-                return PRESENT_LATER;
+                        systemTime(CLOCK_MONOTONIC));
+                break;
             }
 
-            BQ_LOGV("acquireBuffer: accept desire=%" PRId64 " expect=%" PRId64 " "
-                    "(%" PRId64 ") now=%" PRId64, desiredPresent, expectedPresent,
-                    desiredPresent - expectedPresent,
-                    systemTime(CLOCK_MONOTONIC));
-        }
+            BQ_LOGV("acquireBuffer: drop desire=%" PRId64 " expect=%" PRId64
+                    " size=%zu",
+                    desiredPresent, expectedPresent, mCore->mQueue.size());
 
-        int slot = BufferQueueCore::INVALID_BUFFER_SLOT;
-
-        if (sharedBufferAvailable && mCore->mQueue.empty()) {
-            // make sure the buffer has finished allocating before acquiring it
-            mCore->waitWhileAllocatingLocked(lock);
-
-            slot = mCore->mSharedBufferSlot;
-
-            // Recreate the BufferItem for the shared buffer from the data that
-            // was cached when it was last queued.
-            outBuffer->mGraphicBuffer = mSlots[slot].mGraphicBuffer;
-            outBuffer->mFence = Fence::NO_FENCE;
-            outBuffer->mFenceTime = FenceTime::NO_FENCE;
-            outBuffer->mCrop = mCore->mSharedBufferCache.crop;
-            outBuffer->mTransform = mCore->mSharedBufferCache.transform &
-                    ~static_cast<uint32_t>(
-                    NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY);
-            outBuffer->mScalingMode = mCore->mSharedBufferCache.scalingMode;
-            outBuffer->mDataSpace = mCore->mSharedBufferCache.dataspace;
-            outBuffer->mFrameNumber = mCore->mFrameCounter;
-            outBuffer->mSlot = slot;
-            outBuffer->mAcquireCalled = mSlots[slot].mAcquireCalled;
-            outBuffer->mTransformToDisplayInverse =
-                    (mCore->mSharedBufferCache.transform &
-                    NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) != 0;
-            outBuffer->mSurfaceDamage = Region::INVALID_REGION;
-            outBuffer->mQueuedBuffer = false;
-            outBuffer->mIsStale = false;
-            outBuffer->mAutoRefresh = mCore->mSharedBufferMode &&
-                    mCore->mAutoRefresh;
-        } else if (acquireNonDroppableBuffer && front->mIsDroppable) {
-            BQ_LOGV("acquireBuffer: front buffer is not droppable");
-            return NO_BUFFER_AVAILABLE;
-        } else {
-            slot = front->mSlot;
-            *outBuffer = *front;
-        }
+            if (!front->mIsStale) {
+                // Front buffer is still in mSlots, so mark the slot as free
+                mSlots[front->mSlot].mBufferState.freeQueued();
 
-        ATRACE_BUFFER_INDEX(slot);
+                // After leaving shared buffer mode, the shared buffer will
+                // still be around. Mark it as no longer shared if this
+                // operation causes it to be free.
+                if (!mCore->mSharedBufferMode &&
+                        mSlots[front->mSlot].mBufferState.isFree()) {
+                    mSlots[front->mSlot].mBufferState.mShared = false;
+                }
 
-        BQ_LOGV("acquireBuffer: acquiring { slot=%d/%" PRIu64 " buffer=%p }",
-                slot, outBuffer->mFrameNumber, outBuffer->mGraphicBuffer->handle);
+                // Don't put the shared buffer on the free list
+                if (!mSlots[front->mSlot].mBufferState.isShared()) {
+                    mCore->mActiveBuffers.erase(front->mSlot);
+                    mCore->mFreeBuffers.push_back(front->mSlot);
+                }
 
-        if (!outBuffer->mIsStale) {
-            mSlots[slot].mAcquireCalled = true;
-            // Don't decrease the queue count if the BufferItem wasn't
-            // previously in the queue. This happens in shared buffer mode when
-            // the queue is empty and the BufferItem is created above.
-            if (mCore->mQueue.empty()) {
-                mSlots[slot].mBufferState.acquireNotInQueue();
-            } else {
-                mSlots[slot].mBufferState.acquire();
+                if (mCore->mBufferReleasedCbEnabled) {
+                    *outListener = mCore->mConnectedProducerListener;
+                }
+                ++*outNumDroppedBuffers;
             }
-            mSlots[slot].mFence = Fence::NO_FENCE;
+
+            mCore->mQueue.erase(front);
+            front = mCore->mQueue.begin();
         }
 
-        // If the buffer has previously been acquired by the consumer, set
-        // mGraphicBuffer to NULL to avoid unnecessarily remapping this buffer
-        // on the consumer side
-        if (outBuffer->mAcquireCalled) {
-            outBuffer->mGraphicBuffer = nullptr;
+        // See if the front buffer is ready to be acquired
+        nsecs_t desiredPresent = front->mTimestamp;
+        bool bufferIsDue = desiredPresent <= expectedPresent ||
+                desiredPresent > expectedPresent + MAX_REASONABLE_NSEC;
+        bool consumerIsReady = maxFrameNumber > 0 ?
+                front->mFrameNumber <= maxFrameNumber : true;
+        if (!bufferIsDue || !consumerIsReady) {
+            BQ_LOGV("acquireBuffer: defer desire=%" PRId64 " expect=%" PRId64
+                    " (%" PRId64 ") now=%" PRId64 " frame=%" PRIu64
+                    " consumer=%" PRIu64,
+                    desiredPresent, expectedPresent,
+                    desiredPresent - expectedPresent,
+                    systemTime(CLOCK_MONOTONIC),
+                    front->mFrameNumber, maxFrameNumber);
+            ATRACE_NAME("PRESENT_LATER");
+            return PRESENT_LATER;
         }
 
-        mCore->mQueue.erase(front);
+        BQ_LOGV("acquireBuffer: accept desire=%" PRId64 " expect=%" PRId64 " "
+                "(%" PRId64 ") now=%" PRId64, desiredPresent, expectedPresent,
+                desiredPresent - expectedPresent,
+                systemTime(CLOCK_MONOTONIC));
+    }
 
-        // We might have freed a slot while dropping old buffers, or the producer
-        // may be blocked waiting for the number of buffers in the queue to
-        // decrease.
-        mCore->mDequeueCondition.notify_all();
+    int slot = BufferQueueCore::INVALID_BUFFER_SLOT;
 
-        ATRACE_INT(mCore->mConsumerName.c_str(), static_cast<int32_t>(mCore->mQueue.size()));
-#ifndef NO_BINDER
-        mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
-#endif
-        VALIDATE_CONSISTENCY();
+    if (sharedBufferAvailable && mCore->mQueue.empty()) {
+        // make sure the buffer has finished allocating before acquiring it
+        mCore->waitWhileAllocatingLocked(lock);
+
+        slot = mCore->mSharedBufferSlot;
+
+        // Recreate the BufferItem for the shared buffer from the data that
+        // was cached when it was last queued.
+        outBuffer->mGraphicBuffer = mSlots[slot].mGraphicBuffer;
+        outBuffer->mFence = Fence::NO_FENCE;
+        outBuffer->mFenceTime = FenceTime::NO_FENCE;
+        outBuffer->mCrop = mCore->mSharedBufferCache.crop;
+        outBuffer->mTransform = mCore->mSharedBufferCache.transform &
+                ~static_cast<uint32_t>(
+                NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY);
+        outBuffer->mScalingMode = mCore->mSharedBufferCache.scalingMode;
+        outBuffer->mDataSpace = mCore->mSharedBufferCache.dataspace;
+        outBuffer->mFrameNumber = mCore->mFrameCounter;
+        outBuffer->mSlot = slot;
+        outBuffer->mAcquireCalled = mSlots[slot].mAcquireCalled;
+        outBuffer->mTransformToDisplayInverse =
+                (mCore->mSharedBufferCache.transform &
+                NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) != 0;
+        outBuffer->mSurfaceDamage = Region::INVALID_REGION;
+        outBuffer->mQueuedBuffer = false;
+        outBuffer->mIsStale = false;
+        outBuffer->mAutoRefresh = mCore->mSharedBufferMode &&
+                mCore->mAutoRefresh;
+    } else if (acquireNonDroppableBuffer && front->mIsDroppable) {
+        BQ_LOGV("acquireBuffer: front buffer is not droppable");
+        return NO_BUFFER_AVAILABLE;
+    } else {
+        slot = front->mSlot;
+        *outBuffer = *front;
     }
 
-    if (listener != nullptr) {
-        for (int i = 0; i < numDroppedBuffers; ++i) {
-            listener->onBufferReleased();
+    ATRACE_BUFFER_INDEX(slot);
+
+    BQ_LOGV("acquireBuffer: acquiring { slot=%d/%" PRIu64 " buffer=%p }",
+            slot, outBuffer->mFrameNumber, outBuffer->mGraphicBuffer->handle);
+
+    if (!outBuffer->mIsStale) {
+        const nsecs_t now = systemTime();
+        mSlots[slot].mAcquireCalled = true;
+        // Don't decrease the queue count if the BufferItem wasn't
+        // previously in the queue. This happens in shared buffer mode when
+        // the queue is empty and the BufferItem is created above.
+        if (mCore->mQueue.empty()) {
+            mSlots[slot].mBufferState.acquireNotInQueue();
+        } else {
+            mSlots[slot].mBufferState.acquire();
+            mCore->mStats.recordQueueToAcquire(now - mSlots[slot].mQueueTime);
         }
+        mSlots[slot].mFence = Fence::NO_FENCE;
+        mSlots[slot].mAcquireTime = now;
+    }
+
+    // If the buffer has previously been acquired by the consumer, set
+    // mGraphicBuffer to NULL to avoid unnecessarily remapping this buffer
+    // on the consumer side
+    if (outBuffer->mAcquireCalled) {
+        outBuffer->mGraphicBuffer = nullptr;
     }
 
+    mCore->mQueue.erase(front);
+
+    ATRACE_INT(mCore->mConsumerName.c_str(), static_cast<int32_t>(mCore->mQueue.size()));
+#ifndef NO_BINDER
+    mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
+#endif
+    VALIDATE_CONSISTENCY();
+
     return NO_ERROR;
 }
 
+int BufferQueueConsumer::getAcquiredBufferCountLocked() const {
+    int numAcquiredBuffers = 0;
+    for (int s : mCore->mActiveBuffers) {
+        if (mSlots[s].mBufferState.isAcquired()) {
+            ++numAcquiredBuffers;
+        }
+    }
+    return numAcquiredBuffers;
+}
+
 status_t BufferQueueConsumer::detachBuffer(int slot) {
     ATRACE_CALL();
     ATRACE_BUFFER_INDEX(slot);
@@ -451,66 +528,118 @@ status_t BufferQueueConsumer::releaseBuffer(int slot, uint64_t frameNumber,
         const sp<Fence>& releaseFence, EGLDisplay eglDisplay,
         EGLSyncKHR eglFence) {
     ATRACE_CALL();
-    ATRACE_BUFFER_INDEX(slot);
-
-    if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS ||
-            releaseFence == nullptr) {
-        BQ_LOGE("releaseBuffer: slot %d out of range or fence %p NULL", slot,
-                releaseFence.get());
-        return BAD_VALUE;
-    }
 
     sp<IProducerListener> listener;
     { // Autolock scope
         std::lock_guard<std::mutex> lock(mCore->mMutex);
-
-        // If the frame number has changed because the buffer has been reallocated,
-        // we can ignore this releaseBuffer for the old buffer.
-        // Ignore this for the shared buffer where the frame number can easily
-        // get out of sync due to the buffer being queued and acquired at the
-        // same time.
-        if (frameNumber != mSlots[slot].mFrameNumber &&
-                !mSlots[slot].mBufferState.isShared()) {
-            return STALE_BUFFER_SLOT;
+        status_t result = releaseBufferLocked(slot, frameNumber, releaseFence, eglDisplay,
+                eglFence, &listener);
+        if (result != NO_ERROR) {
+            return result;
         }
 
-        if (!mSlots[slot].mBufferState.isAcquired()) {
-            BQ_LOGE("releaseBuffer: attempted to release buffer slot %d "
-                    "but its state was %s", slot,
-                    mSlots[slot].mBufferState.string());
-            return BAD_VALUE;
-        }
+        mCore->mDequeueCondition.notify_all();
+        VALIDATE_CONSISTENCY();
+    } // Autolock scope
 
-        mSlots[slot].mEglDisplay = eglDisplay;
-        mSlots[slot].mEglFence = eglFence;
-        mSlots[slot].mFence = releaseFence;
-        mSlots[slot].mBufferState.release();
+    // Call back without lock held
+    if (listener != nullptr) {
+        listener->onBufferReleased();
+    }
 
-        // After leaving shared buffer mode, the shared buffer will
-        // still be around. Mark it as no longer shared if this
-        // operation causes it to be free.
-        if (!mCore->mSharedBufferMode && mSlots[slot].mBufferState.isFree()) {
-            mSlots[slot].mBufferState.mShared = false;
-        }
-        // Don't put the shared buffer on the free list.
-        if (!mSlots[slot].mBufferState.isShared()) {
-            mCore->mActiveBuffers.erase(slot);
-            mCore->mFreeBuffers.push_back(slot);
-        }
+    return NO_ERROR;
+}
 
-        if (mCore->mBufferReleasedCbEnabled) {
-            listener = mCore->mConnectedProducerListener;
+status_t BufferQueueConsumer::releaseBuffers(const std::vector<ReleaseBufferInput>& inputs,
+        std::vector<status_t>* results) {
+    ATRACE_CALL();
+
+    results->clear();
+    results->reserve(inputs.size());
+
+    int numReleasedBuffers = 0;
+    sp<IProducerListener> listener;
+    { // Autolock scope
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        for (const ReleaseBufferInput& input : inputs) {
+            status_t result = releaseBufferLocked(input.slot, input.frameNumber, input.fence,
+                    EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, &listener);
+            if (result == NO_ERROR) {
+                ++numReleasedBuffers;
+            }
+            results->push_back(result);
         }
-        BQ_LOGV("releaseBuffer: releasing slot %d", slot);
 
-        mCore->mDequeueCondition.notify_all();
-        VALIDATE_CONSISTENCY();
+        if (numReleasedBuffers > 0) {
+            mCore->mDequeueCondition.notify_all();
+            VALIDATE_CONSISTENCY();
+        }
     } // Autolock scope
 
     // Call back without lock held
     if (listener != nullptr) {
-        listener->onBufferReleased();
+        for (int i = 0; i < numReleasedBuffers; ++i) {
+            listener->onBufferReleased();
+        }
+    }
+
+    return NO_ERROR;
+}
+
+status_t BufferQueueConsumer::releaseBufferLocked(int slot, uint64_t frameNumber,
+        const sp<Fence>& releaseFence, EGLDisplay eglDisplay, EGLSyncKHR eglFence,
+        sp<IProducerListener>* outListener) {
+    ATRACE_BUFFER_INDEX(slot);
+
+    if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS ||
+            releaseFence == nullptr) {
+        BQ_LOGE("releaseBuffer: slot %d out of range or fence %p NULL", slot,
+                releaseFence.get());
+        return BAD_VALUE;
+    }
+
+    // If the frame number has changed because the buffer has been reallocated,
+    // we can ignore this releaseBuffer for the old buffer.
+    // Ignore this for the shared buffer where the frame number can easily
+    // get out of sync due to the buffer being queued and acquired at the
+    // same time.
+    if (frameNumber != mSlots[slot].mFrameNumber &&
+            !mSlots[slot].mBufferState.isShared()) {
+        return STALE_BUFFER_SLOT;
+    }
+
+    if (!mSlots[slot].mBufferState.isAcquired()) {
+        BQ_LOGE("releaseBuffer: attempted to release buffer slot %d "
+                "but its state was %s", slot,
+                mSlots[slot].mBufferState.string());
+        return BAD_VALUE;
+    }
+
+    mSlots[slot].mEglDisplay = eglDisplay;
+    mSlots[slot].mEglFence = eglFence;
+    mSlots[slot].mFence = releaseFence;
+    mSlots[slot].mBufferState.release();
+    if (mSlots[slot].mAcquireTime != 0) {
+        mCore->mStats.recordHold(systemTime() - mSlots[slot].mAcquireTime);
+        mSlots[slot].mAcquireTime = 0;
+    }
+
+    // After leaving shared buffer mode, the shared buffer will
+    // still be around. Mark it as no longer shared if this
+    // operation causes it to be free.
+    if (!mCore->mSharedBufferMode && mSlots[slot].mBufferState.isFree()) {
+        mSlots[slot].mBufferState.mShared = false;
+    }
+    // Don't put the shared buffer on the free list.
+    if (!mSlots[slot].mBufferState.isShared()) {
+        mCore->mActiveBuffers.erase(slot);
+        mCore->mFreeBuffers.push_back(slot);
+    }
+
+    if (mCore->mBufferReleasedCbEnabled) {
+        *outListener = mCore->mConnectedProducerListener;
     }
+    BQ_LOGV("releaseBuffer: releasing slot %d", slot);
 
     return NO_ERROR;
 }
@@ -728,6 +857,7 @@ status_t BufferQueueConsumer::setConsumerName(const String8& name) {
     BQ_LOGV("setConsumerName: '%s'", name.c_str());
     std::lock_guard<std::mutex> lock(mCore->mMutex);
     mCore->mConsumerName = name;
+    mCore->mStats.setConsumerName(name.c_str());
     mConsumerName = name;
     return NO_ERROR;
 }
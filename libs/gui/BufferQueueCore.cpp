@@ -131,6 +131,8 @@ BufferQueueCore::BufferQueueCore()
         mUniqueId(getUniqueId()),
         mAutoPrerotation(false),
         mTransformHintInUse(0) {
+    mStats.setConsumerName(mConsumerName.c_str());
+
     int numStartingBuffers = getMaxBufferCountLocked();
     for (int s = 0; s < numStartingBuffers; s++) {
         mFreeSlots.insert(s);
@@ -261,6 +263,7 @@ void BufferQueueCore::clearBufferSlotLocked(int slot) {
     mSlots[slot].mFrameNumber = 0;
     mSlots[slot].mAcquireCalled = false;
     mSlots[slot].mNeedsReallocation = true;
+    mSlots[slot].mAcquireTime = 0;
 
     // Destroy fence as BufferQueue now takes ownership
     if (mSlots[slot].mEglFence != EGL_NO_SYNC_KHR) {
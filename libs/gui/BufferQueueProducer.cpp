@@ -373,15 +373,21 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
                     (acquiredCount <= mCore->mMaxAcquiredBufferCount)) {
                 return WOULD_BLOCK;
             }
+            const nsecs_t waitStartTime = systemTime();
+            bool timedOut = false;
             if (mDequeueTimeout >= 0) {
                 std::cv_status result = mCore->mDequeueCondition.wait_for(lock,
                         std::chrono::nanoseconds(mDequeueTimeout));
-                if (result == std::cv_status::timeout) {
-                    return TIMED_OUT;
-                }
+                timedOut = result == std::cv_status::timeout;
             } else {
                 mCore->mDequeueCondition.wait(lock);
             }
+            if (caller == FreeSlotCaller::Dequeue) {
+                mCore->mStats.recordDequeueBlock(systemTime() - waitStartTime);
+            }
+            if (timedOut) {
+                return TIMED_OUT;
+            }
         }
     } // while (tryAgain)
 
@@ -504,6 +510,7 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
         mSlots[found].mNeedsReallocation = false;
 
         mSlots[found].mBufferState.dequeue();
+        mCore->mStats.recordDequeue();
 
         if ((buffer == nullptr) ||
                 buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage))
@@ -946,6 +953,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 
         mSlots[slot].mFence = acquireFence;
         mSlots[slot].mBufferState.queue();
+        mSlots[slot].mQueueTime = systemTime();
 
         // Increment the frame counter and store a local version of it
         // for use outside the lock on mCore->mMutex.
@@ -1052,6 +1060,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 #ifndef NO_BINDER
         mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
 #endif
+        mCore->mStats.recordOccupancy(mCore->mQueue.size());
         // Take a ticket for the callback functions
         callbackTicket = mNextCallbackTicket++;
 
@@ -1254,7 +1263,7 @@ int BufferQueueProducer::query(int what, int *outValue) {
 status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
         int api, bool producerControlledByApp, QueueBufferOutput *output) {
     ATRACE_CALL();
-    std::lock_guard<std::mutex> lock(mCore->mMutex);
+    std::unique_lock<std::mutex> lock(mCore->mMutex);
     mConsumerName = mCore->mConsumerName;
     BQ_LOGV("connect: api=%d producerControlledByApp=%s", api,
             producerControlledByApp ? "true" : "false");
@@ -1331,7 +1340,8 @@ status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
             status = BAD_VALUE;
             break;
     }
-    mCore->mConnectedPid = BufferQueueThreadState::getCallingPid();
+    const pid_t connectedPid = BufferQueueThreadState::getCallingPid();
+    mCore->mConnectedPid = connectedPid;
     mCore->mBufferHasBeenQueued = false;
     mCore->mDequeueBufferCannotBlock = false;
     mCore->mQueueBufferCanDrop = false;
@@ -1343,6 +1353,10 @@ status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
 
     mCore->mAllowAllocation = true;
     VALIDATE_CONSISTENCY();
+    lock.unlock();
+
+    // Resolving the name reads /proc, so it is done without blocking the consumer.
+    mCore->mStats.setProducerPid(connectedPid);
     return status;
 }
 
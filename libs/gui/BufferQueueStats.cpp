@@ -0,0 +1,320 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BufferQueueStats"
+
+#include <gui/BufferQueueStats.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <unordered_set>
+#include <utility>
+
+namespace android {
+
+namespace {
+
+// Destroyed BufferQueues are folded into at most this many aggregates, past which they are all
+// folded into kOtherName, as consumer names often carry a unique id.
+constexpr size_t kMaxRetiredAggregates = 256;
+constexpr const char* kOtherName = "<other>";
+
+std::string getProcessName(pid_t pid) {
+    if (pid < 0) {
+        return "<none>";
+    }
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+    std::string name = std::to_string(pid);
+    if (FILE* fp = fopen(path, "r")) {
+        char procName[64];
+        if (fgets(procName, sizeof(procName), fp) != nullptr) {
+            name.append(":").append(procName);
+        }
+        fclose(fp);
+    }
+    return name;
+}
+
+nsecs_t bucketUpperBound(size_t bucket) {
+    return us2ns(static_cast<nsecs_t>(1) << bucket);
+}
+
+void appendHistogram(std::string& result, const char* name,
+                     const BufferQueueStats::Histogram& histogram) {
+    char line[160];
+    snprintf(line, sizeof(line),
+             "      %-17s n=%-8" PRIu64 " p50=%" PRId64 " p90=%" PRId64 " p99=%" PRId64
+             " max=%" PRId64 "\n",
+             name, histogram.count, ns2us(histogram.percentile(50)),
+             ns2us(histogram.percentile(90)), ns2us(histogram.percentile(99)),
+             ns2us(histogram.max));
+    result.append(line);
+}
+
+} // namespace
+
+void BufferQueueStats::Histogram::merge(const Histogram& other) {
+    for (size_t i = 0; i < kDurationBucketCount; i++) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    total += other.total;
+    max = std::max(max, other.max);
+}
+
+nsecs_t BufferQueueStats::Histogram::percentile(float percent) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank =
+            std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(count * percent / 100)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i + 1 < kDurationBucketCount; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+void BufferQueueStats::Snapshot::merge(const Snapshot& other) {
+    dequeueCount += other.dequeueCount;
+    dequeueBlockTime.merge(other.dequeueBlockTime);
+    queueToAcquireTime.merge(other.queueToAcquireTime);
+    holdTime.merge(other.holdTime);
+    for (size_t i = 0; i < kOccupancyBucketCount; i++) {
+        occupancy[i] += other.occupancy[i];
+    }
+}
+
+void BufferQueueStats::AtomicHistogram::record(nsecs_t duration) {
+    duration = std::max<nsecs_t>(duration, 0);
+    const uint64_t micros = static_cast<uint64_t>(ns2us(duration));
+    // A duration in [2^(i-1)us, 2^i us) is i bits wide in microseconds.
+    const size_t bucket = micros == 0
+            ? 0
+            : std::min<size_t>(64 - __builtin_clzll(micros), kDurationBucketCount - 1);
+    mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mTotal.fetch_add(duration, std::memory_order_relaxed);
+    nsecs_t max = mMax.load(std::memory_order_relaxed);
+    while (max < duration &&
+           !mMax.compare_exchange_weak(max, duration, std::memory_order_relaxed)) {
+    }
+}
+
+BufferQueueStats::Histogram BufferQueueStats::AtomicHistogram::load() const {
+    Histogram histogram;
+    for (size_t i = 0; i < kDurationBucketCount; i++) {
+        histogram.buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+    }
+    histogram.count = mCount.load(std::memory_order_relaxed);
+    histogram.total = mTotal.load(std::memory_order_relaxed);
+    histogram.max = mMax.load(std::memory_order_relaxed);
+    return histogram;
+}
+
+// Keeps track of the live BufferQueueStats of the process, and of the stats of the destroyed
+// ones. Its lock is only taken when a BufferQueue is created or destroyed, and to collect the
+// stats.
+class BufferQueueStats::Registry {
+public:
+    static Registry& get() {
+        // Never destroyed, as BufferQueues may outlive static destructors.
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    void add(BufferQueueStats* stats) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLive.insert(stats);
+    }
+
+    void remove(BufferQueueStats* stats) {
+        // The BufferQueue is being destroyed, so nothing records into stats anymore. The producer
+        // name was resolved when it connected, as the process may be gone by now.
+        const std::string producerName = stats->getProducerName();
+        const std::string consumerName = stats->getConsumerName();
+        const Snapshot snapshot = stats->snapshot();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mLive.erase(stats);
+        Key key{producerName, consumerName};
+        auto it = mRetired.find(key);
+        if (it == mRetired.end() && mRetired.size() >= kMaxRetiredAggregates) {
+            key = Key{kOtherName, kOtherName};
+            it = mRetired.find(key);
+        }
+        if (it == mRetired.end()) {
+            it = mRetired.emplace(key, Snapshot()).first;
+        }
+        it->second.merge(snapshot);
+    }
+
+    std::vector<Aggregate> collect() {
+        struct LiveStats {
+            std::string producerName;
+            std::string consumerName;
+            Snapshot snapshot;
+        };
+        std::vector<LiveStats> live;
+        std::map<Key, Snapshot> retired;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            live.reserve(mLive.size());
+            for (const BufferQueueStats* stats : mLive) {
+                live.push_back({stats->getProducerName(), stats->getConsumerName(),
+                                stats->snapshot()});
+            }
+            retired = mRetired;
+        }
+
+        std::map<Key, Aggregate> aggregates;
+        for (const auto& [key, snapshot] : retired) {
+            Aggregate& aggregate = aggregates[key];
+            aggregate.producerName = key.first;
+            aggregate.consumerName = key.second;
+            aggregate.stats.merge(snapshot);
+        }
+        for (const LiveStats& stats : live) {
+            const Key key{stats.producerName, stats.consumerName};
+            Aggregate& aggregate = aggregates[key];
+            aggregate.producerName = key.first;
+            aggregate.consumerName = key.second;
+            aggregate.liveQueueCount++;
+            aggregate.stats.merge(stats.snapshot);
+        }
+
+        std::vector<Aggregate> result;
+        result.reserve(aggregates.size());
+        for (auto& [key, aggregate] : aggregates) {
+            result.push_back(std::move(aggregate));
+        }
+        return result;
+    }
+
+private:
+    // Producer process and consumer name.
+    using Key = std::pair<std::string, std::string>;
+
+    std::mutex mMutex;
+    std::unordered_set<BufferQueueStats*> mLive;
+    std::map<Key, Snapshot> mRetired;
+};
+
+BufferQueueStats::BufferQueueStats() {
+    Registry::get().add(this);
+}
+
+BufferQueueStats::~BufferQueueStats() {
+    Registry::get().remove(this);
+}
+
+void BufferQueueStats::setConsumerName(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mNameMutex);
+    mConsumerName = name;
+}
+
+std::string BufferQueueStats::getConsumerName() const {
+    std::lock_guard<std::mutex> lock(mNameMutex);
+    return mConsumerName;
+}
+
+void BufferQueueStats::setProducerPid(pid_t pid) {
+    if (mProducerPid.exchange(pid, std::memory_order_relaxed) == pid) {
+        // Reconnected from the same process, whose name is already known.
+        return;
+    }
+    std::string name = getProcessName(pid);
+    std::lock_guard<std::mutex> lock(mNameMutex);
+    // Callers resolve names without holding the BufferQueue lock, so a producer that connected
+    // since may have stored its name already.
+    if (mProducerPid.load(std::memory_order_relaxed) == pid) {
+        mProducerName = std::move(name);
+    }
+}
+
+std::string BufferQueueStats::getProducerName() const {
+    std::lock_guard<std::mutex> lock(mNameMutex);
+    return mProducerName;
+}
+
+void BufferQueueStats::recordOccupancy(size_t occupancy) {
+    mOccupancy[std::min(occupancy, kOccupancyBucketCount - 1)].fetch_add(
+            1, std::memory_order_relaxed);
+}
+
+BufferQueueStats::Snapshot BufferQueueStats::snapshot() const {
+    Snapshot snapshot;
+    snapshot.dequeueCount = mDequeueCount.load(std::memory_order_relaxed);
+    snapshot.dequeueBlockTime = mDequeueBlockTime.load();
+    snapshot.queueToAcquireTime = mQueueToAcquireTime.load();
+    snapshot.holdTime = mHoldTime.load();
+    for (size_t i = 0; i < kOccupancyBucketCount; i++) {
+        snapshot.occupancy[i] = mOccupancy[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+std::vector<BufferQueueStats::Aggregate> BufferQueueStats::collect() {
+    return Registry::get().collect();
+}
+
+void BufferQueueStats::dump(std::string& result) {
+    std::vector<Aggregate> aggregates = collect();
+    // The most starved producers first.
+    std::stable_sort(aggregates.begin(), aggregates.end(),
+                     [](const Aggregate& lhs, const Aggregate& rhs) {
+                         return lhs.stats.dequeueBlockTime.total >
+                                 rhs.stats.dequeueBlockTime.total;
+                     });
+
+    char line[160];
+    snprintf(line, sizeof(line), "BufferQueue stats (%zu aggregates, durations in us)\n",
+             aggregates.size());
+    result.append(line);
+    for (const Aggregate& aggregate : aggregates) {
+        const Snapshot& stats = aggregate.stats;
+        snprintf(line, sizeof(line), "  [%s] producer=%s live=%zu dequeues=%" PRIu64 "\n",
+                 aggregate.consumerName.c_str(), aggregate.producerName.c_str(),
+                 aggregate.liveQueueCount, stats.dequeueCount);
+        result.append(line);
+        appendHistogram(result, "dequeue-blocked", stats.dequeueBlockTime);
+        appendHistogram(result, "queue-to-acquire", stats.queueToAcquireTime);
+        appendHistogram(result, "hold", stats.holdTime);
+
+        uint64_t queued = 0;
+        for (uint64_t count : stats.occupancy) {
+            queued += count;
+        }
+        result.append("      occupancy        ");
+        for (size_t i = 0; i < kOccupancyBucketCount; i++) {
+            const double share = queued > 0 ? 100.0 * stats.occupancy[i] / queued : 0.0;
+            snprintf(line, sizeof(line), " %zu%s:%.1f%%", i,
+                     i + 1 == kOccupancyBucketCount ? "+" : "", share);
+            result.append(line);
+        }
+        result.append("\n");
+    }
+}
+
+} // namespace android
@@ -146,15 +146,15 @@ void Choreographer::postFrameCallbackDelayed(AChoreographer_frameCallback cb,
                                              nsecs_t delay) {
     nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
     FrameCallback callback{cb, cb64, vsyncCallback, data, now + delay};
-    {
-        std::lock_guard<std::mutex> _l{mLock};
-        mFrameCallbacks.push(callback);
-    }
+    mPostedFrameCallbacks.post(callback);
     if (callback.dueTime <= now) {
         if (std::this_thread::get_id() != mThreadId) {
             if (mLooper != nullptr) {
-                Message m{MSG_SCHEDULE_VSYNC};
-                mLooper->sendMessage(this, m);
+                // Callbacks posted before the pending message is handled share its vsync.
+                if (!mVsyncMessagePending.exchange(true)) {
+                    Message m{MSG_SCHEDULE_VSYNC};
+                    mLooper->sendMessage(this, m);
+                }
             } else {
                 scheduleVsync();
             }
@@ -163,14 +163,30 @@ void Choreographer::postFrameCallbackDelayed(AChoreographer_frameCallback cb,
         }
     } else {
         if (mLooper != nullptr) {
-            Message m{MSG_SCHEDULE_CALLBACKS};
-            mLooper->sendMessageDelayed(delay, this, m);
+            requestCallbacksWakeup(callback.dueTime, now);
         } else {
             scheduleCallbacks();
         }
     }
 }
 
+void Choreographer::requestCallbacksWakeup(nsecs_t dueTime, nsecs_t now) {
+    nsecs_t wakeup = mNextCallbacksWakeup.load();
+    do {
+        if (wakeup <= dueTime) {
+            // The pending message re-arms the wakeup for the callbacks it does not schedule.
+            return;
+        }
+    } while (!mNextCallbacksWakeup.compare_exchange_weak(wakeup, dueTime));
+    Message m{MSG_SCHEDULE_CALLBACKS};
+    mLooper->sendMessageDelayed(std::max<nsecs_t>(dueTime - now, 0), this, m);
+}
+
+void Choreographer::takePostedCallbacksLocked() {
+    mPostedFrameCallbacks.drain(
+            [this](const FrameCallback& callback) { mFrameCallbacks.add(callback); });
+}
+
 void Choreographer::registerRefreshRateCallback(AChoreographer_refreshRateCallback cb, void* data) {
     std::lock_guard<std::mutex> _l{mLock};
     for (const auto& callback : mRefreshRateCallbacks) {
@@ -249,11 +265,12 @@ void Choreographer::scheduleCallbacks() {
     nsecs_t dueTime;
     {
         std::lock_guard<std::mutex> _l{mLock};
+        takePostedCallbacksLocked();
         // If there are no pending callbacks then don't schedule a vsync
         if (mFrameCallbacks.empty()) {
             return;
         }
-        dueTime = mFrameCallbacks.top().dueTime;
+        dueTime = mFrameCallbacks.nextDueTime();
     }
 
     if (dueTime <= now) {
@@ -261,6 +278,10 @@ void Choreographer::scheduleCallbacks() {
         scheduleVsync();
         return;
     }
+    // Woken up early, or the callback this wakeup was for was not the earliest.
+    if (mLooper != nullptr) {
+        requestCallbacksWakeup(dueTime, now);
+    }
 }
 
 void Choreographer::handleRefreshRateUpdates() {
@@ -288,13 +309,20 @@ void Choreographer::handleRefreshRateUpdates() {
 void Choreographer::dispatchVsync(nsecs_t timestamp, PhysicalDisplayId, uint32_t,
                                   VsyncEventData vsyncEventData) {
     std::vector<FrameCallback> callbacks{};
+    nsecs_t nextDueTime;
+    nsecs_t now;
     {
         std::lock_guard<std::mutex> _l{mLock};
-        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-        while (!mFrameCallbacks.empty() && mFrameCallbacks.top().dueTime < now) {
-            callbacks.push_back(mFrameCallbacks.top());
-            mFrameCallbacks.pop();
+        if (vsyncEventData.frameInterval > 0) {
+            mFrameCallbacks.setBucketWidth(vsyncEventData.frameInterval);
         }
+        takePostedCallbacksLocked();
+        now = systemTime(SYSTEM_TIME_MONOTONIC);
+        mFrameCallbacks.takeDue(now, &callbacks);
+        nextDueTime = mFrameCallbacks.nextDueTime();
+    }
+    if (nextDueTime != FrameCallbackSchedule::kNoDueTime && mLooper != nullptr) {
+        requestCallbacksWakeup(nextDueTime, now);
     }
     mLastVsyncEventData = vsyncEventData;
     for (const auto& cb : callbacks) {
@@ -347,9 +375,11 @@ void Choreographer::dispatchNullEvent(nsecs_t, PhysicalDisplayId) {
 void Choreographer::handleMessage(const Message& message) {
     switch (message.what) {
         case MSG_SCHEDULE_CALLBACKS:
+            mNextCallbacksWakeup.store(FrameCallbackSchedule::kNoDueTime);
             scheduleCallbacks();
             break;
         case MSG_SCHEDULE_VSYNC:
+            mVsyncMessagePending.store(false);
             scheduleVsync();
             break;
         case MSG_HANDLE_REFRESH_RATE_UPDATES:
@@ -412,6 +412,36 @@ status_t ConsumerBase::acquireBufferLocked(BufferItem *item,
     return OK;
 }
 
+status_t ConsumerBase::acquireBuffersLocked(std::vector<BufferItem>* items,
+        nsecs_t presentWhen, int maxBuffers) {
+    if (mAbandoned) {
+        CB_LOGE("acquireBuffersLocked: ConsumerBase is abandoned!");
+        return NO_INIT;
+    }
+
+    status_t err = mConsumer->acquireBuffers(maxBuffers, presentWhen, items);
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    for (const BufferItem& item : *items) {
+        if (item.mGraphicBuffer != nullptr) {
+            if (mSlots[item.mSlot].mGraphicBuffer != nullptr) {
+                freeBufferLocked(item.mSlot);
+            }
+            mSlots[item.mSlot].mGraphicBuffer = item.mGraphicBuffer;
+        }
+
+        mSlots[item.mSlot].mFrameNumber = item.mFrameNumber;
+        mSlots[item.mSlot].mFence = item.mFence;
+
+        CB_LOGV("acquireBuffersLocked: -> slot=%d/%" PRIu64,
+                item.mSlot, item.mFrameNumber);
+    }
+
+    return OK;
+}
+
 status_t ConsumerBase::addReleaseFence(int slot,
         const sp<GraphicBuffer> graphicBuffer, const sp<Fence>& fence) {
     Mutex::Autolock lock(mMutex);
@@ -507,6 +537,62 @@ status_t ConsumerBase::releaseBufferLocked(
     return err;
 }
 
+status_t ConsumerBase::releaseBuffersLocked(const std::vector<BufferItem>& items,
+        std::vector<status_t>* results) {
+    if (mAbandoned) {
+        CB_LOGE("releaseBuffersLocked: ConsumerBase is abandoned!");
+        return NO_INIT;
+    }
+
+    // Buffers that the consumer no longer tracks are not released, as in
+    // releaseBufferLocked.
+    results->assign(items.size(), OK);
+    std::vector<IGraphicBufferConsumer::ReleaseBufferInput> inputs;
+    std::vector<size_t> inputItems;
+    inputs.reserve(items.size());
+    inputItems.reserve(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        const int slot = items[i].mSlot;
+        if (!stillTracking(slot, items[i].mGraphicBuffer)) {
+            continue;
+        }
+        CB_LOGV("releaseBuffersLocked: slot=%d/%" PRIu64,
+                slot, mSlots[slot].mFrameNumber);
+        IGraphicBufferConsumer::ReleaseBufferInput& input = inputs.emplace_back();
+        input.slot = slot;
+        input.frameNumber = mSlots[slot].mFrameNumber;
+        input.fence = mSlots[slot].mFence;
+        inputItems.push_back(i);
+    }
+    if (inputs.empty()) {
+        return OK;
+    }
+
+    std::vector<status_t> releaseResults;
+    status_t err = mConsumer->releaseBuffers(inputs, &releaseResults);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    if (releaseResults.size() != inputs.size()) {
+        CB_LOGE("releaseBuffersLocked: got %zu results for %zu buffers",
+                releaseResults.size(), inputs.size());
+        return UNKNOWN_ERROR;
+    }
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const int slot = inputs[i].slot;
+        if (releaseResults[i] == IGraphicBufferConsumer::STALE_BUFFER_SLOT) {
+            freeBufferLocked(slot);
+        }
+
+        mPrevFinalReleaseFence = mSlots[slot].mFence;
+        mSlots[slot].mFence = Fence::NO_FENCE;
+        (*results)[inputItems[i]] = releaseResults[i];
+    }
+
+    return OK;
+}
+
 bool ConsumerBase::stillTracking(int slot,
         const sp<GraphicBuffer> graphicBuffer) {
     if (slot < 0 || slot >= BufferQueue::NUM_BUFFER_SLOTS) {
@@ -33,15 +33,48 @@ namespace android {
 
 CpuConsumer::CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
         size_t maxLockedBuffers, bool controlledByApp) :
+    CpuConsumer(bq, maxLockedBuffers, controlledByApp,
+            Options{/*persistentMapping*/ false, /*prefetch*/ false})
+{
+}
+
+CpuConsumer::CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
+        size_t maxLockedBuffers, bool controlledByApp, const Options& options) :
     ConsumerBase(bq, controlledByApp),
     mMaxLockedBuffers(maxLockedBuffers),
-    mCurrentLockedBuffers(0)
+    mPersistentMapping(options.persistentMapping),
+    mPrefetch(options.prefetch),
+    mCurrentLockedBuffers(0),
+    mPrefetchState(PrefetchState::IDLE),
+    mPrefetchRequested(false),
+    mPrefetchStopped(false),
+    mPrefetchStatus(OK)
 {
     // Create tracking entries for locked buffers
     mAcquiredBuffers.insertAt(0, maxLockedBuffers);
+    if (mPersistentMapping) {
+        mMappings.resize(BufferQueue::NUM_BUFFER_SLOTS);
+    }
 
+    // The prefetched buffer is acquired on top of the locked ones
+    const size_t maxAcquiredBuffers = maxLockedBuffers + (mPrefetch ? 1 : 0);
     mConsumer->setConsumerUsageBits(GRALLOC_USAGE_SW_READ_OFTEN);
-    mConsumer->setMaxAcquiredBufferCount(static_cast<int32_t>(maxLockedBuffers));
+    mConsumer->setMaxAcquiredBufferCount(static_cast<int32_t>(maxAcquiredBuffers));
+
+    if (mPrefetch) {
+        mPrefetchThread = std::thread([this] { prefetchLoop(); });
+    }
+}
+
+CpuConsumer::~CpuConsumer() {
+    if (mPrefetchThread.joinable()) {
+        {
+            Mutex::Autolock _l(mMutex);
+            mPrefetchStopped = true;
+            mPrefetchCondition.broadcast();
+        }
+        mPrefetchThread.join();
+    }
 }
 
 size_t CpuConsumer::findAcquiredBufferLocked(uintptr_t id) const {
@@ -88,15 +121,16 @@ static bool isPossiblyYUV(PixelFormat format) {
     }
 }
 
-status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const {
+status_t CpuConsumer::mapBuffer(const sp<GraphicBuffer>& buffer, const Rect& rect,
+        const sp<Fence>& fence, bool tryFlexYuv, LockedBuffer* outBuffer) const {
     android_ycbcr ycbcr = android_ycbcr();
 
-    PixelFormat format = item.mGraphicBuffer->getPixelFormat();
+    PixelFormat format = buffer->getPixelFormat();
     PixelFormat flexFormat = format;
-    if (isPossiblyYUV(format)) {
-        int fenceFd = item.mFence.get() ? item.mFence->dup() : -1;
-        status_t err = item.mGraphicBuffer->lockAsyncYCbCr(GraphicBuffer::USAGE_SW_READ_OFTEN,
-                                                           item.mCrop, &ycbcr, fenceFd);
+    if (tryFlexYuv) {
+        int fenceFd = fence.get() ? fence->dup() : -1;
+        status_t err = buffer->lockAsyncYCbCr(GraphicBuffer::USAGE_SW_READ_OFTEN, rect, &ycbcr,
+                                              fenceFd);
         if (err == OK) {
             flexFormat = HAL_PIXEL_FORMAT_YCbCr_420_888;
             if (format != HAL_PIXEL_FORMAT_YCbCr_420_888) {
@@ -118,27 +152,57 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
     } else {
         // not flexible YUV; try lockAsync
         void* bufferPointer = nullptr;
-        int fenceFd = item.mFence.get() ? item.mFence->dup() : -1;
-        status_t err = item.mGraphicBuffer->lockAsync(GraphicBuffer::USAGE_SW_READ_OFTEN,
-                                                      item.mCrop, &bufferPointer, fenceFd);
+        int fenceFd = fence.get() ? fence->dup() : -1;
+        status_t err = buffer->lockAsync(GraphicBuffer::USAGE_SW_READ_OFTEN, rect, &bufferPointer,
+                                         fenceFd);
         if (err != OK) {
             CC_LOGE("Unable to lock buffer for CPU reading: %s (%d)", strerror(-err), err);
             return err;
         }
 
         outBuffer->data = reinterpret_cast<uint8_t*>(bufferPointer);
-        outBuffer->stride = item.mGraphicBuffer->getStride();
+        outBuffer->stride = buffer->getStride();
         outBuffer->dataCb = nullptr;
         outBuffer->dataCr = nullptr;
         outBuffer->chromaStride = 0;
         outBuffer->chromaStep = 0;
     }
-
-    outBuffer->width = item.mGraphicBuffer->getWidth();
-    outBuffer->height = item.mGraphicBuffer->getHeight();
-    outBuffer->format = format;
     outBuffer->flexFormat = flexFormat;
 
+    return OK;
+}
+
+bool CpuConsumer::isMappingCachedLocked(int slot, const sp<GraphicBuffer>& buffer) const {
+    return mPersistentMapping && slot >= 0 && slot < BufferQueue::NUM_BUFFER_SLOTS &&
+            buffer != nullptr && mMappings[slot].mGraphicBuffer == buffer;
+}
+
+status_t CpuConsumer::lockBufferItemLocked(const BufferItem& item, LockedBuffer* outBuffer,
+        bool unlockWhileMapping) {
+    const sp<GraphicBuffer> buffer = item.mGraphicBuffer;
+    const bool cached = isMappingCachedLocked(item.mSlot, buffer);
+    const bool tryFlexYuv = cached ? mMappings[item.mSlot].mFlexYuv
+                                   : isPossiblyYUV(buffer->getPixelFormat());
+
+    if (unlockWhileMapping) mMutex.unlock();
+    status_t err = mapBuffer(buffer, item.mCrop, item.mFence, tryFlexYuv, outBuffer);
+    if (unlockWhileMapping) mMutex.lock();
+    if (err != OK) {
+        return err;
+    }
+
+    if (cached) {
+        mStats.reusedMappings++;
+    } else if (mPersistentMapping && mSlots[item.mSlot].mGraphicBuffer == buffer) {
+        // Checked again, as the slot may have been freed while mMutex was unlocked
+        mMappings[item.mSlot].mGraphicBuffer = buffer;
+        mMappings[item.mSlot].mFlexYuv = outBuffer->dataCb != nullptr;
+    }
+
+    outBuffer->width = buffer->getWidth();
+    outBuffer->height = buffer->getHeight();
+    outBuffer->format = buffer->getPixelFormat();
+
     outBuffer->crop = item.mCrop;
     outBuffer->transform = item.mTransform;
     outBuffer->scalingMode = item.mScalingMode;
@@ -156,6 +220,11 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
 
     Mutex::Autolock _l(mMutex);
 
+    // A buffer being prefetched is the next one to return
+    while (mPrefetchState == PrefetchState::IN_PROGRESS) {
+        mPrefetchCondition.wait(mMutex);
+    }
+
     if (mCurrentLockedBuffers == mMaxLockedBuffers) {
         CC_LOGW("Max buffers have been locked (%zd), cannot lock anymore.",
                 mMaxLockedBuffers);
@@ -163,23 +232,37 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
     }
 
     BufferItem b;
-    err = acquireBufferLocked(&b, 0);
-    if (err != OK) {
-        if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
-            return BAD_VALUE;
-        } else {
-            CC_LOGE("Error acquiring buffer: %s (%d)", strerror(err), err);
+    if (mPrefetchState == PrefetchState::READY) {
+        b = mPrefetchItem;
+        *nativeBuffer = mPrefetchBuffer;
+        err = mPrefetchStatus;
+        mPrefetchItem = BufferItem();
+        mPrefetchState = PrefetchState::IDLE;
+        mPrefetchRequested = true;
+        mPrefetchCondition.broadcast();
+        if (err != OK) {
+            releaseBufferLocked(b.mSlot, b.mGraphicBuffer);
             return err;
         }
-    }
+    } else {
+        err = acquireBufferLocked(&b, 0);
+        if (err != OK) {
+            if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
+                return BAD_VALUE;
+            } else {
+                CC_LOGE("Error acquiring buffer: %s (%d)", strerror(err), err);
+                return err;
+            }
+        }
 
-    if (b.mGraphicBuffer == nullptr) {
-        b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
-    }
+        if (b.mGraphicBuffer == nullptr) {
+            b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
+        }
 
-    err = lockBufferItem(b, nativeBuffer);
-    if (err != OK) {
-        return err;
+        err = lockBufferItemLocked(b, nativeBuffer, /*unlockWhileMapping*/ false);
+        if (err != OK) {
+            return err;
+        }
     }
 
     // find an unused AcquiredBuffer
@@ -208,24 +291,113 @@ status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
     }
 
     AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(lockedIdx);
+    const int slot = ab.mSlot;
+    const sp<GraphicBuffer> buffer = ab.mGraphicBuffer;
 
     int fenceFd = -1;
-    status_t err = ab.mGraphicBuffer->unlockAsync(&fenceFd);
+    status_t err = buffer->unlockAsync(&fenceFd);
     if (err != OK) {
         CC_LOGE("%s: Unable to unlock graphic buffer %zd", __FUNCTION__,
                 lockedIdx);
         return err;
     }
-
     sp<Fence> fence(fenceFd >= 0 ? new Fence(fenceFd) : Fence::NO_FENCE);
-    addReleaseFenceLocked(ab.mSlot, ab.mGraphicBuffer, fence);
-    releaseBufferLocked(ab.mSlot, ab.mGraphicBuffer);
 
     ab.reset();
 
     mCurrentLockedBuffers--;
 
+    addReleaseFenceLocked(slot, buffer, fence);
+    releaseBufferLocked(slot, buffer);
+
     return OK;
 }
 
+CpuConsumer::Stats CpuConsumer::getStats() const {
+    Mutex::Autolock _l(mMutex);
+    return mStats;
+}
+
+void CpuConsumer::prefetchLoop() {
+    Mutex::Autolock _l(mMutex);
+    while (true) {
+        while (!mPrefetchStopped &&
+                !(mPrefetchRequested && mPrefetchState == PrefetchState::IDLE)) {
+            mPrefetchCondition.wait(mMutex);
+        }
+        if (mPrefetchStopped) {
+            return;
+        }
+
+        BufferItem item;
+        status_t err = acquireBufferLocked(&item, 0);
+        if (err != OK) {
+            if (err != BufferQueue::NO_BUFFER_AVAILABLE) {
+                CC_LOGE("Error prefetching buffer: %s (%d)", strerror(-err), err);
+            }
+            mPrefetchRequested = false;
+            continue;
+        }
+        if (item.mGraphicBuffer == nullptr) {
+            item.mGraphicBuffer = mSlots[item.mSlot].mGraphicBuffer;
+        }
+
+        mPrefetchItem = item;
+        mPrefetchState = PrefetchState::IN_PROGRESS;
+        LockedBuffer buffer;
+        err = lockBufferItemLocked(item, &buffer, /*unlockWhileMapping*/ true);
+
+        if (mPrefetchStopped) {
+            // Abandoned while mapping: the buffer will never be returned
+            if (err == OK) {
+                item.mGraphicBuffer->unlock();
+            }
+            mPrefetchItem = BufferItem();
+            mPrefetchState = PrefetchState::IDLE;
+            mPrefetchCondition.broadcast();
+            return;
+        }
+
+        mPrefetchBuffer = buffer;
+        mPrefetchStatus = err;
+        mPrefetchState = PrefetchState::READY;
+        if (err == OK) {
+            mStats.prefetchedBuffers++;
+        }
+        mPrefetchCondition.broadcast();
+    }
+}
+
+void CpuConsumer::onFrameAvailable(const BufferItem& item) {
+    if (mPrefetch) {
+        Mutex::Autolock _l(mMutex);
+        mPrefetchRequested = true;
+        mPrefetchCondition.broadcast();
+    }
+    ConsumerBase::onFrameAvailable(item);
+}
+
+void CpuConsumer::freeBufferLocked(int slotIndex) {
+    if (mPersistentMapping) {
+        mMappings[slotIndex] = SlotMapping();
+    }
+    ConsumerBase::freeBufferLocked(slotIndex);
+}
+
+void CpuConsumer::abandonLocked() {
+    if (mPrefetch) {
+        mPrefetchStopped = true;
+        if (mPrefetchState == PrefetchState::READY) {
+            const BufferItem item = mPrefetchItem;
+            mPrefetchItem = BufferItem();
+            mPrefetchState = PrefetchState::IDLE;
+            if (mPrefetchStatus == OK) {
+                item.mGraphicBuffer->unlock();
+            }
+        }
+        mPrefetchCondition.broadcast();
+    }
+    ConsumerBase::abandonLocked();
+}
+
 } // namespace android
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gui/FrameCallbackQueue.h>
+
+#include <algorithm>
+
+namespace android {
+
+namespace {
+
+constexpr uint64_t kFreeIndexMask = 0xffffffff;
+constexpr uint64_t kFreeListUpdate = kFreeIndexMask + 1;
+
+} // namespace
+
+FrameCallbackInbox::FrameCallbackInbox() {
+    for (size_t i = 0; i < kCapacity; i++) {
+        mPool[i].nextFree.store(i + 1 < kCapacity ? static_cast<uint32_t>(i + 2) : 0,
+                                std::memory_order_relaxed);
+    }
+    mFreeList.store(1, std::memory_order_relaxed);
+}
+
+FrameCallbackInbox::~FrameCallbackInbox() {
+    drain([](const FrameCallback&) {});
+}
+
+FrameCallbackInbox::Node* FrameCallbackInbox::allocate() {
+    uint64_t freeList = mFreeList.load(std::memory_order_acquire);
+    while ((freeList & kFreeIndexMask) != 0) {
+        Node* node = &mPool[(freeList & kFreeIndexMask) - 1];
+        const uint64_t newFreeList = ((freeList & ~kFreeIndexMask) + kFreeListUpdate) |
+                node->nextFree.load(std::memory_order_relaxed);
+        if (mFreeList.compare_exchange_weak(freeList, newFreeList, std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+            return node;
+        }
+    }
+    // Overflow: more callbacks are waiting than the pool holds.
+    return new Node;
+}
+
+void FrameCallbackInbox::recycle(Node* node) {
+    if (node < mPool.data() || node >= mPool.data() + kCapacity) {
+        delete node;
+        return;
+    }
+    const uint64_t index = node - mPool.data() + 1;
+    uint64_t freeList = mFreeList.load(std::memory_order_relaxed);
+    uint64_t newFreeList;
+    do {
+        node->nextFree.store(static_cast<uint32_t>(freeList & kFreeIndexMask),
+                             std::memory_order_relaxed);
+        newFreeList = ((freeList & ~kFreeIndexMask) + kFreeListUpdate) | index;
+    } while (!mFreeList.compare_exchange_weak(freeList, newFreeList, std::memory_order_release,
+                                              std::memory_order_relaxed));
+}
+
+bool FrameCallbackInbox::post(const FrameCallback& callback) {
+    Node* node = allocate();
+    node->callback = callback;
+    Node* head = mHead.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!mHead.compare_exchange_weak(head, node, std::memory_order_release,
+                                          std::memory_order_relaxed));
+    return head == nullptr;
+}
+
+FrameCallbackInbox::Node* FrameCallbackInbox::reverse(Node* head) {
+    Node* reversed = nullptr;
+    while (head != nullptr) {
+        Node* next = head->next;
+        head->next = reversed;
+        reversed = head;
+        head = next;
+    }
+    return reversed;
+}
+
+void FrameCallbackSchedule::add(const FrameCallback& callback) {
+    if (mSize == 0) {
+        mFirstBucket = bucketOf(callback.dueTime);
+    }
+    insert(callback);
+    mSize++;
+}
+
+void FrameCallbackSchedule::insert(const FrameCallback& callback) {
+    const int64_t bucket = bucketOf(callback.dueTime);
+    if (bucket < mFirstBucket || bucket - mFirstBucket >= static_cast<int64_t>(kNumBuckets)) {
+        mOverflow.push_back(callback);
+    } else {
+        bucketAt(bucket).push_back(callback);
+    }
+}
+
+void FrameCallbackSchedule::takeDue(nsecs_t now, std::vector<FrameCallback>* outCallbacks) {
+    if (mSize == 0) {
+        return;
+    }
+    const size_t sizeBefore = outCallbacks->size();
+
+    // Due callbacks in the overflow list were either added before the first bucket, and go ahead
+    // of the buckets, or are far ahead and became due because many vsyncs were skipped.
+    auto isDue = [now](const FrameCallback& callback) { return callback.dueTime < now; };
+    auto byDueTime = [](const FrameCallback& lhs, const FrameCallback& rhs) {
+        return lhs.dueTime < rhs.dueTime;
+    };
+    auto due = std::stable_partition(mOverflow.begin(), mOverflow.end(),
+                                     [&](const FrameCallback& c) { return !isDue(c); });
+    auto late = std::stable_partition(due, mOverflow.end(), [&](const FrameCallback& c) {
+        return bucketOf(c.dueTime) < mFirstBucket;
+    });
+    std::stable_sort(due, late, byDueTime);
+    std::stable_sort(late, mOverflow.end(), byDueTime);
+    outCallbacks->insert(outCallbacks->end(), due, late);
+    std::vector<FrameCallback> lateCallbacks(late, mOverflow.end());
+    mOverflow.erase(due, mOverflow.end());
+
+    const int64_t nowBucket = bucketOf(now);
+    const int64_t lastBucket =
+            std::min(nowBucket, mFirstBucket + static_cast<int64_t>(kNumBuckets) - 1);
+    for (int64_t bucket = mFirstBucket; bucket <= lastBucket; bucket++) {
+        std::vector<FrameCallback>& callbacks = bucketAt(bucket);
+        if (bucket < nowBucket) {
+            outCallbacks->insert(outCallbacks->end(), callbacks.begin(), callbacks.end());
+            callbacks.clear();
+        } else {
+            // The bucket of now may hold callbacks due later in the same vsync period.
+            auto later = std::stable_partition(callbacks.begin(), callbacks.end(), isDue);
+            outCallbacks->insert(outCallbacks->end(), callbacks.begin(), later);
+            callbacks.erase(callbacks.begin(), later);
+        }
+    }
+    outCallbacks->insert(outCallbacks->end(), lateCallbacks.begin(), lateCallbacks.end());
+    mSize -= outCallbacks->size() - sizeBefore;
+
+    if (nowBucket > mFirstBucket) {
+        mFirstBucket = nowBucket;
+        // The buckets moved forward: file the callbacks that are now in range.
+        if (!mOverflow.empty()) {
+            std::vector<FrameCallback> overflow;
+            overflow.swap(mOverflow);
+            for (const FrameCallback& callback : overflow) {
+                insert(callback);
+            }
+        }
+    }
+}
+
+nsecs_t FrameCallbackSchedule::nextDueTime() const {
+    nsecs_t dueTime = kNoDueTime;
+    for (const FrameCallback& callback : mOverflow) {
+        dueTime = std::min(dueTime, callback.dueTime);
+    }
+    // Buckets are in due time order, so the first non-empty one holds the earliest callback.
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        const std::vector<FrameCallback>& callbacks = mBuckets[(mFirstBucket + i) % kNumBuckets];
+        if (!callbacks.empty()) {
+            for (const FrameCallback& callback : callbacks) {
+                dueTime = std::min(dueTime, callback.dueTime);
+            }
+            break;
+        }
+    }
+    return dueTime;
+}
+
+void FrameCallbackSchedule::setBucketWidth(nsecs_t bucketWidth) {
+    if (bucketWidth <= 0 || bucketWidth == mBucketWidth) {
+        return;
+    }
+    std::vector<FrameCallback> callbacks;
+    callbacks.swap(mOverflow);
+    callbacks.reserve(mSize);
+    nsecs_t firstDueTime = kNoDueTime;
+    for (int64_t bucket = mFirstBucket;
+         bucket < mFirstBucket + static_cast<int64_t>(kNumBuckets); bucket++) {
+        std::vector<FrameCallback>& bucketCallbacks = bucketAt(bucket);
+        callbacks.insert(callbacks.end(), bucketCallbacks.begin(), bucketCallbacks.end());
+        bucketCallbacks.clear();
+    }
+    for (const FrameCallback& callback : callbacks) {
+        firstDueTime = std::min(firstDueTime, callback.dueTime);
+    }
+
+    mBucketWidth = bucketWidth;
+    mFirstBucket = callbacks.empty() ? 0 : bucketOf(firstDueTime);
+    for (const FrameCallback& callback : callbacks) {
+        insert(callback);
+    }
+}
+
+} // namespace android
@@ -52,7 +52,9 @@ enum class Tag : uint32_t {
     GET_OCCUPANCY_HISTORY,
     DISCARD_FREE_BUFFERS,
     DUMP_STATE,
-    LAST = DUMP_STATE,
+    ACQUIRE_BUFFERS,
+    RELEASE_BUFFERS,
+    LAST = RELEASE_BUFFERS,
 };
 
 } // Anonymous namespace
@@ -167,12 +169,118 @@ public:
         using Signature = status_t (IGraphicBufferConsumer::*)(const String8&, String8*) const;
         return callRemote<Signature>(Tag::DUMP_STATE, prefix, outResult);
     }
+
+    // SafeInterface does not handle vectors of Flattenables, so the batched calls are marshalled
+    // by hand, like the batched calls of IGraphicBufferProducer.
+    status_t acquireBuffers(int maxBuffers, nsecs_t presentWhen,
+                            std::vector<BufferItem>* outBuffers) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferConsumer::getInterfaceDescriptor());
+        data.writeInt32(maxBuffers);
+        data.writeInt64(presentWhen);
+        status_t result = remote()->transact(static_cast<uint32_t>(Tag::ACQUIRE_BUFFERS), data,
+                                             &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        result = reply.resizeOutVector(outBuffers);
+        for (BufferItem& buffer : *outBuffers) {
+            if (result != NO_ERROR) {
+                return result;
+            }
+            result = reply.read(buffer);
+        }
+        if (result != NO_ERROR) {
+            return result;
+        }
+        return reply.readInt32();
+    }
+
+    status_t releaseBuffers(const std::vector<ReleaseBufferInput>& inputs,
+                            std::vector<status_t>* results) override {
+        // A null fence cannot be flattened. Like releaseBuffer(), fail those inputs without
+        // sending them.
+        size_t validCount = 0;
+        for (const ReleaseBufferInput& input : inputs) {
+            if (input.fence != nullptr) {
+                validCount++;
+            }
+        }
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferConsumer::getInterfaceDescriptor());
+        data.writeInt32(static_cast<int32_t>(validCount));
+        for (const ReleaseBufferInput& input : inputs) {
+            if (input.fence != nullptr) {
+                data.write(input);
+            }
+        }
+        status_t result = remote()->transact(static_cast<uint32_t>(Tag::RELEASE_BUFFERS), data,
+                                             &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        std::vector<status_t> validResults;
+        result = reply.readInt32Vector(&validResults);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        if (validResults.size() != validCount) {
+            return BAD_VALUE;
+        }
+        results->clear();
+        results->reserve(inputs.size());
+        auto validResult = validResults.begin();
+        for (const ReleaseBufferInput& input : inputs) {
+            results->push_back(input.fence != nullptr ? *validResult++ : BAD_VALUE);
+        }
+        return NO_ERROR;
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this translation unit
 // (see clang warning -Wweak-vtables)
 BpGraphicBufferConsumer::~BpGraphicBufferConsumer() = default;
 
+////////////////////////////////////////////////////////////////////////
+
+constexpr size_t IGraphicBufferConsumer::ReleaseBufferInput::minFlattenedSize() {
+    return sizeof(slot) + sizeof(frameNumber);
+}
+
+size_t IGraphicBufferConsumer::ReleaseBufferInput::getFlattenedSize() const {
+    return minFlattenedSize() + fence->getFlattenedSize();
+}
+
+size_t IGraphicBufferConsumer::ReleaseBufferInput::getFdCount() const {
+    return fence->getFdCount();
+}
+
+status_t IGraphicBufferConsumer::ReleaseBufferInput::flatten(
+        void*& buffer, size_t& size, int*& fds, size_t& count) const {
+    if (size < getFlattenedSize()) {
+        return NO_MEMORY;
+    }
+
+    FlattenableUtils::write(buffer, size, slot);
+    FlattenableUtils::write(buffer, size, frameNumber);
+    return fence->flatten(buffer, size, fds, count);
+}
+
+status_t IGraphicBufferConsumer::ReleaseBufferInput::unflatten(
+        void const*& buffer, size_t& size, int const*& fds, size_t& count) {
+    if (size < minFlattenedSize()) {
+        return NO_MEMORY;
+    }
+
+    FlattenableUtils::read(buffer, size, slot);
+    FlattenableUtils::read(buffer, size, frameNumber);
+
+    fence = new Fence();
+    return fence->unflatten(buffer, size, fds, count);
+}
+
+////////////////////////////////////////////////////////////////////////
+
 IMPLEMENT_META_INTERFACE(GraphicBufferConsumer, "android.gui.IGraphicBufferConsumer");
 
 status_t BnGraphicBufferConsumer::onTransact(uint32_t code, const Parcel& data, Parcel* reply,
@@ -224,6 +332,38 @@ status_t BnGraphicBufferConsumer::onTransact(uint32_t code, const Parcel& data,
             using Signature = status_t (IGraphicBufferConsumer::*)(const String8&, String8*) const;
             return callLocal<Signature>(data, reply, &IGraphicBufferConsumer::dumpState);
         }
+        case Tag::ACQUIRE_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferConsumer, data, reply);
+            int32_t maxBuffers = data.readInt32();
+            int64_t presentWhen = data.readInt64();
+            std::vector<BufferItem> buffers;
+            status_t result = acquireBuffers(maxBuffers, presentWhen, &buffers);
+            reply->writeVectorSize(buffers);
+            for (const BufferItem& buffer : buffers) {
+                reply->write(buffer);
+            }
+            return reply->writeInt32(result);
+        }
+        case Tag::RELEASE_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferConsumer, data, reply);
+            std::vector<ReleaseBufferInput> inputs;
+            status_t result = data.resizeOutVector(&inputs);
+            for (ReleaseBufferInput& input : inputs) {
+                if (result != NO_ERROR) {
+                    return result;
+                }
+                result = data.read(input);
+            }
+            if (result != NO_ERROR) {
+                return result;
+            }
+            std::vector<status_t> results;
+            result = releaseBuffers(inputs, &results);
+            if (result != NO_ERROR) {
+                return result;
+            }
+            return reply->writeInt32Vector(results);
+        }
     }
 }
 
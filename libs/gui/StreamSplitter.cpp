@@ -58,13 +58,13 @@ status_t StreamSplitter::createSplitter(
 
 StreamSplitter::StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue)
       : mIsAbandoned(false), mMutex(), mReleaseCondition(),
-        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers() {}
+        mOutstandingBuffers(0), mMaxOutstandingBuffers(MAX_OUTSTANDING_BUFFERS),
+        mInput(inputQueue), mOutputs(), mBuffers() {}
 
 StreamSplitter::~StreamSplitter() {
     mInput->consumerDisconnect();
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
-        (*output)->disconnect(NATIVE_WINDOW_API_CPU);
+    for (const Output& output : mOutputs) {
+        output.queue->disconnect(NATIVE_WINDOW_API_CPU);
     }
 
     if (mBuffers.size() > 0) {
@@ -73,7 +73,8 @@ StreamSplitter::~StreamSplitter() {
 }
 
 status_t StreamSplitter::addOutput(
-        const sp<IGraphicBufferProducer>& outputQueue) {
+        const sp<IGraphicBufferProducer>& outputQueue,
+        BackpressurePolicy policy) {
     if (outputQueue == nullptr) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
@@ -82,7 +83,8 @@ status_t StreamSplitter::addOutput(
     Mutex::Autolock lock(mMutex);
 
     IGraphicBufferProducer::QueueBufferOutput queueBufferOutput;
-    sp<OutputListener> listener(new OutputListener(this, outputQueue));
+    sp<OutputListener> listener(new OutputListener(this, outputQueue,
+            mOutputs.size()));
     IInterface::asBinder(outputQueue)->linkToDeath(listener);
     status_t status = outputQueue->connect(listener, NATIVE_WINDOW_API_CPU,
             /* producerControlledByApp */ false, &queueBufferOutput);
@@ -91,7 +93,19 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
-    mOutputs.push_back(outputQueue);
+    if (policy == BackpressurePolicy::DROP_OLDEST) {
+        // Buffers queued in async mode are replaced by the next one until the
+        // consumer acquires them
+        status = outputQueue->setAsyncMode(true);
+        if (status != NO_ERROR) {
+            ALOGE("addOutput: failed to set async mode (%d)", status);
+            outputQueue->disconnect(NATIVE_WINDOW_API_CPU);
+            return status;
+        }
+        mMaxOutstandingBuffers += DROP_OLDEST_OUTSTANDING_BUFFERS;
+    }
+
+    mOutputs.push_back({outputQueue, policy, /* pendingBuffers */ 0});
 
     return NO_ERROR;
 }
@@ -101,19 +115,39 @@ void StreamSplitter::setName(const String8 &name) {
     mInput->setConsumerName(name);
 }
 
+bool StreamSplitter::isInputBlockedLocked() const {
+    if (mOutstandingBuffers >= mMaxOutstandingBuffers) {
+        return true;
+    }
+    for (const Output& output : mOutputs) {
+        if (output.policy == BackpressurePolicy::BLOCK &&
+                output.pendingBuffers >= MAX_OUTSTANDING_BUFFERS) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     ATRACE_CALL();
-    Mutex::Autolock lock(mMutex);
 
-    // The current policy is that if any one consumer is consuming buffers too
-    // slowly, the splitter will stall the rest of the outputs by not acquiring
-    // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
-
-    // If there are too many outstanding buffers, we block until a buffer is
-    // released back to the input in onBufferReleased
-    while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
-        mReleaseCondition.wait(mMutex);
+    BufferItem bufferItem;
+    std::vector<sp<IGraphicBufferProducer> > outputs;
+    {
+        Mutex::Autolock lock(mMutex);
+
+        // If a BLOCK output is consuming buffers too slowly, the splitter will
+        // stall the rest of the outputs by not acquiring any more buffers from
+        // the input. This will cause back pressure on the input queue, slowing
+        // down its producer. DROP_OLDEST outputs return the buffers they
+        // skip, so they only stall the input if their consumer holds on to
+        // more buffers than it has acquired.
+
+        // If we must wait, we block until a buffer is released in
+        // releaseBufferFromOutput
+        while (!mIsAbandoned && isInputBlockedLocked()) {
+            mReleaseCondition.wait(mMutex);
+        }
 
         // If the splitter is abandoned while we are waiting, the release
         // condition variable will be broadcast, and we should just return
@@ -122,26 +156,32 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
         if (mIsAbandoned) {
             return;
         }
-    }
-    ++mOutstandingBuffers;
-
-    // Acquire and detach the buffer from the input
-    BufferItem bufferItem;
-    status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "acquiring buffer from input failed (%d)", status);
+        ++mOutstandingBuffers;
 
-    ALOGV("acquired buffer %#" PRIx64 " from input",
-            bufferItem.mGraphicBuffer->getId());
+        // Acquire and detach the buffer from the input
+        status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "acquiring buffer from input failed (%d)", status);
 
-    status = mInput->detachBuffer(bufferItem.mSlot);
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "detaching buffer from input failed (%d)", status);
+        ALOGV("acquired buffer %#" PRIx64 " from input",
+                bufferItem.mGraphicBuffer->getId());
 
-    // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
+        status = mInput->detachBuffer(bufferItem.mSlot);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "detaching buffer from input failed (%d)", status);
+
+        // Initialize our reference count for this buffer. Every output holds
+        // it until it is released, even if queueing it below fails.
+        mBuffers.add(bufferItem.mGraphicBuffer->getId(),
+                new BufferTracker(bufferItem.mGraphicBuffer, mOutputs.size()));
+        outputs.reserve(mOutputs.size());
+        for (Output& output : mOutputs) {
+            ++output.pendingBuffers;
+            outputs.push_back(output.queue);
+        }
+    }
 
+    const uint64_t bufferId = bufferItem.mGraphicBuffer->getId();
     IGraphicBufferProducer::QueueBufferInput queueInput(
             bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
             bufferItem.mDataSpace, bufferItem.mCrop,
@@ -149,47 +189,45 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             bufferItem.mTransform, bufferItem.mFence);
 
     // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
+    for (size_t outputIndex = 0; outputIndex < outputs.size(); ++outputIndex) {
+        const sp<IGraphicBufferProducer>& output = outputs[outputIndex];
         int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
-        if (status == NO_INIT) {
-            // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
-            onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
-            continue;
+        IGraphicBufferProducer::QueueBufferOutput queueOutput;
+        status_t status = output->attachBuffer(&slot, bufferItem.mGraphicBuffer);
+        if (status == NO_ERROR) {
+            status = output->queueBuffer(slot, queueInput, &queueOutput);
+            LOG_ALWAYS_FATAL_IF(status != NO_ERROR && status != NO_INIT,
+                    "queueing buffer to output failed (%d)", status);
         } else {
-            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+            LOG_ALWAYS_FATAL_IF(status != NO_INIT,
                     "attaching buffer to output failed (%d)", status);
         }
-
-        IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
-            onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+            // that, release the buffer for this output so that we still
+            // release it eventually, and move on to the next output
+            {
+                Mutex::Autolock lock(mMutex);
+                onAbandonedLocked();
+            }
+            releaseBufferFromOutput(outputIndex, bufferId, Fence::NO_FENCE);
             continue;
-        } else {
-            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-                    "queueing buffer to output failed (%d)", status);
         }
 
         ALOGV("queued buffer %#" PRIx64 " to output %p",
-                bufferItem.mGraphicBuffer->getId(), output->get());
+                bufferId, output.get());
+
+        if (queueOutput.bufferReplaced) {
+            // A DROP_OLDEST output dropped the buffer it had not acquired yet,
+            // so it no longer uses that buffer
+            onBufferReleasedByOutput(output, outputIndex);
+        }
     }
 }
 
 void StreamSplitter::onBufferReleasedByOutput(
-        const sp<IGraphicBufferProducer>& from) {
+        const sp<IGraphicBufferProducer>& from, size_t outputIndex) {
     ATRACE_CALL();
-    Mutex::Autolock lock(mMutex);
 
     sp<GraphicBuffer> buffer;
     sp<Fence> fence;
@@ -197,6 +235,7 @@ void StreamSplitter::onBufferReleasedByOutput(
     if (status == NO_INIT) {
         // If we just discovered that this output has been abandoned, note that,
         // but we can't do anything else, since buffer is invalid
+        Mutex::Autolock lock(mMutex);
         onAbandonedLocked();
         return;
     } else {
@@ -207,43 +246,50 @@ void StreamSplitter::onBufferReleasedByOutput(
     ALOGV("detached buffer %#" PRIx64 " from output %p",
           buffer->getId(), from.get());
 
-    const sp<BufferTracker>& tracker = mBuffers.editValueFor(buffer->getId());
+    releaseBufferFromOutput(outputIndex, buffer->getId(), fence);
+}
 
-    // Merge the release fence of the incoming buffer so that the fence we send
-    // back to the input includes all of the outputs' fences
-    tracker->mergeFence(fence);
+void StreamSplitter::releaseBufferFromOutput(size_t outputIndex,
+        uint64_t bufferId, const sp<Fence>& fence) {
+    sp<BufferTracker> tracker;
+    {
+        Mutex::Autolock lock(mMutex);
+        tracker = mBuffers.valueFor(bufferId);
+        --mOutputs[outputIndex].pendingBuffers;
+        // This output may have been the one holding up onFrameAvailable
+        mReleaseCondition.signal();
+    }
 
     // Check to see if this is the last outstanding reference to this buffer
-    size_t releaseCount = tracker->incrementReleaseCountLocked();
-    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", buffer->getId(),
-            releaseCount, mOutputs.size());
-    if (releaseCount < mOutputs.size()) {
+    if (!tracker->releaseByOutput(outputIndex, fence)) {
+        ALOGV("buffer %#" PRIx64 " released by output %zu", bufferId,
+                outputIndex);
         return;
     }
 
+    Mutex::Autolock lock(mMutex);
+
     // If we've been abandoned, we can't return the buffer to the input, so just
     // stop tracking it and move on
-    if (mIsAbandoned) {
-        mBuffers.removeItem(buffer->getId());
-        return;
-    }
-
-    // Attach and release the buffer back to the input
-    int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "attaching buffer to input failed (%d)", status);
+    if (!mIsAbandoned) {
+        // Attach and release the buffer back to the input
+        int consumerSlot;
+        status_t status = mInput->attachBuffer(&consumerSlot,
+                tracker->getBuffer());
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "attaching buffer to input failed (%d)", status);
 
-    status = mInput->releaseBuffer(consumerSlot, /* frameNumber */ 0,
-            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, tracker->getMergedFence());
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "releasing buffer to input failed (%d)", status);
+        status = mInput->releaseBuffer(consumerSlot, /* frameNumber */ 0,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, tracker->getMergedFence());
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "releasing buffer to input failed (%d)", status);
 
-    ALOGV("released buffer %#" PRIx64 " to input", buffer->getId());
+        ALOGV("released buffer %#" PRIx64 " to input", bufferId);
+    }
 
     // We no longer need to track the buffer once it has been returned to the
     // input
-    mBuffers.removeItem(buffer->getId());
+    mBuffers.removeItem(bufferId);
 
     // Notify any waiting onFrameAvailable calls
     --mOutstandingBuffers;
@@ -261,13 +307,13 @@ void StreamSplitter::onAbandonedLocked() {
 
 StreamSplitter::OutputListener::OutputListener(
         const sp<StreamSplitter>& splitter,
-        const sp<IGraphicBufferProducer>& output)
-      : mSplitter(splitter), mOutput(output) {}
+        const sp<IGraphicBufferProducer>& output, size_t outputIndex)
+      : mSplitter(splitter), mOutput(output), mOutputIndex(outputIndex) {}
 
 StreamSplitter::OutputListener::~OutputListener() {}
 
 void StreamSplitter::OutputListener::onBufferReleased() {
-    mSplitter->onBufferReleasedByOutput(mOutput);
+    mSplitter->onBufferReleasedByOutput(mOutput, mOutputIndex);
 }
 
 void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
@@ -275,13 +321,33 @@ void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
     mSplitter->onAbandonedLocked();
 }
 
-StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer)
-      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReleaseCount(0) {}
+StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer,
+        size_t outputCount)
+      : mBuffer(buffer), mReleaseFences(outputCount, Fence::NO_FENCE),
+        mRemainingReleases(outputCount) {}
 
 StreamSplitter::BufferTracker::~BufferTracker() {}
 
-void StreamSplitter::BufferTracker::mergeFence(const sp<Fence>& with) {
-    mMergedFence = Fence::merge(String8("StreamSplitter"), mMergedFence, with);
+bool StreamSplitter::BufferTracker::releaseByOutput(size_t outputIndex,
+        const sp<Fence>& fence) {
+    mReleaseFences[outputIndex] = fence;
+    // The last release must see the fences stored by the others
+    return mRemainingReleases.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+sp<Fence> StreamSplitter::BufferTracker::getMergedFence() const {
+    // Most outputs release without a fence, so only merge when more than one
+    // of them has one
+    sp<Fence> merged = Fence::NO_FENCE;
+    for (const sp<Fence>& fence : mReleaseFences) {
+        if (fence == nullptr || !fence->isValid()) {
+            continue;
+        }
+        merged = merged->isValid()
+                ? Fence::merge(String8("StreamSplitter"), merged, fence)
+                : fence;
+    }
+    return merged;
 }
 
 } // namespace android
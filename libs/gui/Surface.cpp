@@ -20,6 +20,8 @@
 
 #include <gui/Surface.h>
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
@@ -43,6 +45,7 @@
 
 #include <gui/AidlStatusUtil.h>
 #include <gui/BufferItem.h>
+#include <gui/DisplayEventReceiver.h>
 
 #include <gui/IProducerListener.h>
 
@@ -67,6 +70,26 @@ enum {
     NATIVE_WINDOW_GET_HDR_SUPPORT = 29,
 };
 
+// Frame timelines of the display, as Choreographer gets them.
+class DisplayEventVsyncSource : public Surface::VsyncSource {
+public:
+    status_t getLatestVsyncEventData(gui::VsyncEventData* outVsyncEventData) override {
+        status_t err = mReceiver.initCheck();
+        if (err != NO_ERROR) {
+            return err;
+        }
+        gui::ParcelableVsyncEventData vsyncEventData;
+        err = mReceiver.getLatestVsyncEventData(&vsyncEventData);
+        if (err == NO_ERROR) {
+            *outVsyncEventData = vsyncEventData.vsync;
+        }
+        return err;
+    }
+
+private:
+    DisplayEventReceiver mReceiver;
+};
+
 bool isInterceptorRegistrationOp(int op) {
     return op == NATIVE_WINDOW_SET_CANCEL_INTERCEPTOR ||
             op == NATIVE_WINDOW_SET_DEQUEUE_INTERCEPTOR ||
@@ -148,6 +171,11 @@ nsecs_t Surface::now() const {
     return systemTime();
 }
 
+void Surface::waitUntil(nsecs_t time) {
+    std::this_thread::sleep_until(
+            std::chrono::steady_clock::time_point(std::chrono::nanoseconds(time)));
+}
+
 sp<IGraphicBufferProducer> Surface::getIGraphicBufferProducer() const {
     return mGraphicBufferProducer;
 }
@@ -216,6 +244,105 @@ void Surface::enableFrameTimestamps(bool enable) {
     mEnableFrameTimestamps = enable;
 }
 
+status_t Surface::setFramePacingEnabled(bool enabled, const sp<VsyncSource>& vsyncSource) {
+    Mutex::Autolock lock(mMutex);
+    if (!enabled) {
+        mVsyncSource = nullptr;
+    } else if (vsyncSource != nullptr) {
+        mVsyncSource = vsyncSource;
+    } else {
+        mVsyncSource = sp<DisplayEventVsyncSource>::make();
+    }
+    mFramePacingEnabled = enabled;
+    mPacingVsyncEventData = {};
+    mPacedPresentTime = 0;
+    mLastPacedPresentTime = 0;
+    mRenderDurationEstimate = 0;
+    return NO_ERROR;
+}
+
+const gui::VsyncEventData::FrameTimeline* Surface::findPacedFrameTimeline(
+        const gui::VsyncEventData& vsyncEventData, nsecs_t lastPresentTime,
+        nsecs_t renderDuration, nsecs_t startTime) {
+    // Target the earliest timeline after the one of the previous frame whose deadline the frame
+    // can still make. Timelines less than half a frame apart are the same vsync.
+    const nsecs_t minPresentTime = lastPresentTime + vsyncEventData.frameInterval / 2;
+    const size_t timelineCount =
+            std::min<size_t>(vsyncEventData.frameTimelinesLength,
+                             gui::VsyncEventData::kFrameTimelinesCapacity);
+    for (size_t i = 0; i < timelineCount; i++) {
+        const auto& timeline = vsyncEventData.frameTimelines[i];
+        if (timeline.expectedPresentationTime > minPresentTime &&
+            timeline.deadlineTimestamp - renderDuration >= startTime) {
+            return &timeline;
+        }
+    }
+    return nullptr;
+}
+
+void Surface::waitForPacedFrameStart() {
+    sp<VsyncSource> vsyncSource;
+    gui::VsyncEventData vsyncEventData;
+    nsecs_t lastPresentTime;
+    nsecs_t renderDuration;
+    {
+        Mutex::Autolock lock(mMutex);
+        if (!mFramePacingEnabled || (mSharedBufferMode && mAutoRefresh)) {
+            return;
+        }
+        vsyncSource = mVsyncSource;
+        vsyncEventData = mPacingVsyncEventData;
+        lastPresentTime = mLastPacedPresentTime;
+        renderDuration = mRenderDurationEstimate;
+    }
+
+    // The timelines only go stale once the frame is too late for all of them, so the vsync
+    // source is only asked for new ones every few frames.
+    const nsecs_t startTime = now();
+    const gui::VsyncEventData::FrameTimeline* target =
+            findPacedFrameTimeline(vsyncEventData, lastPresentTime, renderDuration, startTime);
+    if (target == nullptr) {
+        if (vsyncSource->getLatestVsyncEventData(&vsyncEventData) != NO_ERROR) {
+            // Render unpaced rather than not at all.
+            return;
+        }
+        {
+            Mutex::Autolock lock(mMutex);
+            if (mVsyncSource == vsyncSource) {
+                mPacingVsyncEventData = vsyncEventData;
+            }
+        }
+        target = findPacedFrameTimeline(vsyncEventData, lastPresentTime, renderDuration,
+                                        startTime);
+        if (target == nullptr) {
+            return;
+        }
+    }
+
+    const nsecs_t wakeTime = target->deadlineTimestamp - renderDuration;
+    if (wakeTime > startTime) {
+        ATRACE_FORMAT("waitForPacedFrameStart %" PRId64 "us", ns2us(wakeTime - startTime));
+        waitUntil(wakeTime);
+    }
+
+    Mutex::Autolock lock(mMutex);
+    mPacedPresentTime = target->expectedPresentationTime;
+    mPacedFrameStartTime = now();
+}
+
+nsecs_t Surface::onPacedFrameQueuedLocked() {
+    if (mPacedPresentTime == 0) {
+        return mTimestamp;
+    }
+    const nsecs_t renderDuration = now() - mPacedFrameStartTime;
+    mRenderDurationEstimate = renderDuration > mRenderDurationEstimate
+            ? renderDuration
+            : (mRenderDurationEstimate * 7 + renderDuration) / 8;
+    mLastPacedPresentTime = mPacedPresentTime;
+    mPacedPresentTime = 0;
+    return mTimestamp == NATIVE_WINDOW_TIMESTAMP_AUTO ? mLastPacedPresentTime : mTimestamp;
+}
+
 status_t Surface::getCompositorTiming(
         nsecs_t* compositeDeadline, nsecs_t* compositeInterval,
         nsecs_t* compositeToPresentLatency) {
@@ -567,6 +694,8 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     ATRACE_FORMAT("dequeueBuffer - %s", getDebugName());
     ALOGV("Surface::dequeueBuffer");
 
+    waitForPacedFrameStart();
+
     IGraphicBufferProducer::DequeueBufferInput dqInput;
     {
         Mutex::Autolock lock(mMutex);
@@ -874,6 +1003,8 @@ int Surface::cancelBuffer(android_native_buffer_t* buffer,
     }
 
     mDequeuedSlots.erase(i);
+    // The next frame picks its own timeline.
+    mPacedPresentTime = 0;
 
     return OK;
 }
@@ -1118,7 +1249,7 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
 
     IGraphicBufferProducer::QueueBufferOutput output;
     IGraphicBufferProducer::QueueBufferInput input;
-    getQueueBufferInputLocked(buffer, fenceFd, mTimestamp, &input);
+    getQueueBufferInputLocked(buffer, fenceFd, onPacedFrameQueuedLocked(), &input);
     applyGrallocMetadataLocked(buffer, input);
     sp<Fence> fence = input.fence;
 
@@ -1892,6 +2023,10 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
         mAutoPrerotation = false;
         mEnableFrameTimestamps = false;
         mMaxBufferCount = NUM_BUFFER_SLOTS;
+        mPacingVsyncEventData = {};
+        mPacedPresentTime = 0;
+        mLastPacedPresentTime = 0;
+        mRenderDurationEstimate = 0;
 
         if (api == NATIVE_WINDOW_API_CPU) {
             mConnectedToCpu = false;
@@ -20,6 +20,8 @@
 #include <gui/ConsumerBase.h>
 #include <gui/BufferQueue.h>
 
+#include <vector>
+
 #define ANDROID_GRAPHICS_BUFFERITEMCONSUMER_JNI_ID "mBufferItemConsumer"
 
 namespace android {
@@ -85,6 +87,24 @@ class BufferItemConsumer: public ConsumerBase
     status_t releaseBuffer(const BufferItem &item,
             const sp<Fence>& releaseFence = Fence::NO_FENCE);
 
+    // Batched version of acquireBuffer. Acquires up to maxBuffers of the
+    // pending buffers with a single call into the BufferQueue, oldest first,
+    // and returns them in items. Stops early, without an error, once no more
+    // buffers are pending or the maximum number of buffers is acquired.
+    // Returns NO_BUFFER_AVAILABLE if the queue of buffers is empty, and
+    // INVALID_OPERATION if the maximum number of buffers is already acquired.
+    //
+    // If waitForFence is true, acquireBuffers waits on the fences of all the
+    // acquired BufferItems before returning.
+    status_t acquireBuffers(std::vector<BufferItem>* items, nsecs_t presentWhen,
+            int maxBuffers, bool waitForFence = true);
+
+    // Batched version of releaseBuffer. Returns all the items to the queue
+    // with a single call into the BufferQueue, each with releaseFence. Returns
+    // OK if every buffer was released, or else the first error.
+    status_t releaseBuffers(const std::vector<BufferItem>& items,
+            const sp<Fence>& releaseFence = Fence::NO_FENCE);
+
    private:
     void freeBufferLocked(int slotIndex) override;
 
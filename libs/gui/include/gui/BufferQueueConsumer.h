@@ -24,9 +24,13 @@
 #include <gui/IGraphicBufferConsumer.h>
 #include <utils/String8.h>
 
+#include <mutex>
+#include <vector>
+
 namespace android {
 
 class BufferQueueCore;
+class IProducerListener;
 
 class BufferQueueConsumer : public BnGraphicBufferConsumer {
 
@@ -72,6 +76,17 @@ public:
             const sp<Fence>& releaseFence, EGLDisplay display,
             EGLSyncKHR fence);
 
+    // See IGraphicBufferConsumer::acquireBuffers. All the buffers are acquired
+    // with a single lock of the BufferQueueCore.
+    status_t acquireBuffers(int maxBuffers, nsecs_t expectedPresent,
+            std::vector<BufferItem>* outBuffers) override;
+
+    // See IGraphicBufferConsumer::releaseBuffers. All the buffers are released
+    // with a single lock of the BufferQueueCore, and waiting producers are
+    // woken up once.
+    status_t releaseBuffers(const std::vector<ReleaseBufferInput>& inputs,
+            std::vector<status_t>* results) override;
+
     // connect connects a consumer to the BufferQueue.  Only one
     // consumer may be connected, and when that consumer disconnects the
     // BufferQueue is placed into the "abandoned" state, causing most
@@ -179,6 +194,25 @@ public:
     void setAllowExtraAcquire(bool /* allow */);
 
 private:
+    // acquireBufferLocked does the work of acquireBuffer, with mCore->mMutex
+    // held by lock, except for waking up the producer, which the callers do
+    // once per call rather than once per buffer. The buffers it drops on the
+    // way are added to outNumDroppedBuffers, and the producer listener to
+    // notify of them once the lock is released is returned in outListener.
+    status_t acquireBufferLocked(BufferItem* outBuffer, nsecs_t expectedPresent,
+            uint64_t maxFrameNumber, std::unique_lock<std::mutex>& lock,
+            int* outNumDroppedBuffers, sp<IProducerListener>* outListener);
+
+    // releaseBufferLocked does the work of releaseBuffer, with mCore->mMutex
+    // held, except for waking up the producer. The producer listener to notify
+    // once the lock is released is returned in outListener.
+    status_t releaseBufferLocked(int slot, uint64_t frameNumber,
+            const sp<Fence>& releaseFence, EGLDisplay eglDisplay,
+            EGLSyncKHR eglFence, sp<IProducerListener>* outListener);
+
+    // Returns the number of buffers currently acquired by the consumer.
+    int getAcquiredBufferCountLocked() const;
+
     sp<BufferQueueCore> mCore;
 
     // This references mCore->mSlots. Lock mCore->mMutex while accessing.
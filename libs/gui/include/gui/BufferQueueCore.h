@@ -19,6 +19,7 @@
 
 #include <gui/BufferItem.h>
 #include <gui/BufferQueueDefs.h>
+#include <gui/BufferQueueStats.h>
 #include <gui/BufferSlot.h>
 #include <gui/OccupancyTracker.h>
 
@@ -344,6 +345,10 @@ private:
 
     OccupancyTracker mOccupancyTracker;
 
+    // mStats records how the buffers move through the BufferQueue, for
+    // dumpsys SurfaceFlinger --buffer-stats. It doesn't need mMutex.
+    BufferQueueStats mStats;
+
     const uint64_t mUniqueId;
 
     // When buffer size is driven by the consumer and mTransformHint specifies
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Timers.h>
+
+#include <sys/types.h>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/**
+ * Continuous instrumentation of a BufferQueue: how long dequeueBuffer blocks, how long buffers
+ * wait in the queue before being acquired, how long the consumer holds them, and how deep the
+ * queue is when a buffer is queued.
+ *
+ * Every BufferQueueCore owns one. Recording only touches relaxed atomics, so it never adds a lock
+ * to the buffer path. The stats of all the BufferQueues of the process can be collected, and
+ * dumped, aggregated by producer process and consumer name. The stats of a destroyed BufferQueue
+ * stay in its aggregate.
+ */
+class BufferQueueStats {
+public:
+    // Durations in power-of-two microsecond buckets: bucket 0 counts durations under 1us, and
+    // bucket i counts durations in [2^(i-1)us, 2^i us). The last bucket also counts anything
+    // longer.
+    static constexpr size_t kDurationBucketCount = 24;
+    // Queue depths 0 to kOccupancyBucketCount - 1. The last bucket also counts deeper queues.
+    static constexpr size_t kOccupancyBucketCount = 8;
+
+    struct Histogram {
+        std::array<uint64_t, kDurationBucketCount> buckets{};
+        uint64_t count = 0;
+        nsecs_t total = 0;
+        nsecs_t max = 0;
+
+        void merge(const Histogram& other);
+        // Returns an upper bound of the given percentile, from 0 to 100, of the durations.
+        nsecs_t percentile(float percent) const;
+    };
+
+    struct Snapshot {
+        uint64_t dequeueCount = 0;
+        // One sample per wait of dequeueBuffer for a free buffer.
+        Histogram dequeueBlockTime;
+        // From queueBuffer to acquireBuffer.
+        Histogram queueToAcquireTime;
+        // From acquireBuffer to releaseBuffer.
+        Histogram holdTime;
+        // Queue depth right after each queueBuffer.
+        std::array<uint64_t, kOccupancyBucketCount> occupancy{};
+
+        void merge(const Snapshot& other);
+    };
+
+    struct Aggregate {
+        std::string producerName;
+        std::string consumerName;
+        // BufferQueues still alive in this aggregate.
+        size_t liveQueueCount = 0;
+        Snapshot stats;
+    };
+
+    BufferQueueStats();
+    ~BufferQueueStats();
+
+    BufferQueueStats(const BufferQueueStats&) = delete;
+    BufferQueueStats& operator=(const BufferQueueStats&) = delete;
+
+    void setConsumerName(const std::string& name);
+    // Resolves the name of the producer process, while it is alive to be asked. Called when the
+    // producer connects, without holding the BufferQueue lock, as it reads /proc.
+    void setProducerPid(pid_t pid);
+
+    void recordDequeue() { mDequeueCount.fetch_add(1, std::memory_order_relaxed); }
+    void recordDequeueBlock(nsecs_t duration) { mDequeueBlockTime.record(duration); }
+    void recordQueueToAcquire(nsecs_t duration) { mQueueToAcquireTime.record(duration); }
+    void recordHold(nsecs_t duration) { mHoldTime.record(duration); }
+    void recordOccupancy(size_t occupancy);
+
+    Snapshot snapshot() const;
+
+    // Returns the stats of all the BufferQueues of the process, live or destroyed, aggregated by
+    // producer process and consumer name.
+    static std::vector<Aggregate> collect();
+    static void dump(std::string& result);
+
+private:
+    class AtomicHistogram {
+    public:
+        void record(nsecs_t duration);
+        Histogram load() const;
+
+    private:
+        std::array<std::atomic<uint64_t>, kDurationBucketCount> mBuckets{};
+        std::atomic<uint64_t> mCount{0};
+        std::atomic<nsecs_t> mTotal{0};
+        std::atomic<nsecs_t> mMax{0};
+    };
+
+    class Registry;
+
+    std::string getConsumerName() const;
+    std::string getProducerName() const;
+
+    std::atomic<uint64_t> mDequeueCount{0};
+    AtomicHistogram mDequeueBlockTime;
+    AtomicHistogram mQueueToAcquireTime;
+    AtomicHistogram mHoldTime;
+    std::array<std::atomic<uint64_t>, kOccupancyBucketCount> mOccupancy{};
+
+    std::atomic<pid_t> mProducerPid{-1};
+    // Only taken to rename the BufferQueue, and to collect the stats.
+    mutable std::mutex mNameMutex;
+    std::string mConsumerName;
+    // "pid:process name" of the last producer to connect.
+    std::string mProducerName = "<none>";
+};
+
+} // namespace android
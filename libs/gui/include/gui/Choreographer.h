@@ -18,30 +18,17 @@
 
 #include <android/choreographer.h>
 #include <gui/DisplayEventDispatcher.h>
+#include <gui/FrameCallbackQueue.h>
 #include <jni.h>
 #include <utils/Looper.h>
 
+#include <atomic>
 #include <mutex>
-#include <queue>
 #include <thread>
 
 namespace android {
 using gui::VsyncEventData;
 
-struct FrameCallback {
-    AChoreographer_frameCallback callback;
-    AChoreographer_frameCallback64 callback64;
-    AChoreographer_vsyncCallback vsyncCallback;
-    void* data;
-    nsecs_t dueTime;
-
-    inline bool operator<(const FrameCallback& rhs) const {
-        // Note that this is intentionally flipped because we want callbacks due sooner to be at
-        // the head of the queue
-        return dueTime > rhs.dueTime;
-    }
-};
-
 struct RefreshRateCallback {
     AChoreographer_refreshRateCallback callback;
     void* data;
@@ -118,13 +105,25 @@ private:
                                     std::vector<FrameRateOverride> overrides) override;
 
     void scheduleCallbacks();
+    // Makes sure a MSG_SCHEDULE_CALLBACKS message is handled by dueTime, unless one already is.
+    void requestCallbacksWakeup(nsecs_t dueTime, nsecs_t now);
+    // Moves the posted callbacks to mFrameCallbacks. Requires mLock.
+    void takePostedCallbacksLocked();
 
     ChoreographerFrameCallbackDataImpl createFrameCallbackData(nsecs_t timestamp) const;
     void registerStartTime() const;
 
+    // Callbacks posted by postFrameCallbackDelayed, without taking mLock.
+    FrameCallbackInbox mPostedFrameCallbacks;
+    // Whether a MSG_SCHEDULE_VSYNC message is pending, so that callbacks posted from other threads
+    // share a single message.
+    std::atomic<bool> mVsyncMessagePending = false;
+    // The earliest time a pending MSG_SCHEDULE_CALLBACKS message is due, or kNoDueTime.
+    std::atomic<nsecs_t> mNextCallbacksWakeup = FrameCallbackSchedule::kNoDueTime;
+
     std::mutex mLock;
     // Protected by mLock
-    std::priority_queue<FrameCallback> mFrameCallbacks;
+    FrameCallbackSchedule mFrameCallbacks;
     std::vector<RefreshRateCallback> mRefreshRateCallbacks;
 
     nsecs_t mLatestVsyncPeriod = -1;
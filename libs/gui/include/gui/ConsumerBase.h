@@ -28,6 +28,8 @@
 #include <utils/Vector.h>
 #include <utils/threads.h>
 
+#include <vector>
+
 
 namespace android {
 // ----------------------------------------------------------------------------
@@ -207,6 +209,21 @@ protected:
             const sp<GraphicBuffer> graphicBuffer,
             EGLDisplay display = EGL_NO_DISPLAY, EGLSyncKHR eglFence = EGL_NO_SYNC_KHR);
 
+    // acquireBuffersLocked is the batched version of acquireBufferLocked. It
+    // fetches up to maxBuffers buffers from the BufferQueue with a single call
+    // (see IGraphicBufferConsumer::acquireBuffers) and updates their buffer
+    // slots. It does not go through acquireBufferLocked, so derived classes
+    // that override acquireBufferLocked must not use it.
+    status_t acquireBuffersLocked(std::vector<BufferItem>* items,
+            nsecs_t presentWhen, int maxBuffers);
+
+    // releaseBuffersLocked is the batched version of releaseBufferLocked,
+    // without EGL fences. The result for each of the items is returned in
+    // results. It does not go through releaseBufferLocked, so derived classes
+    // that override releaseBufferLocked must not use it.
+    status_t releaseBuffersLocked(const std::vector<BufferItem>& items,
+            std::vector<status_t>* results);
+
     // returns true iff the slot still has the graphicBuffer in it.
     bool stillTracking(int slot, const sp<GraphicBuffer> graphicBuffer);
 
@@ -22,8 +22,11 @@
 #include <gui/ConsumerBase.h>
 #include <gui/BufferQueue.h>
 
+#include <utils/Condition.h>
 #include <utils/Vector.h>
 
+#include <thread>
+#include <vector>
 
 namespace android {
 
@@ -89,11 +92,33 @@ class CpuConsumer : public ConsumerBase
         {}
     };
 
+    struct Options {
+        // Remember how the buffer in each BufferQueue slot was mapped, for
+        // as long as it stays in its slot, and map it the same way in later
+        // lockNextBuffer calls, without probing for a flexible YUV layout.
+        // Buffers are still locked in every lockNextBuffer and unlocked in
+        // every unlockBuffer, so gralloc does its cache maintenance and the
+        // producer never writes to a buffer locked for reading. Gralloc keeps
+        // the buffers themselves mapped while they are imported.
+        bool persistentMapping;
+
+        // Acquire and map the next buffer on a background thread as soon as
+        // it is queued, so that lockNextBuffer returns it without waiting.
+        // This acquires one more buffer than maxLockedBuffers.
+        bool prefetch;
+    };
+
     // Create a new CPU consumer. The maxLockedBuffers parameter specifies
     // how many buffers can be locked for user access at the same time.
     CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
             size_t maxLockedBuffers, bool controlledByApp = false);
 
+    CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
+            size_t maxLockedBuffers, bool controlledByApp,
+            const Options& options);
+
+    ~CpuConsumer() override;
+
     // Gets the next graphics buffer from the producer and locks it for CPU use,
     // filling out the passed-in locked buffer structure with the native pointer
     // and metadata. Returns BAD_VALUE if no new buffer is available, and
@@ -111,10 +136,30 @@ class CpuConsumer : public ConsumerBase
     // lockNextBuffer.
     status_t unlockBuffer(const LockedBuffer &nativeBuffer);
 
+    // How lockNextBuffer got the buffers it returned, for tests and
+    // benchmarks.
+    struct Stats {
+        // Buffers mapped on the prefetch thread
+        size_t prefetchedBuffers = 0;
+        // Buffers mapped the way their slot was mapped before
+        size_t reusedMappings = 0;
+    };
+    Stats getStats() const;
+
+  protected:
+    // ConsumerBase overrides, to forget persistent mappings and to start and
+    // stop prefetching.
+    void onFrameAvailable(const BufferItem& item) override;
+    void freeBufferLocked(int slotIndex) override;
+    void abandonLocked() override;
+
   private:
     // Maximum number of buffers that can be locked at a time
     const size_t mMaxLockedBuffers;
 
+    const bool mPersistentMapping;
+    const bool mPrefetch;
+
     // Tracking for buffers acquired by the user
     struct AcquiredBuffer {
         static constexpr uintptr_t kUnusedId = 0;
@@ -138,14 +183,57 @@ class CpuConsumer : public ConsumerBase
         }
     };
 
+    // How the buffer in a slot was mapped
+    struct SlotMapping {
+        sp<GraphicBuffer> mGraphicBuffer;
+        bool mFlexYuv = false;
+    };
+
+    enum class PrefetchState {
+        IDLE,
+        IN_PROGRESS,
+        READY,
+    };
+
     size_t findAcquiredBufferLocked(uintptr_t id) const;
 
-    status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const;
+    // Maps the buffer for CPU reads once fence has signaled, and fills in the
+    // data, stride, chroma and flexFormat fields of outBuffer. Unless
+    // tryFlexYuv, the buffer is not mapped as flexible YUV.
+    status_t mapBuffer(const sp<GraphicBuffer>& buffer, const Rect& rect,
+            const sp<Fence>& fence, bool tryFlexYuv, LockedBuffer* outBuffer) const;
+
+    // Locks the buffer of item for CPU reads. With unlockWhileMapping, mMutex
+    // is unlocked while waiting for the fence and mapping the buffer.
+    status_t lockBufferItemLocked(const BufferItem& item, LockedBuffer* outBuffer,
+            bool unlockWhileMapping);
+
+    // Whether the mapping of the buffer in its slot is remembered.
+    bool isMappingCachedLocked(int slot, const sp<GraphicBuffer>& buffer) const;
+
+    void prefetchLoop();
 
     Vector<AcquiredBuffer> mAcquiredBuffers;
 
     // Count of currently locked buffers
     size_t mCurrentLockedBuffers;
+
+    // Indexed by slot when mPersistentMapping is set, empty otherwise
+    std::vector<SlotMapping> mMappings;
+
+    // Prefetching state, protected by mMutex
+    Condition mPrefetchCondition;
+    PrefetchState mPrefetchState;
+    // Set when a buffer may be available to prefetch
+    bool mPrefetchRequested;
+    bool mPrefetchStopped;
+    BufferItem mPrefetchItem;
+    LockedBuffer mPrefetchBuffer;
+    status_t mPrefetchStatus;
+    std::thread mPrefetchThread;
+
+    // Protected by mMutex
+    Stats mStats;
 };
 
 } // namespace android
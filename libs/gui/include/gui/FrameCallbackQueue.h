@@ -0,0 +1,142 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/choreographer.h>
+#include <utils/Timers.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+namespace android {
+
+struct FrameCallback {
+    AChoreographer_frameCallback callback;
+    AChoreographer_frameCallback64 callback64;
+    AChoreographer_vsyncCallback vsyncCallback;
+    void* data;
+    nsecs_t dueTime;
+
+    inline bool operator<(const FrameCallback& rhs) const {
+        // Note that this is intentionally flipped because we want callbacks due sooner to be at
+        // the head of the queue
+        return dueTime > rhs.dueTime;
+    }
+};
+
+/**
+ * Lock-free queue of frame callbacks posted from any number of threads, drained by the thread
+ * dispatching them.
+ *
+ * Callbacks are held in a pool of kCapacity preallocated nodes, which are recycled as the inbox
+ * is drained, so posting does not allocate. Callbacks posted while the pool is exhausted are held
+ * in nodes allocated on the heap instead, and are drained like the others.
+ */
+class FrameCallbackInbox {
+public:
+    static constexpr size_t kCapacity = 32;
+
+    FrameCallbackInbox();
+    ~FrameCallbackInbox();
+
+    // Safe to call from any thread. Returns true if the inbox was empty.
+    bool post(const FrameCallback& callback);
+
+    // Calls f with every posted callback, in the order they were posted, and empties the inbox.
+    template <typename F>
+    void drain(F&& f) {
+        Node* node = reverse(mHead.exchange(nullptr, std::memory_order_acquire));
+        while (node != nullptr) {
+            f(node->callback);
+            Node* next = node->next;
+            recycle(node);
+            node = next;
+        }
+    }
+
+private:
+    struct Node {
+        FrameCallback callback;
+        Node* next;
+        // Index + 1 of the next node in the free list, or 0 at its end. Pool nodes only.
+        std::atomic<uint32_t> nextFree;
+    };
+
+    static Node* reverse(Node* head);
+
+    // Takes a node from the pool, or from the heap if the pool is exhausted.
+    Node* allocate();
+    void recycle(Node* node);
+
+    FrameCallbackInbox(const FrameCallbackInbox&) = delete;
+    FrameCallbackInbox& operator=(const FrameCallbackInbox&) = delete;
+
+    // Most recently posted first.
+    std::atomic<Node*> mHead = nullptr;
+
+    std::array<Node, kCapacity> mPool;
+    // The free nodes of mPool: the index + 1 of the first one in the low 32 bits, and in the high
+    // 32 bits a count of the updates, so that a stale compare_exchange can't succeed after the
+    // node it read was taken and returned (ABA).
+    std::atomic<uint64_t> mFreeList;
+};
+
+/**
+ * Frame callbacks waiting for their due time, in buckets one vsync period wide. Adding a callback
+ * is O(1), and taking the due callbacks is linear in their number plus the vsyncs elapsed.
+ * Callbacks due outside of the kNumBuckets vsyncs covered by the buckets wait in an overflow list.
+ *
+ * Not thread safe.
+ */
+class FrameCallbackSchedule {
+public:
+    static constexpr size_t kNumBuckets = 64;
+    static constexpr nsecs_t kDefaultBucketWidth = 16'666'667;
+    static constexpr nsecs_t kNoDueTime = std::numeric_limits<nsecs_t>::max();
+
+    void add(const FrameCallback& callback);
+
+    // Moves the callbacks due before now to outCallbacks, in order of their vsync bucket, and in
+    // the order they were added within a bucket.
+    void takeDue(nsecs_t now, std::vector<FrameCallback>* outCallbacks);
+
+    // The earliest due time of the scheduled callbacks, or kNoDueTime if there are none.
+    nsecs_t nextDueTime() const;
+
+    // Re-buckets the scheduled callbacks if the vsync period changed.
+    void setBucketWidth(nsecs_t bucketWidth);
+
+    bool empty() const { return mSize == 0; }
+    size_t size() const { return mSize; }
+
+private:
+    int64_t bucketOf(nsecs_t dueTime) const { return std::max<nsecs_t>(dueTime, 0) / mBucketWidth; }
+    std::vector<FrameCallback>& bucketAt(int64_t bucket) { return mBuckets[bucket % kNumBuckets]; }
+    void insert(const FrameCallback& callback);
+
+    nsecs_t mBucketWidth = kDefaultBucketWidth;
+    // The bucket stored in mBuckets[mFirstBucket % kNumBuckets], the earliest one not yet taken.
+    int64_t mFirstBucket = 0;
+    std::array<std::vector<FrameCallback>, kNumBuckets> mBuckets;
+    std::vector<FrameCallback> mOverflow;
+    size_t mSize = 0;
+};
+
+} // namespace android
@@ -24,9 +24,13 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
+#include <ui/Fence.h>
 #include <ui/PixelFormat.h>
 
 #include <utils/Errors.h>
+#include <utils/Flattenable.h>
+
+#include <vector>
 
 namespace android {
 
@@ -148,6 +152,41 @@ public:
     // as we can finally finish converting away from EGL sync to native Android sync
     using ReleaseBuffer = decltype(&IGraphicBufferConsumer::releaseHelper);
 
+    // Batched version of acquireBuffer().
+    // This method acquires up to maxBuffers pending buffers, oldest first, and stops at the first
+    // buffer that acquireBuffer() would not return, or once the consumer holds as many buffers as
+    // acquireBuffer() allows. The acquired buffers are returned in outBuffers, in acquisition
+    // order. As with acquireBuffer(), a non-zero presentWhen drops the buffers that a later one
+    // replaces on screen, so only presentWhen 0 drains a deep queue.
+    //
+    // Return of NO_ERROR means at least one buffer was acquired. Otherwise the result is what
+    // acquireBuffer() would have returned for the first buffer, or BAD_VALUE if maxBuffers is less
+    // than 1.
+    virtual status_t acquireBuffers(int maxBuffers, nsecs_t presentWhen,
+                                    std::vector<BufferItem>* outBuffers);
+
+    struct ReleaseBufferInput : public Flattenable<ReleaseBufferInput> {
+        ReleaseBufferInput() = default;
+
+        // Flattenable protocol
+        static constexpr size_t minFlattenedSize();
+        size_t getFlattenedSize() const;
+        size_t getFdCount() const;
+        status_t flatten(void*& buffer, size_t& size, int*& fds, size_t& count) const;
+        status_t unflatten(void const*& buffer, size_t& size, int const*& fds, size_t& count);
+
+        int slot = -1;
+        uint64_t frameNumber = 0;
+        sp<Fence> fence = Fence::NO_FENCE;
+    };
+    // Batched version of releaseBuffer(), without the EGL objects (see releaseHelper).
+    // This method behaves like a sequence of releaseBuffer() calls, so an input with a null fence
+    // gets BAD_VALUE.
+    // The return value of the batched method will only be about the
+    // transaction. For a local call, the return value will always be NO_ERROR.
+    virtual status_t releaseBuffers(const std::vector<ReleaseBufferInput>& inputs,
+                                    std::vector<status_t>* results);
+
     // consumerConnect connects a consumer to the BufferQueue. Only one consumer may be connected,
     // and when that consumer disconnects the BufferQueue is placed into the "abandoned" state,
     // causing most interactions with the BufferQueue by the producer to fail. controlledByApp
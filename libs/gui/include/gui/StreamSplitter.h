@@ -25,6 +25,9 @@
 #include <utils/Mutex.h>
 #include <utils/StrongPointer.h>
 
+#include <atomic>
+#include <vector>
+
 namespace android {
 
 class GraphicBuffer;
@@ -39,6 +42,19 @@ class IGraphicBufferProducer;
 // again only once all of the outputs have released it.
 class StreamSplitter : public BnConsumerListener {
 public:
+    // What the splitter does when an output consumes buffers more slowly than
+    // the input produces them.
+    enum class BackpressurePolicy {
+        // Stall the input, and so every other output, until the output
+        // releases a buffer. Every buffer queued to the input reaches the
+        // output.
+        BLOCK,
+        // Replace the buffer the output has not acquired yet with the new
+        // one, and return the replaced buffer to the input. The output only
+        // sees the latest buffer, and never stalls the input.
+        DROP_OLDEST,
+    };
+
     // createSplitter creates a new splitter, outSplitter, using inputQueue as
     // the input BufferQueue. Output BufferQueues must be added using addOutput
     // before queueing any buffers to the input.
@@ -59,9 +75,14 @@ public:
     //
     // A return value other than NO_ERROR means that an error has occurred and
     // outputQueue has not been added to the splitter. BAD_VALUE is returned if
-    // outputQueue is NULL. See IGraphicBufferProducer::connect for explanations
-    // of other error codes.
-    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
+    // outputQueue is NULL. See IGraphicBufferProducer::connect and
+    // IGraphicBufferProducer::setAsyncMode for explanations of other error
+    // codes.
+    //
+    // A DROP_OLDEST output puts outputQueue in async mode, and holds up to its
+    // consumer's max acquired buffer count plus one buffer of the input.
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            BackpressurePolicy policy = BackpressurePolicy::BLOCK);
 
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
@@ -71,9 +92,11 @@ private:
     //
     // During this callback, we store some tracking information, detach the
     // buffer from the input, and attach it to each of the outputs. This call
-    // can block if there are too many outstanding buffers. If it blocks, it
-    // will resume when onBufferReleasedByOutput releases a buffer back to the
-    // input.
+    // can block if there are too many outstanding buffers, or if a BLOCK output
+    // has not released enough of them. If it blocks, it will resume when
+    // onBufferReleasedByOutput releases a buffer. The outputs are called
+    // without holding mMutex, so that their releases are not held up by a slow
+    // output.
     virtual void onFrameAvailable(const BufferItem& item);
 
     // From IConsumerListener
@@ -88,14 +111,26 @@ private:
 
     // This is the implementation of the onBufferReleased callback from
     // IProducerListener. It gets called from an OutputListener (see below), and
-    // 'from' is which producer interface from which the callback was received.
+    // 'from' is which producer interface from which the callback was received,
+    // the output at outputIndex in mOutputs. It is also called when queueing
+    // to a DROP_OLDEST output replaced a buffer.
     //
     // During this callback, we detach the buffer from the output queue that
-    // generated the callback, update our state tracking to see if this is the
-    // last output releasing the buffer, and if so, release it to the input.
-    // If we release the buffer to the input, we allow a blocked
-    // onFrameAvailable call to proceed.
-    void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from);
+    // generated the callback, and account for its release in
+    // releaseBufferFromOutput.
+    void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from,
+            size_t outputIndex);
+
+    // Records that the output at outputIndex no longer uses the buffer, with
+    // the output's release fence. If this is the last output releasing the
+    // buffer, it is released to the input. Either way, a blocked
+    // onFrameAvailable call may proceed.
+    void releaseBufferFromOutput(size_t outputIndex, uint64_t bufferId,
+            const sp<Fence>& fence);
+
+    // Whether onFrameAvailable must wait before taking another buffer from the
+    // input. This must be called with mMutex locked.
+    bool isInputBlockedLocked() const;
 
     // When this is called, the splitter disconnects from (i.e., abandons) its
     // input queue and signals any waiting onFrameAvailable calls to wake up.
@@ -112,7 +147,7 @@ private:
                            public IBinder::DeathRecipient {
     public:
         OutputListener(const sp<StreamSplitter>& splitter,
-                const sp<IGraphicBufferProducer>& output);
+                const sp<IGraphicBufferProducer>& output, size_t outputIndex);
         virtual ~OutputListener();
 
         // From IProducerListener
@@ -124,20 +159,25 @@ private:
     private:
         sp<StreamSplitter> mSplitter;
         sp<IGraphicBufferProducer> mOutput;
+        const size_t mOutputIndex;
     };
 
+    // Tracks the release of a buffer by every output. Releases are counted
+    // without holding mMutex: each output stores its release fence in its own
+    // slot, and the last one to release the buffer merges them.
     class BufferTracker : public LightRefBase<BufferTracker> {
     public:
-        explicit BufferTracker(const sp<GraphicBuffer>& buffer);
+        BufferTracker(const sp<GraphicBuffer>& buffer, size_t outputCount);
 
         const sp<GraphicBuffer>& getBuffer() const { return mBuffer; }
-        const sp<Fence>& getMergedFence() const { return mMergedFence; }
 
-        void mergeFence(const sp<Fence>& with);
+        // Records the release by the output at outputIndex. Returns true if
+        // it was the last output still using the buffer.
+        bool releaseByOutput(size_t outputIndex, const sp<Fence>& fence);
 
-        // Returns the new value
-        // Only called while mMutex is held
-        size_t incrementReleaseCountLocked() { return ++mReleaseCount; }
+        // The release fences of all outputs, merged. Only valid once
+        // releaseByOutput has returned true.
+        sp<Fence> getMergedFence() const;
 
     private:
         // Only destroy through LightRefBase
@@ -149,8 +189,15 @@ private:
         BufferTracker& operator=(const BufferTracker& other);
 
         sp<GraphicBuffer> mBuffer; // One instance that holds this native handle
-        sp<Fence> mMergedFence;
-        size_t mReleaseCount;
+        std::vector<sp<Fence> > mReleaseFences; // Indexed by output
+        std::atomic<size_t> mRemainingReleases;
+    };
+
+    struct Output {
+        sp<IGraphicBufferProducer> queue;
+        BackpressurePolicy policy;
+        // Buffers queued to this output and not released by it yet
+        int pendingBuffers;
     };
 
     // Only called from createSplitter
@@ -161,6 +208,10 @@ private:
 
     static const int MAX_OUTSTANDING_BUFFERS = 2;
 
+    // How many more buffers may be outstanding for each DROP_OLDEST output:
+    // the one it has acquired, and the one waiting to replace it.
+    static const int DROP_OLDEST_OUTSTANDING_BUFFERS = 2;
+
     // mIsAbandoned is set to true when an output dies. Once the StreamSplitter
     // has been abandoned, it will continue to detach buffers from other
     // outputs, but it will disconnect from the input and not attempt to
@@ -170,8 +221,9 @@ private:
     Mutex mMutex;
     Condition mReleaseCondition;
     int mOutstandingBuffers;
+    int mMaxOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
-    Vector<sp<IGraphicBufferProducer> > mOutputs;
+    std::vector<Output> mOutputs;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
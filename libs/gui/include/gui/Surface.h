@@ -22,6 +22,7 @@
 #include <gui/HdrMetadata.h>
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/IProducerListener.h>
+#include <gui/VsyncEventData.h>
 #include <system/window.h>
 #include <ui/ANativeObjectBase.h>
 #include <ui/GraphicTypes.h>
@@ -215,6 +216,28 @@ public:
                                   int8_t changeFrameRateStrategy);
     virtual status_t setFrameTimelineInfo(uint64_t frameNumber, const FrameTimelineInfo& info);
 
+    // Provides the frame timelines that frame pacing targets. The Surface keeps the timelines it
+    // gets, and only asks for new ones once the frame is too late for all of them.
+    class VsyncSource : public virtual RefBase {
+    public:
+        virtual status_t getLatestVsyncEventData(gui::VsyncEventData* outVsyncEventData) = 0;
+    };
+
+    /* Enables or disables frame pacing. It is disabled by default.
+     *
+     * When enabled, dequeueBuffer holds the producer back until the latest time at which it can
+     * start rendering and still make the deadline of the next frame timeline, going by how long
+     * the previous frames took from dequeueBuffer to queueBuffer. queueBuffer then sets the
+     * desired present time of the frame to the expected presentation time of that timeline,
+     * unless the producer set a timestamp itself. This keeps a producer that renders faster than
+     * the display from rendering frames that are dropped or wait in the queue.
+     *
+     * Frame pacing expects one buffer to be dequeued at a time, and does not apply to the batched
+     * dequeueBuffers and queueBuffers. The frame timelines come from vsyncSource, or from a
+     * DisplayEventReceiver if it is null.
+     */
+    status_t setFramePacingEnabled(bool enabled, const sp<VsyncSource>& vsyncSource = nullptr);
+
 protected:
     virtual ~Surface();
 
@@ -222,6 +245,8 @@ protected:
     virtual sp<ISurfaceComposer> composerService() const;
     virtual sp<gui::ISurfaceComposer> composerServiceAIDL() const;
     virtual nsecs_t now() const;
+    // Blocks until now() reaches time.
+    virtual void waitUntil(nsecs_t time);
 
 private:
     // can't be copied
@@ -378,6 +403,8 @@ public:
 
     // Batch version of dequeueBuffer, cancelBuffer and queueBuffer
     // Note that these batched operations are not supported when shared buffer mode is being used.
+    // They are not paced either: the batch is dequeued at once, and each buffer is queued with
+    // its own timestamp.
     struct BatchBuffer {
         ANativeWindowBuffer* buffer = nullptr;
         int fenceFd = -1;
@@ -608,6 +635,31 @@ protected:
 
     Condition mQueueBufferCondition;
 
+    // Waits until the producer should start rendering the next frame when frame pacing is
+    // enabled, and picks the frame timeline that the frame targets. Called without mMutex held.
+    void waitForPacedFrameStart();
+    // Returns the timeline of vsyncEventData that a frame started at startTime targets, or null
+    // if it is too late for all of them.
+    static const gui::VsyncEventData::FrameTimeline* findPacedFrameTimeline(
+            const gui::VsyncEventData& vsyncEventData, nsecs_t lastPresentTime,
+            nsecs_t renderDuration, nsecs_t startTime);
+    // Updates the render duration estimate with the frame being queued, and returns the
+    // timestamp to queue it with.
+    nsecs_t onPacedFrameQueuedLocked();
+
+    bool mFramePacingEnabled = false;
+    sp<VsyncSource> mVsyncSource;
+    // The frame timelines last provided by mVsyncSource.
+    gui::VsyncEventData mPacingVsyncEventData{};
+    // Expected presentation time of the frame timeline that the dequeued frame targets, or 0.
+    nsecs_t mPacedPresentTime = 0;
+    // Expected presentation time targeted by the last queued paced frame.
+    nsecs_t mLastPacedPresentTime = 0;
+    nsecs_t mPacedFrameStartTime = 0;
+    // How long a frame takes from dequeueBuffer to queueBuffer. Follows longer frames at once,
+    // and shorter ones gradually.
+    nsecs_t mRenderDurationEstimate = 0;
+
     uint64_t mNextFrameNumber = 1;
     uint64_t mLastFrameNumber = 0;
 
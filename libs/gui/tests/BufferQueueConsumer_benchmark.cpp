@@ -0,0 +1,134 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <ui/GraphicBuffer.h>
+
+#include <system/window.h>
+
+#include <vector>
+
+#include "MockConsumer.h"
+
+namespace android {
+namespace {
+
+enum Mode {
+    kSingle,
+    kBatched,
+};
+
+// Queues count buffers, allocating them the first time around.
+bool queueBuffers(const sp<IGraphicBufferProducer>& producer, int count) {
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false, HAL_DATASPACE_UNKNOWN,
+                                                     Rect(0, 0, 1, 1),
+                                                     NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                     Fence::NO_FENCE);
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    for (int i = 0; i < count; i++) {
+        int slot;
+        sp<Fence> fence;
+        status_t status = producer->dequeueBuffer(&slot, &fence, 1, 1, HAL_PIXEL_FORMAT_RGBA_8888,
+                                                  GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr);
+        if (status < OK) {
+            return false;
+        }
+        if (status & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            producer->requestBuffer(slot, &buffer);
+        }
+        if (producer->queueBuffer(slot, qbInput, &qbOutput) != OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Drains range(1) queued buffers from the consumer side of a BufferQueue and releases them, one
+// call per buffer or one call for all of them depending on range(0), as a consumer ingesting
+// several streams at once would.
+void BM_acquireAndRelease(benchmark::State& state) {
+    const int mode = state.range(0);
+    const int count = state.range(1);
+
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    if (consumer->consumerConnect(sp<MockConsumer>::make(), false) != OK ||
+        consumer->setMaxAcquiredBufferCount(count) != OK ||
+        producer->connect(sp<StubProducerListener>::make(), NATIVE_WINDOW_API_CPU, false,
+                          &qbOutput) != OK ||
+        producer->setMaxDequeuedBufferCount(count) != OK) {
+        state.SkipWithError("Could not set up the BufferQueue");
+        return;
+    }
+
+    std::vector<BufferItem> items;
+    std::vector<IGraphicBufferConsumer::ReleaseBufferInput> releaseInputs;
+    std::vector<status_t> releaseResults;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (!queueBuffers(producer, count)) {
+            state.SkipWithError("Could not queue buffers");
+            break;
+        }
+        state.ResumeTiming();
+
+        if (mode == kBatched) {
+            consumer->acquireBuffers(count, 0, &items);
+        } else {
+            items.resize(count);
+            for (BufferItem& item : items) {
+                consumer->acquireBuffer(&item, 0);
+            }
+        }
+        if (static_cast<int>(items.size()) != count) {
+            state.SkipWithError("Could not acquire the queued buffers");
+            break;
+        }
+
+        if (mode == kBatched) {
+            releaseInputs.resize(count);
+            for (int i = 0; i < count; i++) {
+                releaseInputs[i].slot = items[i].mSlot;
+                releaseInputs[i].frameNumber = items[i].mFrameNumber;
+                releaseInputs[i].fence = Fence::NO_FENCE;
+            }
+            consumer->releaseBuffers(releaseInputs, &releaseResults);
+        } else {
+            for (const BufferItem& item : items) {
+                consumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY,
+                                        EGL_NO_SYNC_KHR, Fence::NO_FENCE);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+    consumer->consumerDisconnect();
+}
+
+BENCHMARK(BM_acquireAndRelease)
+        ->ArgNames({"batched", "buffers"})
+        ->ArgsProduct({{kSingle, kBatched}, {1, 4, 8, 16}});
+
+} // namespace
+} // namespace android
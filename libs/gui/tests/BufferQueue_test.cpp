@@ -23,6 +23,7 @@
 #include <gui/BufferItem.h>
 #include <gui/BufferItemConsumer.h>
 #include <gui/BufferQueue.h>
+#include <gui/BufferQueueStats.h>
 #include <gui/IProducerListener.h>
 #include <gui/Surface.h>
 
@@ -43,6 +44,10 @@
 #include <future>
 #include <thread>
 
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include <com_android_graphics_libgui_flags.h>
 
 using namespace std::chrono_literals;
@@ -163,6 +168,94 @@ TEST_F(BufferQueueTest, DISABLED_BufferQueueInAnotherProcess) {
     ASSERT_EQ(OK, item.mGraphicBuffer->unlock());
 }
 
+// Runs the batched calls through Binder, so that their marshalling is exercised.
+TEST_F(BufferQueueTest, BatchedCallsOnBufferQueueInAnotherProcess) {
+    const String16 PRODUCER_NAME = String16("BQTestBatchProducer");
+    const String16 CONSUMER_NAME = String16("BQTestBatchConsumer");
+
+    pid_t forkPid = fork();
+    ASSERT_NE(forkPid, -1);
+
+    if (forkPid == 0) {
+        // Child process
+        sp<IGraphicBufferProducer> producer;
+        sp<IGraphicBufferConsumer> consumer;
+        BufferQueue::createBufferQueue(&producer, &consumer);
+        sp<IServiceManager> serviceManager = defaultServiceManager();
+        serviceManager->addService(PRODUCER_NAME, IInterface::asBinder(producer));
+        serviceManager->addService(CONSUMER_NAME, IInterface::asBinder(consumer));
+        ProcessState::self()->startThreadPool();
+        IPCThreadState::self()->joinThreadPool();
+        LOG_ALWAYS_FATAL("Shouldn't be here");
+    }
+
+    sp<IServiceManager> serviceManager = defaultServiceManager();
+    mProducer = interface_cast<IGraphicBufferProducer>(serviceManager->getService(PRODUCER_NAME));
+    ASSERT_TRUE(mProducer != nullptr);
+    mConsumer = interface_cast<IGraphicBufferConsumer>(serviceManager->getService(CONSUMER_NAME));
+    ASSERT_TRUE(mConsumer != nullptr);
+    ASSERT_TRUE(IInterface::asBinder(mConsumer)->remoteBinder() != nullptr);
+
+    sp<MockConsumer> mc(new MockConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, false));
+    ASSERT_EQ(OK, mConsumer->setMaxAcquiredBufferCount(2));
+    IGraphicBufferProducer::QueueBufferOutput qbo;
+    ASSERT_EQ(OK, mProducer->connect(nullptr, NATIVE_WINDOW_API_CPU, false, &qbo));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(3));
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buf;
+    IGraphicBufferProducer::QueueBufferInput qbi(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+                  mProducer->dequeueBuffer(&slot, &fence, 1, 1, 0, GRALLOC_USAGE_SW_READ_OFTEN,
+                                           nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buf));
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, qbi, &qbo));
+    }
+
+    std::vector<BufferItem> items;
+    ASSERT_EQ(OK, mConsumer->acquireBuffers(10, 0, &items));
+    ASSERT_EQ(3u, items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        EXPECT_EQ(i + 1, items[i].mFrameNumber);
+        // First acquisition of each slot, so the buffer comes along.
+        EXPECT_TRUE(items[i].mGraphicBuffer != nullptr);
+    }
+
+    std::vector<IGraphicBufferConsumer::ReleaseBufferInput> inputs(4);
+    inputs[0].slot = items[0].mSlot;
+    inputs[0].frameNumber = items[0].mFrameNumber;
+    // A null fence is failed by the proxy, without being sent.
+    inputs[1].slot = items[1].mSlot;
+    inputs[1].frameNumber = items[1].mFrameNumber;
+    inputs[1].fence = nullptr;
+    inputs[2].slot = items[2].mSlot;
+    inputs[2].frameNumber = items[2].mFrameNumber;
+    // Left at its defaults, which is an invalid slot.
+    std::vector<status_t> results;
+    ASSERT_EQ(OK, mConsumer->releaseBuffers(inputs, &results));
+    EXPECT_EQ(std::vector<status_t>({OK, BAD_VALUE, OK, BAD_VALUE}), results);
+
+    // The buffer with the null fence is still acquired.
+    inputs = {inputs[1]};
+    inputs[0].fence = Fence::NO_FENCE;
+    ASSERT_EQ(OK, mConsumer->releaseBuffers(inputs, &results));
+    EXPECT_EQ(std::vector<status_t>({OK}), results);
+
+    ASSERT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+              mConsumer->acquireBuffers(10, 0, &items));
+    EXPECT_TRUE(items.empty());
+
+    mProducer.clear();
+    mConsumer.clear();
+    kill(forkPid, SIGKILL);
+    waitpid(forkPid, nullptr, 0);
+}
+
 TEST_F(BufferQueueTest, GetMaxBufferCountInQueueBufferOutput_Succeeds) {
     createBufferQueue();
     sp<MockConsumer> mc(new MockConsumer);
@@ -210,6 +303,202 @@ TEST_F(BufferQueueTest, AcquireBuffer_ExceedsMaxAcquireCount_Fails) {
     ASSERT_EQ(INVALID_OPERATION, mConsumer->acquireBuffer(&item, 0));
 }
 
+TEST_F(BufferQueueTest, AcquireBuffers_DrainsQueueUpToMaxAcquireCount) {
+    createBufferQueue();
+    sp<MockConsumer> mc(new MockConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, false));
+    ASSERT_EQ(OK, mConsumer->setMaxAcquiredBufferCount(2));
+    IGraphicBufferProducer::QueueBufferOutput qbo;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &qbo));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(4));
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buf;
+    IGraphicBufferProducer::QueueBufferInput qbi(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+                  mProducer->dequeueBuffer(&slot, &fence, 1, 1, 0, GRALLOC_USAGE_SW_READ_OFTEN,
+                                           nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buf));
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, qbi, &qbo));
+    }
+
+    // The consumer may hold one buffer more than the max acquired count, so
+    // the batch stops after the third buffer without failing.
+    std::vector<BufferItem> items;
+    ASSERT_EQ(OK, mConsumer->acquireBuffers(10, 0, &items));
+    ASSERT_EQ(3u, items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        EXPECT_EQ(i + 1, items[i].mFrameNumber);
+    }
+
+    std::vector<BufferItem> moreItems;
+    ASSERT_EQ(INVALID_OPERATION, mConsumer->acquireBuffers(10, 0, &moreItems));
+    ASSERT_TRUE(moreItems.empty());
+
+    std::vector<IGraphicBufferConsumer::ReleaseBufferInput> inputs;
+    for (const BufferItem& item : items) {
+        IGraphicBufferConsumer::ReleaseBufferInput& input = inputs.emplace_back();
+        input.slot = item.mSlot;
+        input.frameNumber = item.mFrameNumber;
+        input.fence = Fence::NO_FENCE;
+    }
+    std::vector<status_t> results;
+    ASSERT_EQ(OK, mConsumer->releaseBuffers(inputs, &results));
+    ASSERT_EQ(std::vector<status_t>(3, OK), results);
+
+    ASSERT_EQ(OK, mConsumer->acquireBuffers(10, 0, &moreItems));
+    ASSERT_EQ(1u, moreItems.size());
+    EXPECT_EQ(4u, moreItems[0].mFrameNumber);
+
+    ASSERT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+              mConsumer->acquireBuffers(10, 0, &moreItems));
+    ASSERT_TRUE(moreItems.empty());
+}
+
+TEST_F(BufferQueueTest, AcquireBuffers_StopsAtMaxBuffers) {
+    createBufferQueue();
+    sp<MockConsumer> mc(new MockConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, false));
+    ASSERT_EQ(OK, mConsumer->setMaxAcquiredBufferCount(3));
+    IGraphicBufferProducer::QueueBufferOutput qbo;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &qbo));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(3));
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buf;
+    IGraphicBufferProducer::QueueBufferInput qbi(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+                  mProducer->dequeueBuffer(&slot, &fence, 1, 1, 0, GRALLOC_USAGE_SW_READ_OFTEN,
+                                           nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buf));
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, qbi, &qbo));
+    }
+
+    std::vector<BufferItem> items;
+    ASSERT_EQ(BAD_VALUE, mConsumer->acquireBuffers(0, 0, &items));
+    ASSERT_TRUE(items.empty());
+
+    ASSERT_EQ(OK, mConsumer->acquireBuffers(2, 0, &items));
+    ASSERT_EQ(2u, items.size());
+    EXPECT_EQ(1u, items[0].mFrameNumber);
+    EXPECT_EQ(2u, items[1].mFrameNumber);
+
+    ASSERT_EQ(OK, mConsumer->acquireBuffers(2, 0, &items));
+    ASSERT_EQ(1u, items.size());
+    EXPECT_EQ(3u, items[0].mFrameNumber);
+}
+
+TEST_F(BufferQueueTest, ReleaseBuffers_ReturnsResultOfEachBuffer) {
+    createBufferQueue();
+    sp<MockConsumer> mc(new MockConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, false));
+    IGraphicBufferProducer::QueueBufferOutput qbo;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &qbo));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buf;
+    IGraphicBufferProducer::QueueBufferInput qbi(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+                  mProducer->dequeueBuffer(&slot, &fence, 1, 1, 0, GRALLOC_USAGE_SW_READ_OFTEN,
+                                           nullptr, nullptr));
+        ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buf));
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, qbi, &qbo));
+    }
+
+    std::vector<BufferItem> items;
+    ASSERT_EQ(OK, mConsumer->acquireBuffers(2, 0, &items));
+    ASSERT_EQ(2u, items.size());
+
+    std::vector<IGraphicBufferConsumer::ReleaseBufferInput> inputs(4);
+    inputs[0].slot = items[0].mSlot;
+    inputs[0].frameNumber = items[0].mFrameNumber;
+    inputs[0].fence = Fence::NO_FENCE;
+    // Wrong frame number
+    inputs[1].slot = items[1].mSlot;
+    inputs[1].frameNumber = items[1].mFrameNumber + 1;
+    inputs[1].fence = Fence::NO_FENCE;
+    // Invalid slot
+    inputs[2].slot = -1;
+    inputs[2].frameNumber = items[1].mFrameNumber;
+    inputs[2].fence = Fence::NO_FENCE;
+    // Already released by the first input
+    inputs[3] = inputs[0];
+
+    std::vector<status_t> results;
+    ASSERT_EQ(OK, mConsumer->releaseBuffers(inputs, &results));
+    ASSERT_EQ(4u, results.size());
+    EXPECT_EQ(OK, results[0]);
+    EXPECT_EQ(IGraphicBufferConsumer::STALE_BUFFER_SLOT, results[1]);
+    EXPECT_EQ(BAD_VALUE, results[2]);
+    EXPECT_EQ(BAD_VALUE, results[3]);
+
+    // The buffer with the wrong frame number is still acquired.
+    inputs.resize(1);
+    inputs[0].slot = items[1].mSlot;
+    inputs[0].frameNumber = items[1].mFrameNumber;
+    ASSERT_EQ(OK, mConsumer->releaseBuffers(inputs, &results));
+    ASSERT_EQ(std::vector<status_t>{OK}, results);
+}
+
+TEST_F(BufferQueueTest, BufferItemConsumerAcquireAndReleaseBuffers) {
+    createBufferQueue();
+    sp<BufferItemConsumer> bufferConsumer =
+            sp<BufferItemConsumer>::make(mConsumer, GRALLOC_USAGE_SW_READ_OFTEN, 3);
+    IGraphicBufferProducer::QueueBufferOutput qbo;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &qbo));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(3));
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffers[BufferQueueDefs::NUM_BUFFER_SLOTS];
+    IGraphicBufferProducer::QueueBufferInput qbi(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 3; i++) {
+            status_t result = mProducer->dequeueBuffer(&slot, &fence, 1, 1, 0,
+                                                       GRALLOC_USAGE_SW_READ_OFTEN, nullptr,
+                                                       nullptr);
+            ASSERT_GE(result, OK);
+            if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+                ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffers[slot]));
+            }
+            ASSERT_EQ(OK, mProducer->queueBuffer(slot, qbi, &qbo));
+        }
+
+        // Buffers acquired again come back with their GraphicBuffer too.
+        std::vector<BufferItem> items;
+        ASSERT_EQ(OK, bufferConsumer->acquireBuffers(&items, 0, 3));
+        ASSERT_EQ(3u, items.size());
+        for (const BufferItem& item : items) {
+            ASSERT_NE(nullptr, item.mGraphicBuffer);
+            EXPECT_EQ(buffers[item.mSlot]->getId(), item.mGraphicBuffer->getId());
+        }
+        ASSERT_EQ(OK, bufferConsumer->releaseBuffers(items));
+    }
+
+    std::vector<BufferItem> items;
+    ASSERT_EQ(BufferItemConsumer::NO_BUFFER_AVAILABLE,
+              bufferConsumer->acquireBuffers(&items, 0, 3));
+}
+
 TEST_F(BufferQueueTest, SetMaxAcquiredBufferCountWithIllegalValues_ReturnsError) {
     createBufferQueue();
     sp<MockConsumer> mc(new MockConsumer);
@@ -1049,6 +1338,74 @@ private:
     std::vector<int32_t> mDiscardedSlots;
 };
 
+TEST_F(BufferQueueTest, TestBufferStats) {
+    createBufferQueue();
+    sp<MockConsumer> mc(new MockConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, false));
+    const std::string consumerName = "BufferQueueTest-TestBufferStats";
+    ASSERT_EQ(OK, mConsumer->setConsumerName(String8(consumerName.c_str())));
+
+    // The aggregate may already hold the stats of an earlier run in this process.
+    auto getAggregate = [&consumerName]() {
+        for (const BufferQueueStats::Aggregate& aggregate : BufferQueueStats::collect()) {
+            if (aggregate.consumerName == consumerName) {
+                return aggregate;
+            }
+        }
+        return BufferQueueStats::Aggregate();
+    };
+    const BufferQueueStats::Snapshot before = getAggregate().stats;
+
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &output));
+
+    int slot = BufferQueue::INVALID_BUFFER_SLOT;
+    sp<Fence> fence = Fence::NO_FENCE;
+    sp<GraphicBuffer> buffer = nullptr;
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true,
+        HAL_DATASPACE_UNKNOWN, Rect::INVALID_RECT,
+        NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    BufferItem item{};
+    for (size_t i = 0; i < 3; ++i) {
+        status_t result = mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                                                   TEST_PRODUCER_USAGE_BITS, nullptr, nullptr);
+        ASSERT_GE(result, OK);
+        if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+        }
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+
+    BufferQueueStats::Aggregate aggregate = getAggregate();
+    EXPECT_EQ(1u, aggregate.liveQueueCount);
+    // The producer is named after the process it connected from.
+    const std::string producerName = aggregate.producerName;
+    EXPECT_EQ(0u, producerName.find(std::to_string(getpid()) + ":")) << producerName;
+    EXPECT_EQ(before.dequeueCount + 3, aggregate.stats.dequeueCount);
+    EXPECT_EQ(before.queueToAcquireTime.count + 3, aggregate.stats.queueToAcquireTime.count);
+    EXPECT_EQ(before.holdTime.count + 3, aggregate.stats.holdTime.count);
+    // Every buffer was acquired before the next one was queued.
+    EXPECT_EQ(before.occupancy[1] + 3, aggregate.stats.occupancy[1]);
+
+    std::string dump;
+    BufferQueueStats::dump(dump);
+    EXPECT_NE(std::string::npos, dump.find(consumerName));
+
+    // The stats outlive the BufferQueue.
+    ASSERT_EQ(OK, mProducer->disconnect(NATIVE_WINDOW_API_CPU));
+    mProducer.clear();
+    mConsumer.clear();
+    aggregate = getAggregate();
+    EXPECT_EQ(0u, aggregate.liveQueueCount);
+    EXPECT_EQ(producerName, aggregate.producerName);
+    EXPECT_EQ(before.dequeueCount + 3, aggregate.stats.dequeueCount);
+    EXPECT_EQ(before.holdTime.count + 3, aggregate.stats.holdTime.count);
+}
+
 TEST_F(BufferQueueTest, TestDiscardFreeBuffers) {
     createBufferQueue();
     sp<MockConsumer> mc(new MockConsumer);
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/BufferQueue.h>
+#include <gui/CpuConsumer.h>
+#include <gui/IProducerListener.h>
+#include <ui/GraphicBuffer.h>
+
+#include <system/window.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace android {
+namespace {
+
+// Enough for the producer to dequeue a buffer while the consumer holds a locked and a prefetched
+// one, and few enough for every buffer to be recycled many times.
+constexpr int kBufferCount = 4;
+
+enum Mode {
+    kPersistentMapping = 1 << 0,
+    kPrefetch = 1 << 1,
+};
+
+class FrameCounter : public CpuConsumer::FrameAvailableListener {
+public:
+    void onFrameAvailable(const BufferItem&) override {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mFrames++;
+        }
+        mCondition.notify_one();
+    }
+
+    uint64_t frames() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mFrames;
+    }
+
+    void waitForFramesAfter(uint64_t frames) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [&] { return mFrames != frames; });
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    uint64_t mFrames = 0;
+};
+
+// Queues buffers as fast as the consumer releases them, until the consumer is abandoned.
+void produceFrames(const sp<IGraphicBufferProducer>& producer, uint32_t width, uint32_t height) {
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false, HAL_DATASPACE_UNKNOWN,
+                                                     Rect(0, 0, width, height),
+                                                     NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                     Fence::NO_FENCE);
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    while (true) {
+        int slot;
+        sp<Fence> fence;
+        status_t status = producer->dequeueBuffer(&slot, &fence, width, height,
+                                                  HAL_PIXEL_FORMAT_RGBA_8888,
+                                                  GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr);
+        if (status < OK) {
+            return;
+        }
+        if (status & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            producer->requestBuffer(slot, &buffer);
+        }
+        if (producer->queueBuffer(slot, qbInput, &qbOutput) != OK) {
+            return;
+        }
+    }
+}
+
+// Locks, reads and unlocks the frames of a producer thread, with the CpuConsumer options of
+// range(0), for 16:9 RGBA buffers range(1) pixels wide.
+void BM_lockNextBuffer(benchmark::State& state) {
+    const int mode = state.range(0);
+    const uint32_t width = state.range(1);
+    const uint32_t height = width * 9 / 16;
+
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    if (consumer->setMaxBufferCount(kBufferCount) != OK) {
+        state.SkipWithError("Could not set the buffer count");
+        return;
+    }
+    sp<CpuConsumer> cpuConsumer =
+            new CpuConsumer(consumer, 1, /*controlledByApp*/ false,
+                            CpuConsumer::Options{(mode & kPersistentMapping) != 0,
+                                                 (mode & kPrefetch) != 0});
+    sp<FrameCounter> frameCounter = sp<FrameCounter>::make();
+    cpuConsumer->setFrameAvailableListener(frameCounter);
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    if (producer->connect(sp<StubProducerListener>::make(), NATIVE_WINDOW_API_CPU, false,
+                          &qbOutput) != OK) {
+        state.SkipWithError("Could not connect the producer");
+        cpuConsumer->abandon();
+        return;
+    }
+    std::thread producerThread(produceFrames, producer, width, height);
+
+    uint64_t checksum = 0;
+    for (auto _ : state) {
+        CpuConsumer::LockedBuffer buffer;
+        status_t status;
+        while (true) {
+            const uint64_t frames = frameCounter->frames();
+            status = cpuConsumer->lockNextBuffer(&buffer);
+            if (status != BAD_VALUE) {
+                break;
+            }
+            frameCounter->waitForFramesAfter(frames);
+        }
+        if (status != OK) {
+            state.SkipWithError("Could not lock a buffer");
+            break;
+        }
+        // Read one pixel per row, as a consumer scanning the image would touch every row
+        for (uint32_t y = 0; y < buffer.height; y++) {
+            checksum += buffer.data[y * buffer.stride * 4];
+        }
+        cpuConsumer->unlockBuffer(buffer);
+    }
+    benchmark::DoNotOptimize(checksum);
+    state.SetItemsProcessed(state.iterations());
+
+    // Makes the blocked dequeueBuffer fail
+    cpuConsumer->abandon();
+    producerThread.join();
+}
+
+BENCHMARK(BM_lockNextBuffer)
+        ->ArgNames({"mode", "width"})
+        ->ArgsProduct({{0, kPersistentMapping, kPrefetch, kPersistentMapping | kPrefetch},
+                       {640, 1920, 3840}})
+        ->UseRealTime();
+
+} // namespace
+} // namespace android
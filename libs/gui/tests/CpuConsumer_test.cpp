@@ -608,6 +608,69 @@ TEST_P(CpuConsumerTest, FromCpuManyInQueue) {
     }
 }
 
+TEST_P(CpuConsumerTest, FromCpuPersistentMappingAndPrefetch) {
+    status_t err;
+    CpuConsumerTestParams params = GetParam();
+
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<CpuConsumer> cc = new CpuConsumer(consumer, params.maxLockedBuffers,
+            /*controlledByApp*/ false,
+            CpuConsumer::Options{/*persistentMapping*/ true, /*prefetch*/ true});
+    sp<ANativeWindow> anw = new Surface(producer);
+
+    // Cycle through the buffers several times, so that the mappings are
+    // reused. The prefetched buffer is acquired on top of the locked ones.
+    const int numInQueue = 2;
+    const int numFrames = 10;
+    ASSERT_NO_FATAL_FAILURE(configureANW(anw, params, numInQueue + 1));
+
+    for (int i = 0; i < numFrames; i += numInQueue) {
+        uint32_t stride[numInQueue];
+        for (int j = 0; j < numInQueue; j++) {
+            ASSERT_NO_FATAL_FAILURE(produceOneFrame(anw, params, i + j + 1,
+                            &stride[j]));
+        }
+
+        for (int j = 0; j < numInQueue; j++) {
+            // Give the prefetch thread time to map the next buffer, which
+            // lockNextBuffer would otherwise map itself.
+            const size_t prefetchedBuffers = cc->getStats().prefetchedBuffers;
+            for (int k = 0; k < 100 && cc->getStats().prefetchedBuffers == prefetchedBuffers;
+                    k++) {
+                usleep(10 * 1000);
+            }
+            EXPECT_EQ(prefetchedBuffers + 1, cc->getStats().prefetchedBuffers);
+
+            CpuConsumer::LockedBuffer b;
+            err = cc->lockNextBuffer(&b);
+            ASSERT_NO_ERROR(err, "getNextBuffer error: ");
+
+            ASSERT_TRUE(b.data != nullptr);
+            EXPECT_EQ(params.width,  b.width);
+            EXPECT_EQ(params.height, b.height);
+            EXPECT_EQ(params.format, b.format);
+            EXPECT_EQ(stride[j], b.stride);
+            EXPECT_EQ(i + j + 1, b.timestamp);
+
+            checkAnyBuffer(b, GetParam().format);
+
+            err = cc->unlockBuffer(b);
+            ASSERT_NO_ERROR(err, "unlockBuffer error: ");
+        }
+    }
+
+    CpuConsumer::LockedBuffer b;
+    err = cc->lockNextBuffer(&b);
+    ASSERT_EQ(BAD_VALUE, err) << "Expected no more buffers";
+
+    // Only the first frame in each slot was mapped without a cached mapping.
+    const CpuConsumer::Stats stats = cc->getStats();
+    EXPECT_EQ(static_cast<size_t>(numFrames), stats.prefetchedBuffers);
+    EXPECT_GE(stats.reusedMappings, static_cast<size_t>(numFrames - (numInQueue + 1)));
+}
+
 // This test is disabled because the HAL_PIXEL_FORMAT_RAW16 format is not
 // supported on all devices.
 TEST_P(CpuConsumerTest, FromCpuLockMax) {
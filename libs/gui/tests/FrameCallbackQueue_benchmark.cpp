@@ -0,0 +1,145 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/FrameCallbackQueue.h>
+
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+namespace android {
+namespace {
+
+constexpr nsecs_t kFrameInterval = FrameCallbackSchedule::kDefaultBucketWidth;
+// How many posts the dispatching thread makes between two vsyncs.
+constexpr int kPostsPerFrame = 16;
+// Callbacks are due between now and this many frames ahead.
+constexpr int kMaxDelayFrames = 4;
+
+// How Choreographer queued callbacks before: every post and every dispatch takes the lock.
+class LockedQueue {
+public:
+    void post(const FrameCallback& callback) {
+        std::lock_guard<std::mutex> _l{mLock};
+        mCallbacks.push(callback);
+    }
+
+    void dispatch(nsecs_t now, std::vector<FrameCallback>* outCallbacks) {
+        std::lock_guard<std::mutex> _l{mLock};
+        while (!mCallbacks.empty() && mCallbacks.top().dueTime < now) {
+            outCallbacks->push_back(mCallbacks.top());
+            mCallbacks.pop();
+        }
+    }
+
+private:
+    std::mutex mLock;
+    std::priority_queue<FrameCallback> mCallbacks;
+};
+
+// How Choreographer queues callbacks now: posts are lock-free, and the dispatching thread moves
+// them to the schedule.
+class InboxQueue {
+public:
+    void post(const FrameCallback& callback) { mInbox.post(callback); }
+
+    void dispatch(nsecs_t now, std::vector<FrameCallback>* outCallbacks) {
+        std::lock_guard<std::mutex> _l{mLock};
+        mInbox.drain([this](const FrameCallback& callback) { mSchedule.add(callback); });
+        mSchedule.takeDue(now, outCallbacks);
+    }
+
+private:
+    FrameCallbackInbox mInbox;
+    std::mutex mLock;
+    FrameCallbackSchedule mSchedule;
+};
+
+FrameCallback makeCallback(nsecs_t dueTime) {
+    return FrameCallback{nullptr, nullptr, nullptr, nullptr, dueTime};
+}
+
+// The fake vsync clock, advanced by the dispatching thread.
+std::atomic<int64_t> gFrame = 0;
+
+nsecs_t frameTime() {
+    return gFrame.load(std::memory_order_relaxed) * kFrameInterval;
+}
+
+// Every thread posts callbacks, as game engine and rendering threads do, while thread 0 also
+// dispatches them once per kPostsPerFrame of its posts, as the looper thread does on vsync.
+template <typename Queue>
+void BM_postAndDispatch(benchmark::State& state) {
+    static Queue queue;
+    std::vector<FrameCallback> callbacks;
+    const bool isDispatcher = state.thread_index() == 0;
+    if (isDispatcher) {
+        // Left over by the previous run.
+        queue.dispatch(std::numeric_limits<nsecs_t>::max(), &callbacks);
+    }
+
+    int64_t posts = 0;
+    int64_t dispatched = 0;
+    for (auto _ : state) {
+        const nsecs_t delay = (posts % (kMaxDelayFrames + 1)) * kFrameInterval;
+        queue.post(makeCallback(frameTime() + delay));
+        if (++posts % kPostsPerFrame == 0 && isDispatcher) {
+            callbacks.clear();
+            const int64_t frame = gFrame.fetch_add(1, std::memory_order_relaxed) + 1;
+            queue.dispatch(frame * kFrameInterval, &callbacks);
+            dispatched += callbacks.size();
+        }
+    }
+    state.SetItemsProcessed(posts);
+    if (isDispatcher) {
+        state.counters["dispatched"] =
+                benchmark::Counter(dispatched, benchmark::Counter::kAvgIterations);
+    }
+}
+
+// A single thread posting range(0) callbacks per frame and dispatching them, to compare the cost
+// of the priority queue and of the bucketed schedule as the number of pending callbacks grows.
+template <typename Queue>
+void BM_dispatchFrames(benchmark::State& state) {
+    const int callbacksPerFrame = state.range(0);
+    Queue queue;
+    std::vector<FrameCallback> callbacks;
+    callbacks.reserve(callbacksPerFrame * (kMaxDelayFrames + 1));
+    int64_t frame = 0;
+    for (auto _ : state) {
+        const nsecs_t now = frame * kFrameInterval;
+        for (int i = 0; i < callbacksPerFrame; i++) {
+            queue.post(makeCallback(now + (i % (kMaxDelayFrames + 1)) * kFrameInterval + i));
+        }
+        callbacks.clear();
+        queue.dispatch(now + kFrameInterval, &callbacks);
+        benchmark::DoNotOptimize(callbacks.data());
+        frame++;
+    }
+    state.SetItemsProcessed(state.iterations() * callbacksPerFrame);
+}
+
+BENCHMARK(BM_postAndDispatch<LockedQueue>)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_postAndDispatch<InboxQueue>)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_dispatchFrames<LockedQueue>)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK(BM_dispatchFrames<InboxQueue>)->RangeMultiplier(4)->Range(4, 1024);
+
+} // namespace
+} // namespace android
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <gui/FrameCallbackQueue.h>
+
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace test {
+
+namespace {
+
+constexpr nsecs_t kBucketWidth = 1000;
+
+FrameCallback makeCallback(nsecs_t dueTime, intptr_t id) {
+    return FrameCallback{nullptr, nullptr, nullptr, reinterpret_cast<void*>(id), dueTime};
+}
+
+std::vector<intptr_t> ids(const std::vector<FrameCallback>& callbacks) {
+    std::vector<intptr_t> result;
+    for (const auto& callback : callbacks) {
+        result.push_back(reinterpret_cast<intptr_t>(callback.data));
+    }
+    return result;
+}
+
+FrameCallbackSchedule makeSchedule() {
+    FrameCallbackSchedule schedule;
+    schedule.setBucketWidth(kBucketWidth);
+    return schedule;
+}
+
+} // namespace
+
+TEST(FrameCallbackInboxTest, DrainsInPostOrder) {
+    FrameCallbackInbox inbox;
+    EXPECT_TRUE(inbox.post(makeCallback(0, 1)));
+    EXPECT_FALSE(inbox.post(makeCallback(0, 2)));
+    EXPECT_FALSE(inbox.post(makeCallback(0, 3)));
+
+    std::vector<FrameCallback> drained;
+    inbox.drain([&](const FrameCallback& callback) { drained.push_back(callback); });
+    EXPECT_EQ((std::vector<intptr_t>{1, 2, 3}), ids(drained));
+
+    drained.clear();
+    inbox.drain([&](const FrameCallback& callback) { drained.push_back(callback); });
+    EXPECT_TRUE(drained.empty());
+    EXPECT_TRUE(inbox.post(makeCallback(0, 4)));
+}
+
+TEST(FrameCallbackInboxTest, PostsPastCapacity) {
+    FrameCallbackInbox inbox;
+    constexpr intptr_t kPosts = 3 * FrameCallbackInbox::kCapacity + 1;
+    std::vector<intptr_t> expected;
+    for (intptr_t i = 0; i < kPosts; i++) {
+        EXPECT_EQ(i == 0, inbox.post(makeCallback(0, i)));
+        expected.push_back(i);
+    }
+
+    std::vector<FrameCallback> drained;
+    inbox.drain([&](const FrameCallback& callback) { drained.push_back(callback); });
+    EXPECT_EQ(expected, ids(drained));
+
+    // The pool nodes are reused once drained, and the inbox can overflow again.
+    for (int round = 0; round < 3; round++) {
+        for (intptr_t i = 0; i < kPosts; i++) {
+            inbox.post(makeCallback(0, i));
+        }
+        drained.clear();
+        inbox.drain([&](const FrameCallback& callback) { drained.push_back(callback); });
+        EXPECT_EQ(expected, ids(drained));
+    }
+
+    // Callbacks still posted when the inbox is destroyed, past capacity, are released with it.
+    for (intptr_t i = 0; i < kPosts; i++) {
+        inbox.post(makeCallback(0, i));
+    }
+}
+
+TEST(FrameCallbackInboxTest, ConcurrentPosts) {
+    constexpr int kThreads = 4;
+    constexpr int kPostsPerThread = 10000;
+    FrameCallbackInbox inbox;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&inbox, t] {
+            for (int i = 0; i < kPostsPerThread; i++) {
+                inbox.post(makeCallback(i, t));
+            }
+        });
+    }
+
+    // Drain while posting: every thread's callbacks must come out in order, exactly once.
+    std::vector<nsecs_t> nextDueTime(kThreads, 0);
+    auto check = [&](const FrameCallback& callback) {
+        const intptr_t t = reinterpret_cast<intptr_t>(callback.data);
+        EXPECT_EQ(nextDueTime[t]++, callback.dueTime);
+    };
+    for (int i = 0; i < 100; i++) {
+        inbox.drain(check);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    inbox.drain(check);
+    for (int t = 0; t < kThreads; t++) {
+        EXPECT_EQ(kPostsPerThread, nextDueTime[t]);
+    }
+}
+
+TEST(FrameCallbackScheduleTest, TakesOnlyDueCallbacks) {
+    FrameCallbackSchedule schedule = makeSchedule();
+    schedule.add(makeCallback(10'500, 1));
+    schedule.add(makeCallback(12'000, 2));
+    schedule.add(makeCallback(10'100, 3));
+    EXPECT_EQ(3u, schedule.size());
+    EXPECT_EQ(10'100, schedule.nextDueTime());
+
+    std::vector<FrameCallback> due;
+    schedule.takeDue(10'100, &due);
+    EXPECT_TRUE(due.empty());
+
+    schedule.takeDue(10'600, &due);
+    EXPECT_EQ((std::vector<intptr_t>{1, 3}), ids(due));
+    EXPECT_EQ(12'000, schedule.nextDueTime());
+
+    due.clear();
+    schedule.takeDue(20'000, &due);
+    EXPECT_EQ((std::vector<intptr_t>{2}), ids(due));
+    EXPECT_TRUE(schedule.empty());
+    EXPECT_EQ(FrameCallbackSchedule::kNoDueTime, schedule.nextDueTime());
+}
+
+TEST(FrameCallbackScheduleTest, TakesEarlierBucketsFirst) {
+    FrameCallbackSchedule schedule = makeSchedule();
+    schedule.add(makeCallback(13'000, 1));
+    schedule.add(makeCallback(11'000, 2));
+    schedule.add(makeCallback(12'000, 3));
+
+    std::vector<FrameCallback> due;
+    schedule.takeDue(14'000, &due);
+    EXPECT_EQ((std::vector<intptr_t>{2, 3, 1}), ids(due));
+}
+
+TEST(FrameCallbackScheduleTest, CallbackBeforeFirstBucket) {
+    FrameCallbackSchedule schedule = makeSchedule();
+    schedule.add(makeCallback(50'000, 1));
+    schedule.add(makeCallback(10'000, 2));
+    EXPECT_EQ(10'000, schedule.nextDueTime());
+
+    std::vector<FrameCallback> due;
+    schedule.takeDue(10'001, &due);
+    EXPECT_EQ((std::vector<intptr_t>{2}), ids(due));
+    EXPECT_EQ(1u, schedule.size());
+    EXPECT_EQ(50'000, schedule.nextDueTime());
+}
+
+TEST(FrameCallbackScheduleTest, CallbackBeyondLastBucket) {
+    FrameCallbackSchedule schedule = makeSchedule();
+    const nsecs_t farAway = (FrameCallbackSchedule::kNumBuckets * 3) * kBucketWidth;
+    schedule.add(makeCallback(0, 1));
+    schedule.add(makeCallback(farAway, 2));
+    EXPECT_EQ(0, schedule.nextDueTime());
+
+    std::vector<FrameCallback> due;
+    schedule.takeDue(1, &due);
+    EXPECT_EQ((std::vector<intptr_t>{1}), ids(due));
+    EXPECT_EQ(farAway, schedule.nextDueTime());
+
+    // Step through the vsyncs in between, as dispatch would.
+    due.clear();
+    for (nsecs_t now = 0; now <= farAway; now += kBucketWidth) {
+        schedule.takeDue(now, &due);
+        EXPECT_TRUE(due.empty());
+    }
+    schedule.takeDue(farAway + 1, &due);
+    EXPECT_EQ((std::vector<intptr_t>{2}), ids(due));
+    EXPECT_TRUE(schedule.empty());
+}
+
+TEST(FrameCallbackScheduleTest, SkipsMoreVsyncsThanBuckets) {
+    FrameCallbackSchedule schedule = makeSchedule();
+    for (intptr_t i = 0; i < 200; i++) {
+        schedule.add(makeCallback(i * kBucketWidth, i));
+    }
+
+    std::vector<FrameCallback> due;
+    schedule.takeDue(100 * kBucketWidth, &due);
+    ASSERT_EQ(100u, due.size());
+    for (intptr_t i = 0; i < 100; i++) {
+        EXPECT_EQ(i, reinterpret_cast<intptr_t>(due[i].data));
+    }
+    EXPECT_EQ(100u, schedule.size());
+    EXPECT_EQ(100 * kBucketWidth, schedule.nextDueTime());
+}
+
+TEST(FrameCallbackScheduleTest, SetBucketWidthKeepsCallbacks) {
+    FrameCallbackSchedule schedule = makeSchedule();
+    schedule.add(makeCallback(10'000, 1));
+    schedule.add(makeCallback(90'000, 2));
+    schedule.setBucketWidth(kBucketWidth / 2);
+    EXPECT_EQ(2u, schedule.size());
+    EXPECT_EQ(10'000, schedule.nextDueTime());
+
+    std::vector<FrameCallback> due;
+    schedule.takeDue(100'000, &due);
+    EXPECT_EQ((std::vector<intptr_t>{1, 2}), ids(due));
+}
+
+} // namespace test
+} // namespace android
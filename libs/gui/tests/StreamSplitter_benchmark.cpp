@@ -0,0 +1,185 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IConsumerListener.h>
+#include <gui/IProducerListener.h>
+#include <gui/StreamSplitter.h>
+#include <ui/GraphicBuffer.h>
+
+#include <system/window.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace android {
+namespace {
+
+using BackpressurePolicy = StreamSplitter::BackpressurePolicy;
+
+constexpr uint32_t kWidth = 640;
+constexpr uint32_t kHeight = 480;
+
+// Acquires and releases the buffers of an output on its own thread, spending |delay| on each.
+class OutputConsumer : public BnConsumerListener {
+public:
+    OutputConsumer(const sp<IGraphicBufferConsumer>& consumer, std::chrono::microseconds delay)
+          : mConsumer(consumer), mDelay(delay) {}
+
+    void start() { mThread = std::thread([this] { threadMain(); }); }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopped = true;
+        }
+        mCondition.notify_one();
+        mThread.join();
+    }
+
+    void onFrameAvailable(const BufferItem&) override { notify(); }
+    void onFrameReplaced(const BufferItem&) override { notify(); }
+    void onBuffersReleased() override {}
+    void onSidebandStreamChanged() override {}
+
+private:
+    void notify() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mFrameAvailable = true;
+        }
+        mCondition.notify_one();
+    }
+
+    void threadMain() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCondition.wait(lock, [this] { return mStopped || mFrameAvailable; });
+                if (mStopped) {
+                    return;
+                }
+                mFrameAvailable = false;
+            }
+            BufferItem item;
+            while (mConsumer->acquireBuffer(&item, 0) == OK) {
+                if (mDelay.count() > 0) {
+                    std::this_thread::sleep_for(mDelay);
+                }
+                mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY,
+                                         EGL_NO_SYNC_KHR, Fence::NO_FENCE);
+            }
+        }
+    }
+
+    const sp<IGraphicBufferConsumer> mConsumer;
+    const std::chrono::microseconds mDelay;
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopped = false;
+    bool mFrameAvailable = false;
+};
+
+// Splits the input into a fast output, like an encoder, and a slow one, like an analysis stage
+// taking range(1) microseconds per buffer with the policy range(0), and measures how fast the
+// input producer can queue buffers.
+void BM_splitterInputThroughput(benchmark::State& state) {
+    const auto slowPolicy = static_cast<BackpressurePolicy>(state.range(0));
+    const std::chrono::microseconds slowDelay(state.range(1));
+
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+    inputConsumer->setDefaultBufferSize(kWidth, kHeight);
+
+    sp<StreamSplitter> splitter;
+    if (StreamSplitter::createSplitter(inputConsumer, &splitter) != OK) {
+        state.SkipWithError("Could not create the splitter");
+        return;
+    }
+
+    sp<OutputConsumer> outputs[2];
+    const BackpressurePolicy policies[2] = {BackpressurePolicy::BLOCK, slowPolicy};
+    const std::chrono::microseconds delays[2] = {std::chrono::microseconds(0), slowDelay};
+    for (int i = 0; i < 2; i++) {
+        sp<IGraphicBufferProducer> producer;
+        sp<IGraphicBufferConsumer> consumer;
+        BufferQueue::createBufferQueue(&producer, &consumer);
+        outputs[i] = sp<OutputConsumer>::make(consumer, delays[i]);
+        if (consumer->consumerConnect(outputs[i], false) != OK ||
+            splitter->addOutput(producer, policies[i]) != OK) {
+            state.SkipWithError("Could not add an output");
+            return;
+        }
+    }
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    if (inputProducer->connect(sp<StubProducerListener>::make(), NATIVE_WINDOW_API_CPU, false,
+                               &qbOutput) != OK) {
+        state.SkipWithError("Could not connect to the input");
+        return;
+    }
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false, HAL_DATASPACE_UNKNOWN,
+                                                     Rect(0, 0, kWidth, kHeight),
+                                                     NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                     Fence::NO_FENCE);
+    for (const auto& output : outputs) {
+        output->start();
+    }
+
+    for (auto _ : state) {
+        int slot;
+        sp<Fence> fence;
+        status_t status = inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                                                       GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr,
+                                                       nullptr);
+        if (status < OK) {
+            state.SkipWithError("Could not dequeue from the input");
+            break;
+        }
+        if (status & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            inputProducer->requestBuffer(slot, &buffer);
+        }
+        if (inputProducer->queueBuffer(slot, qbInput, &qbOutput) != OK) {
+            state.SkipWithError("Could not queue to the input");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    inputProducer->disconnect(NATIVE_WINDOW_API_CPU);
+    for (const auto& output : outputs) {
+        output->stop();
+    }
+}
+
+BENCHMARK(BM_splitterInputThroughput)
+        ->ArgNames({"dropOldest", "slowUs"})
+        ->Args({static_cast<int>(BackpressurePolicy::BLOCK), 0})
+        ->Args({static_cast<int>(BackpressurePolicy::BLOCK), 5000})
+        ->Args({static_cast<int>(BackpressurePolicy::DROP_OLDEST), 0})
+        ->Args({static_cast<int>(BackpressurePolicy::DROP_OLDEST), 5000})
+        ->UseRealTime();
+
+} // namespace
+} // namespace android
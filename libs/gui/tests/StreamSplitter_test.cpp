@@ -180,6 +180,86 @@ TEST_F(StreamSplitterTest, OneInputMultipleOutputs) {
                                            nullptr, nullptr));
 }
 
+TEST_F(StreamSplitterTest, DropOldestOutputDoesNotStallInput) {
+    const uint32_t NUM_FRAMES = 5;
+
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    // The first output consumes every buffer, the second one none until the end
+    sp<IGraphicBufferProducer> blockProducer;
+    sp<IGraphicBufferConsumer> blockConsumer;
+    BufferQueue::createBufferQueue(&blockProducer, &blockConsumer);
+    ASSERT_EQ(OK, blockConsumer->consumerConnect(new FakeListener, false));
+
+    sp<IGraphicBufferProducer> dropProducer;
+    sp<IGraphicBufferConsumer> dropConsumer;
+    BufferQueue::createBufferQueue(&dropProducer, &dropConsumer);
+    ASSERT_EQ(OK, dropConsumer->consumerConnect(new FakeListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(blockProducer));
+    ASSERT_EQ(OK, splitter->addOutput(dropProducer,
+            StreamSplitter::BackpressurePolicy::DROP_OLDEST));
+    ASSERT_EQ(OK, blockProducer->allowAllocation(false));
+    ASSERT_EQ(OK, dropProducer->allowAllocation(false));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK,
+              inputProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false,
+                                     &qbOutput));
+
+    for (uint32_t frame = 0; frame < NUM_FRAMES; ++frame) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        status = inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr);
+        ASSERT_GE(status, OK);
+        ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+
+        uint32_t* dataIn;
+        ASSERT_EQ(OK, buffer->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN,
+                reinterpret_cast<void**>(&dataIn)));
+        *dataIn = TEST_DATA + frame;
+        ASSERT_EQ(OK, buffer->unlock());
+
+        // This would block forever if the second output stalled the input
+        IGraphicBufferProducer::QueueBufferInput qbInput(0, false,
+                HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+                NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+        ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+        BufferItem item;
+        ASSERT_EQ(OK, blockConsumer->acquireBuffer(&item, 0));
+        uint32_t* dataOut;
+        ASSERT_EQ(OK, item.mGraphicBuffer->lock(GraphicBuffer::USAGE_SW_READ_OFTEN,
+                reinterpret_cast<void**>(&dataOut)));
+        ASSERT_EQ(*dataOut, TEST_DATA + frame);
+        ASSERT_EQ(OK, item.mGraphicBuffer->unlock());
+        ASSERT_EQ(OK, blockConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+
+    // The second output only has the latest buffer left
+    BufferItem item;
+    ASSERT_EQ(OK, dropConsumer->acquireBuffer(&item, 0));
+    uint32_t* dataOut;
+    ASSERT_EQ(OK, item.mGraphicBuffer->lock(GraphicBuffer::USAGE_SW_READ_OFTEN,
+            reinterpret_cast<void**>(&dataOut)));
+    ASSERT_EQ(*dataOut, TEST_DATA + NUM_FRAMES - 1);
+    ASSERT_EQ(OK, item.mGraphicBuffer->unlock());
+    ASSERT_EQ(OK, dropConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    BufferItem noItem;
+    ASSERT_EQ(IGraphicBufferConsumer::NO_BUFFER_AVAILABLE,
+              dropConsumer->acquireBuffer(&noItem, 0));
+}
+
 TEST_F(StreamSplitterTest, OutputAbandonment) {
     sp<IGraphicBufferProducer> inputProducer;
     sp<IGraphicBufferConsumer> inputConsumer;
@@ -1055,6 +1055,10 @@ public:
         mNow = now;
     }
 
+    void waitUntil(nsecs_t time) override {
+        mNow = std::max(mNow, time);
+    }
+
 public:
     sp<FakeSurfaceComposer> mFakeSurfaceComposer;
     sp<FakeSurfaceComposerAIDL> mFakeSurfaceComposerAIDL;
@@ -2128,6 +2132,163 @@ TEST_F(SurfaceTest, DefaultMaxBufferCountSetAndUpdated) {
     EXPECT_EQ(BufferQueueDefs::NUM_BUFFER_SLOTS, count);
 }
 
+// Frame timelines of a display that refreshes every period from time 0, on the clock of a
+// TestSurface. The deadline of each timeline is one period before its expected presentation
+// time.
+class FakeVsyncSource : public Surface::VsyncSource {
+public:
+    FakeVsyncSource(const TestSurface& clock, nsecs_t period) : mClock(clock), mPeriod(period) {}
+
+    status_t getLatestVsyncEventData(gui::VsyncEventData* outVsyncEventData) override {
+        mCallCount++;
+        if (mError != NO_ERROR) {
+            return mError;
+        }
+        const nsecs_t nextDeadline = (mClock.now() / mPeriod + 1) * mPeriod;
+        outVsyncEventData->frameInterval = mPeriod;
+        outVsyncEventData->preferredFrameTimelineIndex = 0;
+        outVsyncEventData->frameTimelinesLength = gui::VsyncEventData::kFrameTimelinesCapacity;
+        for (size_t i = 0; i < gui::VsyncEventData::kFrameTimelinesCapacity; i++) {
+            auto& timeline = outVsyncEventData->frameTimelines[i];
+            timeline.vsyncId = static_cast<int64_t>(i);
+            timeline.deadlineTimestamp = nextDeadline + static_cast<nsecs_t>(i) * mPeriod;
+            timeline.expectedPresentationTime = timeline.deadlineTimestamp + mPeriod;
+        }
+        return NO_ERROR;
+    }
+
+    void setError(status_t error) { mError = error; }
+    int getCallCount() const { return mCallCount; }
+
+private:
+    const TestSurface& mClock;
+    const nsecs_t mPeriod;
+    status_t mError = NO_ERROR;
+    int mCallCount = 0;
+};
+
+class FramePacingTest : public ::testing::Test {
+protected:
+    static constexpr nsecs_t kPeriod = ms2ns(16);
+
+    struct Frame {
+        // When dequeueBuffer returned, and the frame started rendering.
+        nsecs_t startTime;
+        nsecs_t timestamp;
+        bool isAutoTimestamp;
+    };
+
+    void SetUp() override {
+        BufferQueue::createBufferQueue(&mProducer, &mConsumer);
+        ASSERT_EQ(OK, mConsumer->consumerConnect(sp<MockConsumer>::make(), false));
+        mSurface = sp<TestSurface>::make(mProducer, &mFenceMap);
+        mWindow = mSurface;
+        ASSERT_EQ(OK, mSurface->connect(NATIVE_WINDOW_API_CPU, sp<StubProducerListener>::make()));
+        mVsyncSource = sp<FakeVsyncSource>::make(*mSurface, kPeriod);
+        ASSERT_EQ(OK, mSurface->setFramePacingEnabled(true, mVsyncSource));
+    }
+
+    void TearDown() override { EXPECT_EQ(OK, mSurface->disconnect(NATIVE_WINDOW_API_CPU)); }
+
+    // Renders a frame that takes renderDuration from dequeueBuffer to queueBuffer, and acquires
+    // it as the consumer.
+    Frame renderFrame(nsecs_t renderDuration) {
+        Frame frame{};
+        ANativeWindowBuffer* buffer;
+        int fenceFd;
+        EXPECT_EQ(OK, mWindow->dequeueBuffer(mWindow.get(), &buffer, &fenceFd));
+        frame.startTime = mSurface->now();
+        mSurface->setNow(frame.startTime + renderDuration);
+        EXPECT_EQ(OK, mWindow->queueBuffer(mWindow.get(), buffer, fenceFd));
+
+        BufferItem item;
+        EXPECT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        EXPECT_EQ(OK, mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber, Fence::NO_FENCE));
+        frame.timestamp = item.mTimestamp;
+        frame.isAutoTimestamp = item.mIsAutoTimestamp;
+        return frame;
+    }
+
+    sp<IGraphicBufferProducer> mProducer;
+    sp<IGraphicBufferConsumer> mConsumer;
+    FenceToFenceTimeMap mFenceMap;
+    sp<TestSurface> mSurface;
+    sp<ANativeWindow> mWindow;
+    sp<FakeVsyncSource> mVsyncSource;
+};
+
+TEST_F(FramePacingTest, FramesStartRightBeforeTheirDeadline) {
+    constexpr nsecs_t renderDuration = ms2ns(1);
+    mSurface->setNow(ms2ns(4));
+
+    // Nothing is known of how long frames take yet, so the first one starts at the deadline.
+    const Frame first = renderFrame(renderDuration);
+    EXPECT_EQ(kPeriod, first.startTime);
+    EXPECT_EQ(2 * kPeriod, first.timestamp);
+    EXPECT_FALSE(first.isAutoTimestamp);
+
+    // The next ones start one render duration before the deadline of the following vsync.
+    for (nsecs_t vsync = 2; vsync <= 20; vsync++) {
+        SCOPED_TRACE(testing::Message() << "vsync " << vsync);
+        const Frame frame = renderFrame(renderDuration);
+        EXPECT_EQ(vsync * kPeriod - renderDuration, frame.startTime);
+        EXPECT_EQ((vsync + 1) * kPeriod, frame.timestamp);
+        EXPECT_FALSE(frame.isAutoTimestamp);
+    }
+}
+
+TEST_F(FramePacingTest, FrameTimelinesAreFetchedOnlyOnceAllAreUsed) {
+    mSurface->setNow(ms2ns(4));
+    for (int64_t i = 0; i < gui::VsyncEventData::kFrameTimelinesCapacity; i++) {
+        renderFrame(ms2ns(1));
+    }
+    EXPECT_EQ(1, mVsyncSource->getCallCount());
+
+    renderFrame(ms2ns(1));
+    EXPECT_EQ(2, mVsyncSource->getCallCount());
+
+    // Once the frame is late for all the timelines, new ones are fetched.
+    mSurface->setNow(mSurface->now() + 10 * kPeriod);
+    const Frame frame = renderFrame(ms2ns(1));
+    EXPECT_EQ(3, mVsyncSource->getCallCount());
+    EXPECT_EQ(19 * kPeriod - ms2ns(1), frame.startTime);
+    EXPECT_EQ(20 * kPeriod, frame.timestamp);
+}
+
+TEST_F(FramePacingTest, FramesStartEarlierAfterLongFrames) {
+    mSurface->setNow(ms2ns(4));
+    // Misses its deadline, but keeps the timestamp of its timeline.
+    const Frame longFrame = renderFrame(ms2ns(20));
+    EXPECT_EQ(kPeriod, longFrame.startTime);
+    EXPECT_EQ(2 * kPeriod, longFrame.timestamp);
+
+    // Starts 20ms before the first deadline it can still make.
+    const Frame next = renderFrame(ms2ns(1));
+    EXPECT_EQ(4 * kPeriod - ms2ns(20), next.startTime);
+    EXPECT_EQ(5 * kPeriod, next.timestamp);
+
+    // A shorter frame only brings the estimate down by an eighth of the difference.
+    const Frame after = renderFrame(ms2ns(1));
+    EXPECT_EQ(5 * kPeriod - (ms2ns(20) * 7 + ms2ns(1)) / 8, after.startTime);
+    EXPECT_EQ(6 * kPeriod, after.timestamp);
+}
+
+TEST_F(FramePacingTest, FramesAreNotPacedWithoutFrameTimelines) {
+    mVsyncSource->setError(UNKNOWN_ERROR);
+    mSurface->setNow(ms2ns(4));
+    const Frame frame = renderFrame(ms2ns(1));
+    EXPECT_EQ(ms2ns(4), frame.startTime);
+    EXPECT_TRUE(frame.isAutoTimestamp);
+}
+
+TEST_F(FramePacingTest, ProducerTimestampsAreKept) {
+    mSurface->setNow(ms2ns(4));
+    ASSERT_EQ(NO_ERROR, native_window_set_buffers_timestamp(mWindow.get(), ms2ns(100)));
+    const Frame frame = renderFrame(ms2ns(1));
+    EXPECT_EQ(kPeriod, frame.startTime);
+    EXPECT_EQ(ms2ns(100), frame.timestamp);
+}
+
 TEST_F(SurfaceTest, BatchOperations) {
     const int BUFFER_COUNT = 16;
     const int BATCH_SIZE = 8;
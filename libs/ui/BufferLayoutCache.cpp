@@ -0,0 +1,164 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ui/BufferLayoutCache.h>
+
+#include <gralloctypes/Gralloc4.h>
+
+using aidl::android::hardware::graphics::common::PlaneLayoutComponentType;
+
+namespace android {
+
+BufferLayout BufferLayout::fromPlaneLayouts(const std::vector<ui::PlaneLayout>& planeLayouts) {
+    BufferLayout layout;
+    if (planeLayouts.empty()) {
+        return layout;
+    }
+    layout.hasPlanes = true;
+
+    int32_t bitsPerPixel = planeLayouts.front().sampleIncrementInBits;
+    int32_t bytesPerStride = planeLayouts.front().strideInBytes;
+    for (const auto& planeLayout : planeLayouts) {
+        if (bitsPerPixel != planeLayout.sampleIncrementInBits) {
+            bitsPerPixel = -1;
+        }
+        if (bytesPerStride != planeLayout.strideInBytes) {
+            bytesPerStride = -1;
+        }
+    }
+    if (bitsPerPixel >= 0 && bitsPerPixel % 8 == 0) {
+        layout.bytesPerPixel = bitsPerPixel / 8;
+    }
+    if (bytesPerStride >= 0) {
+        layout.bytesPerStride = bytesPerStride;
+    }
+
+    for (const auto& planeLayout : planeLayouts) {
+        for (const auto& planeLayoutComponent : planeLayout.components) {
+            if (!gralloc4::isStandardPlaneLayoutComponentType(planeLayoutComponent.type)) {
+                continue;
+            }
+
+            // Note that `offsetInBits` may not be a multiple of 8 for packed formats (e.g. P010)
+            // but we still want to point to the start of the first byte.
+            const ssize_t offset =
+                    planeLayout.offsetInBytes + planeLayoutComponent.offsetInBits / 8;
+
+            uint64_t sampleIncrementInBytes;
+
+            auto type = static_cast<PlaneLayoutComponentType>(planeLayoutComponent.type.value);
+            switch (type) {
+                case PlaneLayoutComponentType::Y:
+                    if ((layout.yOffset >= 0) || (planeLayout.sampleIncrementInBits % 8 != 0)) {
+                        layout.ycbcrStatus = BAD_VALUE;
+                        return layout;
+                    }
+                    layout.yOffset = offset;
+                    layout.ystride = planeLayout.strideInBytes;
+                    break;
+
+                case PlaneLayoutComponentType::CB:
+                case PlaneLayoutComponentType::CR:
+                    if (planeLayout.sampleIncrementInBits % 8 != 0) {
+                        layout.ycbcrStatus = BAD_VALUE;
+                        return layout;
+                    }
+
+                    sampleIncrementInBytes = planeLayout.sampleIncrementInBits / 8;
+                    if ((sampleIncrementInBytes != 1) && (sampleIncrementInBytes != 2) &&
+                        (sampleIncrementInBytes != 4)) {
+                        layout.ycbcrStatus = BAD_VALUE;
+                        return layout;
+                    }
+
+                    if (layout.cstride == 0 && layout.chromaStep == 0) {
+                        layout.cstride = planeLayout.strideInBytes;
+                        layout.chromaStep = sampleIncrementInBytes;
+                    } else {
+                        if ((static_cast<int64_t>(layout.cstride) != planeLayout.strideInBytes) ||
+                            (layout.chromaStep != sampleIncrementInBytes)) {
+                            layout.ycbcrStatus = BAD_VALUE;
+                            return layout;
+                        }
+                    }
+
+                    if (type == PlaneLayoutComponentType::CB) {
+                        if (layout.cbOffset >= 0) {
+                            layout.ycbcrStatus = BAD_VALUE;
+                            return layout;
+                        }
+                        layout.cbOffset = offset;
+                    } else {
+                        if (layout.crOffset >= 0) {
+                            layout.ycbcrStatus = BAD_VALUE;
+                            return layout;
+                        }
+                        layout.crOffset = offset;
+                    }
+                    break;
+                default:
+                    break;
+            };
+        }
+    }
+    return layout;
+}
+
+void BufferLayout::toYCbCr(void* data, android_ycbcr* outYcbcr) const {
+    uint8_t* base = static_cast<uint8_t*>(data);
+    outYcbcr->y = yOffset >= 0 ? base + yOffset : nullptr;
+    outYcbcr->cb = cbOffset >= 0 ? base + cbOffset : nullptr;
+    outYcbcr->cr = crOffset >= 0 ? base + crOffset : nullptr;
+    outYcbcr->ystride = ystride;
+    outYcbcr->cstride = cstride;
+    outYcbcr->chroma_step = chromaStep;
+}
+
+status_t BufferLayoutCache::get(buffer_handle_t bufferHandle,
+                                const GetPlaneLayoutsFunction& getPlaneLayouts,
+                                BufferLayout* outLayout) {
+    {
+        std::scoped_lock lock(mLock);
+        auto it = mLayouts.find(bufferHandle);
+        if (it != mLayouts.end()) {
+            *outLayout = it->second;
+            return NO_ERROR;
+        }
+    }
+
+    std::vector<ui::PlaneLayout> planeLayouts;
+    status_t error = getPlaneLayouts(bufferHandle, &planeLayouts);
+    if (error != NO_ERROR) {
+        return error;
+    }
+    *outLayout = BufferLayout::fromPlaneLayouts(planeLayouts);
+
+    std::scoped_lock lock(mLock);
+    mLayouts.emplace(bufferHandle, *outLayout);
+    return NO_ERROR;
+}
+
+void BufferLayoutCache::erase(buffer_handle_t bufferHandle) {
+    std::scoped_lock lock(mLock);
+    mLayouts.erase(bufferHandle);
+}
+
+size_t BufferLayoutCache::size() const {
+    std::scoped_lock lock(mLock);
+    return mLayouts.size();
+}
+
+} // namespace android
@@ -213,6 +213,7 @@ status_t Gralloc4Mapper::importBuffer(const native_handle_t* rawHandle,
 }
 
 void Gralloc4Mapper::freeBuffer(buffer_handle_t bufferHandle) const {
+    mLayoutCache.erase(bufferHandle);
     auto buffer = const_cast<native_handle_t*>(bufferHandle);
     auto ret = mMapper->freeBuffer(buffer);
 
@@ -262,34 +263,15 @@ void Gralloc4Mapper::getTransportSize(buffer_handle_t bufferHandle, uint32_t* ou
 status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, const Rect& bounds,
                               int acquireFence, void** outData, int32_t* outBytesPerPixel,
                               int32_t* outBytesPerStride) const {
-    std::vector<ui::PlaneLayout> planeLayouts;
-    status_t err = getPlaneLayouts(bufferHandle, &planeLayouts);
-
-    if (err == NO_ERROR && !planeLayouts.empty()) {
-        if (outBytesPerPixel) {
-            int32_t bitsPerPixel = planeLayouts.front().sampleIncrementInBits;
-            for (const auto& planeLayout : planeLayouts) {
-                if (bitsPerPixel != planeLayout.sampleIncrementInBits) {
-                    bitsPerPixel = -1;
-                }
-            }
-            if (bitsPerPixel >= 0 && bitsPerPixel % 8 == 0) {
-                *outBytesPerPixel = bitsPerPixel / 8;
-            } else {
-                *outBytesPerPixel = -1;
+    // The plane layouts are only needed for the optional outputs.
+    if (outBytesPerPixel || outBytesPerStride) {
+        BufferLayout layout;
+        if (getBufferLayout(bufferHandle, &layout) == NO_ERROR && layout.hasPlanes) {
+            if (outBytesPerPixel) {
+                *outBytesPerPixel = layout.bytesPerPixel;
             }
-        }
-        if (outBytesPerStride) {
-            int32_t bytesPerStride = planeLayouts.front().strideInBytes;
-            for (const auto& planeLayout : planeLayouts) {
-                if (bytesPerStride != planeLayout.strideInBytes) {
-                    bytesPerStride = -1;
-                }
-            }
-            if (bytesPerStride >= 0) {
-                *outBytesPerStride = bytesPerStride;
-            } else {
-                *outBytesPerStride = -1;
+            if (outBytesPerStride) {
+                *outBytesPerStride = layout.bytesPerStride;
             }
         }
     }
@@ -335,8 +317,8 @@ status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, cons
         return BAD_VALUE;
     }
 
-    std::vector<ui::PlaneLayout> planeLayouts;
-    status_t error = getPlaneLayouts(bufferHandle, &planeLayouts);
+    BufferLayout layout;
+    status_t error = getBufferLayout(bufferHandle, &layout);
     if (error != NO_ERROR) {
         return error;
     }
@@ -347,86 +329,12 @@ status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, cons
         return error;
     }
 
-    android_ycbcr ycbcr;
-
-    ycbcr.y = nullptr;
-    ycbcr.cb = nullptr;
-    ycbcr.cr = nullptr;
-    ycbcr.ystride = 0;
-    ycbcr.cstride = 0;
-    ycbcr.chroma_step = 0;
-
-    for (const auto& planeLayout : planeLayouts) {
-        for (const auto& planeLayoutComponent : planeLayout.components) {
-            if (!gralloc4::isStandardPlaneLayoutComponentType(planeLayoutComponent.type)) {
-                continue;
-            }
-
-            uint8_t* tmpData = static_cast<uint8_t*>(data) + planeLayout.offsetInBytes;
-
-            // Note that `offsetInBits` may not be a multiple of 8 for packed formats (e.g. P010)
-            // but we still want to point to the start of the first byte.
-            tmpData += (planeLayoutComponent.offsetInBits / 8);
-
-            uint64_t sampleIncrementInBytes;
-
-            auto type = static_cast<PlaneLayoutComponentType>(planeLayoutComponent.type.value);
-            switch (type) {
-                case PlaneLayoutComponentType::Y:
-                    if ((ycbcr.y != nullptr) || (planeLayout.sampleIncrementInBits % 8 != 0)) {
-                        unlock(bufferHandle);
-                        return BAD_VALUE;
-                    }
-                    ycbcr.y = tmpData;
-                    ycbcr.ystride = planeLayout.strideInBytes;
-                    break;
-
-                case PlaneLayoutComponentType::CB:
-                case PlaneLayoutComponentType::CR:
-                    if (planeLayout.sampleIncrementInBits % 8 != 0) {
-                        unlock(bufferHandle);
-                        return BAD_VALUE;
-                    }
-
-                    sampleIncrementInBytes = planeLayout.sampleIncrementInBits / 8;
-                    if ((sampleIncrementInBytes != 1) && (sampleIncrementInBytes != 2) &&
-                        (sampleIncrementInBytes != 4)) {
-                        unlock(bufferHandle);
-                        return BAD_VALUE;
-                    }
-
-                    if (ycbcr.cstride == 0 && ycbcr.chroma_step == 0) {
-                        ycbcr.cstride = planeLayout.strideInBytes;
-                        ycbcr.chroma_step = sampleIncrementInBytes;
-                    } else {
-                        if ((static_cast<int64_t>(ycbcr.cstride) != planeLayout.strideInBytes) ||
-                            (ycbcr.chroma_step != sampleIncrementInBytes)) {
-                            unlock(bufferHandle);
-                            return BAD_VALUE;
-                        }
-                    }
-
-                    if (type == PlaneLayoutComponentType::CB) {
-                        if (ycbcr.cb != nullptr) {
-                            unlock(bufferHandle);
-                            return BAD_VALUE;
-                        }
-                        ycbcr.cb = tmpData;
-                    } else {
-                        if (ycbcr.cr != nullptr) {
-                            unlock(bufferHandle);
-                            return BAD_VALUE;
-                        }
-                        ycbcr.cr = tmpData;
-                    }
-                    break;
-                default:
-                    break;
-            };
-        }
+    if (layout.ycbcrStatus != NO_ERROR) {
+        unlock(bufferHandle);
+        return layout.ycbcrStatus;
     }
 
-    *outYcbcr = ycbcr;
+    layout.toYCbCr(data, outYcbcr);
     return static_cast<status_t>(Error::NONE);
 }
 
@@ -684,6 +592,16 @@ status_t Gralloc4Mapper::getChromaSiting(buffer_handle_t bufferHandle,
     return NO_ERROR;
 }
 
+status_t Gralloc4Mapper::getBufferLayout(buffer_handle_t bufferHandle,
+                                         BufferLayout* outLayout) const {
+    return mLayoutCache.get(
+            bufferHandle,
+            [this](buffer_handle_t handle, std::vector<ui::PlaneLayout>* outPlaneLayouts) {
+                return getPlaneLayouts(handle, outPlaneLayouts);
+            },
+            outLayout);
+}
+
 status_t Gralloc4Mapper::getPlaneLayouts(buffer_handle_t bufferHandle,
                                          std::vector<ui::PlaneLayout>* outPlaneLayouts) const {
     return get(bufferHandle, gralloc4::MetadataType_PlaneLayouts, gralloc4::decodePlaneLayouts,
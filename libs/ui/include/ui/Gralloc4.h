@@ -22,6 +22,7 @@
 #include <android/hardware/graphics/common/1.1/types.h>
 #include <android/hardware/graphics/mapper/4.0/IMapper.h>
 #include <gralloctypes/Gralloc4.h>
+#include <ui/BufferLayoutCache.h>
 #include <ui/Gralloc.h>
 #include <ui/GraphicTypes.h>
 #include <ui/Rect.h>
@@ -127,6 +128,9 @@ public:
 private:
     friend class GraphicBufferAllocator;
 
+    // The layout of the buffer for lock(), from the plane layouts cached at the first lock.
+    status_t getBufferLayout(buffer_handle_t bufferHandle, BufferLayout* outLayout) const;
+
     template <class T>
     using DecodeFunction = status_t (*)(const hardware::hidl_vec<uint8_t>& input, T* output);
     template <class T>
@@ -161,6 +165,8 @@ private:
             std::ostringstream* outDump, uint64_t* outAllocationSize, bool less) const;
 
     sp<hardware::graphics::mapper::V4_0::IMapper> mMapper;
+    // The plane layouts of the imported buffers, for lock().
+    mutable BufferLayoutCache mLayoutCache;
 };
 
 class Gralloc4Allocator : public GrallocAllocator {
@@ -18,6 +18,7 @@
 
 #include <aidl/android/hardware/graphics/allocator/IAllocator.h>
 #include <android/hardware/graphics/mapper/IMapper.h>
+#include <ui/BufferLayoutCache.h>
 #include <ui/Gralloc.h>
 
 namespace android {
@@ -159,7 +160,13 @@ public:
 private:
     void unlockBlocking(buffer_handle_t bufferHandle) const;
 
+    // The layout of the buffer for lock(), from the plane layouts cached at the first lock.
+    [[nodiscard]] status_t getBufferLayout(buffer_handle_t bufferHandle,
+                                           BufferLayout *outLayout) const;
+
     AIMapper *mMapper = nullptr;
+    // The plane layouts of the imported buffers, for lock().
+    mutable BufferLayoutCache mLayoutCache;
 };
 
 class Gralloc5Allocator : public GrallocAllocator {
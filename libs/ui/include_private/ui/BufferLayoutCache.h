@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
+#include <cutils/native_handle.h>
+#include <system/graphics.h>
+#include <ui/GraphicTypes.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+// What locking a buffer needs to know about its plane layouts. The plane layouts of a buffer are
+// fixed when it is allocated, so this is computed once per buffer instead of on every lock.
+struct BufferLayout {
+    // Whether the buffer reported any plane layouts. If not, the lock outputs are left untouched.
+    bool hasPlanes = false;
+
+    // -1 if the planes have different or non-byte-aligned sample increments.
+    int32_t bytesPerPixel = -1;
+
+    // -1 if the planes have different strides.
+    int32_t bytesPerStride = -1;
+
+    // The android_ycbcr description of the buffer, with offsets from the start of the mapped
+    // buffer in place of pointers. ycbcrStatus is BAD_VALUE if the buffer can't be described as
+    // android_ycbcr.
+    status_t ycbcrStatus = NO_ERROR;
+    ssize_t yOffset = -1;
+    ssize_t cbOffset = -1;
+    ssize_t crOffset = -1;
+    size_t ystride = 0;
+    size_t cstride = 0;
+    size_t chromaStep = 0;
+
+    static BufferLayout fromPlaneLayouts(const std::vector<ui::PlaneLayout>& planeLayouts);
+
+    // Fills in outYcbcr for a buffer mapped at data. Requires ycbcrStatus == NO_ERROR.
+    void toYCbCr(void* data, android_ycbcr* outYcbcr) const;
+};
+
+// Per-buffer cache of BufferLayout, for the gralloc mappers. Entries must be erased when their
+// buffer is freed, since buffer handles may be reused afterwards.
+class BufferLayoutCache {
+public:
+    using GetPlaneLayoutsFunction =
+            std::function<status_t(buffer_handle_t, std::vector<ui::PlaneLayout>*)>;
+
+    // Looks up the layout of the buffer, querying and caching its plane layouts on the first
+    // call for the buffer. Failed queries are not cached.
+    status_t get(buffer_handle_t bufferHandle, const GetPlaneLayoutsFunction& getPlaneLayouts,
+                 BufferLayout* outLayout) EXCLUDES(mLock);
+
+    void erase(buffer_handle_t bufferHandle) EXCLUDES(mLock);
+
+    size_t size() const EXCLUDES(mLock);
+
+private:
+    mutable std::mutex mLock;
+    std::unordered_map<buffer_handle_t, BufferLayout> mLayouts GUARDED_BY(mLock);
+};
+
+} // namespace android
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BufferLayoutCacheTest"
+
+#include <ui/BufferLayoutCache.h>
+
+#include <gralloctypes/Gralloc4.h>
+#include <gtest/gtest.h>
+
+namespace android {
+
+namespace {
+
+using aidl::android::hardware::graphics::common::ExtendableType;
+using aidl::android::hardware::graphics::common::PlaneLayoutComponent;
+
+constexpr int64_t kWidth = 64;
+constexpr int64_t kHeight = 32;
+
+ui::PlaneLayout makePlane(std::vector<ExtendableType> types, int64_t offsetInBytes,
+                          int64_t sampleIncrementInBits, int64_t strideInBytes) {
+    ui::PlaneLayout plane;
+    int64_t offsetInBits = 0;
+    for (const ExtendableType& type : types) {
+        PlaneLayoutComponent component;
+        component.type = type;
+        component.offsetInBits = offsetInBits;
+        component.sizeInBits = 8;
+        plane.components.push_back(component);
+        offsetInBits += 8;
+    }
+    plane.offsetInBytes = offsetInBytes;
+    plane.sampleIncrementInBits = sampleIncrementInBits;
+    plane.strideInBytes = strideInBytes;
+    plane.widthInSamples = kWidth;
+    plane.heightInSamples = kHeight;
+    plane.totalSizeInBytes = strideInBytes * kHeight;
+    return plane;
+}
+
+std::vector<ui::PlaneLayout> rgba8888() {
+    return {makePlane({gralloc4::PlaneLayoutComponentType_R, gralloc4::PlaneLayoutComponentType_G,
+                       gralloc4::PlaneLayoutComponentType_B, gralloc4::PlaneLayoutComponentType_A},
+                      0, 32, kWidth * 4)};
+}
+
+// Y plane followed by an interleaved CbCr plane
+std::vector<ui::PlaneLayout> nv12() {
+    return {makePlane({gralloc4::PlaneLayoutComponentType_Y}, 0, 8, kWidth),
+            makePlane({gralloc4::PlaneLayoutComponentType_CB, gralloc4::PlaneLayoutComponentType_CR},
+                      kWidth * kHeight, 16, kWidth)};
+}
+
+buffer_handle_t fakeHandle(uintptr_t value) {
+    return reinterpret_cast<buffer_handle_t>(value);
+}
+
+} // namespace
+
+TEST(BufferLayoutTest, SinglePlane) {
+    const BufferLayout layout = BufferLayout::fromPlaneLayouts(rgba8888());
+    EXPECT_TRUE(layout.hasPlanes);
+    EXPECT_EQ(4, layout.bytesPerPixel);
+    EXPECT_EQ(kWidth * 4, layout.bytesPerStride);
+}
+
+TEST(BufferLayoutTest, NoPlanes) {
+    const BufferLayout layout = BufferLayout::fromPlaneLayouts({});
+    EXPECT_FALSE(layout.hasPlanes);
+}
+
+TEST(BufferLayoutTest, YCbCr) {
+    const BufferLayout layout = BufferLayout::fromPlaneLayouts(nv12());
+    EXPECT_EQ(-1, layout.bytesPerPixel);
+    EXPECT_EQ(kWidth, layout.bytesPerStride);
+    ASSERT_EQ(NO_ERROR, layout.ycbcrStatus);
+
+    uint8_t data[kWidth * kHeight * 3 / 2];
+    android_ycbcr ycbcr;
+    layout.toYCbCr(data, &ycbcr);
+    EXPECT_EQ(data, ycbcr.y);
+    EXPECT_EQ(data + kWidth * kHeight, ycbcr.cb);
+    EXPECT_EQ(data + kWidth * kHeight + 1, ycbcr.cr);
+    EXPECT_EQ(static_cast<size_t>(kWidth), ycbcr.ystride);
+    EXPECT_EQ(static_cast<size_t>(kWidth), ycbcr.cstride);
+    EXPECT_EQ(2u, ycbcr.chroma_step);
+}
+
+TEST(BufferLayoutTest, MismatchedChromaStridesAreNotYCbCr) {
+    std::vector<ui::PlaneLayout> planes = {
+            makePlane({gralloc4::PlaneLayoutComponentType_Y}, 0, 8, kWidth),
+            makePlane({gralloc4::PlaneLayoutComponentType_CB}, kWidth * kHeight, 8, kWidth / 2),
+            makePlane({gralloc4::PlaneLayoutComponentType_CR}, kWidth * kHeight * 5 / 4, 8,
+                      kWidth)};
+    EXPECT_EQ(BAD_VALUE, BufferLayout::fromPlaneLayouts(planes).ycbcrStatus);
+}
+
+TEST(BufferLayoutCacheTest, QueriesPlaneLayoutsOncePerBuffer) {
+    BufferLayoutCache cache;
+    int queries = 0;
+    auto getPlaneLayouts = [&](buffer_handle_t, std::vector<ui::PlaneLayout>* outPlaneLayouts) {
+        queries++;
+        *outPlaneLayouts = rgba8888();
+        return NO_ERROR;
+    };
+
+    BufferLayout layout;
+    ASSERT_EQ(NO_ERROR, cache.get(fakeHandle(1), getPlaneLayouts, &layout));
+    ASSERT_EQ(NO_ERROR, cache.get(fakeHandle(1), getPlaneLayouts, &layout));
+    EXPECT_EQ(1, queries);
+    EXPECT_EQ(4, layout.bytesPerPixel);
+
+    ASSERT_EQ(NO_ERROR, cache.get(fakeHandle(2), getPlaneLayouts, &layout));
+    EXPECT_EQ(2, queries);
+    EXPECT_EQ(2u, cache.size());
+}
+
+TEST(BufferLayoutCacheTest, ErasedBufferIsQueriedAgain) {
+    BufferLayoutCache cache;
+    std::vector<ui::PlaneLayout> planes = rgba8888();
+    auto getPlaneLayouts = [&](buffer_handle_t, std::vector<ui::PlaneLayout>* outPlaneLayouts) {
+        *outPlaneLayouts = planes;
+        return NO_ERROR;
+    };
+
+    BufferLayout layout;
+    ASSERT_EQ(NO_ERROR, cache.get(fakeHandle(1), getPlaneLayouts, &layout));
+    EXPECT_EQ(4, layout.bytesPerPixel);
+
+    // The handle is freed and reused for a buffer with a different format
+    cache.erase(fakeHandle(1));
+    EXPECT_EQ(0u, cache.size());
+    planes = nv12();
+    ASSERT_EQ(NO_ERROR, cache.get(fakeHandle(1), getPlaneLayouts, &layout));
+    EXPECT_EQ(-1, layout.bytesPerPixel);
+}
+
+TEST(BufferLayoutCacheTest, ErrorsAreNotCached) {
+    BufferLayoutCache cache;
+    status_t result = UNKNOWN_TRANSACTION;
+    auto getPlaneLayouts = [&](buffer_handle_t, std::vector<ui::PlaneLayout>* outPlaneLayouts) {
+        *outPlaneLayouts = rgba8888();
+        return result;
+    };
+
+    BufferLayout layout;
+    EXPECT_EQ(UNKNOWN_TRANSACTION, cache.get(fakeHandle(1), getPlaneLayouts, &layout));
+    EXPECT_EQ(0u, cache.size());
+
+    result = NO_ERROR;
+    EXPECT_EQ(NO_ERROR, cache.get(fakeHandle(1), getPlaneLayouts, &layout));
+    EXPECT_EQ(1u, cache.size());
+}
+
+} // namespace android
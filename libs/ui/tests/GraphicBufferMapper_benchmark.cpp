@@ -0,0 +1,180 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+
+#include <gralloctypes/Gralloc4.h>
+#include <ui/BufferLayoutCache.h>
+#include <ui/GraphicBuffer.h>
+
+namespace {
+
+std::atomic<size_t> gAllocationCount = 0;
+
+} // namespace
+
+// Count every heap allocation made by the process
+void* operator new(size_t size) {
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (p == nullptr) {
+        std::abort();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace android {
+namespace {
+
+using aidl::android::hardware::graphics::common::ExtendableType;
+using aidl::android::hardware::graphics::common::PlaneLayoutComponent;
+
+constexpr uint32_t kWidth = 1920;
+constexpr uint32_t kHeight = 1080;
+
+// Reports the heap allocations per iteration, made since allocationsBefore was sampled
+void reportAllocations(benchmark::State& state, size_t allocationsBefore) {
+    const size_t allocations = gAllocationCount.load() - allocationsBefore;
+    state.counters["allocsPerIteration"] =
+            benchmark::Counter(allocations, benchmark::Counter::kAvgIterations);
+}
+
+ui::PlaneLayout makePlane(std::vector<ExtendableType> types, int64_t offsetInBytes,
+                          int64_t sampleIncrementInBits, int64_t strideInBytes) {
+    ui::PlaneLayout plane;
+    int64_t offsetInBits = 0;
+    for (const ExtendableType& type : types) {
+        PlaneLayoutComponent component;
+        component.type = type;
+        component.offsetInBits = offsetInBits;
+        component.sizeInBits = 8;
+        plane.components.push_back(component);
+        offsetInBits += 8;
+    }
+    plane.offsetInBytes = offsetInBytes;
+    plane.sampleIncrementInBits = sampleIncrementInBits;
+    plane.strideInBytes = strideInBytes;
+    plane.widthInSamples = kWidth;
+    plane.heightInSamples = kHeight;
+    plane.totalSizeInBytes = strideInBytes * kHeight;
+    return plane;
+}
+
+// The plane layouts of an NV12 buffer, as a mapper reports them
+std::vector<ui::PlaneLayout> nv12() {
+    return {makePlane({gralloc4::PlaneLayoutComponentType_Y}, 0, 8, kWidth),
+            makePlane({gralloc4::PlaneLayoutComponentType_CB, gralloc4::PlaneLayoutComponentType_CR},
+                      kWidth * kHeight, 16, kWidth)};
+}
+
+// What every lock used to do: decode the encoded plane layouts metadata and derive the layout
+void BM_BufferLayout_decodeEveryLock(benchmark::State& state) {
+    hardware::hidl_vec<uint8_t> encoded;
+    gralloc4::encodePlaneLayouts(nv12(), &encoded);
+
+    const size_t allocationsBefore = gAllocationCount.load();
+    for (auto _ : state) {
+        std::vector<ui::PlaneLayout> planeLayouts;
+        gralloc4::decodePlaneLayouts(encoded, &planeLayouts);
+        benchmark::DoNotOptimize(BufferLayout::fromPlaneLayouts(planeLayouts));
+    }
+    reportAllocations(state, allocationsBefore);
+}
+BENCHMARK(BM_BufferLayout_decodeEveryLock);
+
+// The layout of a buffer that has already been locked once
+void BM_BufferLayout_cached(benchmark::State& state) {
+    hardware::hidl_vec<uint8_t> encoded;
+    gralloc4::encodePlaneLayouts(nv12(), &encoded);
+    auto getPlaneLayouts = [&](buffer_handle_t, std::vector<ui::PlaneLayout>* outPlaneLayouts) {
+        return gralloc4::decodePlaneLayouts(encoded, outPlaneLayouts);
+    };
+    const buffer_handle_t handle = reinterpret_cast<buffer_handle_t>(&encoded);
+    BufferLayoutCache cache;
+    BufferLayout layout;
+    cache.get(handle, getPlaneLayouts, &layout);
+
+    const size_t allocationsBefore = gAllocationCount.load();
+    for (auto _ : state) {
+        cache.get(handle, getPlaneLayouts, &layout);
+        benchmark::DoNotOptimize(layout);
+    }
+    reportAllocations(state, allocationsBefore);
+}
+BENCHMARK(BM_BufferLayout_cached);
+
+// Lock and unlock of a CPU-readable buffer through the device's mapper, as done per frame by
+// CpuConsumer and screenshot readback
+void BM_GraphicBuffer_lockUnlock(benchmark::State& state) {
+    const PixelFormat format = static_cast<PixelFormat>(state.range(0));
+    sp<GraphicBuffer> buffer =
+            sp<GraphicBuffer>::make(kWidth, kHeight, format, 1,
+                                    GraphicBuffer::USAGE_SW_READ_OFTEN |
+                                            GraphicBuffer::USAGE_SW_WRITE_OFTEN,
+                                    "GraphicBufferMapper_benchmark");
+    if (buffer->initCheck() != NO_ERROR) {
+        state.SkipWithError("Could not allocate a buffer");
+        return;
+    }
+    const bool isYCbCr = format == HAL_PIXEL_FORMAT_YCbCr_420_888;
+    auto lockUnlock = [&]() {
+        status_t result;
+        if (isYCbCr) {
+            android_ycbcr ycbcr;
+            result = buffer->lockYCbCr(GraphicBuffer::USAGE_SW_READ_OFTEN, &ycbcr);
+        } else {
+            void* data;
+            int32_t bytesPerPixel;
+            int32_t bytesPerStride;
+            result = buffer->lock(GraphicBuffer::USAGE_SW_READ_OFTEN, &data, &bytesPerPixel,
+                                  &bytesPerStride);
+        }
+        if (result == NO_ERROR) {
+            buffer->unlock();
+        }
+        return result;
+    };
+
+    // The first lock fills the layout cache
+    if (lockUnlock() != NO_ERROR) {
+        state.SkipWithError("Could not lock the buffer");
+        return;
+    }
+
+    const size_t allocationsBefore = gAllocationCount.load();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lockUnlock());
+    }
+    reportAllocations(state, allocationsBefore);
+}
+BENCHMARK(BM_GraphicBuffer_lockUnlock)
+        ->ArgName("format")
+        ->Arg(PIXEL_FORMAT_RGBA_8888)
+        ->Arg(HAL_PIXEL_FORMAT_YCbCr_420_888);
+
+} // namespace
+} // namespace android
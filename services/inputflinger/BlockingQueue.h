@@ -16,41 +16,70 @@
 
 #pragma once
 
-#include <condition_variable>
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <climits>
 #include <functional>
-#include <list>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <optional>
-#include "android-base/thread_annotations.h"
+#include <utility>
 
 namespace android {
 
 /**
- * A thread-safe FIFO queue. This list-backed queue stores up to <i>capacity</i> objects if
- * a capacity is provided at construction, and is otherwise unbounded.
+ * A thread-safe FIFO queue. This queue stores up to <i>capacity</i> objects if a capacity is
+ * provided at construction, and is otherwise unbounded.
  * Objects can always be added. Objects are added immediately.
  * If the queue is full, new objects cannot be added.
  *
  * The action of retrieving an object will block until an element is available.
+ *
+ * The objects are stored in a ring of cells, each with a sequence number that tells which
+ * position of the queue it holds, and whether it is filled. Producers and consumers claim
+ * positions with a compare-and-swap, so that adding and retrieving objects takes no lock and does
+ * not allocate. A consumer only blocks, on a futex, when the queue is empty.
+ *
+ * Removing objects other than the oldest (erase_if), clearing the queue, and growing an unbounded
+ * queue need the ring to themselves. They wait for the ongoing additions and retrievals to finish,
+ * and hold back the new ones until they are done. They are expected to be rare, so they pay for
+ * the synchronization: additions and retrievals only count themselves in one of a few counters,
+ * picked by thread, and check that no exclusive operation is ongoing, without a full memory
+ * barrier.
  */
 template <class T>
 class BlockingQueue {
 public:
-    explicit BlockingQueue() = default;
+    explicit BlockingQueue() : BlockingQueue(std::nullopt, INITIAL_UNBOUNDED_CAPACITY) {}
 
-    explicit BlockingQueue(size_t capacity) : mCapacity(capacity){};
+    explicit BlockingQueue(size_t capacity) : BlockingQueue(capacity, capacity) {}
+
+    ~BlockingQueue() { destroyElements(); }
+
+    BlockingQueue(const BlockingQueue&) = delete;
+    BlockingQueue& operator=(const BlockingQueue&) = delete;
 
     /**
      * Retrieve and remove the oldest object.
      * Blocks execution indefinitely while queue is empty.
      */
     T pop() {
-        std::unique_lock lock(mLock);
-        android::base::ScopedLockAssertion assumeLock(mLock);
-        mHasElements.wait(lock, [this]() REQUIRES(mLock) { return !this->mQueue.empty(); });
-        T t = std::move(mQueue.front());
-        mQueue.erase(mQueue.begin());
-        return t;
+        while (true) {
+            const uint32_t pushCount = mPushCount.load(std::memory_order_acquire);
+            if (std::optional<T> t = tryPop()) {
+                return std::move(*t);
+            }
+            waitForPush(pushCount, /*timeout=*/nullptr);
+        }
     };
 
     /**
@@ -59,15 +88,25 @@ public:
      * if the queue was empty for the entire duration.
      */
     std::optional<T> popWithTimeout(std::chrono::nanoseconds duration) {
-        std::unique_lock lock(mLock);
-        android::base::ScopedLockAssertion assumeLock(mLock);
-        if (!mHasElements.wait_for(lock, duration,
-                                   [this]() REQUIRES(mLock) { return !this->mQueue.empty(); })) {
-            return {};
-        }
-        T t = std::move(mQueue.front());
-        mQueue.erase(mQueue.begin());
-        return t;
+        const auto deadline = std::chrono::steady_clock::now() + duration;
+        while (true) {
+            const uint32_t pushCount = mPushCount.load(std::memory_order_acquire);
+            if (std::optional<T> t = tryPop()) {
+                return t;
+            }
+            const auto remaining = deadline - std::chrono::steady_clock::now();
+            if (remaining <= std::chrono::nanoseconds::zero()) {
+                return {};
+            }
+            const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+            const timespec timeout{
+                    .tv_sec = static_cast<time_t>(seconds.count()),
+                    .tv_nsec = static_cast<long>(
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(remaining -
+                                                                                 seconds)
+                                    .count())};
+            waitForPush(pushCount, &timeout);
+        }
     };
 
     /**
@@ -76,17 +115,7 @@ public:
      * Return true if an element was successfully added.
      * Return false if the queue is full.
      */
-    bool push(T&& t) {
-        { // acquire lock
-            std::scoped_lock lock(mLock);
-            if (mCapacity && mQueue.size() == mCapacity) {
-                return false;
-            }
-            mQueue.push_back(std::move(t));
-        } // release lock
-        mHasElements.notify_one();
-        return true;
-    };
+    bool push(T&& t) { return emplace(std::move(t)); };
 
     /**
      * Construct a new object into the queue.
@@ -96,20 +125,54 @@ public:
      */
     template <class... Args>
     bool emplace(Args&&... args) {
-        { // acquire lock
-            std::scoped_lock lock(mLock);
-            if (mCapacity && mQueue.size() == mCapacity) {
-                return false;
+        while (true) {
+            size_t cellCount;
+            {
+                SharedAccess access(*this);
+                size_t position;
+                if (Cell* cell = claimPushCell(&position)) {
+                    new (cell->storage) T(std::forward<Args>(args)...);
+                    cell->sequence.store(position + 1, std::memory_order_release);
+                    break;
+                }
+                if (mCapacity) {
+                    return false;
+                }
+                cellCount = mCellCount;
             }
-            mQueue.emplace_back(args...);
-        } // release lock
-        mHasElements.notify_one();
+            // Unbounded queues grow instead of being full.
+            grow(cellCount);
+        }
+        if (mPushCount.fetch_add(PUSH_COUNT_INCREMENT, std::memory_order_release) &
+            PUSH_WAITED_FLAG) {
+            mPushCount.fetch_and(~PUSH_WAITED_FLAG, std::memory_order_relaxed);
+            futexWake(mPushCount, INT_MAX);
+        }
         return true;
     };
 
     void erase_if(const std::function<bool(const T&)>& pred) {
-        std::scoped_lock lock(mLock);
-        std::erase_if(mQueue, pred);
+        ExclusiveAccess access(*this);
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        size_t newTail = head;
+        for (size_t position = head; position < tail; position++) {
+            T* element = elementAt(position);
+            if (pred(*element)) {
+                element->~T();
+                continue;
+            }
+            if (newTail != position) {
+                new (cellAt(newTail).storage) T(std::move(*element));
+                element->~T();
+            }
+            newTail++;
+        }
+        // The cells past the new tail are free for their position again.
+        for (size_t position = newTail; position < tail; position++) {
+            cellAt(position).sequence.store(position, std::memory_order_relaxed);
+        }
+        mTail.store(newTail, std::memory_order_relaxed);
     }
 
     /**
@@ -117,8 +180,15 @@ public:
      * Does not block.
      */
     void clear() {
-        std::scoped_lock lock(mLock);
-        mQueue.clear();
+        ExclusiveAccess access(*this);
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        for (size_t position = head; position < tail; position++) {
+            elementAt(position)->~T();
+            // Free for the position it holds in the next round of the ring.
+            cellAt(position).sequence.store(position + mCellCount, std::memory_order_relaxed);
+        }
+        mHead.store(tail, std::memory_order_relaxed);
     };
 
     /**
@@ -127,21 +197,284 @@ public:
      * Does not block.
      */
     size_t size() {
-        std::scoped_lock lock(mLock);
-        return mQueue.size();
+        SharedAccess access(*this);
+        const size_t head = mHead.load(std::memory_order_acquire);
+        const size_t tail = mTail.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
     }
 
 private:
-    const std::optional<size_t> mCapacity;
+    static constexpr size_t INITIAL_UNBOUNDED_CAPACITY = 16;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    // Counters of the threads accessing the ring, each shared by the threads whose index modulo
+    // the count is its index.
+    static constexpr size_t SHARED_COUNTER_COUNT = 8;
+    // mPushCount counts additions above its lowest bit, which is set while a consumer waits.
+    static constexpr uint32_t PUSH_COUNT_INCREMENT = 2;
+    static constexpr uint32_t PUSH_WAITED_FLAG = 1;
+
+    struct Cell {
+        // Equals the position the cell is free for, or that position plus one once it holds the
+        // element at that position.
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct alignas(CACHE_LINE_SIZE) SharedCounter {
+        std::atomic<uint32_t> count{0};
+    };
+
+    /**
+     * Marks the calling thread as accessing the ring, unless an exclusive operation holds it, in
+     * which case the thread waits for that operation first.
+     */
+    class SharedAccess {
+    public:
+        explicit SharedAccess(BlockingQueue& queue)
+              : mQueue(queue),
+                mCounter(queue.mSharedCounters[threadIndex() % SHARED_COUNTER_COUNT]) {
+            while (true) {
+                mCounter.count.fetch_add(1, std::memory_order_relaxed);
+                lightFence();
+                // Pairs with the release of the last exclusive operation, to see its changes.
+                if (mQueue.mExclusive.load(std::memory_order_acquire) == 0) {
+                    return;
+                }
+                release();
+                futexWait(mQueue.mExclusive, 1, /*timeout=*/nullptr);
+            }
+        }
+        ~SharedAccess() { release(); }
+
+    private:
+        void release() {
+            // Pairs with the acquire of the exclusive operation, for it to see the changes made.
+            const uint32_t count = mCounter.count.fetch_sub(1, std::memory_order_release);
+            lightFence();
+            if (count == 1 && mQueue.mExclusive.load(std::memory_order_relaxed) != 0) {
+                futexWake(mCounter.count, INT_MAX);
+            }
+        }
+
+        BlockingQueue& mQueue;
+        SharedCounter& mCounter;
+    };
+
     /**
-     * Used to signal that mQueue is non-empty.
+     * Gives the calling thread the ring to itself, once the threads that are accessing it are
+     * done.
      */
-    std::condition_variable mHasElements;
+    class ExclusiveAccess {
+    public:
+        explicit ExclusiveAccess(BlockingQueue& queue)
+              : mQueue(queue), mLock(queue.mExclusiveLock) {
+            mQueue.mExclusive.store(1, std::memory_order_relaxed);
+            // Either the threads see the store, or this thread sees them counted.
+            heavyFence();
+            for (SharedCounter& counter : mQueue.mSharedCounters) {
+                for (uint32_t count = counter.count.load(std::memory_order_acquire); count != 0;
+                     count = counter.count.load(std::memory_order_acquire)) {
+                    futexWait(counter.count, count, /*timeout=*/nullptr);
+                }
+            }
+        }
+        ~ExclusiveAccess() {
+            mQueue.mExclusive.store(0, std::memory_order_release);
+            futexWake(mQueue.mExclusive, INT_MAX);
+        }
+
+    private:
+        BlockingQueue& mQueue;
+        std::scoped_lock<std::mutex> mLock;
+    };
+
     /**
-     * Lock for accessing and waiting on elements.
+     * A number of the calling thread, which tells which shared counter it uses. Threads are
+     * numbered in the order they first access a queue of T.
      */
-    std::mutex mLock;
-    std::list<T> mQueue GUARDED_BY(mLock);
+    static size_t threadIndex() {
+        static std::atomic<size_t> sNextIndex{0};
+        thread_local const size_t index = sNextIndex.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    /**
+     * Whether heavyFence can make the other threads of the process execute a memory barrier, so
+     * that lightFence need not.
+     */
+    static bool hasProcessWideBarrier() {
+        static const bool registered =
+                syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0;
+        return registered;
+    }
+
+    /**
+     * Orders the memory accesses of the calling thread before and after it, relative to a
+     * heavyFence of another thread. Paired with heavyFence, it is a full memory barrier.
+     */
+    static void lightFence() {
+        if (hasProcessWideBarrier()) {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    static void heavyFence() {
+        if (hasProcessWideBarrier()) {
+            syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+        } else {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    BlockingQueue(std::optional<size_t> capacity, size_t cellCount)
+          : mCapacity(capacity),
+            // A ring of a single cell could not tell a free cell from a filled one.
+            mCellCount(std::max<size_t>(cellCount, 2)),
+            mCells(makeCells(mCellCount)) {}
+
+    static std::unique_ptr<Cell[]> makeCells(size_t cellCount) {
+        std::unique_ptr<Cell[]> cells(new Cell[cellCount]);
+        for (size_t i = 0; i < cellCount; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        return cells;
+    }
+
+    Cell& cellAt(size_t position) { return mCells[position % mCellCount]; }
+
+    T* elementAt(size_t position) {
+        return std::launder(reinterpret_cast<T*>(cellAt(position).storage));
+    }
+
+    /**
+     * Claims the cell at the tail of the queue, and returns its position in outPosition.
+     * Returns nullptr if the queue is full.
+     */
+    Cell* claimPushCell(size_t* outPosition) {
+        size_t position = mTail.load(std::memory_order_relaxed);
+        while (true) {
+            if (mCapacity && mCellCount > *mCapacity) {
+                // The ring has more cells than the capacity, so it can't tell when it is full.
+                const size_t head = mHead.load(std::memory_order_acquire);
+                if (position >= head && position - head >= *mCapacity) {
+                    return nullptr;
+                }
+            }
+            Cell& cell = cellAt(position);
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == position) {
+                if (mTail.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+                    *outPosition = position;
+                    return &cell;
+                }
+            } else if (sequence < position) {
+                // The cell still holds the element from the previous round of the ring.
+                return nullptr;
+            } else {
+                position = mTail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<T> tryPop() {
+        SharedAccess access(*this);
+        size_t position = mHead.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cellAt(position);
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == position + 1) {
+                if (mHead.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+                    T* element = std::launder(reinterpret_cast<T*>(cell.storage));
+                    std::optional<T> t(std::move(*element));
+                    element->~T();
+                    cell.sequence.store(position + mCellCount, std::memory_order_release);
+                    return t;
+                }
+            } else if (sequence < position + 1) {
+                // Empty.
+                return {};
+            } else {
+                position = mHead.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Blocks until an element is added after pushCount was read, or until the timeout.
+     */
+    void waitForPush(uint32_t pushCount, const timespec* timeout) {
+        // Fails if an element was added since, as the producers change the same word.
+        const uint32_t waited = pushCount | PUSH_WAITED_FLAG;
+        if (pushCount == waited ||
+            mPushCount.compare_exchange_strong(pushCount, waited, std::memory_order_relaxed)) {
+            futexWait(mPushCount, waited, timeout);
+        }
+    }
+
+    /**
+     * Doubles the ring, unless it was already grown past cellCount.
+     */
+    void grow(size_t cellCount) {
+        ExclusiveAccess access(*this);
+        if (mCellCount != cellCount) {
+            return;
+        }
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        const size_t newCellCount = 2 * mCellCount;
+        std::unique_ptr<Cell[]> cells = makeCells(newCellCount);
+        for (size_t position = head; position < tail; position++) {
+            T* element = elementAt(position);
+            Cell& cell = cells[position - head];
+            new (cell.storage) T(std::move(*element));
+            element->~T();
+            cell.sequence.store(position - head + 1, std::memory_order_relaxed);
+        }
+        mCells = std::move(cells);
+        mCellCount = newCellCount;
+        mHead.store(0, std::memory_order_relaxed);
+        mTail.store(tail - head, std::memory_order_relaxed);
+    }
+
+    void destroyElements() {
+        for (size_t position = mHead.load(); position < mTail.load(); position++) {
+            elementAt(position)->~T();
+        }
+    }
+
+    static void futexWait(std::atomic<uint32_t>& word, uint32_t expected,
+                          const timespec* timeout) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected,
+                timeout, nullptr, 0);
+    }
+
+    static void futexWake(std::atomic<uint32_t>& word, int count) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, count, nullptr,
+                nullptr, 0);
+    }
+
+    const std::optional<size_t> mCapacity;
+    // Only changed with exclusive access.
+    size_t mCellCount;
+    std::unique_ptr<Cell[]> mCells;
+
+    // Position of the oldest element, and of the next element to add. Positions only grow, and
+    // the cell of a position is at the position modulo mCellCount.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> mHead{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> mTail{0};
+    // Incremented after every element is added, with PUSH_WAITED_FLAG set by the consumers that
+    // sleep on it.
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> mPushCount{0};
+
+    // Threads accessing the ring, and whether an exclusive operation holds it.
+    std::array<SharedCounter, SHARED_COUNTER_COUNT> mSharedCounters;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> mExclusive{0};
+    // Serializes the exclusive operations.
+    std::mutex mExclusiveLock;
 };
 
 } // namespace android
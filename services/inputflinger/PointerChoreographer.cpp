@@ -18,6 +18,7 @@
 
 #include <android-base/logging.h>
 #include <input/PrintTools.h>
+#include <thread>
 
 #include "PointerChoreographer.h"
 
@@ -44,68 +45,14 @@ bool isHoverAction(int32_t action) {
 bool isStylusHoverEvent(const NotifyMotionArgs& args) {
     return isStylusEvent(args.source, args.pointerProperties) && isHoverAction(args.action);
 }
-} // namespace
-
-// --- PointerChoreographer ---
-
-PointerChoreographer::PointerChoreographer(InputListenerInterface& listener,
-                                           PointerChoreographerPolicyInterface& policy)
-      : mTouchControllerConstructor([this]() REQUIRES(mLock) {
-            return mPolicy.createPointerController(
-                    PointerControllerInterface::ControllerType::TOUCH);
-        }),
-        mNextListener(listener),
-        mPolicy(policy),
-        mDefaultMouseDisplayId(ADISPLAY_ID_DEFAULT),
-        mNotifiedPointerDisplayId(ADISPLAY_ID_NONE),
-        mShowTouchesEnabled(false),
-        mStylusPointerIconEnabled(false) {}
-
-void PointerChoreographer::notifyInputDevicesChanged(const NotifyInputDevicesChangedArgs& args) {
-    std::scoped_lock _l(mLock);
-
-    mInputDeviceInfos = args.inputDeviceInfos;
-    updatePointerControllersLocked();
-    mNextListener.notify(args);
-}
-
-void PointerChoreographer::notifyConfigurationChanged(const NotifyConfigurationChangedArgs& args) {
-    mNextListener.notify(args);
-}
-
-void PointerChoreographer::notifyKey(const NotifyKeyArgs& args) {
-    mNextListener.notify(args);
-}
-
-void PointerChoreographer::notifyMotion(const NotifyMotionArgs& args) {
-    NotifyMotionArgs newArgs = processMotion(args);
-
-    mNextListener.notify(newArgs);
-}
-
-NotifyMotionArgs PointerChoreographer::processMotion(const NotifyMotionArgs& args) {
-    std::scoped_lock _l(mLock);
-
-    if (isFromMouse(args)) {
-        return processMouseEventLocked(args);
-    } else if (isFromTouchpad(args)) {
-        return processTouchpadEventLocked(args);
-    } else if (mStylusPointerIconEnabled && isStylusHoverEvent(args)) {
-        processStylusHoverEventLocked(args);
-    } else if (isFromSource(args.source, AINPUT_SOURCE_TOUCHSCREEN)) {
-        processTouchscreenAndStylusEventLocked(args);
-    }
-    return args;
-}
 
-NotifyMotionArgs PointerChoreographer::processMouseEventLocked(const NotifyMotionArgs& args) {
+NotifyMotionArgs processMouseEvent(const NotifyMotionArgs& args, int32_t displayId,
+                                   PointerControllerInterface& pc) {
     if (args.getPointerCount() != 1) {
         LOG(FATAL) << "Only mouse events with a single pointer are currently supported: "
                    << args.dump();
     }
 
-    auto [displayId, pc] = getDisplayIdAndMouseControllerLocked(args.displayId);
-
     const float deltaX = args.pointerCoords[0].getAxisValue(AMOTION_EVENT_AXIS_RELATIVE_X);
     const float deltaY = args.pointerCoords[0].getAxisValue(AMOTION_EVENT_AXIS_RELATIVE_Y);
     pc.move(deltaX, deltaY);
@@ -121,9 +68,8 @@ NotifyMotionArgs PointerChoreographer::processMouseEventLocked(const NotifyMotio
     return newArgs;
 }
 
-NotifyMotionArgs PointerChoreographer::processTouchpadEventLocked(const NotifyMotionArgs& args) {
-    auto [displayId, pc] = getDisplayIdAndMouseControllerLocked(args.displayId);
-
+NotifyMotionArgs processTouchpadEvent(const NotifyMotionArgs& args, int32_t displayId,
+                                      PointerControllerInterface& pc) {
     NotifyMotionArgs newArgs(args);
     newArgs.displayId = displayId;
     if (args.getPointerCount() == 1 && args.classification == MotionClassification::NONE) {
@@ -159,27 +105,14 @@ NotifyMotionArgs PointerChoreographer::processTouchpadEventLocked(const NotifyMo
  * When screen is touched, fade the mouse pointer on that display. We only call fade for
  * ACTION_DOWN events.This would allow both mouse and touch to be used at the same time if the
  * mouse device keeps moving and unfades the cursor.
- * For touch events, we do not need to populate the cursor position.
  */
-void PointerChoreographer::processTouchscreenAndStylusEventLocked(const NotifyMotionArgs& args) {
-    if (args.displayId == ADISPLAY_ID_NONE) {
-        return;
-    }
-
-    if (const auto it = mMousePointersByDisplay.find(args.displayId);
-        it != mMousePointersByDisplay.end() && args.action == AMOTION_EVENT_ACTION_DOWN) {
-        it->second->fade(PointerControllerInterface::Transition::GRADUAL);
+void fadeMouseOnTouch(const NotifyMotionArgs& args, PointerControllerInterface* mousePc) {
+    if (mousePc != nullptr && args.action == AMOTION_EVENT_ACTION_DOWN) {
+        mousePc->fade(PointerControllerInterface::Transition::GRADUAL);
     }
+}
 
-    if (!mShowTouchesEnabled) {
-        return;
-    }
-
-    // Get the touch pointer controller for the device, or create one if it doesn't exist.
-    auto [it, _] = mTouchPointersByDevice.try_emplace(args.deviceId, mTouchControllerConstructor);
-
-    PointerControllerInterface& pc = *it->second;
-
+void showTouchSpots(const NotifyMotionArgs& args, PointerControllerInterface& pc) {
     const PointerCoords* coords = args.pointerCoords.data();
     const int32_t maskedAction = MotionEvent::getActionMasked(args.action);
     const uint8_t actionIndex = MotionEvent::getActionIndex(args.action);
@@ -200,23 +133,12 @@ void PointerChoreographer::processTouchscreenAndStylusEventLocked(const NotifyMo
     pc.setSpots(coords, idToIndex.cbegin(), idBits, args.displayId);
 }
 
-void PointerChoreographer::processStylusHoverEventLocked(const NotifyMotionArgs& args) {
-    if (args.displayId == ADISPLAY_ID_NONE) {
-        return;
-    }
-
+void processStylusHoverEvent(const NotifyMotionArgs& args, PointerControllerInterface& pc) {
     if (args.getPointerCount() != 1) {
         LOG(WARNING) << "Only stylus hover events with a single pointer are currently supported: "
                      << args.dump();
     }
 
-    // Get the stylus pointer controller for the device, or create one if it doesn't exist.
-    auto [it, _] =
-            mStylusPointersByDevice.try_emplace(args.deviceId,
-                                                getStylusControllerConstructor(args.displayId));
-
-    PointerControllerInterface& pc = *it->second;
-
     const float x = args.pointerCoords[0].getAxisValue(AMOTION_EVENT_AXIS_X);
     const float y = args.pointerCoords[0].getAxisValue(AMOTION_EVENT_AXIS_Y);
     pc.setPosition(x, y);
@@ -226,6 +148,177 @@ void PointerChoreographer::processStylusHoverEventLocked(const NotifyMotionArgs&
         pc.unfade(PointerControllerInterface::Transition::IMMEDIATE);
     }
 }
+} // namespace
+
+// --- PointerChoreographer ---
+
+PointerChoreographer::PointerChoreographer(InputListenerInterface& listener,
+                                           PointerChoreographerPolicyInterface& policy)
+      : mTouchControllerConstructor([this]() REQUIRES(mLock) {
+            return mPolicy.createPointerController(
+                    PointerControllerInterface::ControllerType::TOUCH);
+        }),
+        mNextListener(listener),
+        mPolicy(policy),
+        mDefaultMouseDisplayId(ADISPLAY_ID_DEFAULT),
+        mNotifiedPointerDisplayId(ADISPLAY_ID_NONE),
+        mShowTouchesEnabled(false),
+        mStylusPointerIconEnabled(false),
+        mRouting(nullptr),
+        mRoutingEpoch(0),
+        mRoutingReaderCounts{0, 0} {
+    std::scoped_lock _l(mLock);
+    publishRoutingLocked();
+}
+
+PointerChoreographer::~PointerChoreographer() {
+    delete mRouting.load();
+}
+
+void PointerChoreographer::notifyInputDevicesChanged(const NotifyInputDevicesChangedArgs& args) {
+    std::scoped_lock _l(mLock);
+
+    mInputDeviceInfos = args.inputDeviceInfos;
+    updatePointerControllersLocked();
+    mNextListener.notify(args);
+}
+
+void PointerChoreographer::notifyConfigurationChanged(const NotifyConfigurationChangedArgs& args) {
+    mNextListener.notify(args);
+}
+
+void PointerChoreographer::notifyKey(const NotifyKeyArgs& args) {
+    mNextListener.notify(args);
+}
+
+void PointerChoreographer::notifyMotion(const NotifyMotionArgs& args) {
+    NotifyMotionArgs newArgs = processMotion(args);
+
+    mNextListener.notify(newArgs);
+}
+
+NotifyMotionArgs PointerChoreographer::processMotion(const NotifyMotionArgs& args) {
+    // Most events go to controllers that already exist, so try to route the event without mLock.
+    std::atomic<int32_t>& readerCount = mRoutingReaderCounts[mRoutingEpoch.load() % 2];
+    readerCount.fetch_add(1);
+    std::optional<NotifyMotionArgs> routedArgs = processMotionWithRouting(*mRouting.load(), args);
+    readerCount.fetch_sub(1, std::memory_order_release);
+    if (routedArgs) {
+        return *std::move(routedArgs);
+    }
+
+    // A controller that the event needs is missing, so create it.
+    std::scoped_lock _l(mLock);
+
+    if (isFromMouse(args)) {
+        return processMouseEventLocked(args);
+    } else if (isFromTouchpad(args)) {
+        return processTouchpadEventLocked(args);
+    } else if (mStylusPointerIconEnabled && isStylusHoverEvent(args)) {
+        processStylusHoverEventLocked(args);
+    } else if (isFromSource(args.source, AINPUT_SOURCE_TOUCHSCREEN)) {
+        processTouchscreenAndStylusEventLocked(args);
+    }
+    return args;
+}
+
+/**
+ * Returns the event processed with the controllers in the given routing, or nothing if one of
+ * the controllers it needs has not been created yet.
+ */
+std::optional<NotifyMotionArgs> PointerChoreographer::processMotionWithRouting(
+        const Routing& routing, const NotifyMotionArgs& args) {
+    if (isFromMouse(args) || isFromTouchpad(args)) {
+        const int32_t displayId = args.displayId == ADISPLAY_ID_NONE
+                ? routing.defaultMouseDisplayId
+                : args.displayId;
+        PointerControllerInterface* pc = Routing::find(routing.mousePointersByDisplay, displayId);
+        if (pc == nullptr) {
+            return std::nullopt;
+        }
+        return isFromMouse(args) ? processMouseEvent(args, displayId, *pc)
+                                 : processTouchpadEvent(args, displayId, *pc);
+    } else if (routing.stylusPointerIconEnabled && isStylusHoverEvent(args)) {
+        if (args.displayId == ADISPLAY_ID_NONE) {
+            return args;
+        }
+        PointerControllerInterface* pc =
+                Routing::find(routing.stylusPointersByDevice, args.deviceId);
+        if (pc == nullptr) {
+            return std::nullopt;
+        }
+        processStylusHoverEvent(args, *pc);
+    } else if (isFromSource(args.source, AINPUT_SOURCE_TOUCHSCREEN)) {
+        if (args.displayId == ADISPLAY_ID_NONE) {
+            return args;
+        }
+        PointerControllerInterface* touchPc = nullptr;
+        if (routing.showTouchesEnabled) {
+            touchPc = Routing::find(routing.touchPointersByDevice, args.deviceId);
+            if (touchPc == nullptr) {
+                return std::nullopt;
+            }
+        }
+        fadeMouseOnTouch(args, Routing::find(routing.mousePointersByDisplay, args.displayId));
+        if (touchPc != nullptr) {
+            showTouchSpots(args, *touchPc);
+        }
+    }
+    return args;
+}
+
+NotifyMotionArgs PointerChoreographer::processMouseEventLocked(const NotifyMotionArgs& args) {
+    auto [displayId, pc] = getDisplayIdAndMouseControllerLocked(args.displayId);
+    return processMouseEvent(args, displayId, pc);
+}
+
+NotifyMotionArgs PointerChoreographer::processTouchpadEventLocked(const NotifyMotionArgs& args) {
+    auto [displayId, pc] = getDisplayIdAndMouseControllerLocked(args.displayId);
+    return processTouchpadEvent(args, displayId, pc);
+}
+
+/**
+ * For touch events, we do not need to populate the cursor position.
+ */
+void PointerChoreographer::processTouchscreenAndStylusEventLocked(const NotifyMotionArgs& args) {
+    if (args.displayId == ADISPLAY_ID_NONE) {
+        return;
+    }
+
+    if (const auto it = mMousePointersByDisplay.find(args.displayId);
+        it != mMousePointersByDisplay.end()) {
+        fadeMouseOnTouch(args, it->second.get());
+    }
+
+    if (!mShowTouchesEnabled) {
+        return;
+    }
+
+    // Get the touch pointer controller for the device, or create one if it doesn't exist.
+    auto [it, emplaced] =
+            mTouchPointersByDevice.try_emplace(args.deviceId, mTouchControllerConstructor);
+    if (emplaced) {
+        publishRoutingLocked();
+    }
+
+    showTouchSpots(args, *it->second);
+}
+
+void PointerChoreographer::processStylusHoverEventLocked(const NotifyMotionArgs& args) {
+    if (args.displayId == ADISPLAY_ID_NONE) {
+        return;
+    }
+
+    // Get the stylus pointer controller for the device, or create one if it doesn't exist.
+    auto [it, emplaced] =
+            mStylusPointersByDevice.try_emplace(args.deviceId,
+                                                getStylusControllerConstructor(args.displayId));
+    if (emplaced) {
+        publishRoutingLocked();
+    }
+
+    processStylusHoverEvent(args, *it->second);
+}
 
 void PointerChoreographer::notifySwitch(const NotifySwitchArgs& args) {
     mNextListener.notify(args);
@@ -247,8 +340,11 @@ void PointerChoreographer::notifyDeviceReset(const NotifyDeviceResetArgs& args)
 
 void PointerChoreographer::processDeviceReset(const NotifyDeviceResetArgs& args) {
     std::scoped_lock _l(mLock);
-    mTouchPointersByDevice.erase(args.deviceId);
-    mStylusPointersByDevice.erase(args.deviceId);
+    const size_t erasedCount = mTouchPointersByDevice.erase(args.deviceId) +
+            mStylusPointersByDevice.erase(args.deviceId);
+    if (erasedCount != 0) {
+        publishRoutingLocked();
+    }
 }
 
 void PointerChoreographer::notifyPointerCaptureChanged(
@@ -310,6 +406,7 @@ PointerChoreographer::getDisplayIdAndMouseControllerLocked(int32_t associatedDis
             mMousePointersByDisplay.try_emplace(displayId,
                                                 getMouseControllerConstructor(displayId));
     if (emplaced) {
+        publishRoutingLocked();
         notifyPointerDisplayIdChangedLocked();
     }
 
@@ -370,11 +467,53 @@ void PointerChoreographer::updatePointerControllersLocked() {
                             [id](const auto& info) { return info.getId() == id; }) ==
                 mInputDeviceInfos.end();
     });
+    publishRoutingLocked();
 
     // Notify the policy if there's a change on the pointer display ID.
     notifyPointerDisplayIdChangedLocked();
 }
 
+PointerControllerInterface* PointerChoreographer::Routing::find(const ControllerList& controllers,
+                                                                int32_t id) {
+    const auto it =
+            std::lower_bound(controllers.begin(), controllers.end(), id,
+                             [](const auto& pair, int32_t key) { return pair.first < key; });
+    return it != controllers.end() && it->first == id ? it->second.get() : nullptr;
+}
+
+void PointerChoreographer::publishRoutingLocked() {
+    // std::map iterates in key order, so the lists are sorted as they are copied.
+    std::unique_ptr<const Routing> replaced(mRouting.exchange(new Routing{
+            .mousePointersByDisplay = {mMousePointersByDisplay.begin(),
+                                       mMousePointersByDisplay.end()},
+            .touchPointersByDevice = {mTouchPointersByDevice.begin(), mTouchPointersByDevice.end()},
+            .stylusPointersByDevice = {mStylusPointersByDevice.begin(),
+                                       mStylusPointersByDevice.end()},
+            .defaultMouseDisplayId = mDefaultMouseDisplayId,
+            .showTouchesEnabled = mShowTouchesEnabled,
+            .stylusPointerIconEnabled = mStylusPointerIconEnabled,
+    }));
+    if (replaced) {
+        // Free the replaced Routing, and the controllers that only it still holds, once no
+        // reader can be using it.
+        waitForRoutingReadersLocked();
+    }
+}
+
+void PointerChoreographer::waitForRoutingReadersLocked() {
+    // A reader that loaded the epoch just before a flip may register in the old count after the
+    // wait for it has ended, but it then loads mRouting after the exchange and sees the new
+    // Routing. Flipping twice, and waiting for each count in turn, covers the readers of both
+    // counts that started before the exchange. Readers that start after a flip count towards the
+    // other epoch, so each wait is bounded even under a steady stream of motion events.
+    for (int i = 0; i < 2; i++) {
+        const uint32_t previousEpoch = mRoutingEpoch.fetch_add(1);
+        while (mRoutingReaderCounts[previousEpoch % 2].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
 void PointerChoreographer::notifyPointerDisplayIdChangedLocked() {
     int32_t displayIdToNotify = ADISPLAY_ID_NONE;
     FloatPoint cursorPosition = {0, 0};
@@ -21,7 +21,11 @@
 #include "PointerChoreographerPolicyInterface.h"
 
 #include <android-base/thread_annotations.h>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <type_traits>
+#include <vector>
 
 namespace android {
 
@@ -78,7 +82,7 @@ class PointerChoreographer : public PointerChoreographerInterface {
 public:
     explicit PointerChoreographer(InputListenerInterface& listener,
                                   PointerChoreographerPolicyInterface&);
-    ~PointerChoreographer() override = default;
+    ~PointerChoreographer() override;
 
     void setDefaultMouseDisplayId(int32_t displayId) override;
     void setDisplayViewports(const std::vector<DisplayViewport>& viewports) override;
@@ -103,6 +107,31 @@ public:
     void dump(std::string& dump) override;
 
 private:
+    using ControllerList =
+            std::vector<std::pair<int32_t, std::shared_ptr<PointerControllerInterface>>>;
+
+    /**
+     * An immutable copy of the state needed to route a motion event to its PointerController.
+     * A new Routing is published whenever the controllers or the settings that select them
+     * change, so that motion events whose controllers already exist are processed without
+     * taking mLock. The controller lists are sorted by display or device id.
+     */
+    struct Routing {
+        ControllerList mousePointersByDisplay;
+        ControllerList touchPointersByDevice;
+        ControllerList stylusPointersByDevice;
+        int32_t defaultMouseDisplayId;
+        bool showTouchesEnabled;
+        bool stylusPointerIconEnabled;
+
+        static PointerControllerInterface* find(const ControllerList& controllers, int32_t id);
+    };
+
+    static std::optional<NotifyMotionArgs> processMotionWithRouting(
+            const Routing& routing, const NotifyMotionArgs& args);
+    void publishRoutingLocked() REQUIRES(mLock);
+    void waitForRoutingReadersLocked() REQUIRES(mLock);
+
     void updatePointerControllersLocked() REQUIRES(mLock);
     void notifyPointerDisplayIdChangedLocked() REQUIRES(mLock);
     const DisplayViewport* findViewportByIdLocked(int32_t displayId) const REQUIRES(mLock);
@@ -143,6 +172,14 @@ private:
     std::vector<DisplayViewport> mViewports GUARDED_BY(mLock);
     bool mShowTouchesEnabled GUARDED_BY(mLock);
     bool mStylusPointerIconEnabled GUARDED_BY(mLock);
+
+    // The current Routing, replaced under mLock and read without it. Each reader is counted in
+    // the reader count of the epoch it started in. A publish waits for the readers that may still
+    // hold the replaced Routing to leave, and frees it before returning, so that the controllers
+    // it held are released as soon as PointerChoreographer removes them.
+    std::atomic<const Routing*> mRouting;
+    std::atomic<uint32_t> mRoutingEpoch;
+    std::array<std::atomic<int32_t>, 2> mRoutingReaderCounts;
 };
 
 } // namespace android
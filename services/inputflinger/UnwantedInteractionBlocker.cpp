@@ -17,6 +17,7 @@
 #define LOG_TAG "UnwantedInteractionBlocker"
 #include "UnwantedInteractionBlocker.h"
 
+#include <android-base/parseint.h>
 #include <android-base/stringprintf.h>
 #include <com_android_input_flags.h>
 #include <ftl/enum.h>
@@ -24,6 +25,7 @@
 #include <inttypes.h>
 #include <linux/input-event-codes.h>
 #include <linux/input.h>
+#include <pthread.h>
 #include <server_configurable_flags/get_flags.h>
 
 #include "ui/events/ozone/evdev/touch_filter/neural_stylus_palm_detection_filter.h"
@@ -84,6 +86,12 @@ static const char* INPUT_NATIVE_BOOT = "input_native_boot";
  * 'true' (not case sensitive) or '1'. To disable, specify any other value.
  */
 static const char* PALM_REJECTION_ENABLED = "palm_rejection_enabled";
+/**
+ * Feature flag name. If set to a non-negative number of milliseconds, the palm rejection model runs
+ * asynchronously, and is allowed to lag behind the touch stream by at most this amount of event
+ * time. If not set, or set to an invalid value, the palm rejection model runs synchronously.
+ */
+static const char* PALM_REJECTION_ASYNC_BUDGET_MS = "palm_rejection_async_budget_ms";
 
 static std::string toLower(std::string s) {
     std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
@@ -112,6 +120,34 @@ static bool isPalmRejectionEnabled() {
     return false;
 }
 
+/**
+ * Return the latency budget for asynchronous palm rejection, as specified by the server
+ * configurable flags. Return nullopt if palm rejection should run synchronously.
+ */
+static std::optional<std::chrono::nanoseconds> getAsyncPalmRejectionBudget() {
+    const std::string value =
+            server_configurable_flags::GetServerConfigurableFlag(INPUT_NATIVE_BOOT,
+                                                                 PALM_REJECTION_ASYNC_BUDGET_MS,
+                                                                 "");
+    int64_t budgetMs;
+    if (value.empty() || !android::base::ParseInt(value, &budgetMs, /*min=*/int64_t(0))) {
+        return std::nullopt;
+    }
+    return std::chrono::milliseconds(budgetMs);
+}
+
+/**
+ * Hover, button and scroll events are not sent to the palm rejection model.
+ */
+static bool isIgnoredByPalmRejection(const NotifyMotionArgs& args) {
+    return args.action == AMOTION_EVENT_ACTION_HOVER_ENTER ||
+            args.action == AMOTION_EVENT_ACTION_HOVER_MOVE ||
+            args.action == AMOTION_EVENT_ACTION_HOVER_EXIT ||
+            args.action == AMOTION_EVENT_ACTION_BUTTON_PRESS ||
+            args.action == AMOTION_EVENT_ACTION_BUTTON_RELEASE ||
+            args.action == AMOTION_EVENT_ACTION_SCROLL;
+}
+
 static int getLinuxToolCode(ToolType toolType) {
     switch (toolType) {
         case ToolType::STYLUS:
@@ -336,11 +372,28 @@ std::vector<NotifyMotionArgs> cancelSuppressedPointers(
 }
 
 UnwantedInteractionBlocker::UnwantedInteractionBlocker(InputListenerInterface& listener)
-      : UnwantedInteractionBlocker(listener, isPalmRejectionEnabled()){};
+      : UnwantedInteractionBlocker(listener, isPalmRejectionEnabled(),
+                                   getAsyncPalmRejectionBudget()){};
 
 UnwantedInteractionBlocker::UnwantedInteractionBlocker(InputListenerInterface& listener,
                                                        bool enablePalmRejection)
-      : mQueuedListener(listener), mEnablePalmRejection(enablePalmRejection) {}
+      : UnwantedInteractionBlocker(listener, enablePalmRejection,
+                                   /*asyncPalmRejectionBudget=*/std::nullopt) {}
+
+UnwantedInteractionBlocker::UnwantedInteractionBlocker(
+        InputListenerInterface& listener, bool enablePalmRejection,
+        std::optional<std::chrono::nanoseconds> asyncPalmRejectionBudget)
+      : mQueuedListener(listener),
+        mEnablePalmRejection(enablePalmRejection),
+        mAsyncPalmRejectionBudget(asyncPalmRejectionBudget) {}
+
+std::unique_ptr<PalmRejectorInterface> UnwantedInteractionBlocker::createPalmRejector(
+        const AndroidPalmFilterDeviceInfo& info) const {
+    if (mAsyncPalmRejectionBudget) {
+        return std::make_unique<AsyncPalmRejector>(info, *mAsyncPalmRejectionBudget);
+    }
+    return std::make_unique<PalmRejector>(info);
+}
 
 void UnwantedInteractionBlocker::notifyConfigurationChanged(
         const NotifyConfigurationChangedArgs& args) {
@@ -385,7 +438,7 @@ void UnwantedInteractionBlocker::notifyMotionLocked(const NotifyMotionArgs& args
         return;
     }
 
-    std::vector<NotifyMotionArgs> processedArgs = it->second.processMotion(args);
+    std::vector<NotifyMotionArgs> processedArgs = it->second->processMotion(args);
     for (const NotifyMotionArgs& loopArgs : processedArgs) {
         enqueueOutboundMotionLocked(loopArgs);
     }
@@ -410,10 +463,9 @@ void UnwantedInteractionBlocker::notifyDeviceReset(const NotifyDeviceResetArgs&
         std::scoped_lock lock(mLock);
         auto it = mPalmRejectors.find(args.deviceId);
         if (it != mPalmRejectors.end()) {
-            AndroidPalmFilterDeviceInfo info = it->second.getPalmFilterDeviceInfo();
+            AndroidPalmFilterDeviceInfo info = it->second->getPalmFilterDeviceInfo();
             // Re-create the object instead of resetting it
-            mPalmRejectors.erase(it);
-            mPalmRejectors.emplace(args.deviceId, info);
+            it->second = createPalmRejector(info);
         }
         mQueuedListener.notifyDeviceReset(args);
         mPreferStylusOverTouchBlocker.notifyDeviceReset(args);
@@ -452,11 +504,12 @@ void UnwantedInteractionBlocker::onInputDevicesChanged(
             continue;
         }
 
-        auto [it, emplaced] = mPalmRejectors.try_emplace(device.getId(), *info);
-        if (!emplaced && *info != it->second.getPalmFilterDeviceInfo()) {
+        auto it = mPalmRejectors.find(device.getId());
+        if (it == mPalmRejectors.end()) {
+            mPalmRejectors.emplace(device.getId(), createPalmRejector(*info));
+        } else if (*info != it->second->getPalmFilterDeviceInfo()) {
             // Re-create the PalmRejector because the device info has changed.
-            mPalmRejectors.erase(it);
-            mPalmRejectors.emplace(device.getId(), *info);
+            it->second = createPalmRejector(*info);
         }
         devicesToKeep.insert(device.getId());
     }
@@ -477,10 +530,14 @@ void UnwantedInteractionBlocker::dump(std::string& dump) {
                          std::to_string(mEnablePalmRejection).c_str());
     dump += StringPrintf("  isPalmRejectionEnabled (flag value): %s\n",
                          std::to_string(isPalmRejectionEnabled()).c_str());
+    dump += "  mAsyncPalmRejectionBudget: " +
+            (mAsyncPalmRejectionBudget ? std::to_string(mAsyncPalmRejectionBudget->count()) + "ns"
+                                       : "<synchronous>") +
+            "\n";
     dump += mPalmRejectors.empty() ? "  mPalmRejectors: None\n" : "  mPalmRejectors:\n";
     for (const auto& [deviceId, palmRejector] : mPalmRejectors) {
         dump += StringPrintf("    deviceId = %" PRId32 ":\n", deviceId);
-        dump += addLinePrefix(palmRejector.dump(), "      ");
+        dump += addLinePrefix(palmRejector->dump(), "      ");
     }
 }
 
@@ -692,35 +749,32 @@ std::set<int32_t> PalmRejector::detectPalmPointers(const NotifyMotionArgs& args)
     return newSuppressedIds;
 }
 
-std::vector<NotifyMotionArgs> PalmRejector::processMotion(const NotifyMotionArgs& args) {
-    if (mPalmDetectionFilter == nullptr) {
-        return {args};
-    }
-    const bool skipThisEvent = args.action == AMOTION_EVENT_ACTION_HOVER_ENTER ||
-            args.action == AMOTION_EVENT_ACTION_HOVER_MOVE ||
-            args.action == AMOTION_EVENT_ACTION_HOVER_EXIT ||
-            args.action == AMOTION_EVENT_ACTION_BUTTON_PRESS ||
-            args.action == AMOTION_EVENT_ACTION_BUTTON_RELEASE ||
-            args.action == AMOTION_EVENT_ACTION_SCROLL;
-    if (skipThisEvent) {
-        // Lets not process hover events, button events, or scroll for now.
-        return {args};
-    }
+std::set<int32_t> PalmRejector::updateSuppressedPointerIds(const NotifyMotionArgs& args) {
     if (args.action == AMOTION_EVENT_ACTION_DOWN) {
         mSuppressedPointerIds.clear();
     }
 
-    std::set<int32_t> oldSuppressedIds;
-    std::swap(oldSuppressedIds, mSuppressedPointerIds);
-
     std::optional<NotifyMotionArgs> touchOnlyArgs = removeStylusPointerIds(args);
     if (touchOnlyArgs) {
         mSuppressedPointerIds = detectPalmPointers(*touchOnlyArgs);
-    } else {
-        // This is a stylus-only event.
-        // We can skip this event and just keep the suppressed pointer ids the same as before.
-        mSuppressedPointerIds = oldSuppressedIds;
     }
+    // Otherwise, this is a stylus-only event.
+    // We can skip this event and just keep the suppressed pointer ids the same as before.
+    return mSuppressedPointerIds;
+}
+
+std::vector<NotifyMotionArgs> PalmRejector::processMotion(const NotifyMotionArgs& args) {
+    if (mPalmDetectionFilter == nullptr) {
+        return {args};
+    }
+    if (isIgnoredByPalmRejection(args)) {
+        // Lets not process hover events, button events, or scroll for now.
+        return {args};
+    }
+    const std::set<int32_t> oldSuppressedIds = args.action == AMOTION_EVENT_ACTION_DOWN
+            ? std::set<int32_t>{}
+            : mSuppressedPointerIds;
+    updateSuppressedPointerIds(args);
 
     std::vector<NotifyMotionArgs> argsWithoutUnwantedPointers =
             cancelSuppressedPointers(args, oldSuppressedIds, mSuppressedPointerIds);
@@ -765,4 +819,145 @@ std::string PalmRejector::dump() const {
     return out;
 }
 
+// --- AsyncPalmRejector ---
+
+AsyncPalmRejector::AsyncPalmRejector(const AndroidPalmFilterDeviceInfo& info,
+                                     std::chrono::nanoseconds latencyBudget,
+                                     std::unique_ptr<::ui::PalmDetectionFilter> filter)
+      : mDeviceInfo(info),
+        mLatencyBudget(latencyBudget),
+        mPalmRejector(info, std::move(filter)),
+        mThread(&AsyncPalmRejector::processRequests, this) {
+    // Set the thread name for debugging
+    pthread_setname_np(mThread.native_handle(), "PalmRejector");
+}
+
+AsyncPalmRejector::~AsyncPalmRejector() {
+    mRequests.push({.sequenceNum = ++mLastSequenceNum, .args = std::nullopt});
+    mThread.join();
+}
+
+void AsyncPalmRejector::processRequests() {
+    while (true) {
+        Request request = mRequests.pop();
+        if (!request.args) {
+            return;
+        }
+        std::set<int32_t> suppressedPointerIds;
+        { // acquire model lock
+            std::scoped_lock lock(mModelLock);
+            suppressedPointerIds = mPalmRejector.updateSuppressedPointerIds(*request.args);
+        } // release model lock
+        { // acquire lock
+            std::scoped_lock lock(mLock);
+            for (int32_t pointerId : suppressedPointerIds) {
+                mPendingSuppressions[pointerId] = request.sequenceNum;
+            }
+            mLastProcessedSequenceNum = request.sequenceNum;
+        } // release lock
+        mRequestProcessed.notify_all();
+    }
+}
+
+void AsyncPalmRejector::waitForSequenceNum(uint64_t sequenceNum) {
+    std::unique_lock lock(mLock);
+    android::base::ScopedLockAssertion assumeLock(mLock);
+    mRequestProcessed.wait(lock, [this, sequenceNum]() REQUIRES(mLock) {
+        return mLastProcessedSequenceNum >= sequenceNum;
+    });
+}
+
+std::vector<NotifyMotionArgs> AsyncPalmRejector::processMotion(const NotifyMotionArgs& args) {
+    if (isIgnoredByPalmRejection(args)) {
+        return {args};
+    }
+    const uint64_t sequenceNum = ++mLastSequenceNum;
+    if (args.action == AMOTION_EVENT_ACTION_DOWN) {
+        mSuppressedPointerIds.clear();
+        mPointerDownSequenceNums.clear();
+    }
+    for (size_t i = 0; i < args.getPointerCount(); i++) {
+        const int32_t action = resolveActionForPointer(i, args.action);
+        if (action == AMOTION_EVENT_ACTION_DOWN || action == AMOTION_EVENT_ACTION_POINTER_DOWN) {
+            mPointerDownSequenceNums[args.pointerProperties[i].id] = sequenceNum;
+        }
+    }
+    mRequests.push({.sequenceNum = sequenceNum, .args = args});
+    mInFlightEvents.emplace_back(sequenceNum, args.eventTime);
+
+    // Enforce the latency budget: all of the events that are older than the budget must have been
+    // processed by the model before this event can be sent.
+    const nsecs_t oldestAllowedEventTime = args.eventTime - mLatencyBudget.count();
+    std::optional<uint64_t> requiredSequenceNum;
+    for (const auto& [inFlightSequenceNum, eventTime] : mInFlightEvents) {
+        if (eventTime > oldestAllowedEventTime) {
+            break;
+        }
+        requiredSequenceNum = inFlightSequenceNum;
+    }
+    if (requiredSequenceNum) {
+        waitForSequenceNum(*requiredSequenceNum);
+    }
+
+    std::set<int32_t> newSuppressedPointerIds = mSuppressedPointerIds;
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        while (!mInFlightEvents.empty() &&
+               mInFlightEvents.front().first <= mLastProcessedSequenceNum) {
+            mInFlightEvents.pop_front();
+        }
+        for (const auto& [pointerId, suppressedSequenceNum] : mPendingSuppressions) {
+            // Only apply the decision if it was made about the pointer that is currently down
+            // with this id, and not about an earlier pointer that has already lifted.
+            auto it = mPointerDownSequenceNums.find(pointerId);
+            if (it != mPointerDownSequenceNums.end() && it->second <= suppressedSequenceNum) {
+                newSuppressedPointerIds.insert(pointerId);
+            }
+        }
+        mPendingSuppressions.clear();
+    } // release lock
+
+    std::vector<NotifyMotionArgs> argsWithoutUnwantedPointers =
+            cancelSuppressedPointers(args, mSuppressedPointerIds, newSuppressedPointerIds);
+    if (!std::includes(mSuppressedPointerIds.begin(), mSuppressedPointerIds.end(),
+                       newSuppressedPointerIds.begin(), newSuppressedPointerIds.end())) {
+        ALOGI("Palm detected, removing pointer ids %s after %" PRId64 "ms from %s",
+              dumpSet(newSuppressedPointerIds).c_str(), ns2ms(args.eventTime - args.downTime),
+              args.dump().c_str());
+    }
+    mSuppressedPointerIds = std::move(newSuppressedPointerIds);
+
+    // The pointers that are lifted by this event no longer exist. Their ids may get reused by new
+    // pointers, which should not inherit the suppression.
+    for (size_t i = 0; i < args.getPointerCount(); i++) {
+        const int32_t action = resolveActionForPointer(i, args.action);
+        if (action == AMOTION_EVENT_ACTION_UP || action == AMOTION_EVENT_ACTION_POINTER_UP ||
+            action == AMOTION_EVENT_ACTION_CANCEL) {
+            mPointerDownSequenceNums.erase(args.pointerProperties[i].id);
+            mSuppressedPointerIds.erase(args.pointerProperties[i].id);
+        }
+    }
+    return argsWithoutUnwantedPointers;
+}
+
+const AndroidPalmFilterDeviceInfo& AsyncPalmRejector::getPalmFilterDeviceInfo() const {
+    return mDeviceInfo;
+}
+
+std::string AsyncPalmRejector::dump() const {
+    std::string out;
+    out += StringPrintf("mLatencyBudget: %" PRId64 "ms\n", ns2ms(mLatencyBudget.count()));
+    out += StringPrintf("mInFlightEvents: %zu\n", mInFlightEvents.size());
+    out += "mSuppressedPointerIds: " + dumpSet(mSuppressedPointerIds) + "\n";
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        out += StringPrintf("mLastProcessedSequenceNum: %" PRIu64 " (last sent: %" PRIu64 ")\n",
+                            mLastProcessedSequenceNum, mLastSequenceNum);
+    } // release lock
+    std::scoped_lock lock(mModelLock);
+    out += "mPalmRejector:\n";
+    out += addLinePrefix(mPalmRejector.dump(), "  ");
+    return out;
+}
+
 } // namespace android
@@ -16,14 +16,19 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <set>
+#include <thread>
 
 #include <android-base/thread_annotations.h>
 #include "include/UnwantedInteractionBlockerInterface.h"
 #include "ui/events/ozone/evdev/touch_filter/neural_stylus_palm_detection_filter_util.h"
 #include "ui/events/ozone/evdev/touch_filter/palm_detection_filter.h"
 
+#include "BlockingQueue.h"
 #include "PreferStylusOverTouchBlocker.h"
 
 namespace android {
@@ -73,7 +78,22 @@ std::string toString(const ::ui::InProgressTouchEvdev& touch);
 
 // --- Main classes and interfaces ---
 
-class PalmRejector;
+/**
+ * Removes unwanted (palm) pointers from the touch stream of a single device.
+ */
+class PalmRejectorInterface {
+public:
+    virtual ~PalmRejectorInterface() {}
+    /**
+     * Process the provided motion and return the events that should be sent to the next stage.
+     * Pointers that are detected as palms are canceled, and are removed from all future events.
+     */
+    virtual std::vector<NotifyMotionArgs> processMotion(const NotifyMotionArgs& args) = 0;
+
+    // Get the device info of this device, for comparison purposes
+    virtual const AndroidPalmFilterDeviceInfo& getPalmFilterDeviceInfo() const = 0;
+    virtual std::string dump() const = 0;
+};
 
 // --- Implementations ---
 
@@ -89,6 +109,14 @@ class UnwantedInteractionBlocker : public UnwantedInteractionBlockerInterface {
 public:
     explicit UnwantedInteractionBlocker(InputListenerInterface& listener);
     explicit UnwantedInteractionBlocker(InputListenerInterface& listener, bool enablePalmRejection);
+    /**
+     * If 'asyncPalmRejectionBudget' is set, the palm rejection model runs on a separate thread
+     * for every device, and motion events are forwarded before the model has processed them.
+     * See AsyncPalmRejector.
+     */
+    explicit UnwantedInteractionBlocker(
+            InputListenerInterface& listener, bool enablePalmRejection,
+            std::optional<std::chrono::nanoseconds> asyncPalmRejectionBudget);
 
     void notifyInputDevicesChanged(const NotifyInputDevicesChangedArgs& args) override;
     void notifyConfigurationChanged(const NotifyConfigurationChangedArgs& args) override;
@@ -111,13 +139,17 @@ private:
 
     QueuedInputListener mQueuedListener;
     const bool mEnablePalmRejection;
+    const std::optional<std::chrono::nanoseconds> mAsyncPalmRejectionBudget;
 
     // When stylus is down, ignore touch
     PreferStylusOverTouchBlocker mPreferStylusOverTouchBlocker GUARDED_BY(mLock);
 
     // Detect and reject unwanted palms on screen
     // Use a separate palm rejector for every touch device.
-    std::map<int32_t /*deviceId*/, PalmRejector> mPalmRejectors GUARDED_BY(mLock);
+    std::map<int32_t /*deviceId*/, std::unique_ptr<PalmRejectorInterface>> mPalmRejectors
+            GUARDED_BY(mLock);
+    std::unique_ptr<PalmRejectorInterface> createPalmRejector(
+            const AndroidPalmFilterDeviceInfo& info) const;
     // TODO(b/210159205): delete this when simultaneous stylus and touch is supported
     void notifyMotionLocked(const NotifyMotionArgs& args) REQUIRES(mLock);
 
@@ -161,15 +193,21 @@ std::vector<::ui::InProgressTouchEvdev> getTouches(const NotifyMotionArgs& args,
                                                    const SlotState& oldSlotState,
                                                    const SlotState& newSlotState);
 
-class PalmRejector {
+class PalmRejector : public PalmRejectorInterface {
 public:
     explicit PalmRejector(const AndroidPalmFilterDeviceInfo& info,
                           std::unique_ptr<::ui::PalmDetectionFilter> filter = nullptr);
-    std::vector<NotifyMotionArgs> processMotion(const NotifyMotionArgs& args);
+    std::vector<NotifyMotionArgs> processMotion(const NotifyMotionArgs& args) override;
 
-    // Get the device info of this device, for comparison purposes
-    const AndroidPalmFilterDeviceInfo& getPalmFilterDeviceInfo() const;
-    std::string dump() const;
+    /**
+     * Send this event to the palm rejection model, without modifying the event stream.
+     * Return the ids of all pointers that are suppressed after this event. This is the same set
+     * of pointers that processMotion would have removed from this event.
+     */
+    std::set<int32_t> updateSuppressedPointerIds(const NotifyMotionArgs& args);
+
+    const AndroidPalmFilterDeviceInfo& getPalmFilterDeviceInfo() const override;
+    std::string dump() const override;
 
 private:
     PalmRejector(const PalmRejector&) = delete;
@@ -192,4 +230,72 @@ private:
     SlotState mSlotState;
 };
 
+/**
+ * Runs the palm rejection model of a PalmRejector on a dedicated thread, so that the model
+ * inference is not on the path from the InputReader to the dispatcher.
+ *
+ * Every event is forwarded right away, with only the palm decisions that are already known applied
+ * to it. The model result for each event is published back by the palm rejection thread, and
+ * the newly suppressed pointers get canceled on the next event of the same gesture.
+ *
+ * The decisions are allowed to lag behind the event stream by at most 'latencyBudget' of event
+ * time. If the model falls further behind, processMotion blocks until the model has caught up, so a
+ * palm is never sent to the next stage for longer than the budget. A budget of 0 produces the same
+ * output as the synchronous PalmRejector.
+ */
+class AsyncPalmRejector : public PalmRejectorInterface {
+public:
+    explicit AsyncPalmRejector(const AndroidPalmFilterDeviceInfo& info,
+                               std::chrono::nanoseconds latencyBudget,
+                               std::unique_ptr<::ui::PalmDetectionFilter> filter = nullptr);
+    ~AsyncPalmRejector() override;
+    std::vector<NotifyMotionArgs> processMotion(const NotifyMotionArgs& args) override;
+    const AndroidPalmFilterDeviceInfo& getPalmFilterDeviceInfo() const override;
+    std::string dump() const override;
+
+private:
+    AsyncPalmRejector(const AsyncPalmRejector&) = delete;
+    AsyncPalmRejector& operator=(const AsyncPalmRejector&) = delete;
+
+    struct Request {
+        uint64_t sequenceNum;
+        // An empty request asks the palm rejection thread to exit.
+        std::optional<NotifyMotionArgs> args;
+    };
+
+    // Runs on mThread. Feeds the requests to the model and publishes the results.
+    void processRequests();
+    // Block until the model has processed all requests up to and including 'sequenceNum'
+    void waitForSequenceNum(uint64_t sequenceNum);
+
+    const AndroidPalmFilterDeviceInfo mDeviceInfo;
+    const std::chrono::nanoseconds mLatencyBudget;
+
+    // Only accessed by the palm rejection thread, except for dump.
+    mutable std::mutex mModelLock;
+    PalmRejector mPalmRejector GUARDED_BY(mModelLock);
+
+    // Results published by the palm rejection thread.
+    mutable std::mutex mLock;
+    std::condition_variable mRequestProcessed;
+    uint64_t mLastProcessedSequenceNum GUARDED_BY(mLock) = 0;
+    // Pointers that the model has suppressed but that have not been applied to the event stream
+    // yet, along with the sequence number of the most recent event in which they were suppressed.
+    std::map<int32_t /*pointerId*/, uint64_t /*sequenceNum*/> mPendingSuppressions
+            GUARDED_BY(mLock);
+
+    // State of the outbound event stream. Only accessed by the caller of processMotion.
+    uint64_t mLastSequenceNum = 0;
+    // Events that have been forwarded, but may not have been processed by the model yet
+    std::deque<std::pair<uint64_t /*sequenceNum*/, nsecs_t /*eventTime*/>> mInFlightEvents;
+    // Sequence number of the event in which each of the current pointers went down. Used to reject
+    // the stale decisions about previous pointers that had the same id.
+    std::map<int32_t /*pointerId*/, uint64_t /*sequenceNum*/> mPointerDownSequenceNums;
+    // The pointers that have already been canceled in the outbound event stream
+    std::set<int32_t> mSuppressedPointerIds;
+
+    BlockingQueue<Request> mRequests;
+    std::thread mThread;
+};
+
 } // namespace android
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <utils/Timers.h>
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "../BlockingQueue.h"
+
+namespace android {
+
+namespace {
+
+// Same as the capacity of the queue of events for the motion classifier.
+constexpr size_t CLASSIFIER_QUEUE_CAPACITY = 5;
+// Tells the consumer to stop.
+constexpr nsecs_t EXIT = -1;
+
+/**
+ * The queue BlockingQueue replaced, a list behind a mutex and a condition variable, to compare
+ * against.
+ */
+template <class T>
+class MutexBlockingQueue {
+public:
+    explicit MutexBlockingQueue(size_t capacity) : mCapacity(capacity) {}
+
+    T pop() {
+        std::unique_lock lock(mLock);
+        mHasElements.wait(lock, [this]() { return !mQueue.empty(); });
+        T t = std::move(mQueue.front());
+        mQueue.erase(mQueue.begin());
+        return t;
+    }
+
+    bool push(T&& t) {
+        {
+            std::scoped_lock lock(mLock);
+            if (mQueue.size() == mCapacity) {
+                return false;
+            }
+            mQueue.push_back(std::move(t));
+        }
+        mHasElements.notify_one();
+        return true;
+    }
+
+private:
+    const size_t mCapacity;
+    std::condition_variable mHasElements;
+    std::mutex mLock;
+    std::list<T> mQueue;
+};
+
+/**
+ * Hand timestamps over to a consumer thread, as the reader thread hands motion events over to the
+ * classifier thread. Reports how long the elements wait before they are retrieved.
+ */
+template <class Queue>
+static void benchmarkHandoff(benchmark::State& state) {
+    Queue queue(static_cast<size_t>(state.range(0)));
+
+    nsecs_t totalLatency = 0;
+    int64_t count = 0;
+    std::thread consumer([&]() {
+        for (nsecs_t pushTime = queue.pop(); pushTime != EXIT; pushTime = queue.pop()) {
+            totalLatency += systemTime(SYSTEM_TIME_MONOTONIC) - pushTime;
+            count++;
+        }
+    });
+
+    for (auto _ : state) {
+        while (!queue.push(systemTime(SYSTEM_TIME_MONOTONIC))) {
+            std::this_thread::yield();
+        }
+    }
+    while (!queue.push(nsecs_t(EXIT))) {
+        std::this_thread::yield();
+    }
+    consumer.join();
+
+    state.counters["latency_ns"] =
+            benchmark::Counter(count > 0 ? static_cast<double>(totalLatency) / count : 0);
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Send an element to another thread and wait for it to come back, so that every retrieval finds
+ * the queue empty and has to wait for the element.
+ */
+static void benchmarkRoundTrip(benchmark::State& state) {
+    BlockingQueue<nsecs_t> requests(CLASSIFIER_QUEUE_CAPACITY);
+    BlockingQueue<nsecs_t> responses(CLASSIFIER_QUEUE_CAPACITY);
+
+    std::thread echo([&]() {
+        for (nsecs_t time = requests.pop(); time != EXIT; time = requests.pop()) {
+            responses.push(nsecs_t(time));
+        }
+    });
+
+    for (auto _ : state) {
+        requests.push(systemTime(SYSTEM_TIME_MONOTONIC));
+        benchmark::DoNotOptimize(responses.pop());
+    }
+    requests.push(nsecs_t(EXIT));
+    echo.join();
+}
+
+/**
+ * Several producers add elements that one consumer retrieves, as the benchmark thread.
+ */
+template <class Queue>
+static void benchmarkManyProducers(benchmark::State& state) {
+    Queue queue(CLASSIFIER_QUEUE_CAPACITY);
+
+    std::atomic<bool> done = false;
+    std::vector<std::thread> producers;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        producers.emplace_back([&]() {
+            while (!done.load(std::memory_order_relaxed)) {
+                queue.push(systemTime(SYSTEM_TIME_MONOTONIC));
+            }
+        });
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(queue.pop());
+    }
+
+    done = true;
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(benchmarkHandoff, BlockingQueue<nsecs_t>)
+        ->Arg(CLASSIFIER_QUEUE_CAPACITY)
+        ->Arg(1024)
+        ->UseRealTime();
+BENCHMARK_TEMPLATE(benchmarkHandoff, MutexBlockingQueue<nsecs_t>)
+        ->Arg(CLASSIFIER_QUEUE_CAPACITY)
+        ->Arg(1024)
+        ->UseRealTime();
+BENCHMARK(benchmarkRoundTrip)->UseRealTime();
+BENCHMARK_TEMPLATE(benchmarkManyProducers, BlockingQueue<nsecs_t>)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(benchmarkManyProducers, MutexBlockingQueue<nsecs_t>)
+        ->Arg(1)
+        ->Arg(4)
+        ->UseRealTime();
+
+} // namespace android
@@ -19,10 +19,12 @@
 #include <android/os/IInputConstants.h>
 #include <binder/Binder.h>
 #include <gui/constants.h>
+#include "../dispatcher/AnrTracker.h"
 #include "../dispatcher/InputDispatcher.h"
 #include "../tests/FakeApplicationHandle.h"
 #include "../tests/FakeInputDispatcherPolicy.h"
 #include "../tests/FakeWindowHandle.h"
+#include "NotifyArgsBuilders.h"
 
 using android::base::Result;
 using android::gui::WindowInfo;
@@ -196,11 +198,491 @@ static void benchmarkOnWindowInfosChanged(benchmark::State& state) {
     dispatcher.stop();
 }
 
+// Events dispatched to each connection before the first one is finished.
+constexpr size_t ANR_TRACKER_EVENTS_IN_FLIGHT = 4;
+
+/**
+ * Track the timeouts of state.range(0) connections the way the dispatcher does while a stream of
+ * events goes to all of them: every dispatched event is inserted, every finished event is erased,
+ * and the next timeout is looked up after each. Now and then a connection goes away.
+ */
+static void benchmarkAnrTracker(benchmark::State& state) {
+    const size_t connectionCount = static_cast<size_t>(state.range(0));
+    std::vector<sp<IBinder>> tokens;
+    for (size_t i = 0; i < connectionCount; i++) {
+        tokens.push_back(sp<BBinder>::make());
+    }
+
+    AnrTracker tracker;
+    nsecs_t eventTime = 0;
+    const nsecs_t timeout = DISPATCHING_TIMEOUT.count();
+    for (size_t i = 0; i < ANR_TRACKER_EVENTS_IN_FLIGHT; i++, eventTime++) {
+        for (const sp<IBinder>& token : tokens) {
+            tracker.insert(eventTime + timeout, token);
+        }
+    }
+
+    size_t removedConnection = 0;
+    for (auto _ : state) {
+        for (const sp<IBinder>& token : tokens) {
+            tracker.insert(eventTime + timeout, token);
+            tracker.erase(eventTime - ANR_TRACKER_EVENTS_IN_FLIGHT + timeout, token);
+            benchmark::DoNotOptimize(tracker.firstTimeout());
+        }
+        eventTime++;
+
+        // Replace a connection, along with its pending events.
+        sp<IBinder>& token = tokens[removedConnection++ % connectionCount];
+        tracker.eraseToken(token);
+        token = sp<BBinder>::make();
+        for (size_t i = 0; i < ANR_TRACKER_EVENTS_IN_FLIGHT; i++) {
+            tracker.insert(eventTime - ANR_TRACKER_EVENTS_IN_FLIGHT + i + timeout, token);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * connectionCount);
+}
+
+// Windows are tiled in rows of this many squares of TILE_SIZE, so that they do not overlap.
+constexpr size_t TILE_COLUMNS = 8;
+constexpr int32_t TILE_SIZE = 100;
+
+static Rect getTileFrame(size_t tile) {
+    const int32_t left = static_cast<int32_t>(tile % TILE_COLUMNS) * TILE_SIZE;
+    const int32_t top = static_cast<int32_t>(tile / TILE_COLUMNS) * TILE_SIZE;
+    return Rect(left, top, left + TILE_SIZE, top + TILE_SIZE);
+}
+
+/**
+ * A pointer in the middle of the given tile.
+ */
+static PointerBuilder pointerInTile(int32_t pointerId, size_t tile) {
+    const Rect frame = getTileFrame(tile);
+    return PointerBuilder(pointerId, ToolType::FINGER)
+            .x(frame.left + TILE_SIZE / 2)
+            .y(frame.top + TILE_SIZE / 2);
+}
+
+/**
+ * Create windowCount windows on the given display, one in each tile.
+ */
+static std::vector<sp<FakeWindowHandle>> createTiledWindows(
+        InputDispatcher& dispatcher, const std::shared_ptr<FakeApplicationHandle>& application,
+        size_t windowCount, int32_t displayId) {
+    std::vector<sp<FakeWindowHandle>> windows;
+    for (size_t i = 0; i < windowCount; i++) {
+        sp<FakeWindowHandle> window =
+                sp<FakeWindowHandle>::make(application, dispatcher,
+                                           "Window " + std::to_string(displayId) + "/" +
+                                                   std::to_string(i),
+                                           displayId);
+        window->setFrame(getTileFrame(i));
+        windows.push_back(std::move(window));
+    }
+    return windows;
+}
+
+/**
+ * Report the given windows, topmost first, and the displays they are on to the dispatcher.
+ */
+static void setWindows(InputDispatcher& dispatcher,
+                       const std::vector<sp<FakeWindowHandle>>& windows,
+                       const std::vector<int32_t>& displayIds) {
+    std::vector<gui::WindowInfo> windowInfos;
+    for (const sp<FakeWindowHandle>& window : windows) {
+        windowInfos.push_back(*window->getInfo());
+    }
+    std::vector<gui::DisplayInfo> displayInfos;
+    for (int32_t displayId : displayIds) {
+        gui::DisplayInfo info;
+        info.displayId = displayId;
+        info.logicalWidth = static_cast<int32_t>(TILE_COLUMNS) * TILE_SIZE;
+        info.logicalHeight = info.logicalWidth * 2;
+        displayInfos.push_back(info);
+    }
+    dispatcher.onWindowInfosChanged({windowInfos, displayInfos, /*vsyncId=*/0, /*timestamp=*/0});
+}
+
+/**
+ * Generate a touch gesture on the given display with the given pointers: they go down one after
+ * the other, move together once, and go up in the reverse order.
+ */
+static std::vector<NotifyMotionArgs> generateGesture(const std::vector<PointerBuilder>& pointers,
+                                                     int32_t displayId) {
+    std::vector<NotifyMotionArgs> gesture;
+    const auto generate = [&](int32_t action, size_t pointerCount) {
+        MotionArgsBuilder builder(action, AINPUT_SOURCE_TOUCHSCREEN);
+        builder.deviceId(DEVICE_ID).displayId(displayId);
+        for (size_t i = 0; i < pointerCount; i++) {
+            builder.pointer(pointers[i]);
+        }
+        gesture.push_back(builder.build());
+    };
+    const auto pointerAction = [](int32_t action, size_t index) {
+        return action | static_cast<int32_t>(index << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+    };
+
+    generate(AMOTION_EVENT_ACTION_DOWN, 1);
+    for (size_t i = 1; i < pointers.size(); i++) {
+        generate(pointerAction(AMOTION_EVENT_ACTION_POINTER_DOWN, i), i + 1);
+    }
+    generate(AMOTION_EVENT_ACTION_MOVE, pointers.size());
+    for (size_t i = pointers.size() - 1; i > 0; i--) {
+        generate(pointerAction(AMOTION_EVENT_ACTION_POINTER_UP, i), i + 1);
+    }
+    generate(AMOTION_EVENT_ACTION_UP, 1);
+    return gesture;
+}
+
+/**
+ * Send the gesture to the dispatcher as if it was happening now.
+ */
+static void notifyGesture(InputDispatcher& dispatcher, std::vector<NotifyMotionArgs>& gesture) {
+    const nsecs_t downTime = now();
+    for (NotifyMotionArgs& args : gesture) {
+        args.id = InputEvent::nextId();
+        args.downTime = downTime;
+        args.eventTime = now();
+        dispatcher.notifyMotion(args);
+    }
+}
+
+static std::unique_ptr<FakeInputReceiver> createMonitor(InputDispatcher& dispatcher,
+                                                        int32_t displayId, size_t index) {
+    const std::string name = "Monitor " + std::to_string(index);
+    Result<std::unique_ptr<InputChannel>> channel =
+            dispatcher.createInputMonitor(displayId, name, WINDOW_PID);
+    return std::make_unique<FakeInputReceiver>(std::move(*channel), name);
+}
+
+static void consumeMotions(FakeInputReceiver& monitor, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        std::unique_ptr<InputEvent> event = monitor.consumeEvent(100ms);
+        if (event == nullptr || event->getType() != InputEventType::MOTION) {
+            LOG(FATAL) << "Monitor expected a MotionEvent";
+        }
+    }
+}
+
+/**
+ * Send gestures with state.range(1) pointers over state.range(0) windows. Pointer i lands in the
+ * window that is the i-th from the bottom, so every pointer goes to its own window if there are
+ * enough of them, and the touch is split between them.
+ */
+static void benchmarkSplitMotion(benchmark::State& state) {
+    const size_t windowCount = static_cast<size_t>(state.range(0));
+    const size_t pointerCount = static_cast<size_t>(state.range(1));
+
+    FakeInputDispatcherPolicy fakePolicy;
+    InputDispatcher dispatcher(fakePolicy);
+    dispatcher.setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher.start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    const std::vector<sp<FakeWindowHandle>> windows =
+            createTiledWindows(dispatcher, application, windowCount, DISPLAY_ID);
+    setWindows(dispatcher, windows, {DISPLAY_ID});
+
+    // A window with k pointers gets the DOWN, k - 1 POINTER_DOWN, the MOVE, k - 1 POINTER_UP and
+    // the UP of its split of the gesture.
+    std::vector<PointerBuilder> pointers;
+    std::vector<size_t> eventCountByWindow(windowCount, 0);
+    for (size_t i = 0; i < pointerCount; i++) {
+        const size_t tile = windowCount - 1 - i % windowCount;
+        pointers.push_back(pointerInTile(static_cast<int32_t>(i), tile));
+        eventCountByWindow[tile] += eventCountByWindow[tile] == 0 ? 3 : 2;
+    }
+    std::vector<NotifyMotionArgs> gesture = generateGesture(pointers, DISPLAY_ID);
+
+    for (auto _ : state) {
+        notifyGesture(dispatcher, gesture);
+        for (size_t i = 0; i < windowCount; i++) {
+            for (size_t j = 0; j < eventCountByWindow[i]; j++) {
+                windows[i]->consumeMotion();
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * gesture.size());
+
+    dispatcher.stop();
+}
+
+/**
+ * Send one finger taps to a window, under state.range(0) spy windows and watched by
+ * state.range(1) global monitors, which all get every event.
+ */
+static void benchmarkMotionFanOut(benchmark::State& state) {
+    const size_t spyCount = static_cast<size_t>(state.range(0));
+    const size_t monitorCount = static_cast<size_t>(state.range(1));
+
+    FakeInputDispatcherPolicy fakePolicy;
+    InputDispatcher dispatcher(fakePolicy);
+    dispatcher.setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher.start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<FakeWindowHandle>> windows;
+    for (size_t i = 0; i < spyCount; i++) {
+        sp<FakeWindowHandle> spy =
+                sp<FakeWindowHandle>::make(application, dispatcher,
+                                           "Spy " + std::to_string(i), DISPLAY_ID);
+        spy->setSpy(true);
+        spy->setTrustedOverlay(true);
+        windows.push_back(std::move(spy));
+    }
+    windows.push_back(
+            sp<FakeWindowHandle>::make(application, dispatcher, "Fake Window", DISPLAY_ID));
+    setWindows(dispatcher, windows, {DISPLAY_ID});
+
+    std::vector<std::unique_ptr<FakeInputReceiver>> monitors;
+    for (size_t i = 0; i < monitorCount; i++) {
+        monitors.push_back(createMonitor(dispatcher, DISPLAY_ID, i));
+    }
+
+    std::vector<NotifyMotionArgs> gesture = generateGesture({pointerInTile(0, 0)}, DISPLAY_ID);
+
+    for (auto _ : state) {
+        notifyGesture(dispatcher, gesture);
+        for (const sp<FakeWindowHandle>& window : windows) {
+            for (size_t i = 0; i < gesture.size(); i++) {
+                window->consumeMotion();
+            }
+        }
+        for (const std::unique_ptr<FakeInputReceiver>& monitor : monitors) {
+            consumeMotions(*monitor, gesture.size());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * gesture.size());
+
+    dispatcher.stop();
+}
+
+/**
+ * Tap the bottom window of state.range(1) windows on each of state.range(0) displays in turn.
+ */
+static void benchmarkMultiDisplayMotion(benchmark::State& state) {
+    const size_t displayCount = static_cast<size_t>(state.range(0));
+    const size_t windowCount = static_cast<size_t>(state.range(1));
+
+    FakeInputDispatcherPolicy fakePolicy;
+    InputDispatcher dispatcher(fakePolicy);
+    dispatcher.setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher.start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<int32_t> displayIds;
+    std::vector<sp<FakeWindowHandle>> windows;
+    std::vector<sp<FakeWindowHandle>> touchedWindows;
+    std::vector<std::vector<NotifyMotionArgs>> gestures;
+    for (size_t i = 0; i < displayCount; i++) {
+        const int32_t displayId = DISPLAY_ID + static_cast<int32_t>(i);
+        displayIds.push_back(displayId);
+        std::vector<sp<FakeWindowHandle>> displayWindows =
+                createTiledWindows(dispatcher, application, windowCount, displayId);
+        touchedWindows.push_back(displayWindows.back());
+        windows.insert(windows.end(), displayWindows.begin(), displayWindows.end());
+        gestures.push_back(generateGesture({pointerInTile(0, windowCount - 1)}, displayId));
+    }
+    setWindows(dispatcher, windows, displayIds);
+
+    size_t n = 0;
+    for (auto _ : state) {
+        std::vector<NotifyMotionArgs>& gesture = gestures[n];
+        notifyGesture(dispatcher, gesture);
+        for (size_t i = 0; i < gesture.size(); i++) {
+            touchedWindows[n]->consumeMotion();
+        }
+        n = (n + 1) % displayCount;
+    }
+    state.SetItemsProcessed(state.iterations() * gestures[0].size());
+
+    dispatcher.stop();
+}
+
+/**
+ * Slide a finger across state.range(0) slippery windows. The touch slips from each window into
+ * the next, which cancels it in the window it leaves and starts it in the one it enters.
+ */
+static void benchmarkSlipperyMotion(benchmark::State& state) {
+    const size_t windowCount = static_cast<size_t>(state.range(0));
+
+    FakeInputDispatcherPolicy fakePolicy;
+    InputDispatcher dispatcher(fakePolicy);
+    dispatcher.setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher.start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    const std::vector<sp<FakeWindowHandle>> windows =
+            createTiledWindows(dispatcher, application, windowCount, DISPLAY_ID);
+    for (const sp<FakeWindowHandle>& window : windows) {
+        window->setSlippery(true);
+    }
+    setWindows(dispatcher, windows, {DISPLAY_ID});
+
+    std::vector<NotifyMotionArgs> gesture;
+    for (size_t i = 0; i < windowCount; i++) {
+        const int32_t action = i == 0 ? AMOTION_EVENT_ACTION_DOWN : AMOTION_EVENT_ACTION_MOVE;
+        gesture.push_back(MotionArgsBuilder(action, AINPUT_SOURCE_TOUCHSCREEN)
+                                  .deviceId(DEVICE_ID)
+                                  .displayId(DISPLAY_ID)
+                                  .pointer(pointerInTile(0, i))
+                                  .build());
+    }
+    gesture.push_back(MotionArgsBuilder(AMOTION_EVENT_ACTION_UP, AINPUT_SOURCE_TOUCHSCREEN)
+                              .deviceId(DEVICE_ID)
+                              .displayId(DISPLAY_ID)
+                              .pointer(pointerInTile(0, windowCount - 1))
+                              .build());
+
+    for (auto _ : state) {
+        notifyGesture(dispatcher, gesture);
+        // Each window gets a DOWN, followed by a CANCEL, or the UP for the last one.
+        for (const sp<FakeWindowHandle>& window : windows) {
+            window->consumeMotion();
+            window->consumeMotion();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * gesture.size());
+
+    dispatcher.stop();
+}
+
+/**
+ * Move the focus to the next of state.range(0) windows, and type a key in it.
+ */
+static void benchmarkNotifyKeyWithFocusChange(benchmark::State& state) {
+    const size_t windowCount = static_cast<size_t>(state.range(0));
+
+    FakeInputDispatcherPolicy fakePolicy;
+    InputDispatcher dispatcher(fakePolicy);
+    dispatcher.setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher.start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    const std::vector<sp<FakeWindowHandle>> windows =
+            createTiledWindows(dispatcher, application, windowCount, DISPLAY_ID);
+    for (const sp<FakeWindowHandle>& window : windows) {
+        window->setFocusable(true);
+    }
+    setWindows(dispatcher, windows, {DISPLAY_ID});
+    dispatcher.setFocusedApplication(DISPLAY_ID, application);
+
+    const auto setFocusedWindow = [&dispatcher](const sp<FakeWindowHandle>& window) {
+        gui::FocusRequest request;
+        request.token = window->getToken();
+        request.windowName = window->getName();
+        request.timestamp = now();
+        request.displayId = DISPLAY_ID;
+        dispatcher.setFocusedWindow(request);
+    };
+    setFocusedWindow(windows[0]);
+    windows[0]->consumeFocusEvent();
+
+    NotifyKeyArgs keyDown = KeyArgsBuilder(AKEY_EVENT_ACTION_DOWN, AINPUT_SOURCE_KEYBOARD)
+                                    .deviceId(DEVICE_ID)
+                                    .keyCode(AKEYCODE_A)
+                                    .build();
+    NotifyKeyArgs keyUp = KeyArgsBuilder(AKEY_EVENT_ACTION_UP, AINPUT_SOURCE_KEYBOARD)
+                                  .deviceId(DEVICE_ID)
+                                  .keyCode(AKEYCODE_A)
+                                  .build();
+
+    size_t focusedWindow = 0;
+    for (auto _ : state) {
+        // With a single window, the focus does not change, so there are no focus events.
+        const size_t nextFocusedWindow = (focusedWindow + 1) % windowCount;
+        if (nextFocusedWindow != focusedWindow) {
+            setFocusedWindow(windows[nextFocusedWindow]);
+            windows[focusedWindow]->consumeFocusEvent();
+            windows[nextFocusedWindow]->consumeFocusEvent();
+            focusedWindow = nextFocusedWindow;
+        }
+
+        keyDown.id = InputEvent::nextId();
+        keyDown.downTime = now();
+        keyDown.eventTime = keyDown.downTime;
+        dispatcher.notifyKey(keyDown);
+        keyUp.id = InputEvent::nextId();
+        keyUp.downTime = keyDown.downTime;
+        keyUp.eventTime = now();
+        dispatcher.notifyKey(keyUp);
+
+        windows[focusedWindow]->consumeKey();
+        windows[focusedWindow]->consumeKey();
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+
+    dispatcher.stop();
+}
+
+/**
+ * Tap a window under state.range(0) - 1 spy windows, which all finish their events
+ * state.range(1) taps late. Every connection keeps events in its wait queue, so the dispatcher
+ * keeps an ANR timer running for each of them.
+ */
+static void benchmarkSlowConsumers(benchmark::State& state) {
+    const size_t consumerCount = static_cast<size_t>(state.range(0));
+    const size_t tapsInFlight = static_cast<size_t>(state.range(1));
+
+    FakeInputDispatcherPolicy fakePolicy;
+    InputDispatcher dispatcher(fakePolicy);
+    dispatcher.setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher.start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<FakeWindowHandle>> consumers;
+    for (size_t i = 0; i + 1 < consumerCount; i++) {
+        sp<FakeWindowHandle> spy =
+                sp<FakeWindowHandle>::make(application, dispatcher,
+                                           "Spy " + std::to_string(i), DISPLAY_ID);
+        spy->setSpy(true);
+        spy->setTrustedOverlay(true);
+        consumers.push_back(std::move(spy));
+    }
+    consumers.push_back(
+            sp<FakeWindowHandle>::make(application, dispatcher, "Fake Window", DISPLAY_ID));
+    setWindows(dispatcher, consumers, {DISPLAY_ID});
+
+    std::vector<NotifyMotionArgs> gesture = generateGesture({pointerInTile(0, 0)}, DISPLAY_ID);
+    for (size_t i = 0; i < tapsInFlight; i++) {
+        notifyGesture(dispatcher, gesture);
+    }
+
+    for (auto _ : state) {
+        notifyGesture(dispatcher, gesture);
+        // Finish the oldest tap.
+        for (const sp<FakeWindowHandle>& consumer : consumers) {
+            for (size_t i = 0; i < gesture.size(); i++) {
+                consumer->consumeMotion();
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * gesture.size());
+
+    dispatcher.stop();
+}
+
 } // namespace
 
+BENCHMARK(benchmarkAnrTracker)->Arg(1)->Arg(16)->Arg(128)->Arg(512);
 BENCHMARK(benchmarkNotifyMotion);
 BENCHMARK(benchmarkInjectMotion);
 BENCHMARK(benchmarkOnWindowInfosChanged);
+// The argument names are part of the benchmark names, so that results can be compared across
+// releases. Run with --benchmark_out=<file> --benchmark_out_format=json to export them.
+BENCHMARK(benchmarkSplitMotion)
+        ->ArgNames({"windows", "pointers"})
+        ->ArgsProduct({{1, 16, 64}, {1, 2, 5}});
+BENCHMARK(benchmarkMotionFanOut)
+        ->ArgNames({"spies", "monitors"})
+        ->ArgsProduct({{0, 4, 16}, {0, 4, 16}});
+BENCHMARK(benchmarkMultiDisplayMotion)
+        ->ArgNames({"displays", "windows"})
+        ->ArgsProduct({{1, 2, 4}, {1, 16}});
+BENCHMARK(benchmarkSlipperyMotion)->ArgName("windows")->Arg(2)->Arg(16)->Arg(64);
+BENCHMARK(benchmarkNotifyKeyWithFocusChange)->ArgName("windows")->Arg(1)->Arg(16)->Arg(64);
+BENCHMARK(benchmarkSlowConsumers)
+        ->ArgNames({"consumers", "tapsInFlight"})
+        ->ArgsProduct({{1, 8, 32}, {1, 8}});
 
 } // namespace android::inputdispatcher
 
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/Binder.h>
+#include <gui/constants.h>
+#include "../InputDeviceMetricsSource.h"
+#include "../dispatcher/LatencyTracker.h"
+
+namespace android::inputdispatcher {
+
+namespace {
+
+constexpr DeviceId DEVICE_ID = 1;
+
+// Events are reported by the device every this many nanoseconds.
+constexpr nsecs_t EVENT_INTERVAL = 4'000'000; // 250Hz
+// The apps finish an event this many events after it is sent.
+constexpr int32_t FINISH_DELAY = 4;
+// The apps report the graphics timeline of an event this many events after it is sent.
+constexpr int32_t GRAPHICS_DELAY = 8;
+
+class NoOpProcessor : public InputEventTimelineProcessor {
+public:
+    void processTimeline(const InputEventTimeline& timeline) override {
+        benchmark::DoNotOptimize(timeline.connectionTimelines.size());
+    }
+};
+
+/**
+ * Replay a stream of events sent to state.range(0) connections, as the dispatcher reports it to
+ * LatencyTracker: every event is tracked, then finished and later drawn by each connection. The
+ * events mature after the ANR timeout, so once the stream is longer than that, every event that
+ * is tracked also reports an old one.
+ */
+static void benchmarkLatencyTracker(benchmark::State& state) {
+    const size_t connectionCount = static_cast<size_t>(state.range(0));
+    std::vector<sp<IBinder>> tokens;
+    for (size_t i = 0; i < connectionCount; i++) {
+        tokens.push_back(sp<BBinder>::make());
+    }
+
+    NoOpProcessor processor;
+    LatencyTracker tracker(&processor);
+    InputDeviceIdentifier identifier;
+    identifier.vendor = 1;
+    identifier.product = 2;
+    InputDeviceInfo deviceInfo;
+    deviceInfo.initialize(DEVICE_ID, /*generation=*/1, /*controllerNumber=*/1, identifier,
+                          "Benchmark Device", /*isExternal=*/false, /*hasMic=*/false,
+                          ADISPLAY_ID_NONE);
+    tracker.setInputDevices({deviceInfo});
+    const std::set<InputDeviceUsageSource> sources{InputDeviceUsageSource::TOUCHSCREEN};
+
+    // Event ids are random in practice, so spread them out.
+    const auto eventId = [](int32_t n) { return static_cast<int32_t>(n * 2654435761u); };
+    int32_t n = 0;
+    for (auto _ : state) {
+        const nsecs_t eventTime = n * EVENT_INTERVAL;
+        tracker.trackListener(eventId(n), /*isDown=*/false, eventTime, eventTime, DEVICE_ID,
+                              sources);
+        for (const sp<IBinder>& token : tokens) {
+            if (n >= FINISH_DELAY) {
+                const nsecs_t sentTime = (n - FINISH_DELAY) * EVENT_INTERVAL;
+                tracker.trackFinishedEvent(eventId(n - FINISH_DELAY), token, sentTime,
+                                           sentTime + 1, eventTime);
+            }
+            if (n >= GRAPHICS_DELAY) {
+                std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline;
+                graphicsTimeline[GraphicsTimeline::GPU_COMPLETED_TIME] = eventTime;
+                graphicsTimeline[GraphicsTimeline::PRESENT_TIME] = eventTime + 1;
+                tracker.trackGraphicsLatency(eventId(n - GRAPHICS_DELAY), token,
+                                             graphicsTimeline);
+            }
+        }
+        n++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // namespace
+
+BENCHMARK(benchmarkLatencyTracker)->Arg(1)->Arg(4)->Arg(16);
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/constants.h>
+#include <atomic>
+#include <thread>
+#include "../PointerChoreographer.h"
+#include "NotifyArgsBuilders.h"
+
+namespace android {
+
+namespace {
+
+constexpr int32_t DISPLAY_ID = ADISPLAY_ID_DEFAULT;
+constexpr int32_t DISPLAY_WIDTH = 1920;
+constexpr int32_t DISPLAY_HEIGHT = 1080;
+
+/**
+ * A PointerController that only tracks the cursor position, which is all the choreographer reads
+ * back from it. Like the real one, it can be called from several threads.
+ */
+class BenchmarkPointerController : public PointerControllerInterface {
+public:
+    std::string dump() override { return ""; }
+    std::optional<FloatRect> getBounds() const override { return std::nullopt; }
+    void move(float deltaX, float deltaY) override {
+        mX.store(mX.load(std::memory_order_relaxed) + deltaX, std::memory_order_relaxed);
+        mY.store(mY.load(std::memory_order_relaxed) + deltaY, std::memory_order_relaxed);
+    }
+    void setPosition(float x, float y) override {
+        mX.store(x, std::memory_order_relaxed);
+        mY.store(y, std::memory_order_relaxed);
+    }
+    FloatPoint getPosition() const override {
+        return {mX.load(std::memory_order_relaxed), mY.load(std::memory_order_relaxed)};
+    }
+    void fade(Transition) override {}
+    void unfade(Transition) override {}
+    void setPresentation(Presentation) override {}
+    void setSpots(const PointerCoords* spotCoords, const uint32_t*, BitSet32 spotIdBits,
+                  int32_t) override {
+        benchmark::DoNotOptimize(spotCoords);
+        benchmark::DoNotOptimize(spotIdBits);
+    }
+    void clearSpots() override {}
+    int32_t getDisplayId() const override { return DISPLAY_ID; }
+    void setDisplayViewport(const DisplayViewport&) override {}
+    void updatePointerIcon(PointerIconStyle) override {}
+    void setCustomPointerIcon(const SpriteIcon&) override {}
+
+private:
+    std::atomic<float> mX{0};
+    std::atomic<float> mY{0};
+};
+
+class BenchmarkPolicy : public PointerChoreographerPolicyInterface {
+public:
+    std::shared_ptr<PointerControllerInterface> createPointerController(
+            PointerControllerInterface::ControllerType) override {
+        return std::make_shared<BenchmarkPointerController>();
+    }
+    void notifyPointerDisplayIdChanged(int32_t, const FloatPoint&) override {}
+};
+
+class NoOpListener : public InputListenerInterface {
+public:
+    void notifyInputDevicesChanged(const NotifyInputDevicesChangedArgs&) override {}
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs&) override {}
+    void notifyKey(const NotifyKeyArgs&) override {}
+    void notifyMotion(const NotifyMotionArgs& args) override {
+        benchmark::DoNotOptimize(args.xCursorPosition);
+    }
+    void notifySwitch(const NotifySwitchArgs&) override {}
+    void notifySensor(const NotifySensorArgs&) override {}
+    void notifyVibratorState(const NotifyVibratorStateArgs&) override {}
+    void notifyDeviceReset(const NotifyDeviceResetArgs&) override {}
+    void notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs&) override {}
+};
+
+InputDeviceInfo createDeviceInfo(DeviceId deviceId, uint32_t source, int32_t associatedDisplayId) {
+    InputDeviceIdentifier identifier;
+    InputDeviceInfo info;
+    info.initialize(deviceId, /*generation=*/1, /*controllerNumber=*/1, identifier,
+                    "Benchmark Device", /*isExternal=*/false, /*hasMic=*/false,
+                    associatedDisplayId);
+    info.addSource(source);
+    return info;
+}
+
+std::vector<DisplayViewport> createViewports() {
+    DisplayViewport viewport;
+    viewport.displayId = DISPLAY_ID;
+    viewport.logicalRight = DISPLAY_WIDTH;
+    viewport.logicalBottom = DISPLAY_HEIGHT;
+    return {viewport};
+}
+
+/**
+ * Connect deviceCount mice, styluses and touchscreens, with show touches and the stylus pointer
+ * icon enabled, and return one event from each device, interleaved.
+ */
+std::vector<NotifyMotionArgs> setUpMixedStreams(PointerChoreographer& choreographer,
+                                                int32_t deviceCount) {
+    std::vector<InputDeviceInfo> devices;
+    std::vector<NotifyMotionArgs> events;
+    for (int32_t i = 0; i < deviceCount; i++) {
+        const DeviceId mouseId = 3 * i + 1;
+        const DeviceId stylusId = 3 * i + 2;
+        const DeviceId touchscreenId = 3 * i + 3;
+        devices.push_back(createDeviceInfo(mouseId, AINPUT_SOURCE_MOUSE, ADISPLAY_ID_NONE));
+        devices.push_back(createDeviceInfo(stylusId, AINPUT_SOURCE_STYLUS, DISPLAY_ID));
+        devices.push_back(
+                createDeviceInfo(touchscreenId, AINPUT_SOURCE_TOUCHSCREEN, DISPLAY_ID));
+
+        events.push_back(MotionArgsBuilder(AMOTION_EVENT_ACTION_HOVER_MOVE, AINPUT_SOURCE_MOUSE)
+                                 .pointer(PointerBuilder(/*id=*/0, ToolType::MOUSE)
+                                                  .axis(AMOTION_EVENT_AXIS_RELATIVE_X, 1)
+                                                  .axis(AMOTION_EVENT_AXIS_RELATIVE_Y, 1))
+                                 .deviceId(mouseId)
+                                 .build());
+        events.push_back(MotionArgsBuilder(AMOTION_EVENT_ACTION_HOVER_MOVE,
+                                           AINPUT_SOURCE_TOUCHSCREEN | AINPUT_SOURCE_STYLUS)
+                                 .pointer(PointerBuilder(/*id=*/0, ToolType::STYLUS).x(100).y(200))
+                                 .deviceId(stylusId)
+                                 .displayId(DISPLAY_ID)
+                                 .build());
+        events.push_back(MotionArgsBuilder(AMOTION_EVENT_ACTION_MOVE, AINPUT_SOURCE_TOUCHSCREEN)
+                                 .pointer(PointerBuilder(/*id=*/0, ToolType::FINGER).x(300).y(400))
+                                 .deviceId(touchscreenId)
+                                 .displayId(DISPLAY_ID)
+                                 .build());
+    }
+
+    choreographer.setDisplayViewports(createViewports());
+    choreographer.setShowTouchesEnabled(true);
+    choreographer.setStylusPointerIconEnabled(true);
+    choreographer.notifyInputDevicesChanged({/*id=*/1, devices});
+    // The stylus and touch controllers are created by the first event from each device.
+    for (const NotifyMotionArgs& args : events) {
+        choreographer.notifyMotion(args);
+    }
+    return events;
+}
+
+/**
+ * Route the events of state.range(0) mice, styluses and touchscreens that move at the same time.
+ */
+static void benchmarkMixedStreams(benchmark::State& state) {
+    NoOpListener listener;
+    BenchmarkPolicy policy;
+    PointerChoreographer choreographer(listener, policy);
+    const std::vector<NotifyMotionArgs> events =
+            setUpMixedStreams(choreographer, static_cast<int32_t>(state.range(0)));
+
+    size_t n = 0;
+    for (auto _ : state) {
+        choreographer.notifyMotion(events[n]);
+        n = (n + 1) % events.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Same as benchmarkMixedStreams, while another thread keeps updating the display viewports, as
+ * happens when displays are added or rotated.
+ */
+static void benchmarkMixedStreamsWhileConfiguring(benchmark::State& state) {
+    NoOpListener listener;
+    BenchmarkPolicy policy;
+    PointerChoreographer choreographer(listener, policy);
+    const std::vector<NotifyMotionArgs> events =
+            setUpMixedStreams(choreographer, static_cast<int32_t>(state.range(0)));
+
+    std::atomic<bool> done = false;
+    std::thread configThread([&]() {
+        const std::vector<DisplayViewport> viewports = createViewports();
+        while (!done.load(std::memory_order_relaxed)) {
+            choreographer.setDisplayViewports(viewports);
+        }
+    });
+
+    size_t n = 0;
+    for (auto _ : state) {
+        choreographer.notifyMotion(events[n]);
+        n = (n + 1) % events.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    done = true;
+    configThread.join();
+}
+
+} // namespace
+
+BENCHMARK(benchmarkMixedStreams)->Arg(1)->Arg(4)->Arg(16);
+BENCHMARK(benchmarkMixedStreamsWhileConfiguring)->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+} // namespace android
@@ -0,0 +1,354 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <com_android_input_flags.h>
+#include <gui/constants.h>
+#include <linux/input-event-codes.h>
+#include <utils/Timers.h>
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <vector>
+#include "../reader/include/InputDevice.h"
+#include "../reader/mapper/gestures/TimerProvider.h"
+#include "../tests/FakeEventHub.h"
+#include "../tests/FakeInputReaderPolicy.h"
+#include "../tests/FakePointerController.h"
+#include "../tests/InstrumentedInputReader.h"
+
+namespace android {
+
+namespace input_flags = com::android::input::flags;
+
+namespace {
+
+constexpr int32_t DEVICE_ID = END_RESERVED_ID + 1000;
+constexpr int32_t EVENTHUB_ID = 1;
+constexpr int32_t DISPLAY_ID = ADISPLAY_ID_DEFAULT;
+constexpr int32_t DISPLAY_WIDTH = 1920;
+constexpr int32_t DISPLAY_HEIGHT = 1080;
+
+// The touchpad is 2000 x 1000 units, at 24 units per millimeter, and reports 240 frames a second.
+constexpr int32_t PAD_WIDTH = 2000;
+constexpr int32_t PAD_HEIGHT = 1000;
+constexpr nsecs_t FRAME_INTERVAL = 1'000'000'000 / 240;
+constexpr int32_t MAX_SLOTS = 5;
+
+class NoOpListener : public InputListenerInterface {
+public:
+    void notifyInputDevicesChanged(const NotifyInputDevicesChangedArgs&) override {}
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs&) override {}
+    void notifyKey(const NotifyKeyArgs&) override {}
+    void notifyMotion(const NotifyMotionArgs&) override {}
+    void notifySwitch(const NotifySwitchArgs&) override {}
+    void notifySensor(const NotifySensorArgs&) override {}
+    void notifyVibratorState(const NotifyVibratorStateArgs&) override {}
+    void notifyDeviceReset(const NotifyDeviceResetArgs&) override {}
+    void notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs&) override {}
+};
+
+struct FingerPosition {
+    int32_t x;
+    int32_t y;
+};
+
+/**
+ * Synthesized evdev frames of a touchpad, with times relative to the first frame, as a recording
+ * of the device would have them. Each frame ends with a SYN_REPORT.
+ */
+class TouchpadRecording {
+public:
+    // Records a frame with one finger at each of the given positions, in slot order. Fingers are
+    // put down or lifted so that the number of fingers down matches the number of positions.
+    void addFrame(const std::vector<FingerPosition>& fingers) {
+        mFrames.emplace_back();
+        const size_t previousFingerCount = mFingerCount;
+        for (size_t slot = 0; slot < std::max(fingers.size(), previousFingerCount); slot++) {
+            add(EV_ABS, ABS_MT_SLOT, slot);
+            if (slot >= fingers.size()) {
+                add(EV_ABS, ABS_MT_TRACKING_ID, -1);
+                continue;
+            }
+            if (slot >= previousFingerCount) {
+                add(EV_ABS, ABS_MT_TRACKING_ID, mNextTrackingId++);
+            }
+            add(EV_ABS, ABS_MT_POSITION_X, fingers[slot].x);
+            add(EV_ABS, ABS_MT_POSITION_Y, fingers[slot].y);
+            add(EV_ABS, ABS_MT_PRESSURE, 60);
+        }
+        mFingerCount = fingers.size();
+        if (mFingerCount != previousFingerCount) {
+            if (previousFingerCount == 0 || mFingerCount == 0) {
+                add(EV_KEY, BTN_TOUCH, mFingerCount > 0);
+            }
+            if (previousFingerCount > 0) {
+                add(EV_KEY, toolForFingerCount(previousFingerCount), 0);
+            }
+            if (mFingerCount > 0) {
+                add(EV_KEY, toolForFingerCount(mFingerCount), 1);
+            }
+        }
+        add(EV_SYN, SYN_REPORT, 0);
+        mTime += FRAME_INTERVAL;
+    }
+
+    // Records fingers moving in a straight line from the start positions, by (dx, dy) each frame.
+    void addMotion(std::vector<FingerPosition> fingers, int32_t dx, int32_t dy, size_t frameCount) {
+        for (size_t i = 0; i < frameCount; i++) {
+            addFrame(fingers);
+            for (FingerPosition& finger : fingers) {
+                finger.x += dx;
+                finger.y += dy;
+            }
+        }
+        addFrame({});
+    }
+
+    void addPause(nsecs_t duration) { mTime += duration; }
+
+    const std::vector<std::vector<RawEvent>>& getFrames() const { return mFrames; }
+
+    nsecs_t getDuration() const { return mTime; }
+
+private:
+    static int32_t toolForFingerCount(size_t fingerCount) {
+        switch (fingerCount) {
+            case 1:
+                return BTN_TOOL_FINGER;
+            case 2:
+                return BTN_TOOL_DOUBLETAP;
+            case 3:
+                return BTN_TOOL_TRIPLETAP;
+            case 4:
+                return BTN_TOOL_QUADTAP;
+            default:
+                return BTN_TOOL_QUINTTAP;
+        }
+    }
+
+    void add(int32_t type, int32_t code, int32_t value) {
+        mFrames.back().push_back({.when = mTime,
+                                  .readTime = mTime,
+                                  .deviceId = EVENTHUB_ID,
+                                  .type = type,
+                                  .code = code,
+                                  .value = value});
+    }
+
+    std::vector<std::vector<RawEvent>> mFrames;
+    nsecs_t mTime = 0;
+    size_t mFingerCount = 0;
+    int32_t mNextTrackingId = 1;
+};
+
+TouchpadRecording recordPointerMoves() {
+    TouchpadRecording recording;
+    recording.addMotion({{400, 500}}, /*dx=*/10, /*dy=*/2, /*frameCount=*/120);
+    recording.addPause(100'000'000);
+    recording.addMotion({{1600, 300}}, /*dx=*/-10, /*dy=*/3, /*frameCount=*/120);
+    recording.addPause(100'000'000);
+    return recording;
+}
+
+TouchpadRecording recordTaps() {
+    // Tapping starts timers in the gestures library, to tell taps from double taps and drags.
+    TouchpadRecording recording;
+    for (int32_t i = 0; i < 8; i++) {
+        recording.addMotion({{1000, 500}}, /*dx=*/0, /*dy=*/0, /*frameCount=*/12);
+        recording.addPause(250'000'000);
+    }
+    return recording;
+}
+
+TouchpadRecording recordScrolls() {
+    TouchpadRecording recording;
+    recording.addMotion({{800, 200}, {1100, 200}}, /*dx=*/0, /*dy=*/5, /*frameCount=*/120);
+    recording.addPause(100'000'000);
+    recording.addMotion({{800, 800}, {1100, 800}}, /*dx=*/0, /*dy=*/-5, /*frameCount=*/120);
+    recording.addPause(100'000'000);
+    return recording;
+}
+
+TouchpadRecording recordThreeFingerSwipes() {
+    TouchpadRecording recording;
+    recording.addMotion({{600, 500}, {900, 450}, {1200, 500}}, /*dx=*/8, /*dy=*/0,
+                        /*frameCount=*/60);
+    recording.addPause(100'000'000);
+    recording.addMotion({{1400, 500}, {1100, 450}, {800, 500}}, /*dx=*/-8, /*dy=*/0,
+                        /*frameCount=*/60);
+    recording.addPause(100'000'000);
+    return recording;
+}
+
+/**
+ * A touchpad connected to an InputReader with fake EventHub and policy, so that raw events go
+ * through the real TouchpadInputMapper: the HardwareStateConverter, the gestures library and its
+ * timers, and the GestureConverter.
+ */
+class Touchpad {
+public:
+    Touchpad()
+          : mFakeEventHub(std::make_shared<FakeEventHub>()),
+            mFakePolicy(sp<FakeInputReaderPolicy>::make()),
+            mFakePointerController(std::make_shared<FakePointerController>()) {
+        mFakePointerController->setBounds(0, 0, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1);
+        mFakePolicy->setPointerController(mFakePointerController);
+        mFakePolicy->addDisplayViewport(DISPLAY_ID, DISPLAY_WIDTH, DISPLAY_HEIGHT, ui::ROTATION_0,
+                                        /*isActive=*/true, "local:0", /*physicalPort=*/0,
+                                        ViewportType::INTERNAL);
+        mFakePolicy->setDefaultPointerDisplayId(DISPLAY_ID);
+        mReader = std::make_unique<InstrumentedInputReader>(mFakeEventHub, mFakePolicy, mListener);
+
+        mFakeEventHub->addAbsoluteAxis(EVENTHUB_ID, ABS_MT_SLOT, 0, MAX_SLOTS - 1, 0, 0);
+        mFakeEventHub->addAbsoluteAxis(EVENTHUB_ID, ABS_MT_TRACKING_ID, 0, 65535, 0, 0);
+        mFakeEventHub->addAbsoluteAxis(EVENTHUB_ID, ABS_MT_POSITION_X, 0, PAD_WIDTH, 0, 0,
+                                       /*resolution=*/24);
+        mFakeEventHub->addAbsoluteAxis(EVENTHUB_ID, ABS_MT_POSITION_Y, 0, PAD_HEIGHT, 0, 0,
+                                       /*resolution=*/24);
+        mFakeEventHub->addAbsoluteAxis(EVENTHUB_ID, ABS_MT_PRESSURE, 0, 255, 0, 0);
+        for (int32_t scanCode : {BTN_LEFT, BTN_TOUCH, BTN_TOOL_FINGER, BTN_TOOL_DOUBLETAP,
+                                 BTN_TOOL_TRIPLETAP, BTN_TOOL_QUADTAP, BTN_TOOL_QUINTTAP}) {
+            mFakeEventHub->addKey(EVENTHUB_ID, scanCode, /*usageCode=*/0, AKEYCODE_UNKNOWN,
+                                  /*flags=*/0);
+        }
+
+        InputDeviceIdentifier identifier;
+        identifier.name = "touchpad";
+        identifier.location = "USB1";
+        mDevice = std::make_shared<InputDevice>(mReader->getContext(), DEVICE_ID,
+                                                /*generation=*/2, identifier);
+        mReader->pushNextDevice(mDevice);
+        using namespace ftl::flag_operators;
+        mFakeEventHub->addDevice(EVENTHUB_ID, identifier.name,
+                                 InputDeviceClass::TOUCHPAD | InputDeviceClass::TOUCH_MT);
+        mReader->loopOnce();
+    }
+
+    /**
+     * Replays one frame of the recording, after handling any gestures library timeouts that have
+     * passed. The recording's times are offset by startTime.
+     */
+    std::list<NotifyArgs> replayFrame(const std::vector<RawEvent>& frame, nsecs_t startTime) {
+        mFrameBuffer.assign(frame.begin(), frame.end());
+        for (RawEvent& event : mFrameBuffer) {
+            event.when += startTime;
+            event.readTime += startTime;
+        }
+        std::list<NotifyArgs> out = mDevice->timeoutExpired(mFrameBuffer.front().when);
+        out += mDevice->process(mFrameBuffer.data(), mFrameBuffer.size());
+        return out;
+    }
+
+    InputReaderContext& getContext() { return *mReader->getContext(); }
+
+private:
+    std::shared_ptr<FakeEventHub> mFakeEventHub;
+    sp<FakeInputReaderPolicy> mFakePolicy;
+    std::shared_ptr<FakePointerController> mFakePointerController;
+    NoOpListener mListener;
+    std::unique_ptr<InstrumentedInputReader> mReader;
+    std::shared_ptr<InputDevice> mDevice;
+    std::vector<RawEvent> mFrameBuffer;
+};
+
+/**
+ * Replay the recording over and over, one frame per iteration. The gestures library sets its
+ * timer deadlines from the system clock, so the replay starts from it too.
+ */
+static void benchmarkReplay(benchmark::State& state, TouchpadRecording (*record)()) {
+    input_flags::enable_gestures_library_timer_provider(true);
+    input_flags::enable_pointer_choreographer(false);
+    Touchpad touchpad;
+    const TouchpadRecording recording = record();
+    const std::vector<std::vector<RawEvent>>& frames = recording.getFrames();
+
+    nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    size_t motionCount = 0;
+    for (const std::vector<RawEvent>& frame : frames) {
+        for (const NotifyArgs& args : touchpad.replayFrame(frame, startTime)) {
+            motionCount += std::holds_alternative<NotifyMotionArgs>(args);
+        }
+    }
+    if (motionCount == 0) {
+        state.SkipWithError("The recording did not generate any motion events");
+        return;
+    }
+    startTime += recording.getDuration();
+
+    size_t n = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(touchpad.replayFrame(frames[n], startTime));
+        if (++n == frames.size()) {
+            n = 0;
+            startTime += recording.getDuration();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+stime_t noDeadline(stime_t, void*) {
+    return NO_DEADLINE;
+}
+
+stime_t rescheduleOnce(stime_t, void* data) {
+    bool* rescheduled = static_cast<bool*>(data);
+    *rescheduled = !*rescheduled;
+    return *rescheduled ? 0.001 : NO_DEADLINE;
+}
+
+/**
+ * Set, cancel and trigger gestures library timer deadlines, in the pattern the library uses while
+ * fingers are on the pad: each frame sets a short deadline on a few timers and cancels one of
+ * them, and the deadlines that pass trigger, sometimes rescheduling themselves.
+ */
+static void benchmarkTimerProvider(benchmark::State& state) {
+    Touchpad touchpad;
+    TimerProvider provider(touchpad.getContext());
+    std::vector<GesturesTimer*> timers;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        timers.push_back(provider.createTimer());
+    }
+    bool rescheduled = false;
+
+    size_t n = 0;
+    for (auto _ : state) {
+        for (GesturesTimer* timer : timers) {
+            provider.setDeadline(timer, FRAME_INTERVAL, &noDeadline, nullptr);
+        }
+        provider.setDeadline(timers[n % timers.size()], FRAME_INTERVAL / 2, &rescheduleOnce,
+                             &rescheduled);
+        provider.cancelTimer(timers[(n + 1) % timers.size()]);
+        provider.triggerCallbacks(systemTime(SYSTEM_TIME_MONOTONIC) + FRAME_INTERVAL);
+        n++;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    for (GesturesTimer* timer : timers) {
+        provider.freeTimer(timer);
+    }
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(benchmarkReplay, PointerMoves, &recordPointerMoves);
+BENCHMARK_CAPTURE(benchmarkReplay, Taps, &recordTaps);
+BENCHMARK_CAPTURE(benchmarkReplay, Scrolls, &recordScrolls);
+BENCHMARK_CAPTURE(benchmarkReplay, ThreeFingerSwipes, &recordThreeFingerSwipes);
+BENCHMARK(benchmarkTimerProvider)->Arg(1)->Arg(4)->Arg(16);
+
+} // namespace android
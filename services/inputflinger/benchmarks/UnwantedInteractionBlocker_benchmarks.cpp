@@ -0,0 +1,230 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <android/os/IInputConstants.h>
+#include <gui/constants.h>
+#include "../UnwantedInteractionBlocker.h"
+
+using android::os::IInputConstants;
+using namespace std::chrono_literals;
+
+namespace android {
+
+namespace {
+
+constexpr int32_t DEVICE_ID = 3;
+
+constexpr int32_t POINTER_1_DOWN =
+        AMOTION_EVENT_ACTION_POINTER_DOWN | (1 << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+constexpr int32_t POINTER_1_UP =
+        AMOTION_EVENT_ACTION_POINTER_UP | (1 << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+
+struct PointerData {
+    float x;
+    float y;
+    float major;
+};
+
+struct TraceSample {
+    std::chrono::nanoseconds eventTime;
+    int32_t action;
+    std::vector<PointerData> pointers;
+};
+
+/**
+ * A recorded palm touching the screen, reported as two pointers. Both pointers are palms, and the
+ * synchronous palm rejector cancels the entire gesture at 120ms.
+ */
+const std::vector<TraceSample> PALM_TRACE = {
+        {0ms, AMOTION_EVENT_ACTION_DOWN, {{1342, 613, 79}}},
+        {8ms, AMOTION_EVENT_ACTION_MOVE, {{1406, 650, 52}}},
+        {16ms, AMOTION_EVENT_ACTION_MOVE, {{1429, 672, 46}}},
+        {24ms, AMOTION_EVENT_ACTION_MOVE, {{1417, 685, 41}}},
+        {32ms, POINTER_1_DOWN, {{1417, 685, 41}, {1062, 697, 10}}},
+        {40ms, AMOTION_EVENT_ACTION_MOVE, {{1414, 702, 41}, {1059, 731, 12}}},
+        {48ms, AMOTION_EVENT_ACTION_MOVE, {{1415, 719, 44}, {1060, 760, 11}}},
+        {56ms, AMOTION_EVENT_ACTION_MOVE, {{1421, 733, 42}, {1065, 769, 13}}},
+        {64ms, AMOTION_EVENT_ACTION_MOVE, {{1426, 742, 43}, {1068, 771, 13}}},
+        {72ms, AMOTION_EVENT_ACTION_MOVE, {{1430, 748, 45}, {1069, 772, 13}}},
+        {80ms, AMOTION_EVENT_ACTION_MOVE, {{1432, 750, 44}, {1069, 772, 13}}},
+        {88ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 751, 44}, {1070, 771, 13}}},
+        {96ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 751, 42}, {1071, 770, 13}}},
+        {104ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 751, 45}, {1072, 769, 13}}},
+        {112ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 751, 43}, {1072, 768, 13}}},
+        {120ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 751, 45}, {1072, 767, 13}}},
+        {128ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 751, 43}, {1072, 766, 13}}},
+        {136ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 750, 44}, {1072, 765, 13}}},
+        {144ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 750, 42}, {1072, 763, 14}}},
+        {152ms, AMOTION_EVENT_ACTION_MOVE, {{1434, 750, 44}, {1073, 761, 14}}},
+        {160ms, AMOTION_EVENT_ACTION_MOVE, {{1435, 750, 43}, {1073, 759, 15}}},
+        {168ms, AMOTION_EVENT_ACTION_MOVE, {{1436, 750, 45}, {1074, 757, 15}}},
+        {176ms, AMOTION_EVENT_ACTION_MOVE, {{1436, 750, 44}, {1074, 755, 15}}},
+        {184ms, AMOTION_EVENT_ACTION_MOVE, {{1436, 750, 45}, {1074, 753, 15}}},
+        {192ms, AMOTION_EVENT_ACTION_MOVE, {{1436, 749, 44}, {1074, 751, 15}}},
+        {200ms, AMOTION_EVENT_ACTION_MOVE, {{1435, 748, 45}, {1074, 749, 15}}},
+        {208ms, AMOTION_EVENT_ACTION_MOVE, {{1434, 746, 44}, {1074, 747, 14}}},
+        {216ms, AMOTION_EVENT_ACTION_MOVE, {{1433, 744, 44}, {1075, 745, 14}}},
+        {224ms, AMOTION_EVENT_ACTION_MOVE, {{1431, 741, 43}, {1075, 742, 13}}},
+        {232ms, AMOTION_EVENT_ACTION_MOVE, {{1428, 738, 43}, {1076, 739, 12}}},
+        {240ms, AMOTION_EVENT_ACTION_MOVE, {{1400, 726, 54}, {1076, 739, 13}}},
+        {248ms, POINTER_1_UP, {{1362, 716, 55}, {1076, 739, 13}}},
+        {256ms, AMOTION_EVENT_ACTION_MOVE, {{1362, 716, 55}}},
+        {264ms, AMOTION_EVENT_ACTION_MOVE, {{1347, 707, 54}}},
+        {272ms, AMOTION_EVENT_ACTION_MOVE, {{1340, 698, 54}}},
+        {280ms, AMOTION_EVENT_ACTION_MOVE, {{1338, 694, 55}}},
+        {288ms, AMOTION_EVENT_ACTION_MOVE, {{1336, 690, 53}}},
+        {296ms, AMOTION_EVENT_ACTION_MOVE, {{1334, 685, 47}}},
+        {304ms, AMOTION_EVENT_ACTION_MOVE, {{1333, 679, 46}}},
+        {312ms, AMOTION_EVENT_ACTION_MOVE, {{1332, 672, 45}}},
+        {320ms, AMOTION_EVENT_ACTION_MOVE, {{1333, 666, 40}}},
+        {328ms, AMOTION_EVENT_ACTION_MOVE, {{1336, 661, 24}}},
+        {336ms, AMOTION_EVENT_ACTION_MOVE, {{1338, 656, 16}}},
+        {344ms, AMOTION_EVENT_ACTION_MOVE, {{1341, 649, 1}}},
+        {352ms, AMOTION_EVENT_ACTION_UP, {{1341, 649, 1}}},
+};
+
+static NotifyMotionArgs generateMotionArgs(nsecs_t downTime, const TraceSample& sample) {
+    const size_t pointerCount = sample.pointers.size();
+    PointerProperties pointerProperties[pointerCount];
+    PointerCoords pointerCoords[pointerCount];
+
+    for (size_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i;
+        pointerProperties[i].toolType = ToolType::FINGER;
+
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, sample.pointers[i].x);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, sample.pointers[i].y);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, sample.pointers[i].major);
+    }
+
+    const nsecs_t eventTime = downTime + sample.eventTime.count();
+    return NotifyMotionArgs(IInputConstants::INVALID_INPUT_EVENT_ID, eventTime, eventTime,
+                            DEVICE_ID, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                            POLICY_FLAG_PASS_TO_USER, sample.action, /*actionButton=*/0,
+                            /*flags=*/0, AMETA_NONE, /*buttonState=*/0, MotionClassification::NONE,
+                            AMOTION_EVENT_EDGE_FLAG_NONE, pointerCount, pointerProperties,
+                            pointerCoords, /*xPrecision=*/0, /*yPrecision=*/0,
+                            AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                            AMOTION_EVENT_INVALID_CURSOR_POSITION, downTime, /*videoFrames=*/{});
+}
+
+static InputDeviceInfo generateTouchscreenDeviceInfo() {
+    InputDeviceIdentifier identifier;
+    InputDeviceInfo info;
+    info.initialize(DEVICE_ID, /*generation=*/1, /*controllerNumber=*/1, identifier, "touchscreen",
+                    /*isExternal=*/false, /*hasMic=*/false, ADISPLAY_ID_NONE);
+    info.addSource(AINPUT_SOURCE_TOUCHSCREEN);
+    info.addMotionRange(AMOTION_EVENT_AXIS_X, AINPUT_SOURCE_TOUCHSCREEN, 0, 1599, /*flat=*/0,
+                        /*fuzz=*/0, /*resolution=*/11);
+    info.addMotionRange(AMOTION_EVENT_AXIS_Y, AINPUT_SOURCE_TOUCHSCREEN, 0, 2559, /*flat=*/0,
+                        /*fuzz=*/0, /*resolution=*/11);
+    info.addMotionRange(AMOTION_EVENT_AXIS_TOUCH_MAJOR, AINPUT_SOURCE_TOUCHSCREEN, 0, 255,
+                        /*flat=*/0, /*fuzz=*/0, /*resolution=*/1);
+    return info;
+}
+
+/**
+ * The next stage after the blocker. Records when the palm gets canceled.
+ */
+class PalmTrackingListener : public InputListenerInterface {
+public:
+    void notifyInputDevicesChanged(const NotifyInputDevicesChangedArgs&) override {}
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs&) override {}
+    void notifyKey(const NotifyKeyArgs&) override {}
+    void notifySwitch(const NotifySwitchArgs&) override {}
+    void notifySensor(const NotifySensorArgs&) override {}
+    void notifyVibratorState(const NotifyVibratorStateArgs&) override {}
+    void notifyDeviceReset(const NotifyDeviceResetArgs&) override {}
+    void notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs&) override {}
+
+    void notifyMotion(const NotifyMotionArgs& args) override {
+        if (args.action == AMOTION_EVENT_ACTION_DOWN) {
+            mFirstCancelTime.reset();
+            mGestureCanceled = false;
+        }
+        if ((args.flags & AMOTION_EVENT_FLAG_CANCELED) != 0 && !mFirstCancelTime) {
+            mFirstCancelTime = args.eventTime - args.downTime;
+        }
+        if (args.action == AMOTION_EVENT_ACTION_CANCEL) {
+            mGestureCanceled = true;
+        }
+    }
+
+    std::optional<nsecs_t> getFirstCancelTime() const { return mFirstCancelTime; }
+    bool isGestureCanceled() const { return mGestureCanceled; }
+
+private:
+    std::optional<nsecs_t> mFirstCancelTime;
+    bool mGestureCanceled = false;
+};
+
+/**
+ * Replay the palm trace through the blocker. The time of each iteration is the time it took for
+ * all of the events to be delivered to the next stage. The counters measure the suppression
+ * accuracy:
+ *   - palmsRejected: fraction of the gestures that were fully canceled
+ *   - firstCancelMs: event time from ACTION_DOWN until the first pointer got canceled
+ */
+static void replayPalmTrace(benchmark::State& state,
+                            std::optional<std::chrono::nanoseconds> asyncBudget) {
+    PalmTrackingListener listener;
+    UnwantedInteractionBlocker blocker(listener, /*enablePalmRejection=*/true, asyncBudget);
+    blocker.notifyInputDevicesChanged(
+            {IInputConstants::INVALID_INPUT_EVENT_ID, {generateTouchscreenDeviceInfo()}});
+
+    size_t canceledGestures = 0;
+    nsecs_t totalFirstCancelTime = 0;
+    // Every gesture starts well after the previous one ended, so that the model sees them as
+    // independent strokes.
+    nsecs_t downTime = 0;
+    for (auto _ : state) {
+        downTime += std::chrono::nanoseconds(1s).count();
+        for (const TraceSample& sample : PALM_TRACE) {
+            blocker.notifyMotion(generateMotionArgs(downTime, sample));
+        }
+        if (listener.isGestureCanceled()) {
+            canceledGestures++;
+        }
+        totalFirstCancelTime += listener.getFirstCancelTime().value_or(
+                PALM_TRACE.back().eventTime.count());
+    }
+
+    state.SetItemsProcessed(state.iterations() * PALM_TRACE.size());
+    state.counters["palmsRejected"] =
+            benchmark::Counter(canceledGestures, benchmark::Counter::kAvgIterations);
+    state.counters["firstCancelMs"] =
+            benchmark::Counter(ns2ms(totalFirstCancelTime), benchmark::Counter::kAvgIterations);
+}
+
+static void benchmarkPalmRejectionSync(benchmark::State& state) {
+    replayPalmTrace(state, /*asyncBudget=*/std::nullopt);
+}
+
+static void benchmarkPalmRejectionAsync(benchmark::State& state) {
+    replayPalmTrace(state, std::chrono::milliseconds(state.range(0)));
+}
+
+} // namespace
+
+BENCHMARK(benchmarkPalmRejectionSync);
+// Latency budget in milliseconds
+BENCHMARK(benchmarkPalmRejectionAsync)->Arg(0)->Arg(8)->Arg(16)->Arg(32);
+
+} // namespace android
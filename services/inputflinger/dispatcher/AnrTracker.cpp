@@ -16,15 +16,31 @@
 
 #include "AnrTracker.h"
 
-namespace android::inputdispatcher {
+#include <algorithm>
+#include <limits>
 
-template <typename T>
-static T max(const T& a, const T& b) {
-    return a < b ? b : a;
-}
+namespace android::inputdispatcher {
 
 void AnrTracker::insert(nsecs_t timeoutTime, sp<IBinder> token) {
-    mAnrTimeouts.insert(std::make_pair(timeoutTime, std::move(token)));
+    auto [it, _] = mTimeoutsByToken.try_emplace(token);
+    ConnectionTimeouts& connection = it->second;
+    std::deque<nsecs_t>& timeouts = connection.timeouts;
+
+    if (timeouts.empty()) {
+        connection.token = std::move(token);
+        timeouts.push_back(timeoutTime);
+        connection.heapIndex = mHeap.size();
+        mHeap.push_back(&connection);
+        siftUp(connection.heapIndex);
+    } else if (timeoutTime >= timeouts.back()) {
+        timeouts.push_back(timeoutTime);
+    } else {
+        timeouts.insert(std::upper_bound(timeouts.begin(), timeouts.end(), timeoutTime),
+                        timeoutTime);
+        if (timeouts.front() == timeoutTime) {
+            siftUp(connection.heapIndex);
+        }
+    }
 }
 
 /**
@@ -32,42 +48,111 @@ void AnrTracker::insert(nsecs_t timeoutTime, sp<IBinder> token) {
  * (same time, same connection), then only remove one of them.
  */
 void AnrTracker::erase(nsecs_t timeoutTime, const sp<IBinder>& token) {
-    auto pair = std::make_pair(timeoutTime, token);
-    auto it = mAnrTimeouts.find(pair);
-    if (it != mAnrTimeouts.end()) {
-        mAnrTimeouts.erase(it);
+    auto it = mTimeoutsByToken.find(token);
+    if (it == mTimeoutsByToken.end()) {
+        return;
     }
-}
+    ConnectionTimeouts& connection = it->second;
+    std::deque<nsecs_t>& timeouts = connection.timeouts;
 
-void AnrTracker::eraseToken(const sp<IBinder>& token) {
-    for (auto it = mAnrTimeouts.begin(); it != mAnrTimeouts.end();) {
-        if (it->second == token) {
-            it = mAnrTimeouts.erase(it);
+    if (timeouts.empty()) {
+        return;
+    }
+    if (timeouts.front() == timeoutTime) {
+        timeouts.pop_front();
+        if (timeouts.empty()) {
+            removeFromHeap(connection.heapIndex);
         } else {
-            ++it;
+            siftDown(connection.heapIndex);
         }
+        return;
+    }
+    auto timeout = std::lower_bound(timeouts.begin(), timeouts.end(), timeoutTime);
+    if (timeout != timeouts.end() && *timeout == timeoutTime) {
+        timeouts.erase(timeout);
+    }
+}
+
+void AnrTracker::eraseToken(const sp<IBinder>& token) {
+    auto it = mTimeoutsByToken.find(token);
+    if (it == mTimeoutsByToken.end()) {
+        return;
     }
+    if (!it->second.timeouts.empty()) {
+        removeFromHeap(it->second.heapIndex);
+    }
+    mTimeoutsByToken.erase(it);
 }
 
 bool AnrTracker::empty() const {
-    return mAnrTimeouts.empty();
+    return mHeap.empty();
 }
 
 // If empty() is false, return the time at which the next connection should cause an ANR
 // If empty() is true, return LLONG_MAX
 nsecs_t AnrTracker::firstTimeout() const {
-    if (mAnrTimeouts.empty()) {
+    if (mHeap.empty()) {
         return std::numeric_limits<nsecs_t>::max();
     }
-    return mAnrTimeouts.begin()->first;
+    return mHeap.front()->timeouts.front();
 }
 
 const sp<IBinder>& AnrTracker::firstToken() const {
-    return mAnrTimeouts.begin()->second;
+    return mHeap.front()->token;
 }
 
 void AnrTracker::clear() {
-    mAnrTimeouts.clear();
+    mHeap.clear();
+    mTimeoutsByToken.clear();
+}
+
+bool AnrTracker::isBefore(size_t lhs, size_t rhs) const {
+    return mHeap[lhs]->timeouts.front() < mHeap[rhs]->timeouts.front();
+}
+
+void AnrTracker::swap(size_t lhs, size_t rhs) {
+    std::swap(mHeap[lhs], mHeap[rhs]);
+    mHeap[lhs]->heapIndex = lhs;
+    mHeap[rhs]->heapIndex = rhs;
+}
+
+void AnrTracker::siftUp(size_t index) {
+    while (index > 0) {
+        const size_t parent = (index - 1) / 2;
+        if (!isBefore(index, parent)) {
+            return;
+        }
+        swap(index, parent);
+        index = parent;
+    }
+}
+
+void AnrTracker::siftDown(size_t index) {
+    while (true) {
+        const size_t left = 2 * index + 1;
+        if (left >= mHeap.size()) {
+            return;
+        }
+        const size_t right = left + 1;
+        const size_t child = right < mHeap.size() && isBefore(right, left) ? right : left;
+        if (!isBefore(child, index)) {
+            return;
+        }
+        swap(index, child);
+        index = child;
+    }
+}
+
+void AnrTracker::removeFromHeap(size_t index) {
+    const size_t last = mHeap.size() - 1;
+    if (index != last) {
+        swap(index, last);
+    }
+    mHeap.pop_back();
+    if (index < mHeap.size()) {
+        siftUp(index);
+        siftDown(index);
+    }
 }
 
 } // namespace android::inputdispatcher
@@ -18,13 +18,19 @@
 
 #include <binder/IBinder.h>
 #include <utils/Timers.h>
-#include <set>
+#include <deque>
+#include <unordered_map>
+#include <vector>
 
 namespace android::inputdispatcher {
 
 /**
  * Keeps track of the times when each connection is going to ANR.
  * Provides the ability to quickly find the connection that is going to cause ANR next.
+ *
+ * The timeouts are kept per connection, and the connections are kept in a heap ordered by their
+ * first timeout. Inserting and erasing in order only touch the heap when the first timeout of a
+ * connection changes, and erasing all the timeouts of a connection does not look at the others.
  */
 class AnrTracker {
 public:
@@ -42,16 +48,38 @@ public:
     const sp<IBinder>& firstToken() const;
 
 private:
-    // Optimization: use a multiset to keep track of the event timeouts. When an event is sent
-    // to the InputConsumer, we add an entry to this structure. We look at the smallest value to
-    // determine if any of the connections is unresponsive, and to determine when we should wake
-    // next for the future ANR check.
-    // Using a multiset helps quickly look up the next timeout due.
+    // The pending timeouts of a connection, in increasing order. Events are sent to a connection,
+    // and finished by it, mostly in order, so timeouts are usually appended at the back and
+    // removed from the front.
     //
-    // We must use a multi-set, because it is plausible (although highly unlikely) to have entries
+    // There may be duplicates, because it is plausible (although highly unlikely) to have entries
     // from the same connection and same timestamp, but different sequence numbers.
     // We are not tracking sequence numbers, and just allow duplicates to exist.
-    std::multiset<std::pair<nsecs_t /*timeoutTime*/, sp<IBinder> /*connectionToken*/>> mAnrTimeouts;
+    struct ConnectionTimeouts {
+        sp<IBinder> token;
+        std::deque<nsecs_t> timeouts;
+        // Position in mHeap, if timeouts is not empty.
+        size_t heapIndex = 0;
+    };
+
+    struct IBinderHash {
+        std::size_t operator()(const sp<IBinder>& b) const {
+            return std::hash<IBinder*>{}(b.get());
+        }
+    };
+
+    bool isBefore(size_t lhs, size_t rhs) const;
+    void swap(size_t lhs, size_t rhs);
+    void siftUp(size_t index);
+    void siftDown(size_t index);
+    void removeFromHeap(size_t index);
+
+    // A connection keeps its entry while its timeouts come and go, so that the steady state of
+    // dispatching does not allocate. The entry is removed by eraseToken.
+    std::unordered_map<sp<IBinder>, ConnectionTimeouts, IBinderHash> mTimeoutsByToken;
+    // Min-heap of the connections that have pending timeouts, ordered by their first timeout.
+    // The entries of mTimeoutsByToken are never moved, so they can be pointed to.
+    std::vector<ConnectionTimeouts*> mHeap;
 };
 
 } // namespace android::inputdispatcher
@@ -19,8 +19,8 @@
 #include "../InputDeviceMetricsSource.h"
 
 #include <binder/IBinder.h>
+#include <ftl/small_map.h>
 #include <input/Input.h>
-#include <unordered_map>
 
 namespace android {
 
@@ -77,20 +77,16 @@ private:
 struct InputEventTimeline {
     InputEventTimeline(bool isDown, nsecs_t eventTime, nsecs_t readTime, uint16_t vendorId,
                        uint16_t productId, std::set<InputDeviceUsageSource> sources);
-    const bool isDown; // True if this is an ACTION_DOWN event
-    const nsecs_t eventTime;
-    const nsecs_t readTime;
-    const uint16_t vendorId;
-    const uint16_t productId;
-    const std::set<InputDeviceUsageSource> sources;
-
-    struct IBinderHash {
-        std::size_t operator()(const sp<IBinder>& b) const {
-            return std::hash<IBinder*>{}(b.get());
-        }
-    };
-
-    std::unordered_map<sp<IBinder>, ConnectionTimeline, IBinderHash> connectionTimelines;
+    bool isDown; // True if this is an ACTION_DOWN event
+    nsecs_t eventTime;
+    nsecs_t readTime;
+    uint16_t vendorId;
+    uint16_t productId;
+    std::set<InputDeviceUsageSource> sources;
+
+    // Most events go to a few connections only, so their timelines are stored inline.
+    static constexpr size_t INLINE_CONNECTION_COUNT = 4;
+    ftl::SmallMap<sp<IBinder>, ConnectionTimeline, INLINE_CONNECTION_COUNT> connectionTimelines;
 
     bool operator==(const InputEventTimeline& rhs) const;
 };
@@ -20,6 +20,8 @@
 
 #include <inttypes.h>
 
+#include <limits>
+
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
 #include <android/os/IInputConstants.h>
@@ -48,22 +50,24 @@ static bool isMatureEvent(nsecs_t eventTime, nsecs_t now) {
 }
 
 /**
- * A multimap allows to have several entries with the same key. This function just erases a specific
- * key-value pair. Equivalent to the imaginary std api std::multimap::erase(key, value).
+ * The ring starts with room for this many events, and doubles when it is full, up to
+ * MAX_RECORD_COUNT. That is enough for a few touchscreens reporting at a high rate during the ANR
+ * timeout.
  */
-template <typename K, typename V>
-static void eraseByValue(std::multimap<K, V>& map, const V& value) {
-    for (auto it = map.begin(); it != map.end();) {
-        if (it->second == value) {
-            it = map.erase(it);
-        } else {
-            it++;
-        }
-    }
+constexpr size_t INITIAL_RECORD_COUNT = 64;
+constexpr size_t MAX_RECORD_COUNT = 4096;
+
+constexpr uint32_t EMPTY_INDEX_ENTRY = std::numeric_limits<uint32_t>::max();
+
+static size_t hashInputEventId(int32_t inputEventId, size_t mask) {
+    // Event ids are mostly random, but mix them anyway so that sequential ids spread out.
+    return (static_cast<uint32_t>(inputEventId) * 0x9E3779B1u) & mask;
 }
 
 LatencyTracker::LatencyTracker(InputEventTimelineProcessor* processor)
-      : mTimelineProcessor(processor) {
+      : mRecords(INITIAL_RECORD_COUNT),
+        mIndex(2 * INITIAL_RECORD_COUNT, IndexEntry{0, EMPTY_INDEX_ENTRY}),
+        mTimelineProcessor(processor) {
     LOG_ALWAYS_FATAL_IF(processor == nullptr);
 }
 
@@ -71,14 +75,14 @@ void LatencyTracker::trackListener(int32_t inputEventId, bool isDown, nsecs_t ev
                                    nsecs_t readTime, DeviceId deviceId,
                                    const std::set<InputDeviceUsageSource>& sources) {
     reportAndPruneMatureRecords(eventTime);
-    const auto it = mTimelines.find(inputEventId);
-    if (it != mTimelines.end()) {
+    if (const size_t position = findIndexEntry(inputEventId); position != mIndex.size()) {
         // Input event ids are randomly generated, so it's possible that two events have the same
         // event id. Drop this event, and also drop the existing event because the apps would
         // confuse us by reporting the rest of the timeline for one of them. This should happen
         // rarely, so we won't lose much data
-        mTimelines.erase(it);
-        eraseByValue(mEventTimes, inputEventId);
+        mRecords[mIndex[position].recordIndex].active = false;
+        removeIndexEntry(position);
+        mActiveRecordCount--;
         return;
     }
 
@@ -101,30 +105,53 @@ void LatencyTracker::trackListener(int32_t inputEventId, bool isDown, nsecs_t ev
         return;
     }
 
-    mTimelines.emplace(inputEventId,
-                       InputEventTimeline(isDown, eventTime, readTime, identifier->vendor,
-                                          identifier->product, sources));
-    mEventTimes.emplace(eventTime, inputEventId);
+    if (mRecordCount == mRecords.size()) {
+        if (mRecords.size() < MAX_RECORD_COUNT) {
+            grow();
+        } else {
+            popOldestRecord();
+        }
+    }
+
+    const size_t recordIndex = (mHead + mRecordCount) % mRecords.size();
+    Record& record = mRecords[recordIndex];
+    record.inputEventId = inputEventId;
+    record.active = true;
+    if (record.timeline) {
+        // Reuse the storage of the reported event.
+        InputEventTimeline& timeline = *record.timeline;
+        timeline.isDown = isDown;
+        timeline.eventTime = eventTime;
+        timeline.readTime = readTime;
+        timeline.vendorId = identifier->vendor;
+        timeline.productId = identifier->product;
+        timeline.sources = sources;
+        timeline.connectionTimelines.clear();
+    } else {
+        record.timeline.emplace(isDown, eventTime, readTime, identifier->vendor,
+                                identifier->product, sources);
+    }
+    mRecordCount++;
+    mActiveRecordCount++;
+    addIndexEntry(inputEventId, recordIndex);
 }
 
 void LatencyTracker::trackFinishedEvent(int32_t inputEventId, const sp<IBinder>& connectionToken,
                                         nsecs_t deliveryTime, nsecs_t consumeTime,
                                         nsecs_t finishTime) {
-    const auto it = mTimelines.find(inputEventId);
-    if (it == mTimelines.end()) {
+    InputEventTimeline* timeline = findTimeline(inputEventId);
+    if (timeline == nullptr) {
         // This could happen if we erased this event when duplicate events were detected. It's
         // also possible that an app sent a bad (or late) 'Finish' signal, since it's free to do
         // anything in its process. Just drop the report and move on.
         return;
     }
 
-    InputEventTimeline& timeline = it->second;
-    const auto connectionIt = timeline.connectionTimelines.find(connectionToken);
-    if (connectionIt == timeline.connectionTimelines.end()) {
+    const auto connectionIt = timeline->connectionTimelines.find(connectionToken);
+    if (connectionIt == timeline->connectionTimelines.end()) {
         // Most likely case: app calls 'finishInputEvent' before it reports the graphics timeline
-        timeline.connectionTimelines.emplace(connectionToken,
-                                             ConnectionTimeline{deliveryTime, consumeTime,
-                                                                finishTime});
+        timeline->connectionTimelines.try_emplace(connectionToken, deliveryTime, consumeTime,
+                                                  finishTime);
     } else {
         // Already have a record for this connectionToken
         ConnectionTimeline& connectionTimeline = connectionIt->second;
@@ -133,7 +160,7 @@ void LatencyTracker::trackFinishedEvent(int32_t inputEventId, const sp<IBinder>&
         if (!success) {
             // We are receiving unreliable data from the app. Just delete the entire connection
             // timeline for this event
-            timeline.connectionTimelines.erase(connectionIt);
+            timeline->connectionTimelines.erase(connectionToken);
         }
     }
 }
@@ -141,18 +168,17 @@ void LatencyTracker::trackFinishedEvent(int32_t inputEventId, const sp<IBinder>&
 void LatencyTracker::trackGraphicsLatency(
         int32_t inputEventId, const sp<IBinder>& connectionToken,
         std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline) {
-    const auto it = mTimelines.find(inputEventId);
-    if (it == mTimelines.end()) {
+    InputEventTimeline* timeline = findTimeline(inputEventId);
+    if (timeline == nullptr) {
         // This could happen if we erased this event when duplicate events were detected. It's
         // also possible that an app sent a bad (or late) 'Timeline' signal, since it's free to do
         // anything in its process. Just drop the report and move on.
         return;
     }
 
-    InputEventTimeline& timeline = it->second;
-    const auto connectionIt = timeline.connectionTimelines.find(connectionToken);
-    if (connectionIt == timeline.connectionTimelines.end()) {
-        timeline.connectionTimelines.emplace(connectionToken, std::move(graphicsTimeline));
+    const auto connectionIt = timeline->connectionTimelines.find(connectionToken);
+    if (connectionIt == timeline->connectionTimelines.end()) {
+        timeline->connectionTimelines.try_emplace(connectionToken, std::move(graphicsTimeline));
     } else {
         // Most likely case
         ConnectionTimeline& connectionTimeline = connectionIt->second;
@@ -160,7 +186,7 @@ void LatencyTracker::trackGraphicsLatency(
         if (!success) {
             // We are receiving unreliable data from the app. Just delete the entire connection
             // timeline for this event
-            timeline.connectionTimelines.erase(connectionIt);
+            timeline->connectionTimelines.erase(connectionToken);
         }
     }
 }
@@ -171,29 +197,102 @@ void LatencyTracker::trackGraphicsLatency(
  * 'trackListener' should happen soon after the event occurs.
  */
 void LatencyTracker::reportAndPruneMatureRecords(nsecs_t newEventTime) {
-    while (!mEventTimes.empty()) {
-        const auto& [oldestEventTime, oldestInputEventId] = *mEventTimes.begin();
-        if (isMatureEvent(oldestEventTime, /*now=*/newEventTime)) {
-            // Report and drop this event
-            const auto it = mTimelines.find(oldestInputEventId);
-            LOG_ALWAYS_FATAL_IF(it == mTimelines.end(),
-                                "Event %" PRId32 " is in mEventTimes, but not in mTimelines",
-                                oldestInputEventId);
-            const InputEventTimeline& timeline = it->second;
-            mTimelineProcessor->processTimeline(timeline);
-            mTimelines.erase(it);
-            mEventTimes.erase(mEventTimes.begin());
-        } else {
+    while (mRecordCount > 0) {
+        const Record& oldest = mRecords[mHead];
+        if (oldest.active && !isMatureEvent(oldest.timeline->eventTime, /*now=*/newEventTime)) {
             // If the oldest event does not need to be pruned, no events should be pruned.
             return;
         }
+        popOldestRecord();
+    }
+}
+
+void LatencyTracker::popOldestRecord() {
+    Record& oldest = mRecords[mHead];
+    if (oldest.active) {
+        // Report and drop this event
+        const size_t position = findIndexEntry(oldest.inputEventId);
+        LOG_ALWAYS_FATAL_IF(position == mIndex.size(),
+                            "Event %" PRId32 " is in mRecords, but not in mIndex",
+                            oldest.inputEventId);
+        mTimelineProcessor->processTimeline(*oldest.timeline);
+        removeIndexEntry(position);
+        oldest.active = false;
+        mActiveRecordCount--;
+    }
+    mHead = (mHead + 1) % mRecords.size();
+    mRecordCount--;
+}
+
+void LatencyTracker::grow() {
+    // Unroll the ring into the larger one, oldest first.
+    std::vector<Record> records(2 * mRecords.size());
+    for (size_t i = 0; i < mRecordCount; i++) {
+        records[i] = std::move(mRecords[(mHead + i) % mRecords.size()]);
+    }
+    mRecords = std::move(records);
+    mHead = 0;
+
+    mIndex.assign(2 * mRecords.size(), IndexEntry{0, EMPTY_INDEX_ENTRY});
+    for (size_t i = 0; i < mRecordCount; i++) {
+        if (mRecords[i].active) {
+            addIndexEntry(mRecords[i].inputEventId, i);
+        }
+    }
+}
+
+InputEventTimeline* LatencyTracker::findTimeline(int32_t inputEventId) {
+    const size_t position = findIndexEntry(inputEventId);
+    if (position == mIndex.size()) {
+        return nullptr;
+    }
+    return &*mRecords[mIndex[position].recordIndex].timeline;
+}
+
+size_t LatencyTracker::findIndexEntry(int32_t inputEventId) const {
+    const size_t mask = mIndex.size() - 1;
+    for (size_t position = hashInputEventId(inputEventId, mask);;
+         position = (position + 1) & mask) {
+        const IndexEntry& entry = mIndex[position];
+        if (entry.recordIndex == EMPTY_INDEX_ENTRY) {
+            return mIndex.size();
+        }
+        if (entry.inputEventId == inputEventId) {
+            return position;
+        }
+    }
+}
+
+void LatencyTracker::addIndexEntry(int32_t inputEventId, size_t recordIndex) {
+    const size_t mask = mIndex.size() - 1;
+    size_t position = hashInputEventId(inputEventId, mask);
+    while (mIndex[position].recordIndex != EMPTY_INDEX_ENTRY) {
+        position = (position + 1) & mask;
+    }
+    mIndex[position] = {inputEventId, static_cast<uint32_t>(recordIndex)};
+}
+
+void LatencyTracker::removeIndexEntry(size_t position) {
+    // Shift back the entries that follow in the same probe sequence, so that lookups do not need
+    // tombstones.
+    const size_t mask = mIndex.size() - 1;
+    size_t hole = position;
+    for (size_t next = (hole + 1) & mask; mIndex[next].recordIndex != EMPTY_INDEX_ENTRY;
+         next = (next + 1) & mask) {
+        const size_t home = hashInputEventId(mIndex[next].inputEventId, mask);
+        // The entry can fill the hole if its home is not cyclically within (hole, next].
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            mIndex[hole] = mIndex[next];
+            hole = next;
+        }
     }
+    mIndex[hole].recordIndex = EMPTY_INDEX_ENTRY;
 }
 
 std::string LatencyTracker::dump(const char* prefix) const {
     return StringPrintf("%sLatencyTracker:\n", prefix) +
-            StringPrintf("%s  mTimelines.size() = %zu\n", prefix, mTimelines.size()) +
-            StringPrintf("%s  mEventTimes.size() = %zu\n", prefix, mEventTimes.size());
+            StringPrintf("%s  tracked events = %zu\n", prefix, mActiveRecordCount) +
+            StringPrintf("%s  records = %zu / %zu\n", prefix, mRecordCount, mRecords.size());
 }
 
 void LatencyTracker::setInputDevices(const std::vector<InputDeviceInfo>& inputDevices) {
@@ -18,8 +18,8 @@
 
 #include "../InputDeviceMetricsSource.h"
 
-#include <map>
-#include <unordered_map>
+#include <optional>
+#include <vector>
 
 #include <binder/IBinder.h>
 #include <input/Input.h>
@@ -64,25 +64,53 @@ public:
 
 private:
     /**
-     * A collection of InputEventTimelines keyed by inputEventId. An InputEventTimeline is first
-     * created when 'trackListener' is called.
-     * When either 'trackFinishedEvent' or 'trackGraphicsLatency' is called for this input event,
-     * the corresponding InputEventTimeline will be updated for that token.
+     * An event that 'trackListener' started tracking. Records are reused once they are reported,
+     * so that tracking does not allocate once there are enough of them for the events in flight.
      */
-    std::unordered_map<int32_t /*inputEventId*/, InputEventTimeline> mTimelines;
+    struct Record {
+        int32_t inputEventId = 0;
+        // False if the record is not tracking an event anymore, because duplicate events were
+        // detected.
+        bool active = false;
+        std::optional<InputEventTimeline> timeline;
+    };
+
+    /**
+     * Ring of records, in the order of 'trackListener'. The oldest record is at mHead. Since events
+     * are tracked in the order they are received, they mature in ring order, so pruning only looks
+     * at the oldest records. The ring grows up to MAX_RECORD_COUNT, past which the oldest event is
+     * reported before it matures.
+     */
+    std::vector<Record> mRecords;
+    size_t mHead = 0;
+    // Records in the ring, including the inactive ones.
+    size_t mRecordCount = 0;
+    // Active records, which are the events being tracked.
+    size_t mActiveRecordCount = 0;
+
     /**
-     * The collection of eventTimes will help us quickly find the events that we should prune
-     * from the 'mTimelines'. Since 'mTimelines' is keyed by inputEventId, it would be inefficient
-     * to walk through it directly to find the oldest input events to get rid of.
-     * There is a 1:1 mapping between 'mTimelines' and 'mEventTimes'.
-     * We are using 'multimap' instead of 'map' because there could be more than 1 event with the
-     * same eventTime.
+     * Open addressing hash table from inputEventId to the position in mRecords of the active
+     * records, with linear probing. It is twice as large as mRecords.
      */
-    std::multimap<nsecs_t /*eventTime*/, int32_t /*inputEventId*/> mEventTimes;
+    struct IndexEntry {
+        int32_t inputEventId;
+        uint32_t recordIndex;
+    };
+    std::vector<IndexEntry> mIndex;
 
     InputEventTimelineProcessor* mTimelineProcessor;
     std::vector<InputDeviceInfo> mInputDevices;
+
     void reportAndPruneMatureRecords(nsecs_t newEventTime);
+    // Reports the oldest record if it is active, and removes it from the ring.
+    void popOldestRecord();
+    // Doubles the size of the ring, which must be full.
+    void grow();
+
+    InputEventTimeline* findTimeline(int32_t inputEventId);
+    size_t findIndexEntry(int32_t inputEventId) const;
+    void addIndexEntry(int32_t inputEventId, size_t recordIndex);
+    void removeIndexEntry(size_t position);
 };
 
 } // namespace android::inputdispatcher
@@ -514,7 +514,7 @@ std::list<NotifyArgs> TouchpadInputMapper::processGestures(nsecs_t when, nsecs_t
     if (mDisplayId) {
         MetricsAccumulator& metricsAccumulator = MetricsAccumulator::getInstance();
         for (Gesture& gesture : mGesturesToProcess) {
-            out += mGestureConverter.handleGesture(when, readTime, gesture);
+            mGestureConverter.handleGesture(when, readTime, gesture, out);
             metricsAccumulator.processGesture(mMetricsId, gesture);
         }
     }
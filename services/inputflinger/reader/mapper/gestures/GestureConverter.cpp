@@ -82,20 +82,20 @@ std::list<NotifyArgs> GestureConverter::reset(nsecs_t when) {
     std::list<NotifyArgs> out;
     switch (mCurrentClassification) {
         case MotionClassification::TWO_FINGER_SWIPE:
-            out.push_back(endScroll(when, when));
+            endScroll(when, when, out);
             break;
         case MotionClassification::MULTI_FINGER_SWIPE:
-            out += handleMultiFingerSwipeLift(when, when);
+            handleMultiFingerSwipeLift(when, when, out);
             break;
         case MotionClassification::PINCH:
-            out += endPinch(when, when);
+            endPinch(when, when, out);
             break;
         case MotionClassification::NONE:
             // When a button is pressed, the Gestures library always ends the current gesture,
             // so we don't have to worry about the case where buttons need to be lifted during a
             // pinch or swipe.
             if (mButtonState) {
-                out += releaseAllButtons(when, when);
+                releaseAllButtons(when, when, out);
             }
             break;
         default:
@@ -132,38 +132,53 @@ void GestureConverter::populateMotionRanges(InputDeviceInfo& info) const {
 
 std::list<NotifyArgs> GestureConverter::handleGesture(nsecs_t when, nsecs_t readTime,
                                                       const Gesture& gesture) {
+    std::list<NotifyArgs> out;
+    handleGesture(when, readTime, gesture, out);
+    return out;
+}
+
+void GestureConverter::handleGesture(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                                     std::list<NotifyArgs>& out) {
     if (!mDisplayId) {
         // Ignore gestures when there is no target display configured.
-        return {};
+        return;
     }
 
     switch (gesture.type) {
         case kGestureTypeMove:
-            return {handleMove(when, readTime, gesture)};
+            handleMove(when, readTime, gesture, out);
+            break;
         case kGestureTypeButtonsChange:
-            return handleButtonsChange(when, readTime, gesture);
+            handleButtonsChange(when, readTime, gesture, out);
+            break;
         case kGestureTypeScroll:
-            return handleScroll(when, readTime, gesture);
+            handleScroll(when, readTime, gesture, out);
+            break;
         case kGestureTypeFling:
-            return handleFling(when, readTime, gesture);
+            handleFling(when, readTime, gesture, out);
+            break;
         case kGestureTypeSwipe:
-            return handleMultiFingerSwipe(when, readTime, 3, gesture.details.swipe.dx,
-                                          gesture.details.swipe.dy);
+            handleMultiFingerSwipe(when, readTime, 3, gesture.details.swipe.dx,
+                                   gesture.details.swipe.dy, out);
+            break;
         case kGestureTypeFourFingerSwipe:
-            return handleMultiFingerSwipe(when, readTime, 4, gesture.details.four_finger_swipe.dx,
-                                          gesture.details.four_finger_swipe.dy);
+            handleMultiFingerSwipe(when, readTime, 4, gesture.details.four_finger_swipe.dx,
+                                   gesture.details.four_finger_swipe.dy, out);
+            break;
         case kGestureTypeSwipeLift:
         case kGestureTypeFourFingerSwipeLift:
-            return handleMultiFingerSwipeLift(when, readTime);
+            handleMultiFingerSwipeLift(when, readTime, out);
+            break;
         case kGestureTypePinch:
-            return handlePinch(when, readTime, gesture);
+            handlePinch(when, readTime, gesture, out);
+            break;
         default:
-            return {};
+            break;
     }
 }
 
-NotifyMotionArgs GestureConverter::handleMove(nsecs_t when, nsecs_t readTime,
-                                              const Gesture& gesture) {
+void GestureConverter::handleMove(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                                  std::list<NotifyArgs>& out) {
     float deltaX = gesture.details.move.dx;
     float deltaY = gesture.details.move.dy;
     if (ENABLE_TOUCHPAD_PALM_REJECTION && (std::abs(deltaX) > 0 || std::abs(deltaY) > 0)) {
@@ -188,15 +203,13 @@ NotifyMotionArgs GestureConverter::handleMove(nsecs_t when, nsecs_t readTime,
     coords.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, down ? 1.0f : 0.0f);
 
     const int32_t action = down ? AMOTION_EVENT_ACTION_MOVE : AMOTION_EVENT_ACTION_HOVER_MOVE;
-    return makeMotionArgs(when, readTime, action, /* actionButton= */ 0, mButtonState,
-                          /* pointerCount= */ 1, mFingerProps.data(), &coords, xCursorPosition,
-                          yCursorPosition);
+    out.push_back(makeMotionArgs(when, readTime, action, /* actionButton= */ 0, mButtonState,
+                                 /* pointerCount= */ 1, mFingerProps.data(), &coords,
+                                 xCursorPosition, yCursorPosition));
 }
 
-std::list<NotifyArgs> GestureConverter::handleButtonsChange(nsecs_t when, nsecs_t readTime,
-                                                            const Gesture& gesture) {
-    std::list<NotifyArgs> out = {};
-
+void GestureConverter::handleButtonsChange(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                                           std::list<NotifyArgs>& out) {
     mPointerController->setPresentation(PointerControllerInterface::Presentation::POINTER);
     mPointerController->unfade(PointerControllerInterface::Transition::IMMEDIATE);
 
@@ -214,7 +227,7 @@ std::list<NotifyArgs> GestureConverter::handleButtonsChange(nsecs_t when, nsecs_
         enableTapToClick();
         if (gesture.details.buttons.is_tap) {
             // return early to prevent this tap
-            return out;
+            return;
         }
     }
 
@@ -225,17 +238,13 @@ std::list<NotifyArgs> GestureConverter::handleButtonsChange(nsecs_t when, nsecs_
     coords.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, pointerDown ? 1.0f : 0.0f);
 
     uint32_t newButtonState = mButtonState;
-    std::list<NotifyArgs> pressEvents = {};
     for (uint32_t button = 1; button <= GESTURES_BUTTON_FORWARD; button <<= 1) {
         if (buttonsPressed & button) {
-            uint32_t actionButton = gesturesButtonToMotionEventButton(button);
-            newButtonState |= actionButton;
-            pressEvents.push_back(makeMotionArgs(when, readTime, AMOTION_EVENT_ACTION_BUTTON_PRESS,
-                                                 actionButton, newButtonState,
-                                                 /* pointerCount= */ 1, mFingerProps.data(),
-                                                 &coords, xCursorPosition, yCursorPosition));
+            newButtonState |= gesturesButtonToMotionEventButton(button);
         }
     }
+    // The DOWN event has to come before the BUTTON_PRESS events, and reports every button that is
+    // going down, whereas each BUTTON_PRESS only includes the buttons pressed up to that point.
     if (!isPointerDown(mButtonState) && isPointerDown(newButtonState)) {
         mDownTime = when;
         out.push_back(makeMotionArgs(when, readTime, AMOTION_EVENT_ACTION_DOWN,
@@ -243,7 +252,17 @@ std::list<NotifyArgs> GestureConverter::handleButtonsChange(nsecs_t when, nsecs_
                                      mFingerProps.data(), &coords, xCursorPosition,
                                      yCursorPosition));
     }
-    out.splice(out.end(), pressEvents);
+    uint32_t pressedButtonState = mButtonState;
+    for (uint32_t button = 1; button <= GESTURES_BUTTON_FORWARD; button <<= 1) {
+        if (buttonsPressed & button) {
+            uint32_t actionButton = gesturesButtonToMotionEventButton(button);
+            pressedButtonState |= actionButton;
+            out.push_back(makeMotionArgs(when, readTime, AMOTION_EVENT_ACTION_BUTTON_PRESS,
+                                         actionButton, pressedButtonState, /* pointerCount= */ 1,
+                                         mFingerProps.data(), &coords, xCursorPosition,
+                                         yCursorPosition));
+        }
+    }
 
     // The same button may be in both down and up in the same gesture, in which case we should treat
     // it as having gone down and then up. So, we treat a single button change gesture as two state
@@ -273,11 +292,10 @@ std::list<NotifyArgs> GestureConverter::handleButtonsChange(nsecs_t when, nsecs_
                                      yCursorPosition));
     }
     mButtonState = newButtonState;
-    return out;
 }
 
-std::list<NotifyArgs> GestureConverter::releaseAllButtons(nsecs_t when, nsecs_t readTime) {
-    std::list<NotifyArgs> out;
+void GestureConverter::releaseAllButtons(nsecs_t when, nsecs_t readTime,
+                                         std::list<NotifyArgs>& out) {
     const auto [xCursorPosition, yCursorPosition] =
             mEnablePointerChoreographer ? FloatPoint{0, 0} : mPointerController->getPosition();
 
@@ -307,12 +325,10 @@ std::list<NotifyArgs> GestureConverter::releaseAllButtons(nsecs_t when, nsecs_t
                                      &coords, xCursorPosition, yCursorPosition));
     }
     mButtonState = 0;
-    return out;
 }
 
-std::list<NotifyArgs> GestureConverter::handleScroll(nsecs_t when, nsecs_t readTime,
-                                                     const Gesture& gesture) {
-    std::list<NotifyArgs> out;
+void GestureConverter::handleScroll(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                                    std::list<NotifyArgs>& out) {
     PointerCoords& coords = mFakeFingerCoords[0];
     const auto [xCursorPosition, yCursorPosition] =
             mEnablePointerChoreographer ? FloatPoint{0, 0} : mPointerController->getPosition();
@@ -327,7 +343,7 @@ std::list<NotifyArgs> GestureConverter::handleScroll(nsecs_t when, nsecs_t readT
                                mButtonState, /* pointerCount= */ 1, mFingerProps.data(),
                                mFakeFingerCoords.data(), xCursorPosition, yCursorPosition);
         args.flags |= AMOTION_EVENT_FLAG_IS_GENERATED_GESTURE;
-        out.push_back(args);
+        out.push_back(std::move(args));
     }
     float deltaX = gesture.details.scroll.dx;
     float deltaY = gesture.details.scroll.dy;
@@ -343,12 +359,11 @@ std::list<NotifyArgs> GestureConverter::handleScroll(nsecs_t when, nsecs_t readT
                            mButtonState, /* pointerCount= */ 1, mFingerProps.data(),
                            mFakeFingerCoords.data(), xCursorPosition, yCursorPosition);
     args.flags |= AMOTION_EVENT_FLAG_IS_GENERATED_GESTURE;
-    out.push_back(args);
-    return out;
+    out.push_back(std::move(args));
 }
 
-std::list<NotifyArgs> GestureConverter::handleFling(nsecs_t when, nsecs_t readTime,
-                                                    const Gesture& gesture) {
+void GestureConverter::handleFling(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                                   std::list<NotifyArgs>& out) {
     switch (gesture.details.fling.fling_state) {
         case GESTURES_FLING_START:
             if (mCurrentClassification == MotionClassification::TWO_FINGER_SWIPE) {
@@ -356,7 +371,7 @@ std::list<NotifyArgs> GestureConverter::handleFling(nsecs_t when, nsecs_t readTi
                 // ensure consistency between touchscreen and touchpad flings), so we're just using
                 // the "start fling" gestures as a marker for the end of a two-finger scroll
                 // gesture.
-                return {endScroll(when, readTime)};
+                endScroll(when, readTime, out);
             }
             break;
         case GESTURES_FLING_TAP_DOWN:
@@ -369,20 +384,19 @@ std::list<NotifyArgs> GestureConverter::handleFling(nsecs_t when, nsecs_t readTi
                 if (!mReaderContext.isPreventingTouchpadTaps()) {
                     enableTapToClick();
                 }
-                return {handleMove(when, readTime,
-                                   Gesture(kGestureMove, gesture.start_time, gesture.end_time,
-                                           /*dx=*/0.f,
-                                           /*dy=*/0.f))};
+                handleMove(when, readTime,
+                           Gesture(kGestureMove, gesture.start_time, gesture.end_time,
+                                   /*dx=*/0.f,
+                                   /*dy=*/0.f),
+                           out);
             }
             break;
         default:
             break;
     }
-
-    return {};
 }
 
-NotifyMotionArgs GestureConverter::endScroll(nsecs_t when, nsecs_t readTime) {
+void GestureConverter::endScroll(nsecs_t when, nsecs_t readTime, std::list<NotifyArgs>& out) {
     const auto [xCursorPosition, yCursorPosition] =
             mEnablePointerChoreographer ? FloatPoint{0, 0} : mPointerController->getPosition();
     mFakeFingerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_GESTURE_SCROLL_X_DISTANCE, 0);
@@ -392,16 +406,13 @@ NotifyMotionArgs GestureConverter::endScroll(nsecs_t when, nsecs_t readTime) {
                            mButtonState, /* pointerCount= */ 1, mFingerProps.data(),
                            mFakeFingerCoords.data(), xCursorPosition, yCursorPosition);
     args.flags |= AMOTION_EVENT_FLAG_IS_GENERATED_GESTURE;
+    out.push_back(std::move(args));
     mCurrentClassification = MotionClassification::NONE;
-    return args;
 }
 
-[[nodiscard]] std::list<NotifyArgs> GestureConverter::handleMultiFingerSwipe(nsecs_t when,
-                                                                             nsecs_t readTime,
-                                                                             uint32_t fingerCount,
-                                                                             float dx, float dy) {
-    std::list<NotifyArgs> out = {};
-
+void GestureConverter::handleMultiFingerSwipe(nsecs_t when, nsecs_t readTime,
+                                              uint32_t fingerCount, float dx, float dy,
+                                              std::list<NotifyArgs>& out) {
     const auto [xCursorPosition, yCursorPosition] =
             mEnablePointerChoreographer ? FloatPoint{0, 0} : mPointerController->getPosition();
     if (mCurrentClassification != MotionClassification::MULTI_FINGER_SWIPE) {
@@ -457,14 +468,12 @@ NotifyMotionArgs GestureConverter::endScroll(nsecs_t when, nsecs_t readTime) {
                                  mButtonState, /* pointerCount= */ mSwipeFingerCount,
                                  mFingerProps.data(), mFakeFingerCoords.data(), xCursorPosition,
                                  yCursorPosition));
-    return out;
 }
 
-[[nodiscard]] std::list<NotifyArgs> GestureConverter::handleMultiFingerSwipeLift(nsecs_t when,
-                                                                                 nsecs_t readTime) {
-    std::list<NotifyArgs> out = {};
+void GestureConverter::handleMultiFingerSwipeLift(nsecs_t when, nsecs_t readTime,
+                                                  std::list<NotifyArgs>& out) {
     if (mCurrentClassification != MotionClassification::MULTI_FINGER_SWIPE) {
-        return out;
+        return;
     }
     const auto [xCursorPosition, yCursorPosition] =
             mEnablePointerChoreographer ? FloatPoint{0, 0} : mPointerController->getPosition();
@@ -486,11 +495,10 @@ NotifyMotionArgs GestureConverter::endScroll(nsecs_t when, nsecs_t readTime) {
     mFakeFingerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_GESTURE_SWIPE_FINGER_COUNT, 0);
     mCurrentClassification = MotionClassification::NONE;
     mSwipeFingerCount = 0;
-    return out;
 }
 
-[[nodiscard]] std::list<NotifyArgs> GestureConverter::handlePinch(nsecs_t when, nsecs_t readTime,
-                                                                  const Gesture& gesture) {
+void GestureConverter::handlePinch(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                                   std::list<NotifyArgs>& out) {
     const auto [xCursorPosition, yCursorPosition] =
             mEnablePointerChoreographer ? FloatPoint{0, 0} : mPointerController->getPosition();
 
@@ -515,7 +523,6 @@ NotifyMotionArgs GestureConverter::endScroll(nsecs_t when, nsecs_t readTime) {
         mFakeFingerCoords[1].setAxisValue(AMOTION_EVENT_AXIS_Y, yCursorPosition);
         mFakeFingerCoords[1].setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 1.0f);
         mDownTime = when;
-        std::list<NotifyArgs> out;
         out.push_back(makeMotionArgs(when, readTime, AMOTION_EVENT_ACTION_DOWN,
                                      /* actionButton= */ 0, mButtonState, /* pointerCount= */ 1,
                                      mFingerProps.data(), mFakeFingerCoords.data(), xCursorPosition,
@@ -526,11 +533,12 @@ NotifyMotionArgs GestureConverter::endScroll(nsecs_t when, nsecs_t readTime) {
                                      /* actionButton= */ 0, mButtonState, /* pointerCount= */ 2,
                                      mFingerProps.data(), mFakeFingerCoords.data(), xCursorPosition,
                                      yCursorPosition));
-        return out;
+        return;
     }
 
     if (gesture.details.pinch.zoom_state == GESTURES_ZOOM_END) {
-        return endPinch(when, readTime);
+        endPinch(when, readTime, out);
+        return;
     }
 
     mPinchFingerSeparation *= gesture.details.pinch.dz;
@@ -542,13 +550,12 @@ NotifyMotionArgs GestureConverter::endScroll(nsecs_t when, nsecs_t readTime) {
     mFakeFingerCoords[1].setAxisValue(AMOTION_EVENT_AXIS_X,
                                       xCursorPosition + mPinchFingerSeparation / 2);
     mFakeFingerCoords[1].setAxisValue(AMOTION_EVENT_AXIS_Y, yCursorPosition);
-    return {makeMotionArgs(when, readTime, AMOTION_EVENT_ACTION_MOVE, /*actionButton=*/0,
-                           mButtonState, /*pointerCount=*/2, mFingerProps.data(),
-                           mFakeFingerCoords.data(), xCursorPosition, yCursorPosition)};
+    out.push_back(makeMotionArgs(when, readTime, AMOTION_EVENT_ACTION_MOVE, /*actionButton=*/0,
+                                 mButtonState, /*pointerCount=*/2, mFingerProps.data(),
+                                 mFakeFingerCoords.data(), xCursorPosition, yCursorPosition));
 }
 
-std::list<NotifyArgs> GestureConverter::endPinch(nsecs_t when, nsecs_t readTime) {
-    std::list<NotifyArgs> out;
+void GestureConverter::endPinch(nsecs_t when, nsecs_t readTime, std::list<NotifyArgs>& out) {
     const auto [xCursorPosition, yCursorPosition] =
             mEnablePointerChoreographer ? FloatPoint{0, 0} : mPointerController->getPosition();
 
@@ -564,7 +571,6 @@ std::list<NotifyArgs> GestureConverter::endPinch(nsecs_t when, nsecs_t readTime)
                                  mFakeFingerCoords.data(), xCursorPosition, yCursorPosition));
     mCurrentClassification = MotionClassification::NONE;
     mFakeFingerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_GESTURE_PINCH_SCALE_FACTOR, 0);
-    return out;
 }
 
 NotifyMotionArgs GestureConverter::makeMotionArgs(nsecs_t when, nsecs_t readTime, int32_t action,
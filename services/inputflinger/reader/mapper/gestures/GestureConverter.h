@@ -54,26 +54,30 @@ public:
 
     [[nodiscard]] std::list<NotifyArgs> handleGesture(nsecs_t when, nsecs_t readTime,
                                                       const Gesture& gesture);
+    // Appends the NotifyArgs for the gesture to out, so that a caller converting several gestures
+    // can collect all of them in one list without building a temporary list for each.
+    void handleGesture(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                       std::list<NotifyArgs>& out);
 
 private:
-    [[nodiscard]] NotifyMotionArgs handleMove(nsecs_t when, nsecs_t readTime,
-                                              const Gesture& gesture);
-    [[nodiscard]] std::list<NotifyArgs> handleButtonsChange(nsecs_t when, nsecs_t readTime,
-                                                            const Gesture& gesture);
-    [[nodiscard]] std::list<NotifyArgs> releaseAllButtons(nsecs_t when, nsecs_t readTime);
-    [[nodiscard]] std::list<NotifyArgs> handleScroll(nsecs_t when, nsecs_t readTime,
-                                                     const Gesture& gesture);
-    [[nodiscard]] std::list<NotifyArgs> handleFling(nsecs_t when, nsecs_t readTime,
-                                                    const Gesture& gesture);
-    [[nodiscard]] NotifyMotionArgs endScroll(nsecs_t when, nsecs_t readTime);
-
-    [[nodiscard]] std::list<NotifyArgs> handleMultiFingerSwipe(nsecs_t when, nsecs_t readTime,
-                                                               uint32_t fingerCount, float dx,
-                                                               float dy);
-    [[nodiscard]] std::list<NotifyArgs> handleMultiFingerSwipeLift(nsecs_t when, nsecs_t readTime);
-    [[nodiscard]] std::list<NotifyArgs> handlePinch(nsecs_t when, nsecs_t readTime,
-                                                    const Gesture& gesture);
-    [[nodiscard]] std::list<NotifyArgs> endPinch(nsecs_t when, nsecs_t readTime);
+    // Each of these appends the NotifyArgs it generates to out.
+    void handleMove(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                    std::list<NotifyArgs>& out);
+    void handleButtonsChange(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                             std::list<NotifyArgs>& out);
+    void releaseAllButtons(nsecs_t when, nsecs_t readTime, std::list<NotifyArgs>& out);
+    void handleScroll(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                      std::list<NotifyArgs>& out);
+    void handleFling(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                     std::list<NotifyArgs>& out);
+    void endScroll(nsecs_t when, nsecs_t readTime, std::list<NotifyArgs>& out);
+
+    void handleMultiFingerSwipe(nsecs_t when, nsecs_t readTime, uint32_t fingerCount, float dx,
+                                float dy, std::list<NotifyArgs>& out);
+    void handleMultiFingerSwipeLift(nsecs_t when, nsecs_t readTime, std::list<NotifyArgs>& out);
+    void handlePinch(nsecs_t when, nsecs_t readTime, const Gesture& gesture,
+                     std::list<NotifyArgs>& out);
+    void endPinch(nsecs_t when, nsecs_t readTime, std::list<NotifyArgs>& out);
 
     NotifyMotionArgs makeMotionArgs(nsecs_t when, nsecs_t readTime, int32_t action,
                                     int32_t actionButton, int32_t buttonState,
@@ -75,20 +75,36 @@ std::string TimerProvider::dump() {
     dump += "Timer IDs: " + dumpVector<std::unique_ptr<GesturesTimer>>(mTimers, timerPtrToString) +
             "\n";
     dump += "Deadlines and corresponding timer IDs:\n";
-    dump += addLinePrefix(dumpMap(mDeadlines, constToString,
-                                  [](const Deadline& deadline) {
-                                      return std::to_string(deadline.timerId);
-                                  }),
-                          "  ") +
-            "\n";
+    std::string deadlines;
+    for (const Deadline* deadline = mFirstDeadline; deadline != nullptr;
+         deadline = deadline->next) {
+        if (!deadlines.empty()) {
+            deadlines += "\n";
+        }
+        deadlines += std::to_string(deadline->time) + ":" + std::to_string(deadline->timer->id);
+    }
+    dump += addLinePrefix(deadlines, "  ") + "\n";
     return dump;
 }
 
 void TimerProvider::triggerCallbacks(nsecs_t when) {
-    while (!mDeadlines.empty() && when >= mDeadlines.begin()->first) {
-        const auto& deadlinePair = mDeadlines.begin();
-        deadlinePair->second.callback(when);
-        mDeadlines.erase(deadlinePair);
+    while (mFirstDeadline != nullptr && when >= mFirstDeadline->time) {
+        Deadline* deadline = mFirstDeadline;
+        GesturesTimer* timer = deadline->timer;
+        GesturesTimerCallback callback = deadline->callback;
+        void* callbackData = deadline->callbackData;
+        // Recycle the deadline before running the callback, so that the callback can reschedule or
+        // cancel the timer without this deadline getting in the way.
+        removeDeadline(deadline);
+
+        stime_t nextDelay = callback(nsecsToStime(when), callbackData);
+        if (nextDelay >= 0.0) {
+            // We don't want to call the public setDeadline here, as that would request a timeout
+            // for every rescheduled deadline. requestTimeout is called once all of the deadlines
+            // that have passed have been triggered.
+            setDeadlineWithoutRequestingTimeout(timer, stimeToNsecs(nextDelay), callback,
+                                                callbackData);
+        }
     }
     requestTimeout();
 }
@@ -109,26 +125,65 @@ void TimerProvider::setDeadline(GesturesTimer* timer, nsecs_t delay, GesturesTim
 void TimerProvider::setDeadlineWithoutRequestingTimeout(GesturesTimer* timer, nsecs_t delay,
                                                         GesturesTimerCallback callback,
                                                         void* callbackData) {
-    const nsecs_t now = getCurrentTime();
-    const nsecs_t time = now + delay;
-    std::function<void(nsecs_t)> wrappedCallback = [=, this](nsecs_t triggerTime) {
-        stime_t nextDelay = callback(nsecsToStime(triggerTime), callbackData);
-        if (nextDelay >= 0.0) {
-            // When rescheduling a deadline, we know that we're running inside a call to
-            // triggerCallbacks, at the end of which requestTimeout will be called. This means that
-            // we don't want to call the public setDeadline, as that will request a timeout before
-            // triggerCallbacks has removed this current deadline, resulting in a request for a
-            // timeout that has already passed.
-            setDeadlineWithoutRequestingTimeout(timer, stimeToNsecs(nextDelay), callback,
-                                                callbackData);
-        }
-    };
-    mDeadlines.insert({time, Deadline(wrappedCallback, timer->id)});
+    Deadline* deadline = mFreeDeadlines;
+    if (deadline != nullptr) {
+        mFreeDeadlines = deadline->next;
+    } else {
+        deadline = &mDeadlineStorage.emplace_back();
+    }
+    deadline->time = getCurrentTime() + delay;
+    deadline->timer = timer;
+    deadline->callback = callback;
+    deadline->callbackData = callbackData;
+    insertDeadline(deadline);
+}
+
+void TimerProvider::insertDeadline(Deadline* deadline) {
+    // New deadlines are usually the latest ones, so search from the back.
+    Deadline* prev = mLastDeadline;
+    while (prev != nullptr && prev->time > deadline->time) {
+        prev = prev->prev;
+    }
+    Deadline* next = prev != nullptr ? prev->next : mFirstDeadline;
+    deadline->prev = prev;
+    deadline->next = next;
+    if (prev != nullptr) {
+        prev->next = deadline;
+    } else {
+        mFirstDeadline = deadline;
+    }
+    if (next != nullptr) {
+        next->prev = deadline;
+    } else {
+        mLastDeadline = deadline;
+    }
+}
+
+void TimerProvider::removeDeadline(Deadline* deadline) {
+    if (deadline->prev != nullptr) {
+        deadline->prev->next = deadline->next;
+    } else {
+        mFirstDeadline = deadline->next;
+    }
+    if (deadline->next != nullptr) {
+        deadline->next->prev = deadline->prev;
+    } else {
+        mLastDeadline = deadline->prev;
+    }
+    deadline->prev = nullptr;
+    deadline->next = mFreeDeadlines;
+    mFreeDeadlines = deadline;
 }
 
 void TimerProvider::cancelTimer(GesturesTimer* timer) {
-    int id = timer->id;
-    std::erase_if(mDeadlines, [id](const auto& item) { return item.second.timerId == id; });
+    Deadline* deadline = mFirstDeadline;
+    while (deadline != nullptr) {
+        Deadline* next = deadline->next;
+        if (deadline->timer == timer) {
+            removeDeadline(deadline);
+        }
+        deadline = next;
+    }
     requestTimeout();
 }
 
@@ -138,9 +193,9 @@ void TimerProvider::freeTimer(GesturesTimer* timer) {
 }
 
 void TimerProvider::requestTimeout() {
-    if (!mDeadlines.empty()) {
-        // Because a std::multimap is sorted by key, we simply use the time for the first entry.
-        mReaderContext.requestTimeoutAtTime(mDeadlines.begin()->first);
+    if (mFirstDeadline != nullptr) {
+        // The deadlines are sorted by time, so we simply use the time of the first one.
+        mReaderContext.requestTimeoutAtTime(mFirstDeadline->time);
     }
 }
 
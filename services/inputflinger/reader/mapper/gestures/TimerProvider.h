@@ -16,9 +16,8 @@
 
 #pragma once
 
-#include <functional>
+#include <deque>
 #include <list>
-#include <map>
 #include <memory>
 #include <vector>
 
@@ -58,24 +57,40 @@ protected:
     virtual nsecs_t getCurrentTime();
 
 private:
+    // A deadline set by the gestures library. Deadlines are kept in an intrusive list sorted by
+    // time, and are recycled through a free list rather than being allocated each time the library
+    // sets one, as it does for most hardware states while a finger is on the pad.
+    struct Deadline {
+        nsecs_t time;
+        GesturesTimer* timer;
+        GesturesTimerCallback callback;
+        void* callbackData;
+        Deadline* prev;
+        Deadline* next;
+    };
+
     void setDeadlineWithoutRequestingTimeout(GesturesTimer* timer, nsecs_t delay,
                                              GesturesTimerCallback callback, void* callbackData);
-    // Requests a timeout from the InputReader for the nearest deadline in mDeadlines. Must be
-    // called whenever mDeadlines is modified.
+    // Inserts the deadline after any others with the same or an earlier time, so that deadlines
+    // for the same time trigger in the order they were set.
+    void insertDeadline(Deadline* deadline);
+    // Unlinks the deadline and puts it on the free list.
+    void removeDeadline(Deadline* deadline);
+    // Requests a timeout from the InputReader for the nearest deadline. Must be called whenever the
+    // deadlines are modified.
     void requestTimeout();
 
     InputReaderContext& mReaderContext;
     int mNextTimerId = 0;
     std::vector<std::unique_ptr<GesturesTimer>> mTimers;
 
-    struct Deadline {
-        Deadline(std::function<void(nsecs_t)> callback, int timerId)
-              : callback(callback), timerId(timerId) {}
-        const std::function<void(nsecs_t)> callback;
-        const int timerId;
-    };
-
-    std::multimap<nsecs_t /*time*/, Deadline> mDeadlines;
+    // Owns every Deadline ever allocated. A std::deque never moves its elements when it grows, so
+    // the pointers in the lists below stay valid.
+    std::deque<Deadline> mDeadlineStorage;
+    Deadline* mFirstDeadline = nullptr;
+    Deadline* mLastDeadline = nullptr;
+    // Deadlines that have triggered or been cancelled, linked through their next pointers.
+    Deadline* mFreeDeadlines = nullptr;
 };
 
 } // namespace android
@@ -19,6 +19,8 @@
 #include <binder/Binder.h>
 #include <gtest/gtest.h>
 
+#include <vector>
+
 namespace android {
 
 namespace inputdispatcher {
@@ -162,6 +164,134 @@ TEST(AnrTrackerTest, RemoveInvalidItem_DoesntCrash) {
     ASSERT_EQ(nullptr, tracker.firstToken());
 }
 
+TEST(AnrTrackerTest, MultipleTokens_RemoveToken_KeepsOthersOrdered) {
+    AnrTracker tracker;
+
+    sp<IBinder> token1 = sp<BBinder>::make();
+    sp<IBinder> token2 = sp<BBinder>::make();
+    sp<IBinder> token3 = sp<BBinder>::make();
+
+    tracker.insert(1, token1);
+    tracker.insert(3, token2);
+    tracker.insert(2, token3);
+    tracker.insert(4, token1);
+
+    tracker.eraseToken(token1);
+    ASSERT_EQ(2, tracker.firstTimeout());
+    ASSERT_EQ(token3, tracker.firstToken());
+
+    tracker.eraseToken(token3);
+    ASSERT_EQ(3, tracker.firstTimeout());
+    ASSERT_EQ(token2, tracker.firstToken());
+
+    tracker.eraseToken(token2);
+    ASSERT_TRUE(tracker.empty());
+}
+
+TEST(AnrTrackerTest, SingleToken_OutOfOrderInsert) {
+    AnrTracker tracker;
+
+    sp<IBinder> token1 = sp<BBinder>::make();
+    sp<IBinder> token2 = sp<BBinder>::make();
+
+    tracker.insert(5, token1);
+    tracker.insert(3, token2);
+    tracker.insert(1, token1);
+    ASSERT_EQ(1, tracker.firstTimeout());
+    ASSERT_EQ(token1, tracker.firstToken());
+
+    tracker.erase(1, token1);
+    ASSERT_EQ(3, tracker.firstTimeout());
+    ASSERT_EQ(token2, tracker.firstToken());
+}
+
+TEST(AnrTrackerTest, SingleToken_RemoveOutOfOrder) {
+    AnrTracker tracker;
+
+    sp<IBinder> token1 = sp<BBinder>::make();
+    sp<IBinder> token2 = sp<BBinder>::make();
+
+    tracker.insert(1, token1);
+    tracker.insert(2, token1);
+    tracker.insert(3, token1);
+    tracker.insert(2, token2);
+
+    // Removing an entry that isn't the first one of the connection doesn't change the order.
+    tracker.erase(3, token1);
+    ASSERT_EQ(1, tracker.firstTimeout());
+    ASSERT_EQ(token1, tracker.firstToken());
+
+    tracker.erase(1, token1);
+    tracker.erase(2, token2);
+    ASSERT_EQ(2, tracker.firstTimeout());
+    ASSERT_EQ(token1, tracker.firstToken());
+
+    tracker.erase(2, token1);
+    ASSERT_TRUE(tracker.empty());
+}
+
+TEST(AnrTrackerTest, SingleToken_DuplicateEntries) {
+    AnrTracker tracker;
+
+    sp<IBinder> token = sp<BBinder>::make();
+
+    tracker.insert(1, token);
+    tracker.insert(1, token);
+
+    tracker.erase(1, token);
+    ASSERT_FALSE(tracker.empty());
+    ASSERT_EQ(1, tracker.firstTimeout());
+
+    tracker.erase(1, token);
+    ASSERT_TRUE(tracker.empty());
+}
+
+TEST(AnrTrackerTest, SingleToken_InsertAfterDrained) {
+    AnrTracker tracker;
+
+    sp<IBinder> token1 = sp<BBinder>::make();
+    sp<IBinder> token2 = sp<BBinder>::make();
+
+    tracker.insert(1, token1);
+    tracker.erase(1, token1);
+    ASSERT_TRUE(tracker.empty());
+
+    tracker.insert(5, token2);
+    tracker.insert(3, token1);
+    ASSERT_EQ(3, tracker.firstTimeout());
+    ASSERT_EQ(token1, tracker.firstToken());
+
+    tracker.eraseToken(token1);
+    ASSERT_EQ(5, tracker.firstTimeout());
+    ASSERT_EQ(token2, tracker.firstToken());
+}
+
+/**
+ * Many connections, each with events finished in order, must always report the earliest timeout.
+ */
+TEST(AnrTrackerTest, ManyTokens_MaintainsOrder) {
+    AnrTracker tracker;
+
+    constexpr nsecs_t kTokenCount = 100;
+    std::vector<sp<IBinder>> tokens;
+    for (nsecs_t i = 0; i < kTokenCount; i++) {
+        tokens.push_back(sp<BBinder>::make());
+        // Later connections time out first.
+        tracker.insert(2 * (kTokenCount - i), tokens.back());
+        tracker.insert(2 * (kTokenCount - i) + 1, tokens.back());
+    }
+
+    for (nsecs_t i = kTokenCount - 1; i >= 0; i--) {
+        ASSERT_EQ(2 * (kTokenCount - i), tracker.firstTimeout());
+        ASSERT_EQ(tokens[i], tracker.firstToken());
+        tracker.erase(2 * (kTokenCount - i), tokens[i]);
+        ASSERT_EQ(2 * (kTokenCount - i) + 1, tracker.firstTimeout());
+        ASSERT_EQ(tokens[i], tracker.firstToken());
+        tracker.eraseToken(tokens[i]);
+    }
+    ASSERT_TRUE(tracker.empty());
+}
+
 } // namespace inputdispatcher
 
 } // namespace android
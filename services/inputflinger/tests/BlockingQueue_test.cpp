@@ -18,10 +18,13 @@
 
 
 #include <gtest/gtest.h>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace android {
 
+using std::chrono_literals::operator""ms;
 using std::chrono_literals::operator""ns;
 
 // --- BlockingQueueTest ---
@@ -102,6 +105,90 @@ TEST(BlockingQueueTest, Queue_Erases) {
     ASSERT_EQ(3, queue.pop());
 }
 
+/**
+ * A queue of capacity 1 can be filled again once it is emptied.
+ */
+TEST(BlockingQueueTest, Queue_CapacityOfOne) {
+    BlockingQueue<int> queue(1);
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(queue.push(int(i)));
+        ASSERT_FALSE(queue.push(int(i))) << "Queue should reach capacity at size 1";
+        ASSERT_EQ(1u, queue.size());
+        ASSERT_EQ(i, queue.pop());
+        ASSERT_EQ(0u, queue.size());
+    }
+}
+
+/**
+ * A queue without capacity keeps growing, and keeps the FIFO order while it does.
+ */
+TEST(BlockingQueueTest, Queue_UnboundedGrows) {
+    BlockingQueue<int> queue;
+
+    // Wrap around the ring before it needs to grow.
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE(queue.push(int(i)));
+        ASSERT_EQ(i, queue.pop());
+    }
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(queue.push(int(i)));
+    }
+    ASSERT_EQ(1000u, queue.size());
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(i, queue.pop());
+    }
+}
+
+/**
+ * The queue can be reused after elements are erased, and keeps the order of the other elements.
+ */
+TEST(BlockingQueueTest, Queue_ErasesAndRefills) {
+    constexpr size_t capacity = 4;
+    BlockingQueue<int> queue(capacity);
+
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_EQ(1, queue.pop());
+    queue.push(2);
+    queue.push(3);
+    queue.push(4);
+    queue.push(5);
+    queue.erase_if([](int element) { return element == 2 || element == 4; });
+    ASSERT_EQ(2u, queue.size());
+
+    ASSERT_TRUE(queue.push(6));
+    ASSERT_TRUE(queue.push(7));
+    ASSERT_FALSE(queue.push(8)) << "Queue should reach capacity at size " << capacity;
+    ASSERT_EQ(3, queue.pop());
+    ASSERT_EQ(5, queue.pop());
+    ASSERT_EQ(6, queue.pop());
+    ASSERT_EQ(7, queue.pop());
+}
+
+/**
+ * Elements that are not retrieved are destroyed with the queue, and the ones that are removed
+ * are destroyed right away.
+ */
+TEST(BlockingQueueTest, Queue_DestroysElements) {
+    auto element = std::make_shared<int>(1);
+    {
+        BlockingQueue<std::shared_ptr<int>> queue(4);
+        queue.emplace(element);
+        queue.emplace(element);
+        queue.emplace(element);
+        ASSERT_EQ(4, element.use_count());
+
+        queue.erase_if([](const std::shared_ptr<int>&) { return false; });
+        ASSERT_EQ(4, element.use_count());
+        queue.pop();
+        ASSERT_EQ(3, element.use_count());
+        queue.clear();
+        ASSERT_EQ(1, element.use_count());
+        queue.emplace(element);
+    }
+    ASSERT_EQ(1, element.use_count());
+}
+
 // --- BlockingQueueTest - Multiple threads ---
 
 TEST(BlockingQueueTest, Queue_AllowsMultipleThreads) {
@@ -147,6 +234,98 @@ TEST(BlockingQueueTest, Queue_BlocksWhileWaitingForElements) {
     ASSERT_TRUE(hasReceivedElement);
 }
 
+/**
+ * Every element added by several threads is retrieved exactly once by several other threads,
+ * and each thread receives the elements of a given producer in order.
+ */
+TEST(BlockingQueueTest, Queue_AllowsMultipleProducersAndConsumers) {
+    constexpr int producerCount = 4;
+    constexpr int consumerCount = 4;
+    constexpr int elementsPerProducer = 10000;
+    BlockingQueue<int> queue(16);
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producerCount; producer++) {
+        producers.emplace_back([&queue, producer]() {
+            for (int i = 0; i < elementsPerProducer; i++) {
+                while (!queue.push(producer * elementsPerProducer + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<std::vector<int>> received(consumerCount);
+    std::vector<std::thread> consumers;
+    for (int consumer = 0; consumer < consumerCount; consumer++) {
+        consumers.emplace_back([&queue, &received, consumer]() {
+            for (int i = 0; i < producerCount * elementsPerProducer / consumerCount; i++) {
+                received[consumer].push_back(queue.pop());
+            }
+        });
+    }
+    for (std::thread& thread : producers) {
+        thread.join();
+    }
+    for (std::thread& thread : consumers) {
+        thread.join();
+    }
+
+    std::vector<int> count(producerCount * elementsPerProducer, 0);
+    for (const std::vector<int>& elements : received) {
+        std::vector<int> last(producerCount, -1);
+        for (int element : elements) {
+            count[element]++;
+            const int producer = element / elementsPerProducer;
+            ASSERT_LT(last[producer], element);
+            last[producer] = element;
+        }
+    }
+    for (int c : count) {
+        ASSERT_EQ(1, c);
+    }
+    ASSERT_EQ(0u, queue.size());
+}
+
+/**
+ * Elements can be erased while other threads add and retrieve elements.
+ */
+TEST(BlockingQueueTest, Queue_ErasesWhileInUse) {
+    constexpr int elementCount = 10000;
+    BlockingQueue<int> queue;
+
+    std::thread producer([&queue]() {
+        for (int i = 0; i < elementCount; i++) {
+            queue.push(int(i));
+        }
+        queue.push(-1);
+    });
+    std::thread eraser([&queue]() {
+        for (int i = 0; i < 100; i++) {
+            queue.erase_if([](int element) { return element >= 0 && element % 2 == 1; });
+        }
+    });
+
+    int last = -1;
+    for (int element = queue.pop(); element != -1; element = queue.pop()) {
+        ASSERT_LT(last, element);
+        last = element;
+    }
+    producer.join();
+    eraser.join();
+}
+
+TEST(BlockingQueueTest, Queue_TimeoutWakesOnPush) {
+    BlockingQueue<int> queue;
+
+    std::thread fillQueue([&queue]() {
+        std::this_thread::sleep_for(10ms);
+        queue.push(1);
+    });
+    ASSERT_EQ(1, queue.popWithTimeout(5000ms));
+    fillQueue.join();
+}
+
 TEST(BlockingQueueTest, Queue_TimesOut) {
     BlockingQueue<int> queue;
     ASSERT_EQ(std::nullopt, queue.popWithTimeout(1ns));
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <android-base/logging.h>
+#include <ftl/enum.h>
 #include "../dispatcher/InputDispatcher.h"
 
 using android::base::Result;
@@ -232,16 +233,24 @@ public:
         return mInputReceiver->consumeEvent(timeout);
     }
 
-    void consumeMotion() {
+    void consumeMotion() { consumeEvent(InputEventType::MOTION); }
+
+    void consumeKey() { consumeEvent(InputEventType::KEY); }
+
+    void consumeFocusEvent() { consumeEvent(InputEventType::FOCUS); }
+
+    void consumeEvent(InputEventType expectedType) {
         std::unique_ptr<InputEvent> event = consume(100ms);
 
         if (event == nullptr) {
-            LOG(FATAL) << mName << ": expected a MotionEvent, but didn't get one.";
+            LOG(FATAL) << mName << ": expected a " << ftl::enum_string(expectedType)
+                       << " event, but didn't get one.";
             return;
         }
 
-        if (event->getType() != InputEventType::MOTION) {
-            LOG(FATAL) << mName << " expected a MotionEvent, got " << *event;
+        if (event->getType() != expectedType) {
+            LOG(FATAL) << mName << " expected a " << ftl::enum_string(expectedType)
+                       << " event, got " << *event;
             return;
         }
     }
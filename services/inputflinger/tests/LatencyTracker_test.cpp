@@ -73,7 +73,7 @@ InputEventTimeline getTestTimeline() {
     graphicsTimeline[GraphicsTimeline::GPU_COMPLETED_TIME] = 9;
     graphicsTimeline[GraphicsTimeline::PRESENT_TIME] = 10;
     expectedCT.setGraphicsTimeline(std::move(graphicsTimeline));
-    t.connectionTimelines.emplace(sp<BBinder>::make(), std::move(expectedCT));
+    t.connectionTimelines.try_emplace(sp<BBinder>::make(), std::move(expectedCT));
     return t;
 }
 
@@ -245,9 +245,10 @@ TEST_F(LatencyTrackerTest, MultipleEvents_AreReportedConsistently) {
             /*vendorId=*/0,
             /*productId=*/0,
             /*sources=*/{InputDeviceUsageSource::UNKNOWN});
-    timeline1.connectionTimelines.emplace(connection1,
-                                          ConnectionTimeline(/*deliveryTime*/ 6, /*consumeTime*/ 7,
-                                                             /*finishTime*/ 8));
+    timeline1.connectionTimelines.try_emplace(connection1,
+                                              ConnectionTimeline(/*deliveryTime*/ 6,
+                                                                 /*consumeTime*/ 7,
+                                                                 /*finishTime*/ 8));
     ConnectionTimeline& connectionTimeline1 = timeline1.connectionTimelines.begin()->second;
     std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline1;
     graphicsTimeline1[GraphicsTimeline::GPU_COMPLETED_TIME] = 9;
@@ -262,10 +263,10 @@ TEST_F(LatencyTrackerTest, MultipleEvents_AreReportedConsistently) {
             /*vendorId=*/0,
             /*productId=*/0,
             /*sources=*/{InputDeviceUsageSource::UNKNOWN});
-    timeline2.connectionTimelines.emplace(connection2,
-                                          ConnectionTimeline(/*deliveryTime=*/60,
-                                                             /*consumeTime=*/70,
-                                                             /*finishTime=*/80));
+    timeline2.connectionTimelines.try_emplace(connection2,
+                                              ConnectionTimeline(/*deliveryTime=*/60,
+                                                                 /*consumeTime=*/70,
+                                                                 /*finishTime=*/80));
     ConnectionTimeline& connectionTimeline2 = timeline2.connectionTimelines.begin()->second;
     std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline2;
     graphicsTimeline2[GraphicsTimeline::GPU_COMPLETED_TIME] = 90;
@@ -314,7 +315,7 @@ TEST_F(LatencyTrackerTest, IncompleteEvents_AreHandledConsistently) {
                                  expectedCT.consumeTime, expectedCT.finishTime);
     mTracker->trackGraphicsLatency(/*inputEventId=*/1, token, expectedCT.graphicsTimeline);
 
-    expectedTimelines[0].connectionTimelines.emplace(token, std::move(expectedCT));
+    expectedTimelines[0].connectionTimelines.try_emplace(token, std::move(expectedCT));
     triggerEventReporting(timeline.eventTime);
     assertReceivedTimelines(expectedTimelines);
 }
@@ -341,6 +342,62 @@ TEST_F(LatencyTrackerTest, EventsAreTracked_WhenTrackListenerIsCalledFirst) {
                                               expected.productId, expected.sources});
 }
 
+/**
+ * Events that are still tracked when the tracker has to make room for more are kept, and can be
+ * completed, as long as the tracker can hold them.
+ */
+TEST_F(LatencyTrackerTest, ManyEvents_AreTrackedAndCompleted) {
+    InputEventTimeline timeline = getTestTimeline();
+    const ConnectionTimeline& expectedCT = timeline.connectionTimelines.begin()->second;
+    const sp<IBinder>& token = timeline.connectionTimelines.begin()->first;
+    constexpr int32_t eventCount = 1000;
+
+    std::vector<InputEventTimeline> expectedTimelines;
+    for (int32_t i = 0; i < eventCount; i++) {
+        const int32_t inputEventId = 100 + i;
+        mTracker->trackListener(inputEventId, timeline.isDown, timeline.eventTime + i,
+                                timeline.readTime, DEVICE_ID, timeline.sources);
+        expectedTimelines.push_back(InputEventTimeline{timeline.isDown, timeline.eventTime + i,
+                                                       timeline.readTime, timeline.vendorId,
+                                                       timeline.productId, timeline.sources});
+    }
+    // Complete every other event, after all of them are tracked.
+    for (int32_t i = 0; i < eventCount; i += 2) {
+        const int32_t inputEventId = 100 + i;
+        mTracker->trackFinishedEvent(inputEventId, token, expectedCT.deliveryTime,
+                                     expectedCT.consumeTime, expectedCT.finishTime);
+        mTracker->trackGraphicsLatency(inputEventId, token, expectedCT.graphicsTimeline);
+        expectedTimelines[i].connectionTimelines.try_emplace(token, expectedCT);
+    }
+
+    triggerEventReporting(timeline.eventTime + eventCount);
+    assertReceivedTimelines(expectedTimelines);
+}
+
+/**
+ * A duplicate of an event that is not the latest one still drops both events, without affecting
+ * the events around it.
+ */
+TEST_F(LatencyTrackerTest, DuplicateOfOlderEvent_DropsOnlyThatEvent) {
+    InputEventTimeline timeline = getTestTimeline();
+    std::vector<InputEventTimeline> expectedTimelines;
+    for (int32_t inputEventId = 10; inputEventId < 20; inputEventId++) {
+        mTracker->trackListener(inputEventId, timeline.isDown, timeline.eventTime + inputEventId,
+                                timeline.readTime, DEVICE_ID, timeline.sources);
+        if (inputEventId != 15) {
+            expectedTimelines.push_back(InputEventTimeline{timeline.isDown,
+                                                           timeline.eventTime + inputEventId,
+                                                           timeline.readTime, timeline.vendorId,
+                                                           timeline.productId, timeline.sources});
+        }
+    }
+    mTracker->trackListener(/*inputEventId=*/15, timeline.isDown, timeline.eventTime + 20,
+                            timeline.readTime, DEVICE_ID, timeline.sources);
+
+    triggerEventReporting(timeline.eventTime + 20);
+    assertReceivedTimelines(expectedTimelines);
+}
+
 /**
  * Check that LatencyTracker has the received timeline that contains the correctly
  * resolved product ID, vendor ID and source for a particular device ID from
@@ -17,7 +17,11 @@
 #include "../PointerChoreographer.h"
 
 #include <gtest/gtest.h>
+#include <condition_variable>
 #include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "FakePointerController.h"
@@ -80,6 +84,46 @@ static std::vector<DisplayViewport> createViewports(std::vector<int32_t> display
     return viewports;
 }
 
+/**
+ * A FakePointerController that can hold up the thread routing an event to it, so that tests can
+ * change the PointerChoreographer while that thread is still using the controller.
+ */
+class BlockingPointerController : public FakePointerController {
+public:
+    // Makes the next getPosition call block until unblock is called.
+    void blockNextGetPosition() {
+        std::scoped_lock lock(mLock);
+        mShouldBlock = true;
+    }
+
+    void waitUntilBlocked() {
+        std::unique_lock lock(mLock);
+        mCondition.wait(lock, [this] { return mIsBlocked; });
+    }
+
+    void unblock() {
+        std::scoped_lock lock(mLock);
+        mShouldBlock = false;
+        mCondition.notify_all();
+    }
+
+    FloatPoint getPosition() const override {
+        std::unique_lock lock(mLock);
+        if (mShouldBlock) {
+            mIsBlocked = true;
+            mCondition.notify_all();
+            mCondition.wait(lock, [this] { return !mShouldBlock; });
+        }
+        return FakePointerController::getPosition();
+    }
+
+private:
+    mutable std::mutex mLock;
+    mutable std::condition_variable mCondition;
+    bool mShouldBlock = false;
+    mutable bool mIsBlocked = false;
+};
+
 } // namespace
 
 // --- PointerChoreographerTest ---
@@ -126,6 +170,11 @@ protected:
 
     void assertPointerDisplayIdNotNotified() { ASSERT_EQ(std::nullopt, mPointerDisplayIdNotified); }
 
+    // Creates the controllers that the policy hands to PointerChoreographer.
+    std::function<std::shared_ptr<FakePointerController>()> mControllerFactory = [] {
+        return std::make_shared<FakePointerController>();
+    };
+
 private:
     std::deque<std::pair<ControllerType, std::shared_ptr<FakePointerController>>>
             mCreatedControllers;
@@ -133,7 +182,7 @@ private:
 
     std::shared_ptr<PointerControllerInterface> createPointerController(
             ControllerType type) override {
-        std::shared_ptr<FakePointerController> pc = std::make_shared<FakePointerController>();
+        std::shared_ptr<FakePointerController> pc = mControllerFactory();
         EXPECT_FALSE(pc->isPointerShown());
         mCreatedControllers.emplace_back(type, pc);
         return pc;
@@ -207,6 +256,38 @@ TEST_F(PointerChoreographerTest, WhenMouseIsRemovedRemovesPointerController) {
     assertPointerControllerRemoved(pc);
 }
 
+TEST_F(PointerChoreographerTest, WhenMouseIsRemovedWhileRoutingReleasesPointerController) {
+    mControllerFactory = [] { return std::make_shared<BlockingPointerController>(); };
+    mChoreographer.setDisplayViewports(createViewports({DISPLAY_ID}));
+    mChoreographer.notifyInputDevicesChanged(
+            {/*id=*/0, {generateTestDeviceInfo(DEVICE_ID, AINPUT_SOURCE_MOUSE, DISPLAY_ID)}});
+    auto pc = assertPointerControllerCreated(ControllerType::MOUSE);
+    auto& blockingPc = static_cast<BlockingPointerController&>(*pc);
+
+    // Hold up a mouse event while it is being routed to the controller for the display.
+    blockingPc.blockNextGetPosition();
+    std::thread reader([this] {
+        mChoreographer.notifyMotion(
+                MotionArgsBuilder(AMOTION_EVENT_ACTION_HOVER_MOVE, AINPUT_SOURCE_MOUSE)
+                        .pointer(MOUSE_POINTER)
+                        .deviceId(DEVICE_ID)
+                        .displayId(DISPLAY_ID)
+                        .build());
+    });
+    blockingPc.waitUntilBlocked();
+
+    // Remove the mouse, and with it the controller for the display, while the event still uses it.
+    std::thread remover([this] { mChoreographer.notifyInputDevicesChanged({/*id=*/1, {}}); });
+    assertPointerControllerNotRemoved(pc);
+
+    // Once the event is routed, the removal must release the controller without waiting for some
+    // later change to the PointerChoreographer.
+    blockingPc.unblock();
+    reader.join();
+    remover.join();
+    assertPointerControllerRemoved(pc);
+}
+
 TEST_F(PointerChoreographerTest, WhenKeyboardIsAddedDoesNotCreatePointerController) {
     mChoreographer.notifyInputDevicesChanged(
             {/*id=*/0,
@@ -592,6 +673,32 @@ TEST_F(PointerChoreographerTest, WhenShowTouchesDisabledRemovesPointerController
     assertPointerControllerRemoved(pc);
 }
 
+TEST_F(PointerChoreographerTest, WhenShowTouchesReenabledCreatesNewPointerController) {
+    mChoreographer.notifyInputDevicesChanged(
+            {/*id=*/0, {generateTestDeviceInfo(DEVICE_ID, AINPUT_SOURCE_TOUCHSCREEN, DISPLAY_ID)}});
+    mChoreographer.setShowTouchesEnabled(true);
+    mChoreographer.notifyMotion(
+            MotionArgsBuilder(AMOTION_EVENT_ACTION_DOWN, AINPUT_SOURCE_TOUCHSCREEN)
+                    .pointer(FIRST_TOUCH_POINTER)
+                    .deviceId(DEVICE_ID)
+                    .displayId(DISPLAY_ID)
+                    .build());
+    auto firstPc = assertPointerControllerCreated(ControllerType::TOUCH);
+
+    // Toggle show touches. The next touch must not be routed to the removed controller.
+    mChoreographer.setShowTouchesEnabled(false);
+    assertPointerControllerRemoved(firstPc);
+    mChoreographer.setShowTouchesEnabled(true);
+    mChoreographer.notifyMotion(
+            MotionArgsBuilder(AMOTION_EVENT_ACTION_DOWN, AINPUT_SOURCE_TOUCHSCREEN)
+                    .pointer(FIRST_TOUCH_POINTER)
+                    .deviceId(DEVICE_ID)
+                    .displayId(DISPLAY_ID)
+                    .build());
+    auto secondPc = assertPointerControllerCreated(ControllerType::TOUCH);
+    secondPc->assertSpotCount(DISPLAY_ID, 1);
+}
+
 TEST_F(PointerChoreographerTest, TouchSetsSpots) {
     mChoreographer.setShowTouchesEnabled(true);
     mChoreographer.notifyInputDevicesChanged(
@@ -59,6 +59,17 @@ stime_t incrementInt(stime_t triggerTime, void* data) {
     return NO_DEADLINE;
 }
 
+struct CallRecorder {
+    std::vector<int>* callOrder;
+    int id;
+};
+
+stime_t recordCall(stime_t, void* data) {
+    CallRecorder* recorder = static_cast<CallRecorder*>(data);
+    recorder->callOrder->push_back(recorder->id);
+    return NO_DEADLINE;
+}
+
 } // namespace
 
 using testing::AtLeast;
@@ -297,6 +308,27 @@ TEST_F(TimerProviderTest, CancelledTimerCanBeReused) {
     EXPECT_EQ(1, numCallsAfterCancellation);
 }
 
+TEST_F(TimerProviderTest, DeadlinesAtSameTimeTriggerInOrderTheyWereSet) {
+    GesturesTimer* timer1 = mProvider.createTimer();
+    GesturesTimer* timer2 = mProvider.createTimer();
+    std::vector<int> callOrder;
+    CallRecorder recorder1{&callOrder, 1};
+    CallRecorder recorder2{&callOrder, 2};
+    CallRecorder recorder3{&callOrder, 3};
+    CallRecorder recorder4{&callOrder, 4};
+
+    EXPECT_CALL(mMockContext, requestTimeoutAtTime(1'000'000'000)).Times(1);
+    EXPECT_CALL(mMockContext, requestTimeoutAtTime(500'000'000)).Times(3);
+
+    mProvider.setDeadline(timer1, 1'000'000'000, &recordCall, &recorder1);
+    mProvider.setDeadline(timer2, 500'000'000, &recordCall, &recorder2);
+    mProvider.setDeadline(timer1, 1'000'000'000, &recordCall, &recorder3);
+    mProvider.setDeadline(timer2, 1'000'000'000, &recordCall, &recorder4);
+
+    triggerCallbacksWithFakeTime(1'000'000'000);
+    EXPECT_EQ(std::vector<int>({2, 1, 3, 4}), callOrder);
+}
+
 TEST_F(TimerProviderTest, FreeingTimerCancelsFirst) {
     GesturesTimer* timer = mProvider.createTimer();
     int numCalls = 0;
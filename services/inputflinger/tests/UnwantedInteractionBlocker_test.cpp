@@ -1094,4 +1094,110 @@ TEST_F(PalmRejectorFakeFilterTest, CancelTwoPointers) {
     ASSERT_EQ(CANCEL, argsList[0].action);
 }
 
+class AsyncPalmRejectorTest : public testing::Test {
+protected:
+    std::unique_ptr<AsyncPalmRejector> mPalmRejector;
+
+    /**
+     * The suppressed positions must be specified before the rejector is created, because the
+     * filter is accessed from the palm rejection thread.
+     */
+    void createPalmRejector(std::chrono::nanoseconds latencyBudget,
+                            std::vector<std::pair<float, float>> suppressedPointers) {
+        mSuppressedPointers = std::move(suppressedPointers);
+        std::unique_ptr<::ui::PalmDetectionFilter> filter =
+                std::make_unique<TestFilter>(&mSharedPalmState, /*byref*/ mSuppressedPointers);
+        mPalmRejector = std::make_unique<AsyncPalmRejector>(generatePalmFilterDeviceInfo(),
+                                                            latencyBudget, std::move(filter));
+    }
+
+    void TearDown() override {
+        // Stop the palm rejection thread before the filter state is destroyed
+        mPalmRejector.reset();
+    }
+
+private:
+    std::vector<std::pair<float, float>> mSuppressedPointers;
+    ::ui::SharedPalmDetectionFilterState mSharedPalmState; // unused, but we must retain ownership
+};
+
+/**
+ * With no latency budget, the asynchronous rejector must wait for the model on every event, and
+ * should produce exactly the same output as the synchronous PalmRejector.
+ */
+TEST_F(AsyncPalmRejectorTest, ZeroBudgetBehavesLikeSynchronousRejector) {
+    std::vector<NotifyMotionArgs> argsList;
+    constexpr nsecs_t downTime = 0;
+    createPalmRejector(std::chrono::nanoseconds(0), {{1059, 731}});
+
+    argsList = mPalmRejector->processMotion(
+            generateMotionArgs(downTime, downTime, DOWN, {{1342.0, 613.0, 79.0}}));
+    ASSERT_EQ(1u, argsList.size());
+    argsList = mPalmRejector->processMotion(
+            generateMotionArgs(downTime, /*eventTime=*/1, POINTER_1_DOWN,
+                               {{1417.0, 685.0, 41.0}, {1062.0, 697.0, 10.0}}));
+    ASSERT_EQ(1u, argsList.size());
+    ASSERT_EQ(POINTER_1_DOWN, argsList[0].action);
+
+    argsList = mPalmRejector->processMotion(
+            generateMotionArgs(downTime, /*eventTime=*/2, MOVE,
+                               {{1414.0, 702.0, 41.0}, {1059.0, 731.0, 12.0}}));
+    ASSERT_EQ(2u, argsList.size());
+    ASSERT_EQ(POINTER_1_UP, argsList[0].action);
+    ASSERT_EQ(FLAG_CANCELED, argsList[0].flags);
+    ASSERT_EQ(MOVE, argsList[1].action);
+    ASSERT_EQ(1u, argsList[1].getPointerCount());
+
+    argsList = mPalmRejector->processMotion(
+            generateMotionArgs(downTime, /*eventTime=*/3, MOVE,
+                               {{1433.0, 751.0, 43.0}, {1072.0, 766.0, 13.0}}));
+    ASSERT_EQ(1u, argsList.size());
+    ASSERT_EQ(MOVE, argsList[0].action);
+    ASSERT_EQ(1u, argsList[0].getPointerCount());
+}
+
+/**
+ * The palm decision may arrive after the event that caused it has been forwarded. It must be
+ * applied no later than the first event that is more than 'latencyBudget' newer than that event.
+ */
+TEST_F(AsyncPalmRejectorTest, PalmIsCanceledWithinLatencyBudget) {
+    std::vector<NotifyMotionArgs> argsList;
+    constexpr nsecs_t downTime = 0;
+    createPalmRejector(std::chrono::nanoseconds(10), {{1059, 731}});
+
+    mPalmRejector->processMotion(
+            generateMotionArgs(downTime, downTime, DOWN, {{1342.0, 613.0, 79.0}}));
+    mPalmRejector->processMotion(
+            generateMotionArgs(downTime, /*eventTime=*/1, POINTER_1_DOWN,
+                               {{1417.0, 685.0, 41.0}, {1062.0, 697.0, 10.0}}));
+    // The model detects the palm on this event, but the result may not be available yet
+    std::vector<NotifyMotionArgs> palmArgsList = mPalmRejector->processMotion(
+            generateMotionArgs(downTime, /*eventTime=*/2, MOVE,
+                               {{1414.0, 702.0, 41.0}, {1059.0, 731.0, 12.0}}));
+    // This event is outside of the budget, so the decision must have been applied by now
+    argsList = mPalmRejector->processMotion(
+            generateMotionArgs(downTime, /*eventTime=*/20, MOVE,
+                               {{1433.0, 751.0, 43.0}, {1072.0, 766.0, 13.0}}));
+    palmArgsList.insert(palmArgsList.end(), argsList.begin(), argsList.end());
+
+    ASSERT_EQ(3u, palmArgsList.size());
+    // The palm is canceled exactly once, either right away or on the next event
+    const size_t numCanceled = std::count_if(palmArgsList.begin(), palmArgsList.end(),
+                                             [](const NotifyMotionArgs& args) {
+                                                 return args.action == POINTER_1_UP &&
+                                                         args.flags == FLAG_CANCELED;
+                                             });
+    ASSERT_EQ(1u, numCanceled);
+    ASSERT_EQ(MOVE, palmArgsList.back().action);
+    ASSERT_EQ(1u, palmArgsList.back().getPointerCount());
+    ASSERT_EQ(1433, palmArgsList.back().pointerCoords[0].getX());
+
+    // Future events don't contain the palm
+    argsList = mPalmRejector->processMotion(
+            generateMotionArgs(downTime, /*eventTime=*/30, MOVE,
+                               {{1435.0, 755.0, 43.0}, {1075.0, 770.0, 13.0}}));
+    ASSERT_EQ(1u, argsList.size());
+    ASSERT_EQ(1u, argsList[0].getPointerCount());
+}
+
 } // namespace android
@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "Fusion.h"
+#include "FusionKernels.h"
 
 namespace android {
 
@@ -482,12 +483,13 @@ void Fusion::predict(const vec3_t& w, float dT) {
     Phi[0][0] = I33 - wx*(k1*ilwe) + wx2*k0;
     Phi[1][0] = wx*k0 - I33dT - wx2*(ilwe*ilwe*ilwe)*(lwedT-k1);
 
-    x0 = O*q;
+    x0 = simd::mul(O, q);
 
     if (x0.w < 0)
         x0 = -x0;
 
-    P = Phi*P*transpose(Phi) + GQGt;
+    // P = Phi*P*transpose(Phi) + GQGt, using the block structure of Phi
+    simd::propagateCovariance(P, Phi, GQGt);
 
     checkState();
 }
@@ -508,9 +510,9 @@ void Fusion::update(const vec3_t& z, const vec3_t& Bi, float sigma) {
     const mat33_t R(sigma*sigma);
     const mat33_t S(scaleCovariance(L, P[0][0]) + R);
     const mat33_t Si(invert(S));
-    const mat33_t LtSi(transpose(L)*Si);
-    K[0] = P[0][0] * LtSi;
-    K[1] = transpose(P[1][0])*LtSi;
+    const mat33_t LtSi(simd::transposedMul(L, Si));
+    K[0] = simd::mul(P[0][0], LtSi);
+    K[1] = simd::transposedMul(P[1][0], LtSi);
 
     // update...
     // P = (I-K*H) * P
@@ -519,21 +521,21 @@ void Fusion::update(const vec3_t& z, const vec3_t& Bi, float sigma) {
     // | K1 |                 | K1*L  0 |   | P01  P11 |   | K1*L*P00  K1*L*P10 |
     // Note: the Joseph form is numerically more stable and given by:
     //     P = (I-KH) * P * (I-KH)' + K*R*R'
-    const mat33_t K0L(K[0] * L);
-    const mat33_t K1L(K[1] * L);
-    P[0][0] -= K0L*P[0][0];
-    P[1][1] -= K1L*P[1][0];
-    P[1][0] -= K0L*P[1][0];
+    const mat33_t K0L(simd::mul(K[0], L));
+    const mat33_t K1L(simd::mul(K[1], L));
+    P[0][0] = simd::mulSub(P[0][0], K0L, P[0][0]);
+    P[1][1] = simd::mulSub(P[1][1], K1L, P[1][0]);
+    P[1][0] = simd::mulSub(P[1][0], K0L, P[1][0]);
     P[0][1] = transpose(P[1][0]);
 
     const vec3_t e(z - Bb);
-    const vec3_t dq(K[0]*e);
+    const vec3_t dq(simd::mul(K[0], e));
 
-    q += getF(q)*(0.5f*dq);
+    q += simd::mul(getF(q), 0.5f*dq);
     x0 = normalize_quat(q);
 
     if (mMode != FUSION_NOMAG) {
-        const vec3_t db(K[1]*e);
+        const vec3_t db(simd::mul(K[1], e));
         x1 += db;
     }
 
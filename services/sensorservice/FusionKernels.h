@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FUSION_KERNELS_H
+#define ANDROID_FUSION_KERNELS_H
+
+#include "mat.h"
+#include "vec.h"
+
+// -----------------------------------------------------------------------
+namespace android {
+namespace simd {
+// -----------------------------------------------------------------------
+
+/*
+ * Fixed-size kernels for the small matrix products used by the fusion
+ * EKF. The generic operators in mat.h work one scalar at a time through
+ * nested templates; these work on whole columns, using the compiler's
+ * vector extension so that each column is a single NEON / SSE register.
+ *
+ * Matrices are column-major (m[column][row]), so a product is built one
+ * output column at a time as a linear combination of the columns of the
+ * left-hand side.
+ *
+ * The results match the generic operators up to floating-point
+ * reassociation.
+ */
+
+typedef float float4_t __attribute__((vector_size(4 * sizeof(float))));
+
+static_assert(sizeof(vec3_t) == 3 * sizeof(float), "vec3_t must be packed");
+static_assert(sizeof(vec4_t) == 4 * sizeof(float), "vec4_t must be packed");
+
+// 3-vectors live in the first three lanes, the last lane is kept at zero.
+inline float4_t load(const vec3_t& v) {
+    return float4_t{v.x, v.y, v.z, 0.0f};
+}
+
+inline float4_t load(const vec4_t& v) {
+    return float4_t{v.x, v.y, v.z, v.w};
+}
+
+inline void store(vec3_t& v, float4_t f) {
+    v.x = f[0];
+    v.y = f[1];
+    v.z = f[2];
+}
+
+inline void store(vec4_t& v, float4_t f) {
+    v.x = f[0];
+    v.y = f[1];
+    v.z = f[2];
+    v.w = f[3];
+}
+
+// A*B
+inline mat33_t mul(const mat33_t& A, const mat33_t& B) {
+    const float4_t a0 = load(A[0]);
+    const float4_t a1 = load(A[1]);
+    const float4_t a2 = load(A[2]);
+    mat33_t C;
+    for (size_t c = 0; c < 3; c++) {
+        store(C[c], a0 * B[c][0] + a1 * B[c][1] + a2 * B[c][2]);
+    }
+    return C;
+}
+
+// A*transpose(B)
+inline mat33_t mulTransposed(const mat33_t& A, const mat33_t& B) {
+    const float4_t a0 = load(A[0]);
+    const float4_t a1 = load(A[1]);
+    const float4_t a2 = load(A[2]);
+    mat33_t C;
+    for (size_t c = 0; c < 3; c++) {
+        store(C[c], a0 * B[0][c] + a1 * B[1][c] + a2 * B[2][c]);
+    }
+    return C;
+}
+
+// transpose(A)*B. The columns of transpose(A) are the rows of A; they are
+// gathered into registers once, rather than by the generic transpose().
+inline mat33_t transposedMul(const mat33_t& A, const mat33_t& B) {
+    const float4_t at0 = float4_t{A[0][0], A[1][0], A[2][0], 0.0f};
+    const float4_t at1 = float4_t{A[0][1], A[1][1], A[2][1], 0.0f};
+    const float4_t at2 = float4_t{A[0][2], A[1][2], A[2][2], 0.0f};
+    mat33_t C;
+    for (size_t c = 0; c < 3; c++) {
+        store(C[c], at0 * B[c][0] + at1 * B[c][1] + at2 * B[c][2]);
+    }
+    return C;
+}
+
+// A*B + C
+inline mat33_t mulAdd(const mat33_t& A, const mat33_t& B, const mat33_t& C) {
+    const float4_t a0 = load(A[0]);
+    const float4_t a1 = load(A[1]);
+    const float4_t a2 = load(A[2]);
+    mat33_t D;
+    for (size_t c = 0; c < 3; c++) {
+        store(D[c], load(C[c]) + a0 * B[c][0] + a1 * B[c][1] + a2 * B[c][2]);
+    }
+    return D;
+}
+
+// C - A*B
+inline mat33_t mulSub(const mat33_t& C, const mat33_t& A, const mat33_t& B) {
+    const float4_t a0 = load(A[0]);
+    const float4_t a1 = load(A[1]);
+    const float4_t a2 = load(A[2]);
+    mat33_t D;
+    for (size_t c = 0; c < 3; c++) {
+        store(D[c], load(C[c]) - (a0 * B[c][0] + a1 * B[c][1] + a2 * B[c][2]));
+    }
+    return D;
+}
+
+// A*v
+inline vec3_t mul(const mat33_t& A, const vec3_t& v) {
+    vec3_t r;
+    store(r, load(A[0]) * v.x + load(A[1]) * v.y + load(A[2]) * v.z);
+    return r;
+}
+
+// A*v
+inline vec4_t mul(const mat44_t& A, const vec4_t& v) {
+    vec4_t r;
+    store(r, load(A[0]) * v.x + load(A[1]) * v.y + load(A[2]) * v.z + load(A[3]) * v.w);
+    return r;
+}
+
+// A*v, where A is a 4x3 matrix (3 columns of 4 rows)
+inline vec4_t mul(const mat<float, 3, 4>& A, const vec3_t& v) {
+    vec4_t r;
+    store(r, load(A[0]) * v.x + load(A[1]) * v.y + load(A[2]) * v.z);
+    return r;
+}
+
+/*
+ * Covariance propagation of the EKF:
+ *
+ *     P = Phi*P*transpose(Phi) + GQGt
+ *
+ * where the state transition matrix has the structure
+ *
+ *     Phi = | Phi00 Phi10 | = | A  B |
+ *           |   0    I33  |   | 0  I |
+ *
+ * Expanding the block products gives
+ *
+ *     T    = A*P10 + B*P11
+ *     P00' = (A*P00 + B*P01)*At + T*Bt
+ *     P10' = T
+ *     P01' = P01*At + P11*Bt
+ *     P11' = P11
+ *
+ * which needs 8 3x3 products instead of the 16 of the generic block
+ * matrix product (several of which multiply by 0 or I).
+ */
+inline void propagateCovariance(mat<mat33_t, 2, 2>& P,
+        const mat<mat33_t, 2, 2>& Phi, const mat<mat33_t, 2, 2>& GQGt) {
+    const mat33_t& A = Phi[0][0];
+    const mat33_t& B = Phi[1][0];
+    const mat33_t& P00 = P[0][0];
+    const mat33_t& P10 = P[1][0];
+    const mat33_t& P01 = P[0][1];
+    const mat33_t& P11 = P[1][1];
+
+    const mat33_t T(mulAdd(B, P11, mul(A, P10)));
+    const mat33_t APB(mulAdd(B, P01, mul(A, P00)));
+    const mat33_t newP00(mulTransposed(APB, A) + mulTransposed(T, B));
+    const mat33_t newP01(mulTransposed(P01, A) + mulTransposed(P11, B));
+
+    P[0][0] = newP00 + GQGt[0][0];
+    P[0][1] = newP01 + GQGt[0][1];
+    P[1][0] = T + GQGt[1][0];
+    P[1][1] = P11 + GQGt[1][1];
+}
+
+// -----------------------------------------------------------------------
+}; // namespace simd
+}; // namespace android
+
+#endif // ANDROID_FUSION_KERNELS_H
@@ -21,7 +21,9 @@
 #include <frameworks/base/core/proto/android/service/sensor_service.proto.h>
 #include <utils/Timers.h>
 
+#include <algorithm>
 #include <inttypes.h>
+#include <string.h>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -30,52 +32,212 @@ namespace {
     constexpr size_t LOG_SIZE = 10;
     constexpr size_t LOG_SIZE_MED = 30;  // debugging for slower sensors
     constexpr size_t LOG_SIZE_LARGE = 50;  // larger samples for debugging
+
+    // Timestamp deltas are stored as a 30-bit magnitude and a 2-bit unit. The unit with all
+    // bits set is reserved for RecentEventLogger::kTimestampEscape.
+    constexpr uint32_t DELTA_UNIT_SHIFT = 30;
+    constexpr uint32_t DELTA_MAGNITUDE_MASK = (1u << DELTA_UNIT_SHIFT) - 1;
+    enum DeltaUnit : uint32_t {
+        DELTA_UNIT_NS = 0,
+        DELTA_UNIT_US = 1,
+        DELTA_UNIT_MS = 2,
+    };
+
+    // The log may be read while it is being written, so all of the shared words are accessed
+    // atomically. Relaxed accesses compile to plain loads and stores.
+    inline void storeWords(uint32_t* dst, const uint32_t* src, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            __atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    inline void loadWords(uint32_t* dst, const uint32_t* src, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+    }
 }// unnamed namespace
 
 RecentEventLogger::RecentEventLogger(int sensorType) :
         mSensorType(sensorType), mEventSize(eventSizeBySensorType(mSensorType)),
-        mRecentEvents(logSizeBySensorType(sensorType)), mMaskData(false),
+        mCapacity(logSizeBySensorType(sensorType)),
+        mWordsPerEvent(sensorType == SENSOR_TYPE_STEP_COUNTER
+                ? sizeof(uint64_t) / sizeof(uint32_t) : mEventSize),
+        mTimestampDeltas(new uint32_t[mCapacity]()),
+        mData(new uint32_t[mCapacity * mWordsPerEvent]()),
+        mLastTimestamp(0), mTimestampEscapes(), mTimestampEscapeCount(0), mLastEvent(),
+        mSequence(0), mMaskData(false),
         mIsLastEventCurrent(false) {
     // blank
 }
 
 void RecentEventLogger::addEvent(const sensors_event_t& event) {
-    std::lock_guard<std::mutex> lk(mLock);
-    mRecentEvents.emplace(event);
-    mIsLastEventCurrent = true;
+    const uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+    const uint64_t count = sequence / 2;
+    const size_t slot = count % mCapacity;
+
+    // Mark the log as being modified before touching any of the data
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const int64_t lastTimestamp = mLastTimestamp.load(std::memory_order_relaxed);
+    const uint32_t encodedDelta =
+            count == 0 ? 0 : encodeTimestampDelta(event.timestamp - lastTimestamp);
+    if (encodedDelta == kTimestampEscape) {
+        TimestampEscape& escape =
+                mTimestampEscapes[mTimestampEscapeCount++ % kMaxTimestampEscapes];
+        __atomic_store_n(&escape.mEventIndex, count, __ATOMIC_RELAXED);
+        __atomic_store_n(&escape.mPreviousTimestamp, lastTimestamp, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&mTimestampDeltas[slot], encodedDelta, __ATOMIC_RELAXED);
+    storeWords(&mData[slot * mWordsPerEvent], reinterpret_cast<const uint32_t*>(event.data),
+            mWordsPerEvent);
+    storeWords(mLastEvent, reinterpret_cast<const uint32_t*>(&event), kEventWordCount);
+    mLastTimestamp.store(event.timestamp, std::memory_order_relaxed);
+
+    mSequence.store(sequence + 2, std::memory_order_release);
+    mIsLastEventCurrent.store(true, std::memory_order_relaxed);
 }
 
 bool RecentEventLogger::isEmpty() const {
-    return mRecentEvents.size() == 0;
+    return mSequence.load(std::memory_order_relaxed) < 2;
 }
 
 void RecentEventLogger::setLastEventStale() {
-    std::lock_guard<std::mutex> lk(mLock);
-    mIsLastEventCurrent = false;
+    mIsLastEventCurrent.store(false, std::memory_order_relaxed);
+}
+
+size_t RecentEventLogger::getLogSizeBytes() const {
+    return mCapacity * (sizeof(uint32_t) + mWordsPerEvent * sizeof(uint32_t)) +
+            sizeof(mLastEvent) + sizeof(mLastTimestamp) + sizeof(mTimestampEscapes);
+}
+
+uint32_t RecentEventLogger::encodeTimestampDelta(int64_t delta) {
+    // Deltas are exact below ~1s, and accurate to 1us below ~17min. Longer gaps are only
+    // reported at millisecond precision, up to ~12 days. Timestamps that go backwards, or gaps
+    // longer than that, are escaped so that the timestamps of older events stay exact.
+    if (delta < 0) {
+        return kTimestampEscape;
+    }
+    if (delta <= DELTA_MAGNITUDE_MASK) {
+        return (DELTA_UNIT_NS << DELTA_UNIT_SHIFT) | uint32_t(delta);
+    }
+    if (ns2us(delta) <= DELTA_MAGNITUDE_MASK) {
+        return (DELTA_UNIT_US << DELTA_UNIT_SHIFT) | uint32_t(ns2us(delta));
+    }
+    if (ns2ms(delta) <= DELTA_MAGNITUDE_MASK) {
+        return (DELTA_UNIT_MS << DELTA_UNIT_SHIFT) | uint32_t(ns2ms(delta));
+    }
+    return kTimestampEscape;
+}
+
+int64_t RecentEventLogger::decodeTimestampDelta(uint32_t encodedDelta) {
+    const int64_t magnitude = encodedDelta & DELTA_MAGNITUDE_MASK;
+    switch (encodedDelta >> DELTA_UNIT_SHIFT) {
+        case DELTA_UNIT_NS:
+            return magnitude;
+        case DELTA_UNIT_US:
+            return us2ns(magnitude);
+        default:
+            return ms2ns(magnitude);
+    }
+}
+
+std::vector<RecentEventLogger::SensorEventLog> RecentEventLogger::decodeEvents() const {
+    constexpr int kMaxAttempts = 10;
+    std::vector<uint32_t> deltas(mCapacity);
+    std::vector<uint32_t> data(mCapacity * mWordsPerEvent);
+    TimestampEscape escapes[kMaxTimestampEscapes];
+    uint64_t sequence = 0;
+    int64_t lastTimestamp = 0;
+    bool consistent = false;
+    for (int attempt = 0; attempt < kMaxAttempts && !consistent; attempt++) {
+        sequence = mSequence.load(std::memory_order_acquire);
+        if (sequence % 2 != 0) {
+            continue;
+        }
+        lastTimestamp = mLastTimestamp.load(std::memory_order_relaxed);
+        loadWords(deltas.data(), mTimestampDeltas.get(), deltas.size());
+        loadWords(data.data(), mData.get(), data.size());
+        for (size_t i = 0; i < kMaxTimestampEscapes; i++) {
+            escapes[i].mEventIndex =
+                    __atomic_load_n(&mTimestampEscapes[i].mEventIndex, __ATOMIC_RELAXED);
+            escapes[i].mPreviousTimestamp =
+                    __atomic_load_n(&mTimestampEscapes[i].mPreviousTimestamp, __ATOMIC_RELAXED);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        consistent = mSequence.load(std::memory_order_relaxed) == sequence;
+    }
+    if (!consistent) {
+        // The writer kept modifying the log while it was being read; there is no consistent
+        // snapshot to report.
+        return {};
+    }
+
+    // Sensor timestamps are in the elapsedRealtimeNanos time base. Convert them to wall time
+    // using the current offset between the two clocks.
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    const int64_t realtimeOffset =
+            seconds_to_nanoseconds(now.tv_sec) + now.tv_nsec - systemTime(SYSTEM_TIME_BOOTTIME);
+
+    const uint64_t count = sequence / 2;
+    const size_t numEvents = std::min<uint64_t>(count, mCapacity);
+    std::vector<SensorEventLog> events(numEvents);
+    int64_t timestamp = lastTimestamp;
+    for (size_t i = 0; i < numEvents; i++) {
+        const uint64_t index = count - 1 - i;
+        const size_t slot = index % mCapacity;
+        SensorEventLog& ev = events[i];
+        ev.mTimestamp = timestamp;
+        const int64_t wallTime = timestamp + realtimeOffset;
+        ev.mWallTime.tv_sec = wallTime / 1000000000LL;
+        ev.mWallTime.tv_nsec = wallTime % 1000000000LL;
+        std::fill(std::begin(ev.mData), std::end(ev.mData), 0);
+        std::copy_n(&data[slot * mWordsPerEvent], mWordsPerEvent, ev.mData);
+
+        if (deltas[slot] != kTimestampEscape) {
+            timestamp -= decodeTimestampDelta(deltas[slot]);
+            continue;
+        }
+        const auto escape = std::find_if(std::begin(escapes), std::end(escapes),
+                [index](const TimestampEscape& e) { return e.mEventIndex == index; });
+        if (escape == std::end(escapes)) {
+            // The escape holding the timestamp of the older events has been overwritten.
+            events.resize(i + 1);
+            break;
+        }
+        timestamp = escape->mPreviousTimestamp;
+    }
+    return events;
 }
 
 std::string RecentEventLogger::dump() const {
-    std::lock_guard<std::mutex> lk(mLock);
+    const std::vector<SensorEventLog> events = decodeEvents();
+    const bool maskData = mMaskData.load(std::memory_order_relaxed);
 
     //TODO: replace String8 with std::string completely in this function
     String8 buffer;
 
-    buffer.appendFormat("last %zu events\n", mRecentEvents.size());
+    buffer.appendFormat("last %zu events\n", events.size());
     int j = 0;
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
+    for (const SensorEventLog& ev : events) {
         struct tm * timeinfo = localtime(&(ev.mWallTime.tv_sec));
         buffer.appendFormat("\t%2d (ts=%.9f, wall=%02d:%02d:%02d.%03d) ",
-                ++j, ev.mEvent.timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
+                ++j, ev.mTimestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
                 (int) ns2ms(ev.mWallTime.tv_nsec));
 
         // data
-        if (!mMaskData) {
+        if (!maskData) {
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                buffer.appendFormat("%" PRIu64 ", ", ev.mEvent.u64.step_counter);
+                uint64_t stepCounter;
+                memcpy(&stepCounter, ev.mData, sizeof(stepCounter));
+                buffer.appendFormat("%" PRIu64 ", ", stepCounter);
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    buffer.appendFormat("%.2f, ", ev.mEvent.data[k]);
+                    float value;
+                    memcpy(&value, &ev.mData[k], sizeof(value));
+                    buffer.appendFormat("%.2f, ", value);
                 }
             }
         } else {
@@ -95,24 +257,28 @@ std::string RecentEventLogger::dump() const {
  */
 void RecentEventLogger::dump(util::ProtoOutputStream* proto) const {
     using namespace service::SensorEventsProto;
-    std::lock_guard<std::mutex> lk(mLock);
+    const std::vector<SensorEventLog> events = decodeEvents();
+    const bool maskData = mMaskData.load(std::memory_order_relaxed);
 
-    proto->write(RecentEventsLog::RECENT_EVENTS_COUNT, int(mRecentEvents.size()));
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
+    proto->write(RecentEventsLog::RECENT_EVENTS_COUNT, int(events.size()));
+    for (const SensorEventLog& ev : events) {
         const uint64_t token = proto->start(RecentEventsLog::EVENTS);
-        proto->write(Event::TIMESTAMP_SEC, float(ev.mEvent.timestamp) / 1e9f);
+        proto->write(Event::TIMESTAMP_SEC, float(ev.mTimestamp) / 1e9f);
         proto->write(Event::WALL_TIMESTAMP_MS, ev.mWallTime.tv_sec * 1000LL
                 + ns2ms(ev.mWallTime.tv_nsec));
 
-        if (mMaskData) {
+        if (maskData) {
             proto->write(Event::MASKED, true);
         } else {
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                proto->write(Event::INT64_DATA, int64_t(ev.mEvent.u64.step_counter));
+                uint64_t stepCounter;
+                memcpy(&stepCounter, ev.mData, sizeof(stepCounter));
+                proto->write(Event::INT64_DATA, int64_t(stepCounter));
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    proto->write(Event::FLOAT_ARRAY, ev.mEvent.data[k]);
+                    float value;
+                    memcpy(&value, &ev.mData[k], sizeof(value));
+                    proto->write(Event::FLOAT_ARRAY, value);
                 }
             }
         }
@@ -121,23 +287,30 @@ void RecentEventLogger::dump(util::ProtoOutputStream* proto) const {
 }
 
 void RecentEventLogger::setFormat(std::string format) {
-    if (format == "mask_data" ) {
-        mMaskData = true;
-    } else {
-        mMaskData = false;
-    }
+    mMaskData.store(format == "mask_data", std::memory_order_relaxed);
 }
 
 bool RecentEventLogger::populateLastEventIfCurrent(sensors_event_t *event) const {
-    std::lock_guard<std::mutex> lk(mLock);
-
-    if (mIsLastEventCurrent && mRecentEvents.size()) {
-        // Index 0 contains the latest event emplace()'ed
-        *event = mRecentEvents[0].mEvent;
-        return true;
-    } else {
+    if (!mIsLastEventCurrent.load(std::memory_order_relaxed)) {
         return false;
     }
+    uint32_t lastEvent[kEventWordCount];
+    for (int attempt = 0; attempt < 10; attempt++) {
+        const uint64_t sequence = mSequence.load(std::memory_order_acquire);
+        if (sequence == 0) {
+            return false;
+        }
+        if (sequence % 2 != 0) {
+            continue;
+        }
+        loadWords(lastEvent, mLastEvent, kEventWordCount);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mSequence.load(std::memory_order_relaxed) == sequence) {
+            memcpy(event, lastEvent, sizeof(*event));
+            return true;
+        }
+    }
+    return false;
 }
 
 
@@ -154,9 +327,5 @@ size_t RecentEventLogger::logSizeBySensorType(int sensorType) {
     return LOG_SIZE;
 }
 
-RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e) : mEvent(e) {
-    clock_gettime(CLOCK_REALTIME, &mWallTime);
-}
-
 } // namespace SensorServiceUtil
 } // namespace android
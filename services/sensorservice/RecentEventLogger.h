@@ -17,13 +17,14 @@
 #ifndef ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 #define ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 
-#include "RingBuffer.h"
 #include "SensorServiceUtils.h"
 
 #include <hardware/sensors.h>
 #include <utils/String8.h>
 
-#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -33,6 +34,12 @@ namespace SensorServiceUtil {
 // generated from the sensor are stored in this buffer.  The buffer is NOT cleared when the sensor
 // unregisters and as a result very old data in the dumpsys output can be seen, which is an intended
 // behavior.
+//
+// The events are stored in a compact columnar form: one 32-bit timestamp delta per event and only
+// the data words that are meaningful for the sensor type. addEvent() is called for every event on
+// the poll thread, so it only stores these words and never blocks; the log is protected by a
+// sequence counter and decoded at dump time. addEvent() must not be called concurrently for the
+// same logger, but all other methods may run concurrently with it.
 class RecentEventLogger : public Dumpable {
 public:
     explicit RecentEventLogger(int sensorType);
@@ -46,26 +53,65 @@ public:
     void setLastEventStale();
     virtual ~RecentEventLogger() {}
 
+    // Number of bytes used to store the recent events
+    size_t getLogSizeBytes() const;
+
     // Dumpable interface
     virtual std::string dump() const override;
     virtual void dump(util::ProtoOutputStream* proto) const override;
     virtual void setFormat(std::string format) override;
 
 protected:
+    // Size of the data union of sensors_event_t, in 32-bit words
+    static constexpr size_t kDataWordCount = 16;
+    static constexpr size_t kEventWordCount = sizeof(sensors_event_t) / sizeof(uint32_t);
+
+    // A recorded event, as decoded from the log at dump time.
     struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
+        int64_t mTimestamp;
         timespec mWallTime;
-        sensors_event_t mEvent;
+        uint32_t mData[kDataWordCount];
     };
 
+    // Decode the events in the log, from the most recent to the oldest.
+    std::vector<SensorEventLog> decodeEvents() const;
+
     const int mSensorType;
     const size_t mEventSize;
-
-    mutable std::mutex mLock;
-    RingBuffer<SensorEventLog> mRecentEvents;
-
-    bool mMaskData;
-    bool mIsLastEventCurrent;
+    const size_t mCapacity;
+    // Number of 32-bit data words stored for each event
+    const size_t mWordsPerEvent;
+
+    // A timestamp delta that does not fit in the encoded form, stored as the full timestamp of
+    // the event before the one with index mEventIndex.
+    struct TimestampEscape {
+        uint64_t mEventIndex;
+        int64_t mPreviousTimestamp;
+    };
+    // Escapes are rare, so only the most recent ones are kept. Events older than the oldest
+    // escape that is kept are not reported.
+    static constexpr size_t kMaxTimestampEscapes = 4;
+    // Encoded delta of an event whose previous timestamp is stored in mTimestampEscapes
+    static constexpr uint32_t kTimestampEscape = UINT32_MAX;
+
+    // Returns kTimestampEscape if the delta is negative or too large to be encoded.
+    static uint32_t encodeTimestampDelta(int64_t delta);
+    static int64_t decodeTimestampDelta(uint32_t encodedDelta);
+
+    // Written by addEvent() only. See encodeTimestampDelta() for the format.
+    std::unique_ptr<uint32_t[]> mTimestampDeltas;
+    std::unique_ptr<uint32_t[]> mData;
+    std::atomic<int64_t> mLastTimestamp;
+    TimestampEscape mTimestampEscapes[kMaxTimestampEscapes];
+    uint64_t mTimestampEscapeCount;
+    // The complete last event, to be sent to new clients of on-change sensors
+    uint32_t mLastEvent[kEventWordCount];
+
+    // Odd while addEvent() is modifying the log. mSequence / 2 is the number of recorded events.
+    std::atomic<uint64_t> mSequence;
+
+    std::atomic<bool> mMaskData;
+    std::atomic<bool> mIsLastEventCurrent;
 
 private:
     static size_t logSizeBySensorType(int sensorType);
@@ -168,11 +168,13 @@ bool SensorService::SensorEventConnection::addSensor(int32_t handle) {
         return false;
     }
     mSensorInfo[handle] = FlushInfo();
+    mService->mEventRouter.addSubscriber(handle, this);
     return true;
 }
 
 bool SensorService::SensorEventConnection::removeSensor(int32_t handle) {
     Mutex::Autolock _l(mConnectionLock);
+    mService->mEventRouter.removeSubscriber(handle, this);
     if (mSensorInfo.erase(handle) >= 0) {
         return true;
     }
@@ -290,7 +292,8 @@ bool SensorService::SensorEventConnection::incrementPendingFlushCountIfHasAccess
 status_t SensorService::SensorEventConnection::sendEvents(
         sensors_event_t const* buffer, size_t numEvents,
         sensors_event_t* scratch,
-        wp<const SensorEventConnection> const * mapFlushEventsToConnections) {
+        wp<const SensorEventConnection> const * mapFlushEventsToConnections,
+        const std::vector<SensorServiceUtil::EventRange>* ranges) {
     // filter out events not for this connection
 
     std::unique_ptr<sensors_event_t[]> sanitizedBuffer;
@@ -298,64 +301,74 @@ status_t SensorService::SensorEventConnection::sendEvents(
     int count = 0;
     Mutex::Autolock _l(mConnectionLock);
     if (scratch) {
-        size_t i=0;
-        while (i<numEvents) {
-            int32_t sensor_handle = buffer[i].sensor;
-            if (buffer[i].type == SENSOR_TYPE_META_DATA) {
-                ALOGD_IF(DEBUG_CONNECTIONS, "flush complete event sensor==%d ",
-                        buffer[i].meta_data.sensor);
-                // Setting sensor_handle to the correct sensor to ensure the sensor events per
-                // connection are filtered correctly.  buffer[i].sensor is zero for meta_data
-                // events.
-                sensor_handle = buffer[i].meta_data.sensor;
-            }
+        // Without ranges from the poll thread, scan the whole buffer.
+        const SensorServiceUtil::EventRange allEvents = {0, numEvents};
+        const SensorServiceUtil::EventRange* range = ranges ? ranges->data() : &allEvents;
+        const SensorServiceUtil::EventRange* rangesEnd = ranges ? range + ranges->size()
+                                                                : &allEvents + 1;
+        for (; range != rangesEnd; ++range) {
+            size_t i = range->mBegin;
+            const size_t end = range->mEnd;
+            while (i < end) {
+                int32_t sensor_handle = buffer[i].sensor;
+                if (buffer[i].type == SENSOR_TYPE_META_DATA) {
+                    ALOGD_IF(DEBUG_CONNECTIONS, "flush complete event sensor==%d ",
+                            buffer[i].meta_data.sensor);
+                    // Setting sensor_handle to the correct sensor to ensure the sensor events per
+                    // connection are filtered correctly.  buffer[i].sensor is zero for meta_data
+                    // events.
+                    sensor_handle = buffer[i].meta_data.sensor;
+                }
 
-            // Check if this connection has registered for this sensor. If not continue to the
-            // next sensor_event.
-            if (mSensorInfo.count(sensor_handle) == 0) {
-                ++i;
-                continue;
-            }
+                // Check if this connection has registered for this sensor. If not continue to
+                // the next sensor_event.
+                if (mSensorInfo.count(sensor_handle) == 0) {
+                    ++i;
+                    continue;
+                }
 
-            FlushInfo& flushInfo = mSensorInfo[sensor_handle];
-            // Check if there is a pending flush_complete event for this sensor on this connection.
-            if (buffer[i].type == SENSOR_TYPE_META_DATA && flushInfo.mFirstFlushPending == true &&
-                    mapFlushEventsToConnections[i] == this) {
-                flushInfo.mFirstFlushPending = false;
-                ALOGD_IF(DEBUG_CONNECTIONS, "First flush event for sensor==%d ",
-                        buffer[i].meta_data.sensor);
-                ++i;
-                continue;
-            }
+                FlushInfo& flushInfo = mSensorInfo[sensor_handle];
+                // Check if there is a pending flush_complete event for this sensor on this
+                // connection.
+                if (buffer[i].type == SENSOR_TYPE_META_DATA &&
+                        flushInfo.mFirstFlushPending == true &&
+                        mapFlushEventsToConnections[i] == this) {
+                    flushInfo.mFirstFlushPending = false;
+                    ALOGD_IF(DEBUG_CONNECTIONS, "First flush event for sensor==%d ",
+                            buffer[i].meta_data.sensor);
+                    ++i;
+                    continue;
+                }
 
-            // If there is a pending flush complete event for this sensor on this connection,
-            // ignore the event and proceed to the next.
-            if (flushInfo.mFirstFlushPending) {
-                ++i;
-                continue;
-            }
+                // If there is a pending flush complete event for this sensor on this connection,
+                // ignore the event and proceed to the next.
+                if (flushInfo.mFirstFlushPending) {
+                    ++i;
+                    continue;
+                }
 
-            do {
-                // Keep copying events into the scratch buffer as long as they are regular
-                // sensor_events are from the same sensor_handle OR they are flush_complete_events
-                // from the same sensor_handle AND the current connection is mapped to the
-                // corresponding flush_complete_event.
-                if (buffer[i].type == SENSOR_TYPE_META_DATA) {
-                    if (mapFlushEventsToConnections[i] == this) {
-                        scratch[count++] = buffer[i];
+                do {
+                    // Keep copying events into the scratch buffer as long as they are regular
+                    // sensor_events are from the same sensor_handle OR they are
+                    // flush_complete_events from the same sensor_handle AND the current
+                    // connection is mapped to the corresponding flush_complete_event.
+                    if (buffer[i].type == SENSOR_TYPE_META_DATA) {
+                        if (mapFlushEventsToConnections[i] == this) {
+                            scratch[count++] = buffer[i];
+                        }
+                    } else {
+                        // Regular sensor event, just copy it to the scratch buffer after checking
+                        // the AppOp.
+                        if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
+                            scratch[count++] = buffer[i];
+                        }
                     }
-                } else {
-                    // Regular sensor event, just copy it to the scratch buffer after checking
-                    // the AppOp.
-                    if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
-                        scratch[count++] = buffer[i];
-                    }
-                }
-                i++;
-            } while ((i<numEvents) && ((buffer[i].sensor == sensor_handle &&
+                    i++;
+                } while ((i < end) && ((buffer[i].sensor == sensor_handle &&
                                         buffer[i].type != SENSOR_TYPE_META_DATA) ||
                                        (buffer[i].type == SENSOR_TYPE_META_DATA  &&
                                         buffer[i].meta_data.sensor == sensor_handle)));
+            }
         }
     } else {
         if (hasSensorAccess()) {
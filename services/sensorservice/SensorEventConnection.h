@@ -54,8 +54,12 @@ public:
                           bool isDataInjectionMode, const String16& opPackageName,
                           const String16& attributionTag);
 
+    // Sends the events of the buffer that are for this connection. If scratch is set, the events
+    // are filtered into it; ranges, when set, limit the filtering to the ranges of the buffer
+    // routed to this connection by the poll thread.
     status_t sendEvents(sensors_event_t const* buffer, size_t count, sensors_event_t* scratch,
-                        wp<const SensorEventConnection> const * mapFlushEventsToConnections = nullptr);
+                        wp<const SensorEventConnection> const * mapFlushEventsToConnections = nullptr,
+                        const std::vector<SensorServiceUtil::EventRange>* ranges = nullptr);
     bool hasSensor(int32_t handle) const;
     bool hasAnySensor() const;
     bool hasOneShotSensors() const;
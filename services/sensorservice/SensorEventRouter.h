@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_SERVICE_UTIL_SENSOR_EVENT_ROUTER_H
+#define ANDROID_SENSOR_SERVICE_UTIL_SENSOR_EVENT_ROUTER_H
+
+#include <hardware/sensors.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace SensorServiceUtil {
+
+// A run of consecutive events of a batch, [mBegin, mEnd).
+struct EventRange {
+    size_t mBegin;
+    size_t mEnd;
+};
+
+// Routes the events of a batch to the subscribers of their sensors.
+//
+// The router keeps an index of the subscribers of each sensor handle, which is updated when a
+// subscriber enables or disables a sensor. route() makes a single pass over a batch and builds,
+// for every subscriber, the ranges of the batch that contain its events, so each subscriber only
+// visits its own events instead of scanning the whole batch. Flush complete events are routed by
+// the sensor they were generated for.
+//
+// The router stores pointers to the subscribers but never dereferences them. A subscriber must be
+// removed with removeSubscriber() before it is destroyed. This class is not thread safe.
+template <typename Subscriber>
+class SensorEventRouter {
+public:
+    // Returns true if the subscriber was not already subscribed to the sensor.
+    bool addSubscriber(int32_t handle, const Subscriber* subscriber) {
+        std::vector<Slot*>& slots = mSlotsByHandle[handle];
+        Slot& slot = mSlots[subscriber];
+        if (std::find(slots.begin(), slots.end(), &slot) != slots.end()) {
+            return false;
+        }
+        slots.push_back(&slot);
+        slot.mHandleCount++;
+        return true;
+    }
+
+    // Returns true if the subscriber was subscribed to the sensor.
+    bool removeSubscriber(int32_t handle, const Subscriber* subscriber) {
+        auto slotIt = mSlots.find(subscriber);
+        auto handleIt = mSlotsByHandle.find(handle);
+        if (slotIt == mSlots.end() || handleIt == mSlotsByHandle.end()) {
+            return false;
+        }
+        std::vector<Slot*>& slots = handleIt->second;
+        auto it = std::find(slots.begin(), slots.end(), &slotIt->second);
+        if (it == slots.end()) {
+            return false;
+        }
+        slots.erase(it);
+        if (slots.empty()) {
+            mSlotsByHandle.erase(handleIt);
+        }
+        if (--slotIt->second.mHandleCount == 0) {
+            eraseSlot(slotIt);
+        }
+        return true;
+    }
+
+    // Removes the subscriber from all the sensors it is subscribed to.
+    void removeSubscriber(const Subscriber* subscriber) {
+        auto slotIt = mSlots.find(subscriber);
+        if (slotIt == mSlots.end()) {
+            return;
+        }
+        for (auto it = mSlotsByHandle.begin(); it != mSlotsByHandle.end();) {
+            std::vector<Slot*>& slots = it->second;
+            slots.erase(std::remove(slots.begin(), slots.end(), &slotIt->second), slots.end());
+            it = slots.empty() ? mSlotsByHandle.erase(it) : std::next(it);
+        }
+        eraseSlot(slotIt);
+    }
+
+    size_t getSubscriberCount(int32_t handle) const {
+        auto it = mSlotsByHandle.find(handle);
+        return it == mSlotsByHandle.end() ? 0 : it->second.size();
+    }
+
+    // Builds the ranges of events of each subscriber, replacing those of the previous batch.
+    void route(const sensors_event_t* buffer, size_t count) {
+        for (Slot* slot : mRoutedSlots) {
+            slot->mRanges.clear();
+        }
+        mRoutedSlots.clear();
+
+        int32_t lastHandle = 0;
+        const std::vector<Slot*>* slots = nullptr;
+        for (size_t i = 0; i < count; i++) {
+            const int32_t handle = getHandle(buffer[i]);
+            if (slots == nullptr || handle != lastHandle) {
+                auto it = mSlotsByHandle.find(handle);
+                slots = it == mSlotsByHandle.end() ? &kNoSlots : &it->second;
+                lastHandle = handle;
+            }
+            for (Slot* slot : *slots) {
+                std::vector<EventRange>& ranges = slot->mRanges;
+                if (ranges.empty()) {
+                    mRoutedSlots.push_back(slot);
+                    ranges.push_back({i, i + 1});
+                } else if (ranges.back().mEnd == i) {
+                    ranges.back().mEnd++;
+                } else {
+                    ranges.push_back({i, i + 1});
+                }
+            }
+        }
+    }
+
+    // The ranges of the last routed batch that contain events for the subscriber.
+    const std::vector<EventRange>& getRanges(const Subscriber* subscriber) const {
+        auto it = mSlots.find(subscriber);
+        return it == mSlots.end() ? kNoRanges : it->second.mRanges;
+    }
+
+    // The sensor an event is routed by.
+    static int32_t getHandle(const sensors_event_t& event) {
+        // buffer[i].sensor is zero for flush complete events.
+        return event.type == SENSOR_TYPE_META_DATA ? event.meta_data.sensor : event.sensor;
+    }
+
+private:
+    struct Slot {
+        size_t mHandleCount = 0;
+        std::vector<EventRange> mRanges;
+    };
+
+    // Nodes of an unordered_map are stable, so the slots can be referenced by pointer.
+    using SlotMap = std::unordered_map<const Subscriber*, Slot>;
+
+    void eraseSlot(typename SlotMap::iterator it) {
+        Slot* slot = &it->second;
+        mRoutedSlots.erase(std::remove(mRoutedSlots.begin(), mRoutedSlots.end(), slot),
+                           mRoutedSlots.end());
+        mSlots.erase(it);
+    }
+
+    static inline const std::vector<Slot*> kNoSlots;
+    static inline const std::vector<EventRange> kNoRanges;
+
+    SlotMap mSlots;
+    std::unordered_map<int32_t, std::vector<Slot*>> mSlotsByHandle;
+    // Slots with ranges from the last routed batch.
+    std::vector<Slot*> mRoutedSlots;
+};
+
+} // namespace SensorServiceUtil
+} // namespace android
+
+#endif // ANDROID_SENSOR_SERVICE_UTIL_SENSOR_EVENT_ROUTER_H
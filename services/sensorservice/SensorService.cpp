@@ -1220,12 +1220,16 @@ bool SensorService::threadLoop() {
             }
         }
 
+        // Find the events of each connection in a single pass over the buffer.
+        mEventRouter.route(mSensorEventBuffer, count);
+
         // Send our events to clients. Check the state of wake lock for each client and release the
         // lock if none of the clients need it.
         bool needsWakeLock = false;
         for (const sp<SensorEventConnection>& connection : activeConnections) {
             connection->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
-                                   mMapFlushEventsToConnections);
+                                   mMapFlushEventsToConnections,
+                                   &mEventRouter.getRanges(connection.get()));
             needsWakeLock |= connection->needsWakeLock();
             // If the connection has one-shot sensors, it may be cleaned up after first trigger.
             // Early check for one-shot sensors.
@@ -1856,6 +1860,8 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
             i++;
         }
     }
+    // Drop the sensors that are no longer active from the routing index as well.
+    mEventRouter.removeSubscriber(c);
     c->updateLooperRegistration(mLooper);
     mConnectionHolder.removeEventConnection(connection);
     if (c->needsWakeLock()) {
@@ -19,6 +19,7 @@
 
 #include "SensorList.h"
 #include "RecentEventLogger.h"
+#include "SensorEventRouter.h"
 
 #include <android-base/macros.h>
 #include <binder/AppOpsManager.h>
@@ -549,6 +550,8 @@ private:
     // WARNING: these SensorEventConnection instances must not be promoted to sp, except via
     // modification to add support for them in ConnectionSafeAutolock
     wp<const SensorEventConnection> * mMapFlushEventsToConnections;
+    // The connections registered for each sensor, used to route the polled events.
+    SensorServiceUtil::SensorEventRouter<SensorEventConnection> mEventRouter;
     std::unordered_map<int, SensorServiceUtil::RecentEventLogger*> mRecentEvent;
     Mode mCurrentOperatingMode;
     std::queue<sensors_event_t> mRuntimeSensorEventQueue;
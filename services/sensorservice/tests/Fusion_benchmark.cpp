@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <hardware/sensors.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Fusion.h"
+#include "FusionKernels.h"
+
+using namespace android;
+
+namespace {
+
+vec3_t makeVec3(float x, float y, float z) {
+    vec3_t v;
+    v.x = x;
+    v.y = y;
+    v.z = z;
+    return v;
+}
+
+struct ImuSample {
+    int type;
+    int64_t timestamp;
+    vec3_t value;
+};
+
+/**
+ * Recorded IMU data can be replayed by setting FUSION_REPLAY_TRACE to a file with one sample per
+ * line, in the form "type,timestampNs,x,y,z", where type is a SENSOR_TYPE_* value. Otherwise, a
+ * synthetic 10 second trace of a device slowly rotating about all three axes is used.
+ */
+std::vector<ImuSample> loadTrace() {
+    std::vector<ImuSample> trace;
+    const char* path = getenv("FUSION_REPLAY_TRACE");
+    if (path != nullptr) {
+        FILE* file = fopen(path, "r");
+        if (file != nullptr) {
+            ImuSample sample;
+            long long timestamp;
+            while (fscanf(file, "%d,%lld,%f,%f,%f", &sample.type, &timestamp, &sample.value.x,
+                          &sample.value.y, &sample.value.z) == 5) {
+                sample.timestamp = timestamp;
+                trace.push_back(sample);
+            }
+            fclose(file);
+        }
+        if (!trace.empty()) {
+            return trace;
+        }
+        fprintf(stderr, "Could not read %s, using a synthetic trace\n", path);
+    }
+
+    // 200Hz gyroscope and accelerometer, 50Hz magnetometer
+    constexpr int64_t period = 5000000;
+    const vec3_t w = makeVec3(0.3f, -0.2f, 0.5f);
+    for (int i = 0; i < 2000; i++) {
+        const int64_t timestamp = i * period;
+        const float t = timestamp * 1e-9f;
+        // The gravity and magnetic field vectors, seen from the rotating device
+        const vec3_t a = makeVec3(9.81f * sinf(w.x * t), 9.81f * sinf(w.y * t) * cosf(w.x * t),
+                                  9.81f * cosf(w.y * t) * cosf(w.x * t));
+        const vec3_t m = makeVec3(30.f * cosf(w.z * t), 30.f * sinf(w.z * t), -40.f);
+        trace.push_back({SENSOR_TYPE_GYROSCOPE, timestamp, w});
+        trace.push_back({SENSOR_TYPE_ACCELEROMETER, timestamp, a});
+        if (i % 4 == 0) {
+            trace.push_back({SENSOR_TYPE_MAGNETIC_FIELD, timestamp, m});
+        }
+    }
+    return trace;
+}
+
+const std::vector<ImuSample>& getTrace() {
+    static const std::vector<ImuSample> trace = loadTrace();
+    return trace;
+}
+
+mat33_t randomMatrix(unsigned& seed) {
+    mat33_t m;
+    for (size_t c = 0; c < 3; c++) {
+        for (size_t r = 0; r < 3; r++) {
+            seed = seed * 1103515245 + 12345;
+            m[c][r] = float((seed >> 16) & 0x7fff) / 0x7fff - 0.5f;
+        }
+    }
+    return m;
+}
+
+// A covariance matrix and a state transition matrix with the structure used by Fusion::predict
+void makeCovarianceInputs(mat<mat33_t, 2, 2>& P, mat<mat33_t, 2, 2>& Phi,
+                          mat<mat33_t, 2, 2>& GQGt) {
+    unsigned seed = 1;
+    const mat33_t M0 = randomMatrix(seed);
+    const mat33_t M1 = randomMatrix(seed);
+    const mat33_t M2 = randomMatrix(seed);
+    P[0][0] = M0 * transpose(M0) + mat33_t(1);
+    P[1][0] = M1 * 0.1f;
+    P[0][1] = transpose(P[1][0]);
+    P[1][1] = M2 * transpose(M2) + mat33_t(1);
+    Phi[0][0] = mat33_t(1) + randomMatrix(seed) * 0.01f;
+    Phi[1][0] = randomMatrix(seed) * 0.005f;
+    Phi[0][1] = 0;
+    Phi[1][1] = 1;
+    GQGt[0][0] = 1e-7f;
+    GQGt[1][0] = -1e-9f;
+    GQGt[0][1] = -1e-9f;
+    GQGt[1][1] = 1e-12f;
+}
+
+// One step of covariance propagation using the generic block matrix operators
+void BM_Fusion_propagateCovarianceGeneric(benchmark::State& state) {
+    mat<mat33_t, 2, 2> P, Phi, GQGt;
+    makeCovarianceInputs(P, Phi, GQGt);
+    for (auto _ : state) {
+        mat<mat33_t, 2, 2> result = Phi * P * transpose(Phi) + GQGt;
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_Fusion_propagateCovarianceGeneric);
+
+// One step of covariance propagation using the SIMD kernels
+void BM_Fusion_propagateCovarianceSimd(benchmark::State& state) {
+    mat<mat33_t, 2, 2> P, Phi, GQGt;
+    makeCovarianceInputs(P, Phi, GQGt);
+    for (auto _ : state) {
+        mat<mat33_t, 2, 2> result = P;
+        simd::propagateCovariance(result, Phi, GQGt);
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_Fusion_propagateCovarianceSimd);
+
+// Quaternion and gain products from Fusion::predict and Fusion::update, generic vs SIMD
+void BM_Fusion_quaternionProducts(benchmark::State& state) {
+    const bool useSimd = state.range(0);
+    unsigned seed = 7;
+    const mat33_t A = randomMatrix(seed);
+    const mat33_t B = randomMatrix(seed);
+    mat44_t O;
+    O[0].xyz = A[0];
+    O[1].xyz = A[1];
+    O[2].xyz = A[2];
+    O[3].xyz = B[0];
+    O[0].w = O[1].w = O[2].w = O[3].w = 0.5f;
+    vec4_t q;
+    q.xyz = makeVec3(0.1f, 0.2f, 0.3f);
+    q.w = 0.9f;
+    const vec3_t v = B[1];
+
+    for (auto _ : state) {
+        if (useSimd) {
+            benchmark::DoNotOptimize(simd::mul(O, q));
+            benchmark::DoNotOptimize(simd::mul(simd::transposedMul(A, B), v));
+        } else {
+            benchmark::DoNotOptimize(O * q);
+            benchmark::DoNotOptimize(transpose(A) * B * v);
+        }
+    }
+}
+BENCHMARK(BM_Fusion_quaternionProducts)->ArgName("simd")->Arg(0)->Arg(1);
+
+// Replay of a full IMU trace through the filter, in each fusion mode
+void BM_Fusion_replay(benchmark::State& state) {
+    const int mode = state.range(0);
+    const std::vector<ImuSample>& trace = getTrace();
+    const bool useGyro = mode != FUSION_NOGYRO;
+    const bool useMag = mode != FUSION_NOMAG;
+
+    for (auto _ : state) {
+        Fusion fusion;
+        fusion.init(mode);
+        int64_t lastGyro = 0;
+        int64_t lastAcc = 0;
+        for (const ImuSample& sample : trace) {
+            switch (sample.type) {
+                case SENSOR_TYPE_GYROSCOPE:
+                    if (useGyro) {
+                        if (lastGyro != 0) {
+                            fusion.handleGyro(sample.value, (sample.timestamp - lastGyro) * 1e-9f);
+                        }
+                        lastGyro = sample.timestamp;
+                    }
+                    break;
+                case SENSOR_TYPE_ACCELEROMETER:
+                    if (lastAcc != 0) {
+                        fusion.handleAcc(sample.value, (sample.timestamp - lastAcc) * 1e-9f);
+                    }
+                    lastAcc = sample.timestamp;
+                    break;
+                case SENSOR_TYPE_MAGNETIC_FIELD:
+                    if (useMag) {
+                        fusion.handleMag(sample.value);
+                    }
+                    break;
+            }
+        }
+        benchmark::DoNotOptimize(fusion.getAttitude());
+    }
+    state.SetItemsProcessed(state.iterations() * trace.size());
+}
+BENCHMARK(BM_Fusion_replay)
+        ->ArgName("mode")
+        ->Arg(FUSION_9AXIS)
+        ->Arg(FUSION_NOMAG)
+        ->Arg(FUSION_NOGYRO);
+
+} // namespace
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "FusionKernels.h"
+
+namespace android {
+
+namespace {
+
+// Largest difference allowed between the kernels and the generic mat.h operators, relative to
+// the magnitude of the result. The kernels only reassociate the sums of the generic operators.
+constexpr float TOLERANCE = 1e-5f;
+
+constexpr unsigned SEEDS[] = {1, 7, 42, 1234};
+
+vec3_t makeVec3(float x, float y, float z) {
+    vec3_t v;
+    v.x = x;
+    v.y = y;
+    v.z = z;
+    return v;
+}
+
+mat33_t randomMatrix(unsigned& seed) {
+    mat33_t m;
+    for (size_t c = 0; c < 3; c++) {
+        for (size_t r = 0; r < 3; r++) {
+            seed = seed * 1103515245 + 12345;
+            m[c][r] = float((seed >> 16) & 0x7fff) / 0x7fff - 0.5f;
+        }
+    }
+    return m;
+}
+
+// A covariance matrix and a state transition matrix with the structure used by Fusion::predict
+void makeCovarianceInputs(unsigned seed, mat<mat33_t, 2, 2>& P, mat<mat33_t, 2, 2>& Phi,
+                          mat<mat33_t, 2, 2>& GQGt) {
+    const mat33_t M0 = randomMatrix(seed);
+    const mat33_t M1 = randomMatrix(seed);
+    const mat33_t M2 = randomMatrix(seed);
+    P[0][0] = M0 * transpose(M0) + mat33_t(1);
+    P[1][0] = M1 * 0.1f;
+    P[0][1] = transpose(P[1][0]);
+    P[1][1] = M2 * transpose(M2) + mat33_t(1);
+    Phi[0][0] = mat33_t(1) + randomMatrix(seed) * 0.01f;
+    Phi[1][0] = randomMatrix(seed) * 0.005f;
+    Phi[0][1] = 0;
+    Phi[1][1] = 1;
+    GQGt[0][0] = 1e-7f;
+    GQGt[1][0] = -1e-9f;
+    GQGt[0][1] = -1e-9f;
+    GQGt[1][1] = 1e-12f;
+}
+
+template <typename V>
+void expectNear(const V& expected, const V& actual, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        EXPECT_LE(fabsf(expected[i] - actual[i]), TOLERANCE * std::max(1.f, fabsf(expected[i])))
+                << "at " << i << ": expected " << expected[i] << ", got " << actual[i];
+    }
+}
+
+void expectNear(const mat33_t& expected, const mat33_t& actual) {
+    for (size_t c = 0; c < 3; c++) {
+        SCOPED_TRACE(testing::Message() << "column " << c);
+        expectNear(expected[c], actual[c], 3);
+    }
+}
+
+} // namespace
+
+TEST(FusionKernelsTest, MatrixProductsMatchGenericOperators) {
+    for (unsigned seed : SEEDS) {
+        SCOPED_TRACE(testing::Message() << "seed " << seed);
+        const mat33_t A = randomMatrix(seed);
+        const mat33_t B = randomMatrix(seed);
+        const mat33_t C = randomMatrix(seed);
+
+        expectNear(A * B, simd::mul(A, B));
+        expectNear(A * transpose(B), simd::mulTransposed(A, B));
+        expectNear(transpose(A) * B, simd::transposedMul(A, B));
+        expectNear(A * B + C, simd::mulAdd(A, B, C));
+        expectNear(C - A * B, simd::mulSub(C, A, B));
+    }
+}
+
+TEST(FusionKernelsTest, TransposedMulOfIdentityIsTranspose) {
+    unsigned seed = 3;
+    const mat33_t A = randomMatrix(seed);
+    const mat33_t At = simd::transposedMul(A, mat33_t(1));
+    for (size_t c = 0; c < 3; c++) {
+        for (size_t r = 0; r < 3; r++) {
+            EXPECT_EQ(A[r][c], At[c][r]);
+        }
+    }
+}
+
+TEST(FusionKernelsTest, MatrixVectorProductsMatchGenericOperators) {
+    for (unsigned seed : SEEDS) {
+        SCOPED_TRACE(testing::Message() << "seed " << seed);
+        const mat33_t A = randomMatrix(seed);
+        const mat33_t B = randomMatrix(seed);
+        const vec3_t v = makeVec3(0.1f, -0.7f, 2.5f);
+        expectNear(A * v, simd::mul(A, v), 3);
+
+        mat44_t O;
+        O[0].xyz = A[0];
+        O[1].xyz = A[1];
+        O[2].xyz = A[2];
+        O[3].xyz = B[0];
+        O[0].w = O[1].w = O[2].w = O[3].w = 0.5f;
+        vec4_t q;
+        q.xyz = makeVec3(0.1f, 0.2f, 0.3f);
+        q.w = 0.9f;
+        expectNear(O * q, simd::mul(O, q), 4);
+
+        mat<float, 3, 4> F;
+        F[0] = O[0];
+        F[1] = O[1];
+        F[2] = O[2];
+        expectNear(F * v, simd::mul(F, v), 4);
+    }
+}
+
+TEST(FusionKernelsTest, PropagateCovarianceMatchesGenericBlockProduct) {
+    for (unsigned seed : SEEDS) {
+        SCOPED_TRACE(testing::Message() << "seed " << seed);
+        mat<mat33_t, 2, 2> P, Phi, GQGt;
+        makeCovarianceInputs(seed, P, Phi, GQGt);
+        const mat<mat33_t, 2, 2> expected = Phi * P * transpose(Phi) + GQGt;
+
+        mat<mat33_t, 2, 2> actual = P;
+        simd::propagateCovariance(actual, Phi, GQGt);
+        for (size_t i = 0; i < 2; i++) {
+            for (size_t j = 0; j < 2; j++) {
+                SCOPED_TRACE(testing::Message() << "block " << i << "," << j);
+                expectNear(expected[i][j], actual[i][j]);
+            }
+        }
+    }
+}
+
+} // namespace android
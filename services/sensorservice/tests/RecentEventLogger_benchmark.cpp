@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RecentEventLogger.h"
+
+using android::SensorServiceUtil::RecentEventLogger;
+
+namespace {
+
+// Size of an entry in the previous RingBuffer-based log: a full event and the wall time.
+constexpr size_t LEGACY_ENTRY_SIZE = sizeof(sensors_event_t) + sizeof(timespec);
+
+// A mix of sensor types, similar to the sensor list of a phone with many sensors.
+const std::vector<int> SENSOR_TYPES = {
+        SENSOR_TYPE_ACCELEROMETER,   SENSOR_TYPE_GYROSCOPE,
+        SENSOR_TYPE_MAGNETIC_FIELD,  SENSOR_TYPE_LIGHT,
+        SENSOR_TYPE_PROXIMITY,       SENSOR_TYPE_STEP_COUNTER,
+        SENSOR_TYPE_ROTATION_VECTOR, SENSOR_TYPE_GYROSCOPE_UNCALIBRATED,
+        SENSOR_TYPE_PRESSURE,        SENSOR_TYPE_DEVICE_PRIVATE_BASE,
+};
+
+sensors_event_t makeEvent(int sensorType, int64_t timestamp) {
+    sensors_event_t event{};
+    event.version = sizeof(sensors_event_t);
+    event.sensor = 1;
+    event.type = sensorType;
+    event.timestamp = timestamp;
+    if (sensorType == SENSOR_TYPE_STEP_COUNTER) {
+        event.u64.step_counter = timestamp / 1000000;
+    } else {
+        for (size_t i = 0; i < 16; i++) {
+            event.data[i] = 0.01f * float(timestamp % 1000) + float(i);
+        }
+    }
+    return event;
+}
+
+// Per-event cost of logging on the poll thread
+void BM_RecentEventLogger_addEvent(benchmark::State& state) {
+    const int sensorType = SENSOR_TYPES[state.range(0)];
+    RecentEventLogger logger(sensorType);
+    // 400Hz
+    constexpr int64_t period = 2500000;
+    int64_t timestamp = 0;
+    sensors_event_t event = makeEvent(sensorType, timestamp);
+    for (auto _ : state) {
+        timestamp += period;
+        event.timestamp = timestamp;
+        logger.addEvent(event);
+        benchmark::ClobberMemory();
+    }
+    state.counters["logBytes"] = logger.getLogSizeBytes();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RecentEventLogger_addEvent)->DenseRange(0, SENSOR_TYPES.size() - 1);
+
+// Per-event cost of logging while another thread keeps dumping the log
+void BM_RecentEventLogger_addEventWithConcurrentDump(benchmark::State& state) {
+    RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER);
+    std::atomic<bool> stop = false;
+    std::thread dumpThread([&]() {
+        while (!stop) {
+            benchmark::DoNotOptimize(logger.dump());
+        }
+    });
+
+    int64_t timestamp = 0;
+    sensors_event_t event = makeEvent(SENSOR_TYPE_ACCELEROMETER, timestamp);
+    for (auto _ : state) {
+        timestamp += 2500000;
+        event.timestamp = timestamp;
+        logger.addEvent(event);
+    }
+    stop = true;
+    dumpThread.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RecentEventLogger_addEventWithConcurrentDump);
+
+// Cost of decoding and formatting a full log at dump time
+void BM_RecentEventLogger_dump(benchmark::State& state) {
+    RecentEventLogger logger(SENSOR_TYPE_ACCELEROMETER);
+    for (int64_t i = 0; i < 100; i++) {
+        logger.addEvent(makeEvent(SENSOR_TYPE_ACCELEROMETER, i * 2500000));
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(logger.dump());
+    }
+}
+BENCHMARK(BM_RecentEventLogger_dump);
+
+// Memory used by the logs of many sensors, compared with the previous full-event ring buffers
+void BM_RecentEventLogger_manySensors(benchmark::State& state) {
+    const size_t sensorCount = state.range(0);
+    std::vector<std::unique_ptr<RecentEventLogger>> loggers;
+    std::vector<sensors_event_t> events;
+    for (size_t i = 0; i < sensorCount; i++) {
+        const int sensorType = SENSOR_TYPES[i % SENSOR_TYPES.size()];
+        loggers.push_back(std::make_unique<RecentEventLogger>(sensorType));
+        events.push_back(makeEvent(sensorType, 0));
+    }
+
+    int64_t timestamp = 0;
+    for (auto _ : state) {
+        timestamp += 1000000;
+        for (size_t i = 0; i < sensorCount; i++) {
+            events[i].timestamp = timestamp;
+            loggers[i]->addEvent(events[i]);
+        }
+    }
+
+    size_t logBytes = 0;
+    size_t legacyBytes = 0;
+    for (const auto& logger : loggers) {
+        logBytes += logger->getLogSizeBytes();
+        // Every log holds as many events as its previous ring buffer did
+        std::string dump = logger->dump();
+        legacyBytes += LEGACY_ENTRY_SIZE * std::count(dump.begin(), dump.end(), '\n') -
+                LEGACY_ENTRY_SIZE;
+    }
+    state.counters["logBytes"] = logBytes;
+    state.counters["legacyLogBytes"] = legacyBytes;
+    state.SetItemsProcessed(state.iterations() * sensorCount);
+}
+BENCHMARK(BM_RecentEventLogger_manySensors)->Arg(32)->Arg(128);
+
+} // namespace
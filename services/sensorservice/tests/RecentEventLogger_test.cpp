@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RecentEventLogger.h"
+
+namespace android {
+namespace SensorServiceUtil {
+
+namespace {
+
+// Capacity of the log for gyroscopes, and the number of values they report.
+constexpr size_t GYROSCOPE_LOG_SIZE = 10;
+constexpr size_t GYROSCOPE_VALUE_COUNT = 3;
+
+// Exposes the encoding and the decoded events of the log.
+class TestRecentEventLogger : public RecentEventLogger {
+public:
+    using RecentEventLogger::RecentEventLogger;
+    using RecentEventLogger::decodeEvents;
+    using RecentEventLogger::decodeTimestampDelta;
+    using RecentEventLogger::encodeTimestampDelta;
+    using RecentEventLogger::kMaxTimestampEscapes;
+    using RecentEventLogger::kTimestampEscape;
+
+    std::vector<int64_t> getTimestamps() const {
+        std::vector<int64_t> timestamps;
+        for (const auto& event : decodeEvents()) {
+            timestamps.push_back(event.mTimestamp);
+        }
+        return timestamps;
+    }
+};
+
+sensors_event_t makeEvent(int sensorType, int64_t timestamp, float value) {
+    sensors_event_t event{};
+    event.version = sizeof(sensors_event_t);
+    event.sensor = 1;
+    event.type = sensorType;
+    event.timestamp = timestamp;
+    for (size_t i = 0; i < 16; i++) {
+        event.data[i] = value + float(i);
+    }
+    return event;
+}
+
+sensors_event_t makeStepCounterEvent(int64_t timestamp, uint64_t steps) {
+    sensors_event_t event{};
+    event.version = sizeof(sensors_event_t);
+    event.sensor = 1;
+    event.type = SENSOR_TYPE_STEP_COUNTER;
+    event.timestamp = timestamp;
+    event.u64.step_counter = steps;
+    return event;
+}
+
+std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::istringstream stream(text);
+    for (std::string line; std::getline(stream, line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+} // namespace
+
+TEST(RecentEventLoggerTest, TimestampDeltasUnderOneSecondRoundTripExactly) {
+    for (int64_t delta : {int64_t(0), int64_t(1), int64_t(2'500'000), int64_t(999'999'999),
+                          int64_t((1 << 30) - 1)}) {
+        const uint32_t encoded = TestRecentEventLogger::encodeTimestampDelta(delta);
+        ASSERT_NE(TestRecentEventLogger::kTimestampEscape, encoded) << delta;
+        EXPECT_EQ(delta, TestRecentEventLogger::decodeTimestampDelta(encoded)) << delta;
+    }
+}
+
+TEST(RecentEventLoggerTest, LongerTimestampDeltasRoundTripToCoarserUnits) {
+    // Below ~17 minutes, deltas keep microsecond precision.
+    const int64_t seconds = s2ns(5) + 123'456'789;
+    EXPECT_EQ(s2ns(5) + 123'456'000,
+              TestRecentEventLogger::decodeTimestampDelta(
+                      TestRecentEventLogger::encodeTimestampDelta(seconds)));
+
+    // Up to ~12 days, deltas keep millisecond precision.
+    const int64_t hours = s2ns(3 * 60 * 60) + 987'654'321;
+    EXPECT_EQ(s2ns(3 * 60 * 60) + 987'000'000,
+              TestRecentEventLogger::decodeTimestampDelta(
+                      TestRecentEventLogger::encodeTimestampDelta(hours)));
+}
+
+TEST(RecentEventLoggerTest, NegativeAndOverflowingDeltasAreEscaped) {
+    EXPECT_EQ(TestRecentEventLogger::kTimestampEscape,
+              TestRecentEventLogger::encodeTimestampDelta(-1));
+    EXPECT_EQ(TestRecentEventLogger::kTimestampEscape,
+              TestRecentEventLogger::encodeTimestampDelta(-s2ns(10)));
+    EXPECT_EQ(TestRecentEventLogger::kTimestampEscape,
+              TestRecentEventLogger::encodeTimestampDelta(s2ns(30LL * 24 * 60 * 60)));
+}
+
+TEST(RecentEventLoggerTest, DecodesTimestampsExactlyAcrossEscapes) {
+    TestRecentEventLogger logger(SENSOR_TYPE_GYROSCOPE);
+    // The third event goes back in time, and the fifth one comes after a gap of a month.
+    const std::vector<int64_t> timestamps = {1'000'000'001, 1'002'500'003, 1'001'000'007,
+                                             1'003'500'011, 1'003'500'011 + s2ns(2'592'000),
+                                             1'006'000'013 + s2ns(2'592'000)};
+    for (int64_t timestamp : timestamps) {
+        logger.addEvent(makeEvent(SENSOR_TYPE_GYROSCOPE, timestamp, 1.0f));
+    }
+
+    EXPECT_EQ(std::vector<int64_t>(timestamps.rbegin(), timestamps.rend()),
+              logger.getTimestamps());
+}
+
+TEST(RecentEventLoggerTest, DropsEventsOlderThanTheOldestKeptEscape) {
+    TestRecentEventLogger logger(SENSOR_TYPE_GYROSCOPE);
+    // Every event after the first goes back in time, so each one needs an escape.
+    const size_t eventCount = TestRecentEventLogger::kMaxTimestampEscapes + 2;
+    for (size_t i = 0; i < eventCount; i++) {
+        logger.addEvent(makeEvent(SENSOR_TYPE_GYROSCOPE, 1'000'000'000 - i * 1000, float(i)));
+    }
+
+    // The escape of the second event was overwritten, so the first event is not reported.
+    std::vector<int64_t> expected;
+    for (size_t i = eventCount - 1; i >= 1; i--) {
+        expected.push_back(1'000'000'000 - i * 1000);
+    }
+    EXPECT_EQ(expected, logger.getTimestamps());
+}
+
+TEST(RecentEventLoggerTest, StoresStepCounterValues) {
+    TestRecentEventLogger logger(SENSOR_TYPE_STEP_COUNTER);
+    // Larger than 32 bits, so that both words of the counter have to be kept.
+    const uint64_t steps = (uint64_t(1) << 32) + 12345;
+    logger.addEvent(makeStepCounterEvent(1'000'000'000, steps));
+    logger.addEvent(makeStepCounterEvent(2'000'000'000, steps + 1));
+
+    const auto events = logger.decodeEvents();
+    ASSERT_EQ(2u, events.size());
+    uint64_t decoded;
+    memcpy(&decoded, events[0].mData, sizeof(decoded));
+    EXPECT_EQ(steps + 1, decoded);
+    memcpy(&decoded, events[1].mData, sizeof(decoded));
+    EXPECT_EQ(steps, decoded);
+
+    const std::string dump = logger.dump();
+    EXPECT_NE(std::string::npos, dump.find(std::to_string(steps + 1) + ", ")) << dump;
+    EXPECT_NE(std::string::npos, dump.find(std::to_string(steps) + ", ")) << dump;
+
+    sensors_event_t lastEvent;
+    ASSERT_TRUE(logger.populateLastEventIfCurrent(&lastEvent));
+    EXPECT_EQ(steps + 1, lastEvent.u64.step_counter);
+    EXPECT_EQ(2'000'000'000, lastEvent.timestamp);
+}
+
+TEST(RecentEventLoggerTest, DumpsTheMostRecentEventsAfterTheLogWraps) {
+    TestRecentEventLogger logger(SENSOR_TYPE_GYROSCOPE);
+    const size_t eventCount = 2 * GYROSCOPE_LOG_SIZE + 5;
+    for (size_t i = 0; i < eventCount; i++) {
+        logger.addEvent(makeEvent(SENSOR_TYPE_GYROSCOPE, ms2ns(i + 1), float(i)));
+    }
+
+    const std::vector<std::string> lines = splitLines(logger.dump());
+    ASSERT_EQ(GYROSCOPE_LOG_SIZE + 1, lines.size());
+    EXPECT_EQ("last 10 events", lines[0]);
+    for (size_t j = 0; j < GYROSCOPE_LOG_SIZE; j++) {
+        // The most recent event comes first.
+        const size_t i = eventCount - 1 - j;
+        const std::string& line = lines[j + 1];
+        char expectedTimestamp[32];
+        snprintf(expectedTimestamp, sizeof(expectedTimestamp), "ts=%.9f", ms2ns(i + 1) / 1e9);
+        EXPECT_NE(std::string::npos, line.find(expectedTimestamp)) << line;
+
+        // Only the values meaningful for the sensor type are reported.
+        std::string expectedValues;
+        for (size_t k = 0; k < GYROSCOPE_VALUE_COUNT; k++) {
+            char value[16];
+            snprintf(value, sizeof(value), "%.2f, ", float(i) + float(k));
+            expectedValues += value;
+        }
+        EXPECT_EQ(expectedValues, line.substr(line.size() - expectedValues.size())) << line;
+    }
+
+    logger.setFormat("mask_data");
+    const std::vector<std::string> maskedLines = splitLines(logger.dump());
+    ASSERT_EQ(GYROSCOPE_LOG_SIZE + 1, maskedLines.size());
+    for (size_t j = 1; j < maskedLines.size(); j++) {
+        EXPECT_EQ("[value masked]",
+                  maskedLines[j].substr(maskedLines[j].size() - strlen("[value masked]")))
+                << maskedLines[j];
+    }
+}
+
+TEST(RecentEventLoggerTest, ReadersSeeConsistentLogsWhileEventsAreAdded) {
+    TestRecentEventLogger logger(SENSOR_TYPE_GYROSCOPE);
+    constexpr int64_t period = 2'500'000;
+    constexpr size_t eventCount = 100'000;
+    std::atomic<bool> done = false;
+    std::thread writer([&]() {
+        for (size_t i = 0; i < eventCount; i++) {
+            logger.addEvent(makeEvent(SENSOR_TYPE_GYROSCOPE, period * (i + 1), float(i)));
+        }
+        done = true;
+    });
+
+    // Every event read must have the values it was added with, and the timestamps must be those
+    // of consecutive events, whatever the writer was doing at the time.
+    while (!done) {
+        const auto events = logger.decodeEvents();
+        for (size_t j = 0; j < events.size(); j++) {
+            const int64_t index = events[j].mTimestamp / period - 1;
+            ASSERT_EQ(period * (index + 1), events[j].mTimestamp);
+            float value;
+            memcpy(&value, &events[j].mData[0], sizeof(value));
+            ASSERT_EQ(float(index), value);
+            if (j > 0) {
+                ASSERT_EQ(events[j - 1].mTimestamp - period, events[j].mTimestamp);
+            }
+        }
+    }
+    writer.join();
+    EXPECT_EQ(GYROSCOPE_LOG_SIZE, logger.decodeEvents().size());
+}
+
+TEST(RecentEventLoggerTest, LastEventIsNotCurrentOnceStale) {
+    TestRecentEventLogger logger(SENSOR_TYPE_GYROSCOPE);
+    sensors_event_t lastEvent;
+    EXPECT_TRUE(logger.isEmpty());
+    EXPECT_FALSE(logger.populateLastEventIfCurrent(&lastEvent));
+
+    logger.addEvent(makeEvent(SENSOR_TYPE_GYROSCOPE, 1'000'000, 4.0f));
+    EXPECT_FALSE(logger.isEmpty());
+    ASSERT_TRUE(logger.populateLastEventIfCurrent(&lastEvent));
+    EXPECT_EQ(4.0f, lastEvent.data[0]);
+
+    logger.setLastEventStale();
+    EXPECT_FALSE(logger.populateLastEventIfCurrent(&lastEvent));
+}
+
+} // namespace SensorServiceUtil
+} // namespace android
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "SensorEventRouter.h"
+
+using android::SensorServiceUtil::EventRange;
+using android::SensorServiceUtil::SensorEventRouter;
+
+namespace {
+
+// Size of a batch read from the HAL, as in SensorService::threadLoop
+constexpr size_t BATCH_SIZE = 256;
+
+// Sensors of the synthetic HAL and their rates in Hz
+struct SyntheticSensor {
+    int32_t handle;
+    int type;
+    int rateHz;
+};
+const std::vector<SyntheticSensor> SENSORS = {
+        {1, SENSOR_TYPE_ACCELEROMETER, 400},   {2, SENSOR_TYPE_GYROSCOPE, 400},
+        {3, SENSOR_TYPE_MAGNETIC_FIELD, 100},  {4, SENSOR_TYPE_ROTATION_VECTOR, 200},
+        {5, SENSOR_TYPE_GAME_ROTATION_VECTOR, 200}, {6, SENSOR_TYPE_LIGHT, 10},
+        {7, SENSOR_TYPE_PROXIMITY, 5},         {8, SENSOR_TYPE_PRESSURE, 25},
+        {9, SENSOR_TYPE_GRAVITY, 200},         {10, SENSOR_TYPE_LINEAR_ACCELERATION, 200},
+};
+
+// A batch of events from all the sensors, interleaved by timestamp with a few flush complete
+// events, as returned by the HAL
+std::vector<sensors_event_t> makeBatch() {
+    std::vector<sensors_event_t> batch;
+    int64_t timestamp = 0;
+    while (batch.size() < BATCH_SIZE) {
+        timestamp += 1000000; // 1ms
+        for (const SyntheticSensor& sensor : SENSORS) {
+            if (batch.size() == BATCH_SIZE) {
+                break;
+            }
+            if ((timestamp / 1000000) % (1000 / sensor.rateHz) != 0) {
+                continue;
+            }
+            sensors_event_t event{};
+            event.version = sizeof(sensors_event_t);
+            event.sensor = sensor.handle;
+            event.type = sensor.type;
+            event.timestamp = timestamp;
+            if (batch.size() % 64 == 63) {
+                event.type = SENSOR_TYPE_META_DATA;
+                event.sensor = 0;
+                event.meta_data.what = META_DATA_FLUSH_COMPLETE;
+                event.meta_data.sensor = sensor.handle;
+            }
+            batch.push_back(event);
+        }
+    }
+    return batch;
+}
+
+// A client connection, registered for a few of the sensors
+struct Connection {
+    std::unordered_map<int32_t, bool> sensorInfo;
+    std::unique_ptr<sensors_event_t[]> scratch = std::make_unique<sensors_event_t[]>(BATCH_SIZE);
+    size_t delivered = 0;
+};
+
+std::vector<std::unique_ptr<Connection>> makeConnections(size_t count) {
+    std::vector<std::unique_ptr<Connection>> connections;
+    for (size_t i = 0; i < count; i++) {
+        auto connection = std::make_unique<Connection>();
+        // Most clients only use one or two sensors
+        connection->sensorInfo[SENSORS[i % SENSORS.size()].handle] = true;
+        if (i % 3 == 0) {
+            connection->sensorInfo[SENSORS[(i * 7 + 1) % SENSORS.size()].handle] = true;
+        }
+        connections.push_back(std::move(connection));
+    }
+    return connections;
+}
+
+// Copies the events of the range that are for the connection into its scratch buffer
+size_t filterEvents(Connection& connection, const sensors_event_t* buffer, EventRange range,
+                    size_t count) {
+    for (size_t i = range.mBegin; i < range.mEnd; i++) {
+        const int32_t handle = SensorEventRouter<Connection>::getHandle(buffer[i]);
+        if (connection.sensorInfo.count(handle) != 0) {
+            connection.scratch[count++] = buffer[i];
+        }
+    }
+    return count;
+}
+
+// Every connection scans the whole batch for its events
+void BM_SensorEventRouter_scanPerConnection(benchmark::State& state) {
+    const std::vector<sensors_event_t> batch = makeBatch();
+    std::vector<std::unique_ptr<Connection>> connections = makeConnections(state.range(0));
+    for (auto _ : state) {
+        for (auto& connection : connections) {
+            connection->delivered += filterEvents(*connection, batch.data(), {0, batch.size()}, 0);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_SensorEventRouter_scanPerConnection)->RangeMultiplier(2)->Range(1, 64)->Arg(100);
+
+// The poll thread routes the batch once, and every connection only visits its own events
+void BM_SensorEventRouter_route(benchmark::State& state) {
+    const std::vector<sensors_event_t> batch = makeBatch();
+    std::vector<std::unique_ptr<Connection>> connections = makeConnections(state.range(0));
+    SensorEventRouter<Connection> router;
+    for (auto& connection : connections) {
+        for (const auto& [handle, _] : connection->sensorInfo) {
+            router.addSubscriber(handle, connection.get());
+        }
+    }
+
+    for (auto _ : state) {
+        router.route(batch.data(), batch.size());
+        for (auto& connection : connections) {
+            size_t count = 0;
+            for (const EventRange& range : router.getRanges(connection.get())) {
+                count = filterEvents(*connection, batch.data(), range, count);
+            }
+            connection->delivered += count;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_SensorEventRouter_route)->RangeMultiplier(2)->Range(1, 64)->Arg(100);
+
+// Cost of a client enabling and disabling a sensor while many connections are registered
+void BM_SensorEventRouter_enableDisable(benchmark::State& state) {
+    std::vector<std::unique_ptr<Connection>> connections = makeConnections(state.range(0));
+    SensorEventRouter<Connection> router;
+    for (auto& connection : connections) {
+        for (const auto& [handle, _] : connection->sensorInfo) {
+            router.addSubscriber(handle, connection.get());
+        }
+    }
+    Connection client;
+    for (auto _ : state) {
+        router.addSubscriber(SENSORS[0].handle, &client);
+        router.removeSubscriber(SENSORS[0].handle, &client);
+    }
+}
+BENCHMARK(BM_SensorEventRouter_enableDisable)->Arg(10)->Arg(100);
+
+} // namespace
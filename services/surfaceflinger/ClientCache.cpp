@@ -19,6 +19,7 @@
 #define LOG_TAG "ClientCache"
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <algorithm>
 #include <cinttypes>
 
 #include <android-base/stringprintf.h>
@@ -33,30 +34,73 @@ ANDROID_SINGLETON_STATIC_INSTANCE(ClientCache);
 
 ClientCache::ClientCache() : mDeathRecipient(sp<CacheDeathRecipient>::make()) {}
 
-bool ClientCache::getBuffer(const client_cache_t& cacheId,
-                            ClientCacheBuffer** outClientCacheBuffer) {
-    auto& [processToken, id] = cacheId;
-    if (processToken == nullptr) {
-        ALOGE_AND_TRACE("ClientCache::getBuffer - invalid (nullptr) process token");
-        return false;
+namespace {
+
+uint64_t processKey(const wp<IBinder>& processToken) {
+    return reinterpret_cast<uintptr_t>(processToken.unsafe_get());
+}
+
+} // namespace
+
+ClientCache::ProcessCache* ClientCache::findProcessLocked(const wp<IBinder>& processToken) {
+    std::unique_ptr<ProcessCache>* process = mProcesses.find(processKey(processToken));
+    return process != nullptr ? process->get() : nullptr;
+}
+
+ClientCache::ProcessCache* ClientCache::addProcessLocked(const wp<IBinder>& processToken) {
+    // Another thread may have added the process since the caller looked it up.
+    if (ProcessCache* process = findProcessLocked(processToken)) {
+        return process;
     }
-    auto it = mBuffers.find(processToken);
-    if (it == mBuffers.end()) {
-        ALOGE_AND_TRACE("ClientCache::getBuffer - invalid process token");
-        return false;
+
+    sp<IBinder> token = processToken.promote();
+    if (!token) {
+        ALOGE_AND_TRACE("ClientCache::add - invalid token");
+        return nullptr;
     }
 
-    auto& processBuffers = it->second.second;
+    // Only call linkToDeath if not a local binder. If the client process dies, we will get a
+    // callback through binderDied.
+    if (token->localBinder() == nullptr) {
+        status_t err = token->linkToDeath(mDeathRecipient);
+        if (err != NO_ERROR) {
+            ALOGE_AND_TRACE("ClientCache::add - could not link to death");
+            return nullptr;
+        }
+    }
+    std::unique_ptr<ProcessCache>& process = mProcesses[processKey(processToken)];
+    process = std::make_unique<ProcessCache>(token);
+    return process.get();
+}
 
-    auto bufItr = processBuffers.find(id);
-    if (bufItr == processBuffers.end()) {
-        ALOGE_AND_TRACE("ClientCache::getBuffer - invalid buffer id");
-        return false;
+bool ClientCache::isFull(const wp<IBinder>& processToken) {
+    bool full = false;
+    mProcessesMutex.lock_shared();
+    if (ProcessCache* process = findProcessLocked(processToken)) {
+        process->mutex.lock_shared();
+        full = process->buffers.size() > BUFFER_CACHE_MAX_SIZE;
+        process->mutex.unlock_shared();
     }
+    mProcessesMutex.unlock_shared();
+    return full;
+}
 
-    ClientCacheBuffer& buf = bufItr->second;
-    *outClientCacheBuffer = &buf;
-    return true;
+base::expected<std::shared_ptr<renderengine::ExternalTexture>, ClientCache::AddError>
+ClientCache::addBuffer(ProcessCache& process, uint64_t id,
+                       const std::shared_ptr<renderengine::ExternalTexture>& buffer) {
+    // A buffer that is replaced is released after unlocking.
+    std::shared_ptr<renderengine::ExternalTexture> replacedBuffer;
+    process.mutex.lock();
+    if (process.buffers.size() > BUFFER_CACHE_MAX_SIZE) {
+        process.mutex.unlock();
+        ALOGE_AND_TRACE("ClientCache::add - cache is full");
+        return base::unexpected(AddError::CacheFull);
+    }
+    ClientCacheBuffer& entry = process.buffers[id];
+    replacedBuffer = std::move(entry.buffer);
+    entry.buffer = buffer;
+    process.mutex.unlock();
+    return buffer;
 }
 
 base::expected<std::shared_ptr<renderengine::ExternalTexture>, ClientCache::AddError>
@@ -72,145 +116,175 @@ ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer)
         return base::unexpected(AddError::Unspecified);
     }
 
-    std::lock_guard lock(mMutex);
-    sp<IBinder> token;
-
-    // If this is a new process token, set a death recipient. If the client process dies, we will
-    // get a callback through binderDied.
-    auto it = mBuffers.find(processToken);
-    if (it == mBuffers.end()) {
-        token = processToken.promote();
-        if (!token) {
-            ALOGE_AND_TRACE("ClientCache::add - invalid token");
-            return base::unexpected(AddError::Unspecified);
-        }
-
-        // Only call linkToDeath if not a local binder
-        if (token->localBinder() == nullptr) {
-            status_t err = token->linkToDeath(mDeathRecipient);
-            if (err != NO_ERROR) {
-                ALOGE_AND_TRACE("ClientCache::add - could not link to death");
-                return base::unexpected(AddError::Unspecified);
-            }
-        }
-        auto [itr, success] =
-                mBuffers.emplace(processToken,
-                                 std::make_pair(token,
-                                                std::unordered_map<uint64_t, ClientCacheBuffer>()));
-        LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
-        it = itr;
-    }
-
-    auto& processBuffers = it->second.second;
+    LOG_ALWAYS_FATAL_IF(mRenderEngine == nullptr,
+                        "Attempted to build the ClientCache before a RenderEngine instance was "
+                        "ready!");
 
-    if (processBuffers.size() > BUFFER_CACHE_MAX_SIZE) {
+    // Rejecting a buffer costs no import. addBuffer checks again, as the cache may fill up while the
+    // buffer is imported.
+    if (isFull(processToken)) {
         ALOGE_AND_TRACE("ClientCache::add - cache is full");
         return base::unexpected(AddError::CacheFull);
     }
 
-    LOG_ALWAYS_FATAL_IF(mRenderEngine == nullptr,
-                        "Attempted to build the ClientCache before a RenderEngine instance was "
-                        "ready!");
-
-    return (processBuffers[id].buffer = std::make_shared<
-                    renderengine::impl::ExternalTexture>(buffer, *mRenderEngine,
-                                                         renderengine::impl::ExternalTexture::
-                                                                 Usage::READABLE));
+    // Import the buffer before taking any lock, so that lookups do not wait for it.
+    auto externalTexture = std::make_shared<
+            renderengine::impl::ExternalTexture>(buffer, *mRenderEngine,
+                                                 renderengine::impl::ExternalTexture::Usage::
+                                                         READABLE);
+
+    mProcessesMutex.lock_shared();
+    ProcessCache* process = findProcessLocked(processToken);
+    if (process == nullptr) {
+        mProcessesMutex.unlock_shared();
+
+        mProcessesMutex.lock();
+        process = addProcessLocked(processToken);
+        if (process == nullptr) {
+            mProcessesMutex.unlock();
+            return base::unexpected(AddError::Unspecified);
+        }
+        auto result = addBuffer(*process, id, externalTexture);
+        mProcessesMutex.unlock();
+        return result;
+    }
+    auto result = addBuffer(*process, id, externalTexture);
+    mProcessesMutex.unlock_shared();
+    return result;
 }
 
 sp<GraphicBuffer> ClientCache::erase(const client_cache_t& cacheId) {
-    sp<GraphicBuffer> buffer;
     auto& [processToken, id] = cacheId;
-    std::vector<sp<ErasedRecipient>> pendingErase;
-    {
-        std::lock_guard lock(mMutex);
-        ClientCacheBuffer* buf = nullptr;
-        if (!getBuffer(cacheId, &buf)) {
-            ALOGE("failed to erase buffer, could not retrieve buffer");
-            return nullptr;
-        }
-
-        buffer = buf->buffer->getBuffer();
+    if (processToken == nullptr) {
+        ALOGE_AND_TRACE("ClientCache::erase - invalid (nullptr) process token");
+        return nullptr;
+    }
 
-        for (auto& recipient : buf->recipients) {
-            sp<ErasedRecipient> erasedRecipient = recipient.promote();
-            if (erasedRecipient) {
-                pendingErase.push_back(erasedRecipient);
-            }
-        }
+    ClientCacheBuffer erased;
+    bool found = false;
+    mProcessesMutex.lock_shared();
+    if (ProcessCache* process = findProcessLocked(processToken)) {
+        process->mutex.lock();
+        found = process->buffers.erase(id, &erased);
+        process->mutex.unlock();
+    }
+    mProcessesMutex.unlock_shared();
 
-        mBuffers[processToken].second.erase(id);
+    if (!found) {
+        ALOGE("failed to erase buffer, could not retrieve buffer");
+        return nullptr;
     }
 
-    for (auto& recipient : pendingErase) {
-        recipient->bufferErased(cacheId);
+    for (auto& recipient : erased.recipients) {
+        sp<ErasedRecipient> erasedRecipient = recipient.promote();
+        if (erasedRecipient) {
+            erasedRecipient->bufferErased(cacheId);
+        }
     }
-    return buffer;
+    return erased.buffer->getBuffer();
 }
 
 std::shared_ptr<renderengine::ExternalTexture> ClientCache::get(const client_cache_t& cacheId) {
-    std::lock_guard lock(mMutex);
-
-    ClientCacheBuffer* buf = nullptr;
-    if (!getBuffer(cacheId, &buf)) {
-        ALOGE("failed to get buffer, could not retrieve buffer");
+    auto& [processToken, id] = cacheId;
+    if (processToken == nullptr) {
+        ALOGE_AND_TRACE("ClientCache::get - invalid (nullptr) process token");
         return nullptr;
     }
 
-    return buf->buffer;
+    std::shared_ptr<renderengine::ExternalTexture> buffer;
+    mProcessesMutex.lock_shared();
+    if (ProcessCache* process = findProcessLocked(processToken)) {
+        process->mutex.lock_shared();
+        if (const ClientCacheBuffer* buf = process->buffers.find(id)) {
+            buffer = buf->buffer;
+        }
+        process->mutex.unlock_shared();
+    }
+    mProcessesMutex.unlock_shared();
+
+    if (!buffer) {
+        ALOGE_AND_TRACE("ClientCache::get - invalid process token or buffer id");
+    }
+    return buffer;
 }
 
 bool ClientCache::registerErasedRecipient(const client_cache_t& cacheId,
                                           const wp<ErasedRecipient>& recipient) {
-    std::lock_guard lock(mMutex);
+    auto& [processToken, id] = cacheId;
+    bool registered = false;
+    mProcessesMutex.lock_shared();
+    if (ProcessCache* process = processToken ? findProcessLocked(processToken) : nullptr) {
+        process->mutex.lock();
+        if (ClientCacheBuffer* buf = process->buffers.find(id)) {
+            auto& recipients = buf->recipients;
+            if (std::find(recipients.begin(), recipients.end(), recipient) == recipients.end()) {
+                recipients.push_back(recipient);
+            }
+            registered = true;
+        }
+        process->mutex.unlock();
+    }
+    mProcessesMutex.unlock_shared();
 
-    ClientCacheBuffer* buf = nullptr;
-    if (!getBuffer(cacheId, &buf)) {
+    if (!registered) {
         ALOGV("failed to register erased recipient, could not retrieve buffer");
-        return false;
     }
-    buf->recipients.insert(recipient);
-    return true;
+    return registered;
 }
 
 void ClientCache::unregisterErasedRecipient(const client_cache_t& cacheId,
                                             const wp<ErasedRecipient>& recipient) {
-    std::lock_guard lock(mMutex);
+    auto& [processToken, id] = cacheId;
+    bool found = false;
+    mProcessesMutex.lock_shared();
+    if (ProcessCache* process = processToken ? findProcessLocked(processToken) : nullptr) {
+        process->mutex.lock();
+        if (ClientCacheBuffer* buf = process->buffers.find(id)) {
+            auto& recipients = buf->recipients;
+            if (auto it = std::find(recipients.begin(), recipients.end(), recipient);
+                it != recipients.end()) {
+                recipients.unstable_erase(it);
+            }
+            found = true;
+        }
+        process->mutex.unlock();
+    }
+    mProcessesMutex.unlock_shared();
 
-    ClientCacheBuffer* buf = nullptr;
-    if (!getBuffer(cacheId, &buf)) {
+    if (!found) {
         ALOGE("failed to unregister erased recipient");
-        return;
     }
-
-    buf->recipients.erase(recipient);
 }
 
 void ClientCache::removeProcess(const wp<IBinder>& processToken) {
-    std::vector<std::pair<sp<ErasedRecipient>, client_cache_t>> pendingErase;
-    {
-        if (processToken == nullptr) {
-            ALOGE("failed to remove process, invalid (nullptr) process token");
-            return;
-        }
-        std::lock_guard lock(mMutex);
-        auto itr = mBuffers.find(processToken);
-        if (itr == mBuffers.end()) {
-            ALOGE("failed to remove process, could not find process");
-            return;
-        }
+    if (processToken == nullptr) {
+        ALOGE("failed to remove process, invalid (nullptr) process token");
+        return;
+    }
+
+    std::unique_ptr<ProcessCache> process;
+    mProcessesMutex.lock();
+    mProcesses.erase(processKey(processToken), &process);
+    mProcessesMutex.unlock();
+
+    if (!process) {
+        ALOGE("failed to remove process, could not find process");
+        return;
+    }
 
-        for (auto& [id, clientCacheBuffer] : itr->second.second) {
-            client_cache_t cacheId = {processToken, id};
-            for (auto& recipient : clientCacheBuffer.recipients) {
-                sp<ErasedRecipient> erasedRecipient = recipient.promote();
-                if (erasedRecipient) {
-                    pendingErase.emplace_back(erasedRecipient, cacheId);
-                }
+    // The process is no longer reachable, so this only waits for threads that were still using it.
+    std::vector<std::pair<sp<ErasedRecipient>, client_cache_t>> pendingErase;
+    process->mutex.lock();
+    process->buffers.forEach([&](uint64_t id, const ClientCacheBuffer& clientCacheBuffer) {
+        client_cache_t cacheId = {processToken, id};
+        for (auto& recipient : clientCacheBuffer.recipients) {
+            sp<ErasedRecipient> erasedRecipient = recipient.promote();
+            if (erasedRecipient) {
+                pendingErase.emplace_back(erasedRecipient, cacheId);
             }
         }
-        mBuffers.erase(itr);
-    }
+    });
+    process->mutex.unlock();
 
     for (auto& [recipient, cacheId] : pendingErase) {
         recipient->bufferErased(cacheId);
@@ -222,16 +296,19 @@ void ClientCache::CacheDeathRecipient::binderDied(const wp<IBinder>& who) {
 }
 
 void ClientCache::dump(std::string& result) {
-    std::lock_guard lock(mMutex);
-    for (const auto& [_, cache] : mBuffers) {
-        base::StringAppendF(&result, " Cache owner: %p\n", cache.first.get());
+    mProcessesMutex.lock_shared();
+    mProcesses.forEach([&](uint64_t, const std::unique_ptr<ProcessCache>& process) {
+        base::StringAppendF(&result, " Cache owner: %p\n", process->token.get());
 
-        for (const auto& [id, entry] : cache.second) {
+        process->mutex.lock_shared();
+        process->buffers.forEach([&](uint64_t id, const ClientCacheBuffer& entry) {
             const auto& buffer = entry.buffer->getBuffer();
-            base::StringAppendF(&result, "\tID: %" PRIu64 ", size: %ux%u\n", id, buffer->getWidth(),
-                                buffer->getHeight());
-        }
-    }
+            base::StringAppendF(&result, "\tID: %" PRIu64 ", size: %ux%u\n", id,
+                                buffer->getWidth(), buffer->getHeight());
+        });
+        process->mutex.unlock_shared();
+    });
+    mProcessesMutex.unlock_shared();
 }
 
 } // namespace android
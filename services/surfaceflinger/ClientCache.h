@@ -18,16 +18,17 @@
 
 #include <android-base/thread_annotations.h>
 #include <binder/IBinder.h>
+#include <ftl/shared_mutex.h>
+#include <ftl/small_vector.h>
 #include <gui/LayerState.h>
 #include <renderengine/RenderEngine.h>
 #include <ui/GraphicBuffer.h>
 #include <utils/RefBase.h>
 #include <utils/Singleton.h>
 
-#include <map>
-#include <mutex>
-#include <set>
-#include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 // 4096 is based on 64 buffers * 64 layers. Once this limit is reached, the least recently used
 // buffer is uncached before the new buffer is cached.
@@ -78,16 +79,140 @@ public:
     void dump(std::string& result);
 
 private:
-    std::mutex mMutex;
+    friend class ClientCacheTest;
+
+    // Open-addressing hash map from 64-bit keys, with linear probing. Keys are cache ids, which
+    // clients hand out in sequence, and binder addresses, so they are mixed before probing.
+    template <typename V>
+    class IdMap {
+    public:
+        size_t size() const { return mSize; }
+        size_t capacity() const { return mSlots.size(); }
+
+        V* find(uint64_t key) {
+            const ssize_t index = indexOf(key);
+            return index >= 0 ? &mSlots[index].value : nullptr;
+        }
+
+        // Returns the value of key, which is default-constructed if key is new.
+        V& operator[](uint64_t key) {
+            if ((mSize + 1) * 2 > mSlots.size()) {
+                grow();
+            }
+            size_t i = homeOf(key);
+            for (; mSlots[i].used; i = next(i)) {
+                if (mSlots[i].key == key) {
+                    return mSlots[i].value;
+                }
+            }
+            mSlots[i].used = true;
+            mSlots[i].key = key;
+            mSize++;
+            return mSlots[i].value;
+        }
+
+        // Removes key, and moves its value to outValue if not null.
+        bool erase(uint64_t key, V* outValue = nullptr) {
+            ssize_t index = indexOf(key);
+            if (index < 0) {
+                return false;
+            }
+            if (outValue) {
+                *outValue = std::move(mSlots[index].value);
+            }
+            mSlots[index] = Slot();
+            mSize--;
+            // Move back the entries of the cluster that would not be found past the hole.
+            size_t hole = static_cast<size_t>(index);
+            for (size_t i = next(hole); mSlots[i].used; i = next(i)) {
+                const size_t home = homeOf(mSlots[i].key);
+                if (((i - home) & mask()) >= ((i - hole) & mask())) {
+                    mSlots[hole] = std::move(mSlots[i]);
+                    mSlots[i] = Slot();
+                    hole = i;
+                }
+            }
+            return true;
+        }
+
+        template <typename F>
+        void forEach(F f) const {
+            for (const Slot& slot : mSlots) {
+                if (slot.used) {
+                    f(slot.key, slot.value);
+                }
+            }
+        }
+
+    private:
+        friend class ClientCacheTest;
+
+        struct Slot {
+            uint64_t key = 0;
+            bool used = false;
+            V value{};
+        };
+
+        static constexpr size_t kMinCapacity = 16;
+
+        size_t mask() const { return mSlots.size() - 1; }
+        size_t next(size_t i) const { return (i + 1) & mask(); }
+
+        size_t homeOf(uint64_t key) const {
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdULL;
+            key ^= key >> 33;
+            return static_cast<size_t>(key) & mask();
+        }
+
+        ssize_t indexOf(uint64_t key) const {
+            if (mSize == 0) {
+                return -1;
+            }
+            for (size_t i = homeOf(key); mSlots[i].used; i = next(i)) {
+                if (mSlots[i].key == key) {
+                    return static_cast<ssize_t>(i);
+                }
+            }
+            return -1;
+        }
+
+        void grow() {
+            std::vector<Slot> slots(std::max(kMinCapacity, mSlots.size() * 2));
+            std::swap(slots, mSlots);
+            mSize = 0;
+            for (Slot& slot : slots) {
+                if (slot.used) {
+                    (*this)[slot.key] = std::move(slot.value);
+                }
+            }
+        }
+
+        std::vector<Slot> mSlots;
+        size_t mSize = 0;
+    };
 
     struct ClientCacheBuffer {
         std::shared_ptr<renderengine::ExternalTexture> buffer;
-        std::set<wp<ErasedRecipient>> recipients;
+        // Usually only the layer that the buffer is set on.
+        ftl::SmallVector<wp<ErasedRecipient>, 2> recipients;
     };
-    std::map<wp<IBinder> /*caching process*/,
-             std::pair<sp<IBinder> /*strong ref to caching process*/,
-                       std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer>>>
-            mBuffers GUARDED_BY(mMutex);
+
+    // The buffers cached by one process. Lookups take its lock shared, and add only takes it
+    // exclusively to insert a buffer that is already imported, so lookups never wait for buffers
+    // of other processes, nor for the import of buffers of their own process.
+    struct ProcessCache {
+        explicit ProcessCache(const sp<IBinder>& token) : token(token) {}
+
+        // Strong reference to the caching process.
+        const sp<IBinder> token;
+        ftl::SharedMutex mutex;
+        IdMap<ClientCacheBuffer> buffers GUARDED_BY(mutex);
+    };
+
+    // Only taken exclusively when a process caches its first buffer or goes away.
+    ftl::SharedMutex mProcessesMutex;
+    IdMap<std::unique_ptr<ProcessCache>> mProcesses GUARDED_BY(mProcessesMutex);
 
     class CacheDeathRecipient : public IBinder::DeathRecipient {
     public:
@@ -97,8 +222,15 @@ private:
     sp<CacheDeathRecipient> mDeathRecipient;
     renderengine::RenderEngine* mRenderEngine = nullptr;
 
-    bool getBuffer(const client_cache_t& cacheId, ClientCacheBuffer** outClientCacheBuffer)
-            REQUIRES(mMutex);
+    ProcessCache* findProcessLocked(const wp<IBinder>& processToken)
+            REQUIRES_SHARED(mProcessesMutex);
+    ProcessCache* addProcessLocked(const wp<IBinder>& processToken) REQUIRES(mProcessesMutex);
+    // Whether the process has as many buffers cached as it may. The answer may be stale once the
+    // locks are released, so add only uses it to skip importing buffers that would be rejected.
+    bool isFull(const wp<IBinder>& processToken) EXCLUDES(mProcessesMutex);
+    base::expected<std::shared_ptr<renderengine::ExternalTexture>, AddError> addBuffer(
+            ProcessCache& process, uint64_t id,
+            const std::shared_ptr<renderengine::ExternalTexture>& buffer);
 };
 
 }; // namespace android
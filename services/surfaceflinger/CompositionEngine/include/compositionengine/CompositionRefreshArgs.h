@@ -106,6 +106,10 @@ struct CompositionRefreshArgs {
 
     bool hasTrustedPresentationListener = false;
 
+    // If true, HWC validates the outputs being refreshed with a single composer call, rather than
+    // one output after the other.
+    bool batchDeviceCompositionChanges = false;
+
     ICEPowerCallback* powerCallback = nullptr;
 };
 
@@ -268,6 +268,17 @@ public:
     // asynchronously, in which case the returned future must be waited upon.
     virtual ftl::Future<std::monostate> present(const CompositionRefreshArgs&) = 0;
 
+    // present() in two steps, so that HWC can validate several outputs at once in between.
+    // beginPresent() writes the state of the frame, up to choosing its composition strategy, and
+    // finishPresent() does the rest.
+    virtual void beginPresent(const CompositionRefreshArgs&) = 0;
+    virtual ftl::Future<std::monostate> finishPresent(const CompositionRefreshArgs&) = 0;
+
+    // Returns what HWC needs to validate the frame written by beginPresent(), if the output
+    // is validated by HWC.
+    virtual std::optional<android::HWComposer::DeviceCompositionRequest>
+    getDeviceCompositionRequest() const = 0;
+
     // Whether this output can be presented from another thread.
     virtual bool supportsOffloadPresent() const = 0;
 
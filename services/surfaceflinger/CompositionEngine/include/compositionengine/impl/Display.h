@@ -58,6 +58,8 @@ public:
     bool chooseCompositionStrategy(
             std::optional<android::HWComposer::DeviceRequestedChanges>*) override;
     void applyCompositionStrategy(const std::optional<DeviceRequestedChanges>&) override;
+    std::optional<android::HWComposer::DeviceCompositionRequest> getDeviceCompositionRequest()
+            const override;
     bool getSkipColorTransform() const override;
     compositionengine::Output::FrameFences presentFrame() override;
     void setExpensiveRenderingExpected(bool) override;
@@ -81,6 +81,10 @@ public:
 
     void prepare(const CompositionRefreshArgs&, LayerFESet&) override;
     ftl::Future<std::monostate> present(const CompositionRefreshArgs&) override;
+    void beginPresent(const CompositionRefreshArgs&) override;
+    ftl::Future<std::monostate> finishPresent(const CompositionRefreshArgs&) override;
+    std::optional<android::HWComposer::DeviceCompositionRequest> getDeviceCompositionRequest()
+            const override;
     bool supportsOffloadPresent() const override { return false; }
     void offloadPresentNextFrame() override;
 
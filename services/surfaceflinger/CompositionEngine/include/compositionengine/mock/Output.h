@@ -82,6 +82,11 @@ public:
     MOCK_METHOD2(prepare, void(const compositionengine::CompositionRefreshArgs&, LayerFESet&));
     MOCK_METHOD1(present,
                  ftl::Future<std::monostate>(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD(void, beginPresent, (const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD(ftl::Future<std::monostate>, finishPresent,
+                (const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD(std::optional<android::HWComposer::DeviceCompositionRequest>,
+                getDeviceCompositionRequest, (), (const));
     MOCK_CONST_METHOD0(supportsOffloadPresent, bool());
     MOCK_METHOD(void, offloadPresentNextFrame, ());
 
@@ -150,8 +150,28 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
     offloadOutputs(args.outputs);
 
     ui::DisplayVector<ftl::Future<std::monostate>> presentFutures;
-    for (const auto& output : args.outputs) {
-        presentFutures.push_back(output->present(args));
+    if (args.batchDeviceCompositionChanges && args.outputs.size() > 1) {
+        for (const auto& output : args.outputs) {
+            output->beginPresent(args);
+        }
+
+        std::vector<HWComposer::DeviceCompositionRequest> requests;
+        for (const auto& output : args.outputs) {
+            if (auto request = output->getDeviceCompositionRequest()) {
+                requests.push_back(*request);
+            }
+        }
+        if (requests.size() > 1) {
+            getHwComposer().prefetchDeviceCompositionChanges(requests);
+        }
+
+        for (const auto& output : args.outputs) {
+            presentFutures.push_back(output->finishPresent(args));
+        }
+    } else {
+        for (const auto& output : args.outputs) {
+            presentFutures.push_back(output->present(args));
+        }
     }
 
     {
@@ -275,6 +275,23 @@ bool Display::chooseCompositionStrategy(
     return true;
 }
 
+std::optional<android::HWComposer::DeviceCompositionRequest> Display::getDeviceCompositionRequest()
+        const {
+    // As chooseCompositionStrategy(), for the outputs prepareFrame() chooses a strategy for.
+    const auto halDisplayId = HalDisplayId::tryCast(mId);
+    if (mIsDisconnected || !halDisplayId || !getState().isEnabled) {
+        return std::nullopt;
+    }
+
+    return android::HWComposer::DeviceCompositionRequest{
+            .displayId = *halDisplayId,
+            .frameUsesClientComposition = anyLayersRequireClientComposition(),
+            .earliestPresentTime = getState().earliestPresentTime,
+            .expectedPresentTime = getState().expectedPresentTime,
+            .frameInterval = getState().frameInterval,
+    };
+}
+
 void Display::applyCompositionStrategy(const std::optional<DeviceRequestedChanges>& changes) {
     if (changes) {
         applyChangedTypesToLayers(changes->changedTypes);
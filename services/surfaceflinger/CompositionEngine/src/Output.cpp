@@ -432,12 +432,26 @@ ftl::Future<std::monostate> Output::present(
     ATRACE_FORMAT("%s for %s", __func__, mNamePlusId.c_str());
     ALOGV(__FUNCTION__);
 
+    beginPresent(refreshArgs);
+    return finishPresent(refreshArgs);
+}
+
+void Output::beginPresent(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_FORMAT("%s for %s", __func__, mNamePlusId.c_str());
+    ALOGV(__FUNCTION__);
+
     updateColorProfile(refreshArgs);
     updateCompositionState(refreshArgs);
     planComposition();
     writeCompositionState(refreshArgs);
     setColorTransform(refreshArgs);
     beginFrame();
+}
+
+ftl::Future<std::monostate> Output::finishPresent(
+        const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_FORMAT("%s for %s", __func__, mNamePlusId.c_str());
+    ALOGV(__FUNCTION__);
 
     GpuCompositionResult result;
     const bool predictCompositionStrategy = canPredictCompositionStrategy(refreshArgs);
@@ -466,6 +480,12 @@ ftl::Future<std::monostate> Output::present(
     return future;
 }
 
+std::optional<android::HWComposer::DeviceCompositionRequest> Output::getDeviceCompositionRequest()
+        const {
+    // The base output implementation can only do client composition
+    return std::nullopt;
+}
+
 void Output::offloadPresentNextFrame() {
     mOffloadPresent = true;
     updateHwcAsyncWorker();
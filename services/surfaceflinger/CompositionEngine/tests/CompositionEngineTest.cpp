@@ -130,6 +130,53 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+TEST_F(CompositionEnginePresentTest, batchesDeviceCompositionChanges) {
+    static constexpr PhysicalDisplayId kDisplayId1 = PhysicalDisplayId::fromPort(123u);
+    static constexpr PhysicalDisplayId kDisplayId2 = PhysicalDisplayId::fromPort(234u);
+    android::mock::HWComposer* hwc = new StrictMock<android::mock::HWComposer>();
+    mEngine.setHwComposer(std::unique_ptr<android::HWComposer>(hwc));
+
+    InSequence seq;
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput3, prepare(Ref(mRefreshArgs), _));
+
+    SET_FLAG_FOR_TEST(flags::multithreaded_present, false);
+
+    // The frames of all the outputs are written before HWC validates them at once.
+    EXPECT_CALL(*mOutput1, beginPresent(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, beginPresent(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput3, beginPresent(Ref(mRefreshArgs)));
+
+    EXPECT_CALL(*mOutput1, getDeviceCompositionRequest())
+            .WillOnce(Return(android::HWComposer::DeviceCompositionRequest{.displayId =
+                                                                                   kDisplayId1}));
+    // Not validated by HWC.
+    EXPECT_CALL(*mOutput2, getDeviceCompositionRequest()).WillOnce(Return(std::nullopt));
+    EXPECT_CALL(*mOutput3, getDeviceCompositionRequest())
+            .WillOnce(Return(android::HWComposer::DeviceCompositionRequest{.displayId =
+                                                                                   kDisplayId2}));
+    std::vector<android::HWComposer::DeviceCompositionRequest> requests;
+    EXPECT_CALL(*hwc, prefetchDeviceCompositionChanges(_)).WillOnce(SaveArg<0>(&requests));
+
+    EXPECT_CALL(*mOutput1, finishPresent(Ref(mRefreshArgs)))
+            .WillOnce(Return(ftl::yield<std::monostate>({})));
+    EXPECT_CALL(*mOutput2, finishPresent(Ref(mRefreshArgs)))
+            .WillOnce(Return(ftl::yield<std::monostate>({})));
+    EXPECT_CALL(*mOutput3, finishPresent(Ref(mRefreshArgs)))
+            .WillOnce(Return(ftl::yield<std::monostate>({})));
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2, mOutput3};
+    mRefreshArgs.batchDeviceCompositionChanges = true;
+    mEngine.present(mRefreshArgs);
+
+    ASSERT_EQ(2u, requests.size());
+    EXPECT_EQ(HalDisplayId(kDisplayId1), requests[0].displayId);
+    EXPECT_EQ(HalDisplayId(kDisplayId2), requests[1].displayId);
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
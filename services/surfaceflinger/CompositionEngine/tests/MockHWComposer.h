@@ -57,6 +57,8 @@ public:
     MOCK_METHOD(status_t, getDeviceCompositionChanges,
                 (HalDisplayId, bool, std::optional<std::chrono::steady_clock::time_point>, nsecs_t,
                  Fps, std::optional<android::HWComposer::DeviceRequestedChanges>*));
+    MOCK_METHOD(void, prefetchDeviceCompositionChanges,
+                (const std::vector<android::HWComposer::DeviceCompositionRequest>&));
     MOCK_METHOD(status_t, setClientTarget,
                 (HalDisplayId, uint32_t, const sp<Fence>&, const sp<GraphicBuffer>&, ui::Dataspace,
                  float),
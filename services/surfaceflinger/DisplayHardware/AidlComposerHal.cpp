@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <unordered_map>
 
 #include "HWC2.h"
 
@@ -48,7 +49,9 @@ using aidl::android::hardware::graphics::composer3::ClientTargetPropertyWithBrig
 using aidl::android::hardware::graphics::composer3::PowerMode;
 using aidl::android::hardware::graphics::composer3::VirtualDisplay;
 
+using aidl::android::hardware::graphics::composer3::CommandError;
 using aidl::android::hardware::graphics::composer3::CommandResultPayload;
+using aidl::android::hardware::graphics::composer3::DisplayCommand;
 
 using AidlColorMode = aidl::android::hardware::graphics::composer3::ColorMode;
 using AidlContentType = aidl::android::hardware::graphics::composer3::ContentType;
@@ -168,6 +171,28 @@ mat4 makeMat4(std::vector<float> in) {
     return mat4(static_cast<const float*>(in.data()));
 }
 
+// Returns the display a command result is for. Errors are for a command instead.
+std::optional<int64_t> getResultDisplay(const CommandResultPayload& result) {
+    using Tag = CommandResultPayload::Tag;
+    switch (result.getTag()) {
+        case Tag::error:
+            return std::nullopt;
+        case Tag::changedTypes:
+            return result.get<Tag::changedTypes>().display;
+        case Tag::displayRequest:
+            return result.get<Tag::displayRequest>().display;
+        case Tag::presentFence:
+            return result.get<Tag::presentFence>().display;
+        case Tag::releaseFences:
+            return result.get<Tag::releaseFences>().display;
+        case Tag::presentOrValidateResult:
+            return result.get<Tag::presentOrValidateResult>().display;
+        case Tag::clientTargetProperty:
+            return result.get<Tag::clientTargetProperty>().display;
+    }
+    return std::nullopt;
+}
+
 } // namespace
 
 class AidlIComposerCallbackWrapper : public BnComposerCallback {
@@ -249,7 +274,23 @@ AidlComposer::AidlComposer(const std::string& serviceName) {
         return;
     }
 
+    initialize();
+    if (getLayerLifecycleBatchCommand()) {
+        mEnableLayerCommandBatchingFlag =
+                FlagManager::getInstance().enable_layer_command_batching();
+    }
+    ALOGI("Loaded AIDL composer3 HAL service");
+}
+
+AidlComposer::AidlComposer(std::shared_ptr<AidlIComposerClient> client)
+      : mAidlComposerClient(std::move(client)) {
+    initialize();
+}
+
+void AidlComposer::initialize() {
+    mMutex.lock();
     addReader(translate<Display>(kSingleReaderKey));
+    mMutex.unlock();
 
     // If unable to read interface version, then become backwards compatible.
     const auto status = mAidlComposerClient->getInterfaceVersion(&mComposerInterfaceVersion);
@@ -271,11 +312,6 @@ AidlComposer::AidlComposer(const std::string& serviceName) {
             }
         }
     }
-    if (getLayerLifecycleBatchCommand()) {
-        mEnableLayerCommandBatchingFlag =
-                FlagManager::getInstance().enable_layer_command_batching();
-    }
-    ALOGI("Loaded AIDL composer3 HAL service");
 }
 
 AidlComposer::~AidlComposer() = default;
@@ -880,6 +916,76 @@ Error AidlComposer::presentOrValidateDisplay(Display display, nsecs_t expectedPr
     return Error::NONE;
 }
 
+std::vector<Composer::PresentOrValidateResult> AidlComposer::presentOrValidateDisplays(
+        const std::vector<PresentOrValidateRequest>& requests) {
+    ATRACE_FORMAT("HwcPresentOrValidateDisplays %zu", requests.size());
+
+    std::vector<PresentOrValidateResult> results(requests.size());
+    // The displays to execute, and the index of the request of each.
+    std::vector<Display> displays;
+    std::vector<size_t> requestIndices;
+
+    mMutex.lock_shared();
+    for (size_t i = 0; i < requests.size(); i++) {
+        const auto& request = requests[i];
+        const auto displayId = translate<int64_t>(request.display);
+        auto writer = getWriter(request.display);
+        if (!writer || !getReader(request.display)) {
+            results[i].error = Error::BAD_DISPLAY;
+            continue;
+        }
+        if (request.canPresent) {
+            writer->get().presentOrvalidateDisplay(displayId,
+                                                   ClockMonotonicTimestamp{
+                                                           request.expectedPresentTime},
+                                                   request.frameIntervalNs);
+        } else {
+            writer->get().validateDisplay(displayId,
+                                          ClockMonotonicTimestamp{request.expectedPresentTime},
+                                          request.frameIntervalNs);
+        }
+        displays.push_back(request.display);
+        requestIndices.push_back(i);
+    }
+
+    std::vector<Error> errors;
+    const Error error = execute(displays, &errors);
+    for (size_t i = 0; i < displays.size(); i++) {
+        const auto& request = requests[requestIndices[i]];
+        auto& result = results[requestIndices[i]];
+        result.error = error != Error::NONE ? error : errors[i];
+        if (result.error != Error::NONE) {
+            continue;
+        }
+
+        const auto displayId = translate<int64_t>(request.display);
+        auto& reader = getReader(request.display)->get();
+        if (!request.canPresent) {
+            reader.hasChanges(displayId, &result.numTypes, &result.numRequests);
+            continue;
+        }
+
+        const auto stage = reader.takePresentOrValidateStage(displayId);
+        if (!stage.has_value()) {
+            result.state = translate<uint32_t>(-1);
+            result.error = Error::NO_RESOURCES;
+            continue;
+        }
+
+        result.state = translate<uint32_t>(*stage);
+        if (*stage == PresentOrValidate::Result::Presented) {
+            auto fence = reader.takePresentFence(displayId);
+            // take ownership
+            result.presentFence = fence.get();
+            *fence.getR() = -1;
+        } else {
+            reader.hasChanges(displayId, &result.numTypes, &result.numRequests);
+        }
+    }
+    mMutex.unlock_shared();
+    return results;
+}
+
 Error AidlComposer::setCursorPosition(Display display, Layer layer, int32_t x, int32_t y) {
     Error error = Error::NONE;
     mMutex.lock_shared();
@@ -1118,17 +1224,32 @@ Error AidlComposer::setLayerZOrder(Display display, Layer layer, uint32_t z) {
 }
 
 Error AidlComposer::execute(Display display) {
-    auto writer = getWriter(display);
-    auto reader = getReader(display);
-    if (!writer || !reader) {
-        return Error::BAD_DISPLAY;
+    std::vector<Error> errors;
+    const Error error = execute({display}, &errors);
+    return error != Error::NONE ? error : errors.front();
+}
+
+Error AidlComposer::execute(const std::vector<Display>& displays, std::vector<Error>* outErrors) {
+    outErrors->assign(displays.size(), Error::NONE);
+
+    // The commands of all the displays, and the index in displays of the display of each.
+    std::vector<DisplayCommand> commands;
+    std::vector<size_t> commandDisplayIndices;
+    for (size_t i = 0; i < displays.size(); i++) {
+        auto writer = getWriter(displays[i]);
+        if (!writer || !getReader(displays[i])) {
+            (*outErrors)[i] = Error::BAD_DISPLAY;
+            continue;
+        }
+        auto displayCommands = writer->get().takePendingCommands();
+        commandDisplayIndices.insert(commandDisplayIndices.end(), displayCommands.size(), i);
+        std::move(displayCommands.begin(), displayCommands.end(), std::back_inserter(commands));
     }
-
-    auto commands = writer->get().takePendingCommands();
     if (commands.empty()) {
         return Error::NONE;
     }
 
+    std::vector<CommandError> commandErrors;
     { // scope for results
         std::vector<CommandResultPayload> results;
         auto status = mAidlComposerClient->executeCommands(commands, &results);
@@ -1137,10 +1258,37 @@ Error AidlComposer::execute(Display display) {
             return static_cast<Error>(status.getServiceSpecificError());
         }
 
-        reader->get().parse(std::move(results));
+        // Errors refer to a command, so they are handled below rather than by the readers, and
+        // each reader only accepts the results of its display, unless there is a single reader.
+        std::vector<CommandResultPayload> readerResults;
+        std::unordered_map<int64_t, std::vector<CommandResultPayload>> displayResults;
+        if (!mSingleReader) {
+            for (size_t i : commandDisplayIndices) {
+                displayResults.try_emplace(translate<int64_t>(displays[i]));
+            }
+        }
+        for (auto& result : results) {
+            if (result.getTag() == CommandResultPayload::Tag::error) {
+                commandErrors.push_back(
+                        std::move(result.get<CommandResultPayload::Tag::error>()));
+            } else if (mSingleReader) {
+                readerResults.push_back(std::move(result));
+            } else if (const auto displayId = getResultDisplay(result);
+                       displayId && displayResults.count(*displayId)) {
+                displayResults[*displayId].push_back(std::move(result));
+            } else {
+                ALOGE("executeCommands returned a result for an unexpected display");
+            }
+        }
+
+        if (mSingleReader) {
+            getReader(displays.front())->get().parse(std::move(readerResults));
+        }
+        for (auto& [displayId, resultsForDisplay] : displayResults) {
+            getReader(translate<Display>(displayId))->get().parse(std::move(resultsForDisplay));
+        }
     }
-    const auto commandErrors = reader->get().takeErrors();
-    Error error = Error::NONE;
+
     for (const auto& cmdErr : commandErrors) {
         const auto index = static_cast<size_t>(cmdErr.commandIndex);
         if (index < 0 || index >= commands.size()) {
@@ -1150,14 +1298,14 @@ Error AidlComposer::execute(Display display) {
 
         const auto& command = commands[index];
         if (command.validateDisplay || command.presentDisplay || command.presentOrValidateDisplay) {
-            error = translate<Error>(cmdErr.errorCode);
+            (*outErrors)[commandDisplayIndices[index]] = translate<Error>(cmdErr.errorCode);
         } else {
             ALOGW("command '%s' generated error %" PRId32, command.toString().c_str(),
                   cmdErr.errorCode);
         }
     }
 
-    return error;
+    return Error::NONE;
 }
 
 Error AidlComposer::setLayerPerFrameMetadata(
@@ -63,6 +63,9 @@ public:
     static bool isDeclared(const std::string& serviceName);
 
     explicit AidlComposer(const std::string& serviceName);
+    // For tests. Uses the given client rather than connecting to the composer service.
+    explicit AidlComposer(
+            std::shared_ptr<aidl::android::hardware::graphics::composer3::IComposerClient>);
     ~AidlComposer() override;
 
     bool isSupported(OptionalFeature) const;
@@ -142,6 +145,8 @@ public:
                                    int32_t frameIntervalNs, uint32_t* outNumTypes,
                                    uint32_t* outNumRequests, int* outPresentFence,
                                    uint32_t* state) override;
+    std::vector<PresentOrValidateResult> presentOrValidateDisplays(
+            const std::vector<PresentOrValidateRequest>&) override;
 
     Error setCursorPosition(Display display, Layer layer, int32_t x, int32_t y) override;
     /* see setClientTarget for the purpose of slot */
@@ -250,6 +255,13 @@ private:
     // queue to batch the calls.  validateDisplay and presentDisplay will call
     // this function to execute the command queue.
     Error execute(Display) REQUIRES_SHARED(mMutex);
+    // Executes the command queues of several displays in a single call to the composer. The
+    // error of each display is returned in outErrors, in the order of displays. The returned
+    // error is for the call itself.
+    Error execute(const std::vector<Display>& displays, std::vector<Error>* outErrors)
+            REQUIRES_SHARED(mMutex);
+
+    void initialize();
 
     // returns the default instance name for the given service
     static std::string instance(const std::string& serviceName);
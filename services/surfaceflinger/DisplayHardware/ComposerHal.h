@@ -183,6 +183,30 @@ public:
                                            uint32_t* outNumRequests, int* outPresentFence,
                                            uint32_t* state) = 0;
 
+    struct PresentOrValidateRequest {
+        Display display;
+        nsecs_t expectedPresentTime;
+        int32_t frameIntervalNs;
+        // Whether to call presentOrValidateDisplay, or only validateDisplay.
+        bool canPresent;
+    };
+
+    // The outputs of validateDisplay or presentOrValidateDisplay for one display.
+    struct PresentOrValidateResult {
+        Error error = Error::NONE;
+        uint32_t numTypes = 0;
+        uint32_t numRequests = 0;
+        // Owned by the caller.
+        int presentFence = -1;
+        // As presentOrValidateDisplay. 0 if the display was only validated.
+        uint32_t state = 0;
+    };
+
+    // Validates, or presents or validates, several displays with as few calls to the composer as
+    // possible. The results are in the order of the requests.
+    virtual std::vector<PresentOrValidateResult> presentOrValidateDisplays(
+            const std::vector<PresentOrValidateRequest>&) = 0;
+
     virtual Error setCursorPosition(Display display, Layer layer, int32_t x, int32_t y) = 0;
     /* see setClientTarget for the purpose of slot */
     virtual Error setLayerBuffer(Display display, Layer layer, uint32_t slot,
@@ -463,35 +463,37 @@ status_t HWComposer::getDeviceCompositionChanges(
 
     hal::Error error = hal::Error::NONE;
 
-    // First try to skip validate altogether. We can do that when
-    // 1. The previous frame has not been presented yet or already passed the
-    // earliest time to present. Otherwise, we may present a frame too early.
-    // 2. There is no client composition. Otherwise, we first need to render the
-    // client target buffer.
-    const bool canSkipValidate = [&] {
-        // We must call validate if we have client composition
-        if (frameUsesClientComposition) {
-            return false;
-        }
-
-        // If composer supports getting the expected present time, we can skip
-        // as composer will make sure to prevent early presentation
-        if (!earliestPresentTime) {
-            return true;
+    auto prefetched = std::exchange(displayData.prefetchedValidation, std::nullopt);
+    if (prefetched && prefetched->frameUsesClientComposition != frameUsesClientComposition) {
+        // The layers changed since the prefetch, so validate again, unless it already presented.
+        if (prefetched->state == 1) {
+            ALOGW("%s: Presented a frame whose layers changed since", to_string(displayId).c_str());
+        } else {
+            prefetched.reset();
         }
+    }
 
-        // composer doesn't support getting the expected present time. We can only
-        // skip validate if we know that we are not going to present early.
-        return std::chrono::steady_clock::now() >= *earliestPresentTime;
-    }();
+    // First try to skip validate altogether.
+    const bool canSkipValidate = prefetched
+            ? prefetched->canSkipValidate
+            : HWComposer::canSkipValidate(frameUsesClientComposition, earliestPresentTime);
 
     displayData.validateWasSkipped = false;
     ATRACE_FORMAT("NextFrameInterval %d_Hz", frameInterval.getIntValue());
     if (canSkipValidate) {
         sp<Fence> outPresentFence = Fence::NO_FENCE;
         uint32_t state = UINT32_MAX;
-        error = hwcDisplay->presentOrValidate(expectedPresentTime, frameInterval.getPeriodNsecs(),
-                                              &numTypes, &numRequests, &outPresentFence, &state);
+        if (prefetched) {
+            error = prefetched->error;
+            numTypes = prefetched->numTypes;
+            numRequests = prefetched->numRequests;
+            outPresentFence = prefetched->presentFence;
+            state = prefetched->state;
+        } else {
+            error = hwcDisplay->presentOrValidate(expectedPresentTime,
+                                                  frameInterval.getPeriodNsecs(), &numTypes,
+                                                  &numRequests, &outPresentFence, &state);
+        }
         if (!hasChangesError(error)) {
             RETURN_IF_HWC_ERROR_FOR("presentOrValidate", error, displayId, UNKNOWN_ERROR);
         }
@@ -505,6 +507,10 @@ status_t HWComposer::getDeviceCompositionChanges(
             return NO_ERROR;
         }
         // Present failed but Validate ran.
+    } else if (prefetched) {
+        error = prefetched->error;
+        numTypes = prefetched->numTypes;
+        numRequests = prefetched->numRequests;
     } else {
         error = hwcDisplay->validate(expectedPresentTime, frameInterval.getPeriodNsecs(), &numTypes,
                                      &numRequests);
@@ -537,6 +543,73 @@ status_t HWComposer::getDeviceCompositionChanges(
     return NO_ERROR;
 }
 
+void HWComposer::prefetchDeviceCompositionChanges(
+        const std::vector<DeviceCompositionRequest>& requests) {
+    ATRACE_CALL();
+
+    std::vector<Hwc2::Composer::PresentOrValidateRequest> composerRequests;
+    std::vector<DisplayData*> displays;
+    for (const auto& request : requests) {
+        auto it = mDisplayData.find(request.displayId);
+        if (it == mDisplayData.end() || !it->second.hwcDisplay->isConnected()) {
+            continue;
+        }
+        auto& displayData = it->second;
+        displayData.prefetchedValidation.reset();
+
+        const bool canSkipValidate =
+                HWComposer::canSkipValidate(request.frameUsesClientComposition,
+                                            request.earliestPresentTime);
+        composerRequests.push_back({.display = displayData.hwcDisplay->getId(),
+                                    .expectedPresentTime = request.expectedPresentTime,
+                                    .frameIntervalNs = request.frameInterval.getPeriodNsecs(),
+                                    .canPresent = canSkipValidate});
+        displayData.prefetchedValidation = {.frameUsesClientComposition =
+                                                    request.frameUsesClientComposition,
+                                            .canSkipValidate = canSkipValidate};
+        displays.push_back(&displayData);
+    }
+
+    const auto results = mComposer->presentOrValidateDisplays(composerRequests);
+    LOG_ALWAYS_FATAL_IF(results.size() != displays.size(), "%s: Expected %zu results, got %zu",
+                        __func__, displays.size(), results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& result = results[i];
+        auto& prefetched = *displays[i]->prefetchedValidation;
+        prefetched.error = static_cast<hal::Error>(result.error);
+        prefetched.numTypes = result.numTypes;
+        prefetched.numRequests = result.numRequests;
+        prefetched.state = result.state;
+        prefetched.presentFence =
+                result.state == 1 ? sp<Fence>::make(result.presentFence) : Fence::NO_FENCE;
+    }
+}
+
+bool HWComposer::canSkipValidate(
+        bool frameUsesClientComposition,
+        std::optional<std::chrono::steady_clock::time_point> earliestPresentTime) {
+    // We can skip validate when
+    // 1. The previous frame has not been presented yet or already passed the
+    // earliest time to present. Otherwise, we may present a frame too early.
+    // 2. There is no client composition. Otherwise, we first need to render the
+    // client target buffer.
+
+    // We must call validate if we have client composition
+    if (frameUsesClientComposition) {
+        return false;
+    }
+
+    // If composer supports getting the expected present time, we can skip
+    // as composer will make sure to prevent early presentation
+    if (!earliestPresentTime) {
+        return true;
+    }
+
+    // composer doesn't support getting the expected present time. We can only
+    // skip validate if we know that we are not going to present early.
+    return std::chrono::steady_clock::now() >= *earliestPresentTime;
+}
+
 sp<Fence> HWComposer::getPresentFence(HalDisplayId displayId) const {
     RETURN_IF_INVALID_DISPLAY(displayId, Fence::NO_FENCE);
     return mDisplayData.at(displayId).lastPresentFence;
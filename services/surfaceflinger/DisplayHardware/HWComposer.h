@@ -95,6 +95,15 @@ public:
         ClientTargetProperty clientTargetProperty;
     };
 
+    // The arguments of getDeviceCompositionChanges for one display.
+    struct DeviceCompositionRequest {
+        HalDisplayId displayId;
+        bool frameUsesClientComposition = false;
+        std::optional<std::chrono::steady_clock::time_point> earliestPresentTime;
+        nsecs_t expectedPresentTime = 0;
+        Fps frameInterval;
+    };
+
     struct HWCDisplayMode {
         hal::HWConfigId hwcId;
         int32_t width = -1;
@@ -150,6 +159,12 @@ public:
             nsecs_t expectedPresentTime, Fps frameInterval,
             std::optional<DeviceRequestedChanges>* outChanges) = 0;
 
+    // Runs the HWC validation that getDeviceCompositionChanges would for several displays, with a
+    // single call to the composer when it supports it. The next getDeviceCompositionChanges call
+    // for each display then returns the result of this validation, rather than validating again.
+    virtual void prefetchDeviceCompositionChanges(
+            const std::vector<DeviceCompositionRequest>&) = 0;
+
     virtual status_t setClientTarget(HalDisplayId, uint32_t slot, const sp<Fence>& acquireFence,
                                      const sp<GraphicBuffer>& target, ui::Dataspace,
                                      float hdrSdrRatio) = 0;
@@ -349,6 +364,7 @@ public:
             std::optional<std::chrono::steady_clock::time_point> earliestPresentTime,
             nsecs_t expectedPresentTime, Fps frameInterval,
             std::optional<DeviceRequestedChanges>* outChanges) override;
+    void prefetchDeviceCompositionChanges(const std::vector<DeviceCompositionRequest>&) override;
 
     status_t setClientTarget(HalDisplayId, uint32_t slot, const sp<Fence>& acquireFence,
                              const sp<GraphicBuffer>& target, ui::Dataspace,
@@ -503,12 +519,29 @@ private:
         bool validateWasSkipped;
         hal::Error presentError;
 
+        // The outputs of the validation run by prefetchDeviceCompositionChanges.
+        struct PrefetchedValidation {
+            bool frameUsesClientComposition;
+            bool canSkipValidate;
+            hal::Error error;
+            uint32_t numTypes;
+            uint32_t numRequests;
+            sp<Fence> presentFence;
+            uint32_t state;
+        };
+        std::optional<PrefetchedValidation> prefetchedValidation;
+
         bool vsyncTraceToggle = false;
 
         std::mutex vsyncEnabledLock;
         hal::Vsync vsyncEnabled GUARDED_BY(vsyncEnabledLock) = hal::Vsync::DISABLE;
     };
 
+    // Whether the frame can be presented with presentOrValidate, rather than validated first.
+    static bool canSkipValidate(
+            bool frameUsesClientComposition,
+            std::optional<std::chrono::steady_clock::time_point> earliestPresentTime);
+
     std::optional<DisplayIdentificationInfo> onHotplugConnect(hal::HWDisplayId);
     std::optional<DisplayIdentificationInfo> onHotplugDisconnect(hal::HWDisplayId);
     bool shouldIgnoreHotplugConnect(hal::HWDisplayId, bool hasDisplayIdentificationData) const;
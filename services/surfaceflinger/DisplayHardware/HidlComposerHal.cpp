@@ -715,6 +715,28 @@ Error HidlComposer::presentOrValidateDisplay(Display display, nsecs_t /*expected
     return Error::NONE;
 }
 
+std::vector<Composer::PresentOrValidateResult> HidlComposer::presentOrValidateDisplays(
+        const std::vector<PresentOrValidateRequest>& requests) {
+    // The commands are executed display by display, since a failed command only tells which
+    // display failed through the error of its execute().
+    std::vector<PresentOrValidateResult> results(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        const auto& request = requests[i];
+        auto& result = results[i];
+        if (request.canPresent) {
+            result.error = presentOrValidateDisplay(request.display, request.expectedPresentTime,
+                                                    request.frameIntervalNs, &result.numTypes,
+                                                    &result.numRequests, &result.presentFence,
+                                                    &result.state);
+        } else {
+            result.error = validateDisplay(request.display, request.expectedPresentTime,
+                                           request.frameIntervalNs, &result.numTypes,
+                                           &result.numRequests);
+        }
+    }
+    return results;
+}
+
 Error HidlComposer::setCursorPosition(Display display, Layer layer, int32_t x, int32_t y) {
     mWriter.selectDisplay(display);
     mWriter.selectLayer(layer);
@@ -244,6 +244,8 @@ public:
                                    int32_t frameIntervalNs, uint32_t* outNumTypes,
                                    uint32_t* outNumRequests, int* outPresentFence,
                                    uint32_t* state) override;
+    std::vector<PresentOrValidateResult> presentOrValidateDisplays(
+            const std::vector<PresentOrValidateRequest>&) override;
 
     Error setCursorPosition(Display display, Layer layer, int32_t x, int32_t y) override;
     /* see setClientTarget for the purpose of slot */
@@ -25,15 +25,81 @@
 #include "FrameTracer.h"
 
 #include <android-base/stringprintf.h>
+#include <log/log.h>
 #include <perfetto/common/builtin_clock.pbzero.h>
+#include <utils/Trace.h>
 
 #include <algorithm>
+#include <iterator>
 #include <mutex>
 
 PERFETTO_DEFINE_DATA_SOURCE_STATIC_MEMBERS(android::FrameTracer::FrameTracerDataSource);
 
 namespace android {
 
+thread_local FrameTracer::ThreadEventBuffer FrameTracer::sThreadEventBuffer;
+std::atomic<uint64_t> FrameTracer::sNextTracerId = 1;
+std::atomic<FrameTracer*> FrameTracer::sInstance = nullptr;
+
+void FrameTracer::FrameTracerDataSource::OnFlush(const FlushArgs&) {
+    if (FrameTracer* tracer = sInstance.load()) {
+        tracer->flush();
+    }
+}
+
+void FrameTracer::FrameTracerDataSource::OnStop(const StopArgs&) {
+    if (FrameTracer* tracer = sInstance.load()) {
+        tracer->flush();
+    }
+}
+
+size_t FrameTracer::EventBuffer::size() const {
+    return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+}
+
+FrameTracer::Event* FrameTracer::EventBuffer::beginWrite() {
+    const size_t tail = mTail.load(std::memory_order_relaxed);
+    if (tail - mHead.load(std::memory_order_acquire) == kCapacity) {
+        return nullptr;
+    }
+    return &mEvents[tail % kCapacity];
+}
+
+void FrameTracer::EventBuffer::setPendingSequence(uint64_t sequence) {
+    mPendingSequence.store(sequence);
+}
+
+uint64_t FrameTracer::EventBuffer::getPendingSequence() const {
+    return mPendingSequence.load(std::memory_order_acquire);
+}
+
+void FrameTracer::EventBuffer::endWrite() {
+    mTail.fetch_add(1, std::memory_order_release);
+    mPendingSequence.store(kNoPendingSequence, std::memory_order_release);
+}
+
+FrameTracer::Event* FrameTracer::EventBuffer::front() {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    if (head == mTail.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return &mEvents[head % kCapacity];
+}
+
+void FrameTracer::EventBuffer::pop() {
+    const size_t head = mHead.load(std::memory_order_relaxed);
+    // Do not keep the fence alive until the event is overwritten.
+    mEvents[head % kCapacity].fence.reset();
+    mHead.store(head + 1, std::memory_order_release);
+}
+
+FrameTracer::FrameTracer() : mId(sNextTracerId++) {}
+
+FrameTracer::~FrameTracer() {
+    FrameTracer* tracer = this;
+    sInstance.compare_exchange_strong(tracer, nullptr);
+}
+
 void FrameTracer::initialize() {
     std::call_once(mInitializationFlag, [this]() {
         perfetto::TracingInitArgs args;
@@ -44,138 +110,299 @@ void FrameTracer::initialize() {
 }
 
 void FrameTracer::registerDataSource() {
+    sInstance.store(this);
     perfetto::DataSourceDescriptor dsd;
     dsd.set_name(kFrameTracerDataSource);
     FrameTracerDataSource::Register(dsd);
 }
 
-void FrameTracer::traceNewLayer(int32_t layerId, const std::string& layerName) {
-    FrameTracerDataSource::Trace([this, layerId, &layerName](FrameTracerDataSource::TraceContext) {
-        if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
-            std::lock_guard<std::mutex> lock(mTraceMutex);
-            mTraceTracker[layerId].layerName = layerName;
+bool FrameTracer::isTracing() {
+    bool tracing = false;
+    FrameTracerDataSource::Trace([&tracing](FrameTracerDataSource::TraceContext) {
+        tracing = true;
+    });
+    return tracing;
+}
+
+FrameTracer::EventBuffer& FrameTracer::getThreadEventBuffer() {
+    ThreadEventBuffer& threadBuffer = sThreadEventBuffer;
+    if (threadBuffer.tracerId == mId) {
+        return *threadBuffer.buffer;
+    }
+
+    const std::thread::id threadId = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(mEventBuffersMutex);
+    auto it = std::find_if(mEventBuffers.begin(), mEventBuffers.end(),
+                           [threadId](const auto& buffer) {
+                               return buffer->getOwner() == threadId;
+                           });
+    if (it == mEventBuffers.end()) {
+        mEventBuffers.push_back(std::make_unique<EventBuffer>(threadId));
+        it = std::prev(mEventBuffers.end());
+    }
+    threadBuffer = {.tracerId = mId, .buffer = it->get()};
+    return *threadBuffer.buffer;
+}
+
+template <typename Fill>
+void FrameTracer::record(Fill&& fill) {
+    EventBuffer& buffer = getThreadEventBuffer();
+    Event* event = buffer.beginWrite();
+    while (!event) {
+        {
+            std::lock_guard<std::mutex> lock(mProcessMutex);
+            processEventsLocked();
         }
+        event = buffer.beginWrite();
+        if (!event) {
+            // The events of this thread wait for one that another thread is writing.
+            std::this_thread::yield();
+        }
+    }
+    // Advertise the sequence before taking it, so that the events taking later ones are held back
+    // until this one is written. The fetch_add publishes it to processEventsLocked().
+    buffer.setPendingSequence(mNextSequence.load(std::memory_order_relaxed));
+    event->sequence = mNextSequence.fetch_add(1);
+    fill(*event);
+    buffer.endWrite();
+
+    // Keep room in the buffer, unless another thread is already processing the events.
+    if (buffer.size() >= EventBuffer::kCapacity / 2) {
+        std::unique_lock<std::mutex> lock(mProcessMutex, std::try_to_lock);
+        if (lock.owns_lock()) {
+            processEventsLocked();
+        }
+    }
+}
+
+void FrameTracer::traceNewLayer(int32_t layerId, const std::string& layerName) {
+    if (!isTracing()) {
+        return;
+    }
+    record([&](Event& event) {
+        event.kind = EventKind::NewLayer;
+        event.layerId = layerId;
+        event.layerName = layerName;
     });
 }
 
 void FrameTracer::traceTimestamp(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
                                  nsecs_t timestamp, FrameEvent::BufferEventType type,
                                  nsecs_t duration) {
-    FrameTracerDataSource::Trace([this, layerId, bufferID, frameNumber, timestamp, type,
-                                  duration](FrameTracerDataSource::TraceContext ctx) {
-        std::lock_guard<std::mutex> lock(mTraceMutex);
-        if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
-            return;
-        }
-
-        // Handle any pending fences for this buffer.
-        tracePendingFencesLocked(ctx, layerId, bufferID);
-
-        // Complete current trace.
-        traceLocked(ctx, layerId, bufferID, frameNumber, timestamp, type, duration);
+    if (!isTracing()) {
+        return;
+    }
+    record([&](Event& event) {
+        event.kind = EventKind::Timestamp;
+        event.layerId = layerId;
+        event.bufferID = bufferID;
+        event.frameNumber = frameNumber;
+        event.type = type;
+        event.timestamp = timestamp;
+        event.duration = duration;
     });
 }
 
 void FrameTracer::traceFence(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
                              const std::shared_ptr<FenceTime>& fence,
                              FrameEvent::BufferEventType type, nsecs_t startTime) {
-    FrameTracerDataSource::Trace([this, layerId, bufferID, frameNumber, &fence, type,
-                                  startTime](FrameTracerDataSource::TraceContext ctx) {
-        const nsecs_t signalTime = fence->getSignalTime();
-        if (signalTime != Fence::SIGNAL_TIME_INVALID) {
-            std::lock_guard<std::mutex> lock(mTraceMutex);
-            if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
-                return;
+    if (!isTracing()) {
+        return;
+    }
+    const nsecs_t signalTime = fence->getSignalTime();
+    if (signalTime == Fence::SIGNAL_TIME_INVALID) {
+        return;
+    }
+    record([&](Event& event) {
+        event.kind = EventKind::Fence;
+        event.layerId = layerId;
+        event.bufferID = bufferID;
+        event.frameNumber = frameNumber;
+        event.type = type;
+        event.timestamp = signalTime;
+        event.duration = startTime;
+        if (signalTime == Fence::SIGNAL_TIME_PENDING) {
+            event.fence = fence;
+        }
+    });
+}
+
+void FrameTracer::onDestroy(int32_t layerId) {
+    // Recorded even when not tracing, to forget the layer once its last events are processed.
+    record([&](Event& event) {
+        event.kind = EventKind::Destroy;
+        event.layerId = layerId;
+    });
+}
+
+void FrameTracer::flush() {
+    {
+        std::lock_guard<std::mutex> lock(mProcessMutex);
+        processEventsLocked();
+    }
+    FrameTracerDataSource::Trace([](FrameTracerDataSource::TraceContext ctx) { ctx.Flush(); });
+}
+
+void FrameTracer::processEventsLocked() {
+    ATRACE_CALL();
+    struct Source {
+        EventBuffer* buffer;
+        // Only process the events recorded before we started, as the threads keep recording.
+        size_t remaining;
+    };
+    // Every sequence below endSequence was taken by a thread that had already advertised it as
+    // pending, so an event still being written is either seen here as pending, or is already in
+    // its buffer when the buffer is read below.
+    uint64_t endSequence = mNextSequence.load(std::memory_order_acquire);
+    std::vector<Source> sources;
+    {
+        std::lock_guard<std::mutex> lock(mEventBuffersMutex);
+        sources.reserve(mEventBuffers.size());
+        for (const auto& buffer : mEventBuffers) {
+            endSequence = std::min(endSequence, buffer->getPendingSequence());
+            if (const size_t size = buffer->size(); size > 0) {
+                sources.push_back({buffer.get(), size});
             }
+        }
+    }
 
-            // Handle any pending fences for this buffer.
-            tracePendingFencesLocked(ctx, layerId, bufferID);
-
-            if (signalTime != Fence::SIGNAL_TIME_PENDING) {
-                traceSpanLocked(ctx, layerId, bufferID, frameNumber, type, startTime, signalTime);
-            } else {
-                mTraceTracker[layerId].pendingFences[bufferID].push_back(
-                        {.frameNumber = frameNumber,
-                         .type = type,
-                         .fence = fence,
-                         .startTime = startTime});
+    // Merge the buffers by sequence, up to the first event still being written. There are only as
+    // many buffers as threads that trace.
+    while (true) {
+        Source* next = nullptr;
+        for (Source& source : sources) {
+            if (source.remaining > 0 && source.buffer->front()->sequence < endSequence &&
+                (!next || source.buffer->front()->sequence < next->buffer->front()->sequence)) {
+                next = &source;
             }
         }
-    });
+        if (!next) {
+            break;
+        }
+        processEventLocked(*next->buffer->front());
+        next->buffer->pop();
+        next->remaining--;
+    }
 }
 
-void FrameTracer::tracePendingFencesLocked(FrameTracerDataSource::TraceContext& ctx,
-                                           int32_t layerId, uint64_t bufferID) {
-    if (mTraceTracker[layerId].pendingFences.count(bufferID)) {
-        auto& pendingFences = mTraceTracker[layerId].pendingFences[bufferID];
-        for (size_t i = 0; i < pendingFences.size(); ++i) {
-            auto& pendingFence = pendingFences[i];
+void FrameTracer::processEventLocked(const Event& event) {
+    if (event.kind == EventKind::NewLayer) {
+        if (auto [it, inserted] = mTraceTracker.try_emplace(event.layerId); inserted) {
+            it->second.layerName = event.layerName;
+        }
+        return;
+    }
+    if (event.kind == EventKind::Destroy) {
+        mTraceTracker.erase(event.layerId);
+        return;
+    }
+
+    auto it = mTraceTracker.find(event.layerId);
+    if (it == mTraceTracker.end()) {
+        return;
+    }
+    TraceRecord& record = it->second;
 
+    // Handle any pending fences for this buffer.
+    tracePendingFencesLocked(event.layerId, record, event.bufferID);
+
+    if (event.kind == EventKind::Timestamp) {
+        // Complete current trace.
+        traceLocked(record, event.bufferID, event.frameNumber, event.timestamp, event.type,
+                    event.duration);
+    } else if (event.timestamp != Fence::SIGNAL_TIME_PENDING) {
+        traceSpanLocked(record, event.bufferID, event.frameNumber, event.type, event.duration,
+                        event.timestamp);
+    } else {
+        if (record.pendingFenceCount == kMaxPendingFences) {
+            ALOGW("Layer %d has more than %zu pending fences, discarding the oldest",
+                  event.layerId, kMaxPendingFences);
+            std::move(record.pendingFences.begin() + 1, record.pendingFences.end(),
+                      record.pendingFences.begin());
+            record.pendingFenceCount--;
+        }
+        record.pendingFences[record.pendingFenceCount++] = {.bufferID = event.bufferID,
+                                                            .frameNumber = event.frameNumber,
+                                                            .type = event.type,
+                                                            .fence = event.fence,
+                                                            .startTime = event.duration};
+    }
+}
+
+void FrameTracer::tracePendingFencesLocked(int32_t layerId, TraceRecord& record,
+                                           uint64_t bufferID) {
+    size_t keptCount = 0;
+    for (size_t i = 0; i < record.pendingFenceCount; ++i) {
+        PendingFence& pendingFence = record.pendingFences[i];
+        bool keep = pendingFence.bufferID != bufferID;
+        if (!keep) {
             nsecs_t signalTime = Fence::SIGNAL_TIME_INVALID;
             if (pendingFence.fence && pendingFence.fence->isValid()) {
                 signalTime = pendingFence.fence->getSignalTime();
-                if (signalTime == Fence::SIGNAL_TIME_PENDING) {
-                    continue;
-                }
+                keep = signalTime == Fence::SIGNAL_TIME_PENDING;
             }
 
-            if (signalTime != Fence::SIGNAL_TIME_INVALID &&
+            if (!keep && signalTime != Fence::SIGNAL_TIME_INVALID &&
                 systemTime() - signalTime < kFenceSignallingDeadline) {
-                traceSpanLocked(ctx, layerId, bufferID, pendingFence.frameNumber, pendingFence.type,
+                traceSpanLocked(record, bufferID, pendingFence.frameNumber, pendingFence.type,
                                 pendingFence.startTime, signalTime);
             }
+        }
 
-            pendingFences.erase(pendingFences.begin() + i);
-            --i;
+        if (keep) {
+            if (keptCount != i) {
+                record.pendingFences[keptCount] = std::move(pendingFence);
+            }
+            keptCount++;
         }
     }
+    for (size_t i = keptCount; i < record.pendingFenceCount; ++i) {
+        record.pendingFences[i].fence.reset();
+    }
+    record.pendingFenceCount = keptCount;
+    ALOGV("Layer %d has %zu pending fences", layerId, keptCount);
 }
 
-void FrameTracer::traceLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId,
-                              uint64_t bufferID, uint64_t frameNumber, nsecs_t timestamp,
-                              FrameEvent::BufferEventType type, nsecs_t duration) {
-    auto packet = ctx.NewTracePacket();
-    packet->set_timestamp_clock_id(perfetto::protos::pbzero::BUILTIN_CLOCK_MONOTONIC);
-    packet->set_timestamp(timestamp);
-    auto* event = packet->set_graphics_frame_event()->set_buffer_event();
-    event->set_buffer_id(static_cast<uint32_t>(bufferID));
-    if (frameNumber != UNSPECIFIED_FRAME_NUMBER) {
-        event->set_frame_number(frameNumber);
-    }
-    event->set_type(type);
+void FrameTracer::traceLocked(const TraceRecord& record, uint64_t bufferID, uint64_t frameNumber,
+                              nsecs_t timestamp, FrameEvent::BufferEventType type,
+                              nsecs_t duration) {
+    FrameTracerDataSource::Trace([&](FrameTracerDataSource::TraceContext ctx) {
+        auto packet = ctx.NewTracePacket();
+        packet->set_timestamp_clock_id(perfetto::protos::pbzero::BUILTIN_CLOCK_MONOTONIC);
+        packet->set_timestamp(timestamp);
+        auto* event = packet->set_graphics_frame_event()->set_buffer_event();
+        event->set_buffer_id(static_cast<uint32_t>(bufferID));
+        if (frameNumber != UNSPECIFIED_FRAME_NUMBER) {
+            event->set_frame_number(frameNumber);
+        }
+        event->set_type(type);
 
-    if (mTraceTracker.find(layerId) != mTraceTracker.end() &&
-        !mTraceTracker[layerId].layerName.empty()) {
-        const std::string& layerName = mTraceTracker[layerId].layerName;
-        event->set_layer_name(layerName.c_str(), layerName.size());
-    }
+        if (!record.layerName.empty()) {
+            event->set_layer_name(record.layerName.c_str(), record.layerName.size());
+        }
 
-    if (duration > 0) {
-        event->set_duration_ns(duration);
-    }
+        if (duration > 0) {
+            event->set_duration_ns(duration);
+        }
+    });
 }
 
-void FrameTracer::traceSpanLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId,
-                                  uint64_t bufferID, uint64_t frameNumber,
-                                  FrameEvent::BufferEventType type, nsecs_t startTime,
-                                  nsecs_t endTime) {
+void FrameTracer::traceSpanLocked(const TraceRecord& record, uint64_t bufferID,
+                                  uint64_t frameNumber, FrameEvent::BufferEventType type,
+                                  nsecs_t startTime, nsecs_t endTime) {
     nsecs_t timestamp = endTime;
     nsecs_t duration = 0;
     if (startTime > 0 && startTime < endTime) {
         timestamp = startTime;
         duration = endTime - startTime;
     }
-    traceLocked(ctx, layerId, bufferID, frameNumber, timestamp, type, duration);
-}
-
-void FrameTracer::onDestroy(int32_t layerId) {
-    std::lock_guard<std::mutex> traceLock(mTraceMutex);
-    mTraceTracker.erase(layerId);
+    traceLocked(record, bufferID, frameNumber, timestamp, type, duration);
 }
 
 std::string FrameTracer::miniDump() {
     std::string result = "FrameTracer miniDump:\n";
-    std::lock_guard<std::mutex> lock(mTraceMutex);
+    std::lock_guard<std::mutex> lock(mProcessMutex);
+    processEventsLocked();
     android::base::StringAppendF(&result, "Number of layers currently being traced is %zu\n",
                                  mTraceTracker.size());
     return result;
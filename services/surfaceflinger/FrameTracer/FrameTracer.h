@@ -20,8 +20,15 @@
 #include <perfetto/tracing.h>
 #include <ui/FenceTime.h>
 
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 
@@ -30,14 +37,16 @@ public:
     class FrameTracerDataSource : public perfetto::DataSource<FrameTracerDataSource> {
         virtual void OnSetup(const SetupArgs&) override{};
         virtual void OnStart(const StartArgs&) override{};
-        virtual void OnStop(const StopArgs&) override{};
+        virtual void OnFlush(const FlushArgs&) override;
+        virtual void OnStop(const StopArgs&) override;
     };
 
     static const uint64_t UNSPECIFIED_FRAME_NUMBER = std::numeric_limits<uint64_t>::max();
 
     using FrameEvent = perfetto::protos::pbzero::GraphicsFrameEvent;
 
-    ~FrameTracer() = default;
+    FrameTracer();
+    ~FrameTracer();
 
     // Sets up the perfetto tracing backend and data source.
     void initialize();
@@ -63,6 +72,10 @@ public:
     // Takes care of cleanup when a layer is destroyed.
     void onDestroy(int32_t layerId);
 
+    // Writes the trace points recorded by all threads so far. Called when the data source is
+    // flushed or stopped.
+    void flush();
+
     std::string miniDump();
 
     static constexpr char kFrameTracerDataSource[] = "android.surfaceflinger.frame";
@@ -72,8 +85,67 @@ public:
     // Public for testing.
     static constexpr nsecs_t kFenceSignallingDeadline = 60'000'000'000; // 60 seconds
 
+    // The maximum number of unsignalled fences tracked per layer. The oldest fence is discarded
+    // when a layer has more.
+    static constexpr size_t kMaxPendingFences = 16;
+
 private:
+    // The trace calls only record an event into a buffer owned by the calling thread, without
+    // locking. The events of all the threads are then processed in the order they were recorded
+    // when perfetto flushes the data source, or when a thread fills half of its buffer. Events
+    // recorded after one that a thread has not finished writing yet wait for the next round.
+    enum class EventKind : uint8_t { NewLayer, Destroy, Timestamp, Fence };
+
+    struct Event {
+        uint64_t sequence;
+        EventKind kind;
+        int32_t layerId;
+        uint64_t bufferID;
+        uint64_t frameNumber;
+        FrameEvent::BufferEventType type;
+        // The timestamp, or the signal time of the fence when traced.
+        nsecs_t timestamp;
+        // The duration, or the start time of the fence.
+        nsecs_t duration;
+        // Only set for fences that were pending when traced.
+        std::shared_ptr<FenceTime> fence;
+        std::string layerName;
+    };
+
+    // Single producer, single consumer ring of events. The owning thread produces, and the
+    // consumer holds mProcessMutex.
+    class EventBuffer {
+    public:
+        static constexpr size_t kCapacity = 512;
+        static constexpr uint64_t kNoPendingSequence = std::numeric_limits<uint64_t>::max();
+
+        explicit EventBuffer(std::thread::id owner) : mOwner(owner) {}
+
+        std::thread::id getOwner() const { return mOwner; }
+        size_t size() const;
+
+        // Returns the next free event, or nullptr if the buffer is full.
+        Event* beginWrite();
+        // Called before taking the sequence of the event being written, with a lower bound of it.
+        void setPendingSequence(uint64_t sequence);
+        // Returns a lower bound of the sequence of the event being written, or kNoPendingSequence.
+        uint64_t getPendingSequence() const;
+        void endWrite();
+
+        // Returns the oldest event, or nullptr if the buffer is empty.
+        Event* front();
+        void pop();
+
+    private:
+        const std::thread::id mOwner;
+        std::array<Event, kCapacity> mEvents;
+        alignas(64) std::atomic<size_t> mHead = 0;
+        alignas(64) std::atomic<size_t> mTail = 0;
+        std::atomic<uint64_t> mPendingSequence = kNoPendingSequence;
+    };
+
     struct PendingFence {
+        uint64_t bufferID;
         uint64_t frameNumber;
         FrameEvent::BufferEventType type;
         std::shared_ptr<FenceTime> fence;
@@ -82,25 +154,48 @@ private:
 
     struct TraceRecord {
         std::string layerName;
-        using BufferID = uint64_t;
-        std::unordered_map<BufferID, std::vector<PendingFence>> pendingFences;
+        // In the order they were traced.
+        std::array<PendingFence, kMaxPendingFences> pendingFences;
+        size_t pendingFenceCount = 0;
     };
 
+    static bool isTracing();
+    EventBuffer& getThreadEventBuffer();
+    template <typename Fill>
+    void record(Fill&& fill);
+
+    // Processes the events recorded by all threads, in order, up to the first one that is still
+    // being written.
+    void processEventsLocked();
+    void processEventLocked(const Event& event);
     // Checks if any pending fences for a layer and buffer have signalled and, if they have, creates
     // trace points for them.
-    void tracePendingFencesLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId,
-                                  uint64_t bufferID);
+    void tracePendingFencesLocked(int32_t layerId, TraceRecord& record, uint64_t bufferID);
     // Creates a trace point by translating a start time and an end time to a timestamp and
     // duration. If startTime is later than end time it sets end time as the timestamp and the
     // duration to 0. Used by traceFence().
-    void traceSpanLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId,
-                         uint64_t bufferID, uint64_t frameNumber, FrameEvent::BufferEventType type,
-                         nsecs_t startTime, nsecs_t endTime);
-    void traceLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId, uint64_t bufferID,
-                     uint64_t frameNumber, nsecs_t timestamp, FrameEvent::BufferEventType type,
-                     nsecs_t duration = 0);
-
-    std::mutex mTraceMutex;
+    void traceSpanLocked(const TraceRecord& record, uint64_t bufferID, uint64_t frameNumber,
+                         FrameEvent::BufferEventType type, nsecs_t startTime, nsecs_t endTime);
+    void traceLocked(const TraceRecord& record, uint64_t bufferID, uint64_t frameNumber,
+                     nsecs_t timestamp, FrameEvent::BufferEventType type, nsecs_t duration = 0);
+
+    struct ThreadEventBuffer {
+        uint64_t tracerId = 0;
+        EventBuffer* buffer = nullptr;
+    };
+    static thread_local ThreadEventBuffer sThreadEventBuffer;
+    static std::atomic<uint64_t> sNextTracerId;
+    // The tracer whose events are written when the data source is flushed.
+    static std::atomic<FrameTracer*> sInstance;
+
+    const uint64_t mId;
+    std::atomic<uint64_t> mNextSequence = 0;
+
+    std::mutex mEventBuffersMutex;
+    std::vector<std::unique_ptr<EventBuffer>> mEventBuffers;
+
+    // Held to process the events, and guards mTraceTracker.
+    std::mutex mProcessMutex;
     std::unordered_map<int32_t, TraceRecord> mTraceTracker;
     std::once_flag mInitializationFlag;
 };
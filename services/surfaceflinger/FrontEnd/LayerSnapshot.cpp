@@ -269,6 +269,11 @@ bool LayerSnapshot::hasInputInfo() const {
             reachablilty == Reachablilty::Reachable;
 }
 
+bool LayerSnapshot::hasChanges() const {
+    return changes.get() != 0 || clientChanges != 0 || contentDirty || hasReadyFrame ||
+            sidebandStreamHasFrame || !surfaceDamage.isEmpty();
+}
+
 std::string LayerSnapshot::getDebugString() const {
     std::stringstream debug;
     debug << "Snapshot{" << path.toString() << name << " isVisible=" << isVisible << " {"
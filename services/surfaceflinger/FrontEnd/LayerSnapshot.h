@@ -55,6 +55,10 @@ struct LayerSnapshot : public compositionengine::LayerFECompositionState {
     bool isHiddenByPolicyFromRelativeParent = false;
     ftl::Flags<RequestedLayerState::Changes> changes;
     uint64_t clientChanges = 0;
+    // Id of the last LayerSnapshotBuilder::update that changed this snapshot or cleared its
+    // changes. Lets consumers that skip updates, such as layer traces, tell if the snapshot
+    // changed since they last looked at it.
+    uint64_t changedUpdateId = 0;
     // Some consumers of this snapshot (input, layer traces) rely on each snapshot to be unique.
     // For mirrored layers, snapshots will have the same sequence so this unique id provides
     // an alternative identifier when needed.
@@ -142,6 +146,8 @@ struct LayerSnapshot : public compositionengine::LayerFECompositionState {
     std::string getDebugString() const;
     std::string getIsVisibleReason() const;
     bool hasInputInfo() const;
+    // True if the last update set any change flag or per frame state on this snapshot.
+    bool hasChanges() const;
     FloatRect sourceBounds() const;
     bool isFrontBuffered() const;
     Hwc2::IComposerClient::BlendMode getBlendMode(const RequestedLayerState& requested) const;
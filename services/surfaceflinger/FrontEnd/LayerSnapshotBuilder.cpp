@@ -504,7 +504,20 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
 }
 
 void LayerSnapshotBuilder::update(const Args& args) {
+    mUpdateId++;
+    if (args.forceUpdate != ForceUpdateFlags::NONE || args.displayChanges ||
+        args.layerLifecycleManager.getGlobalChanges().any(
+                RequestedLayerState::Changes::Created | RequestedLayerState::Changes::Destroyed |
+                RequestedLayerState::Changes::Hierarchy | RequestedLayerState::Changes::Z |
+                RequestedLayerState::Changes::Mirror | RequestedLayerState::Changes::Parent |
+                RequestedLayerState::Changes::RelativeParent)) {
+        mLastGlobalChangeUpdateId = mUpdateId;
+    }
+
     for (auto& snapshot : mSnapshots) {
+        if (snapshot->hasChanges()) {
+            snapshot->changedUpdateId = mUpdateId;
+        }
         clearChanges(*snapshot);
     }
 
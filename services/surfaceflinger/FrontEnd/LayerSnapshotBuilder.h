@@ -74,6 +74,12 @@ public:
     LayerSnapshot* getSnapshot(uint32_t layerId) const;
     LayerSnapshot* getSnapshot(const LayerHierarchy::TraversalPath& id) const;
 
+    // Id of the last call to update. See LayerSnapshot::changedUpdateId.
+    uint64_t getUpdateId() const { return mUpdateId; }
+    // Id of the last update that may have changed the hierarchy, the displays, or all the
+    // snapshots at once.
+    uint64_t getLastGlobalChangeUpdateId() const { return mLastGlobalChangeUpdateId; }
+
     typedef std::function<void(const LayerSnapshot& snapshot)> ConstVisitor;
 
     // Visit each visible snapshot in z-order
@@ -135,6 +141,8 @@ private:
     std::vector<std::unique_ptr<LayerSnapshot>> mSnapshots;
     bool mResortSnapshots = false;
     int mNumInterestingSnapshots = 0;
+    uint64_t mUpdateId = 0;
+    uint64_t mLastGlobalChangeUpdateId = 0;
 };
 
 } // namespace android::surfaceflinger::frontend
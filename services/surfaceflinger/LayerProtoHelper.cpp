@@ -263,9 +263,7 @@ void LayerProtoHelper::readFromProto(const perfetto::protos::BlurRegion& proto,
     outRegion.bottom = proto.bottom();
 }
 
-perfetto::protos::LayersProto LayerProtoFromSnapshotGenerator::generate(
-        const frontend::LayerHierarchy& root) {
-    mLayersProto.clear_layers();
+std::unordered_set<uint64_t> LayerProtoFromSnapshotGenerator::getStackIdsToSkip() const {
     std::unordered_set<uint64_t> stackIdsToSkip;
     if ((mTraceFlags & LayerTracing::TRACE_VIRTUAL_DISPLAYS) == 0) {
         for (const auto& [layerStack, displayInfo] : mDisplayInfos) {
@@ -274,6 +272,13 @@ perfetto::protos::LayersProto LayerProtoFromSnapshotGenerator::generate(
             }
         }
     }
+    return stackIdsToSkip;
+}
+
+perfetto::protos::LayersProto LayerProtoFromSnapshotGenerator::generate(
+        const frontend::LayerHierarchy& root) {
+    mLayersProto.clear_layers();
+    const std::unordered_set<uint64_t> stackIdsToSkip = getStackIdsToSkip();
 
     frontend::LayerHierarchy::TraversalPath path = frontend::LayerHierarchy::TraversalPath::ROOT;
     for (auto& [child, variant] : root.mChildren) {
@@ -324,6 +329,9 @@ void LayerProtoFromSnapshotGenerator::writeHierarchyToProto(
         const frontend::LayerHierarchy& root, frontend::LayerHierarchy::TraversalPath& path) {
     using Variant = frontend::LayerHierarchy::Variant;
     perfetto::protos::LayerProto* layerProto = mLayersProto.add_layers();
+    if (mLayerPaths) {
+        mLayerPaths->push_back(path);
+    }
     const frontend::RequestedLayerState& layer = *root.getLayer();
     frontend::LayerSnapshot* snapshot = getSnapshot(path, layer);
     LayerProtoHelper::writeSnapshotToProto(layerProto, layer, *snapshot, mTraceFlags);
@@ -362,6 +370,185 @@ void LayerProtoFromSnapshotGenerator::writeHierarchyToProto(
     }
 }
 
+std::vector<std::shared_ptr<const std::string>>
+LayerProtoFromSnapshotGenerator::generateIncrementally(const frontend::LayerHierarchy& root,
+                                                       LayerProtoCache& cache) {
+    // The layers are traced in the same order, with the same parents, as long as the hierarchy
+    // and the displays did not change. Composition state is not tracked by the snapshots.
+    if (!cache.mValid || cache.mSnapshotBuilder != &mSnapshotBuilder ||
+        cache.mTraceFlags != mTraceFlags ||
+        mSnapshotBuilder.getLastGlobalChangeUpdateId() > cache.mUpdateId ||
+        (mTraceFlags & LayerTracing::TRACE_COMPOSITION)) {
+        return generateAndUpdateCache(root, cache);
+    }
+
+    std::vector<std::shared_ptr<const std::string>> layers;
+    layers.reserve(cache.mEntries.size());
+    const std::unordered_set<uint64_t> stackIdsToSkip = getStackIdsToSkip();
+    frontend::LayerHierarchy::TraversalPath path = frontend::LayerHierarchy::TraversalPath::ROOT;
+    for (auto& [child, variant] : root.mChildren) {
+        if (variant != frontend::LayerHierarchy::Variant::Attached ||
+            stackIdsToSkip.find(child->getLayer()->layerStack.id) != stackIdsToSkip.end()) {
+            continue;
+        }
+        frontend::LayerHierarchy::ScopedAddToTraversalPath addChildToPath(path,
+                                                                          child->getLayer()->id,
+                                                                          variant);
+        if (!updateHierarchyFromCache(*child, path, cache, layers)) {
+            return generateAndUpdateCache(root, cache);
+        }
+    }
+    cache.mUpdateId = mSnapshotBuilder.getUpdateId();
+    return layers;
+}
+
+std::vector<std::shared_ptr<const std::string>>
+LayerProtoFromSnapshotGenerator::generateAndUpdateCache(const frontend::LayerHierarchy& root,
+                                                        LayerProtoCache& cache) {
+    std::vector<frontend::LayerHierarchy::TraversalPath> paths;
+    mLayerPaths = &paths;
+    const perfetto::protos::LayersProto layersProto = generate(root);
+    mLayerPaths = nullptr;
+
+    cache.mValid = (mTraceFlags & LayerTracing::TRACE_COMPOSITION) == 0;
+    cache.mSnapshotBuilder = &mSnapshotBuilder;
+    cache.mTraceFlags = mTraceFlags;
+    cache.mUpdateId = mSnapshotBuilder.getUpdateId();
+    cache.mEntries.clear();
+
+    std::vector<std::shared_ptr<const std::string>> layers;
+    layers.reserve(static_cast<size_t>(layersProto.layers_size()));
+    for (int i = 0; i < layersProto.layers_size(); i++) {
+        const perfetto::protos::LayerProto& layerProto = layersProto.layers(i);
+        layers.push_back(std::make_shared<const std::string>(layerProto.SerializeAsString()));
+        if (!cache.mValid) {
+            continue;
+        }
+        LayerProtoCache::Entry entry{.bytes = layers.back(),
+                                     .uniqueSequence = static_cast<uint32_t>(layerProto.id()),
+                                     .parent = layerProto.parent(),
+                                     .zOrderRelativeOf = layerProto.z_order_relative_of(),
+                                     .children =
+                                             std::vector<uint32_t>(layerProto.children().begin(),
+                                                                   layerProto.children().end()),
+                                     .relatives =
+                                             std::vector<uint32_t>(layerProto.relatives().begin(),
+                                                                   layerProto.relatives().end())};
+        // A snapshot traced twice would have two sets of children.
+        cache.mValid = cache.mEntries.emplace(paths[static_cast<size_t>(i)], std::move(entry))
+                               .second;
+    }
+    if (!cache.mValid) {
+        cache.mEntries.clear();
+    }
+    return layers;
+}
+
+bool LayerProtoFromSnapshotGenerator::updateHierarchyFromCache(
+        const frontend::LayerHierarchy& root, frontend::LayerHierarchy::TraversalPath& path,
+        LayerProtoCache& cache, std::vector<std::shared_ptr<const std::string>>& outLayers) {
+    using Variant = frontend::LayerHierarchy::Variant;
+    // Default snapshots are not cached, as generate creates new ones for every trace entry.
+    const frontend::LayerSnapshot* snapshot = mSnapshotBuilder.getSnapshot(path);
+    auto it = cache.mEntries.find(path);
+    if (!snapshot || it == cache.mEntries.end() ||
+        it->second.uniqueSequence != snapshot->uniqueSequence) {
+        return false;
+    }
+    LayerProtoCache::Entry& entry = it->second;
+
+    // Snapshots recreated by the builder get new unique sequences.
+    size_t childCount = 0;
+    size_t relativeCount = 0;
+    for (const auto& [child, variant] : root.mChildren) {
+        frontend::LayerHierarchy::ScopedAddToTraversalPath addChildToPath(path,
+                                                                          child->getLayer()->id,
+                                                                          variant);
+        const frontend::LayerSnapshot* childSnapshot = mSnapshotBuilder.getSnapshot(path);
+        if (!childSnapshot) {
+            return false;
+        }
+        if (variant == Variant::Attached || variant == Variant::Detached ||
+            variant == Variant::Mirror) {
+            if (childCount >= entry.children.size() ||
+                entry.children[childCount++] != childSnapshot->uniqueSequence) {
+                return false;
+            }
+        } else if (variant == Variant::Relative) {
+            if (relativeCount >= entry.relatives.size() ||
+                entry.relatives[relativeCount++] != childSnapshot->uniqueSequence) {
+                return false;
+            }
+        }
+    }
+    if (childCount != entry.children.size() || relativeCount != entry.relatives.size()) {
+        return false;
+    }
+
+    if (snapshot->hasChanges() || snapshot->changedUpdateId > cache.mUpdateId) {
+        perfetto::protos::LayerProto layerProto;
+        LayerProtoHelper::writeSnapshotToProto(&layerProto, *root.getLayer(), *snapshot,
+                                               mTraceFlags);
+        for (uint32_t id : entry.children) {
+            layerProto.add_children(static_cast<int32_t>(id));
+        }
+        for (uint32_t id : entry.relatives) {
+            layerProto.add_relatives(static_cast<int32_t>(id));
+        }
+        layerProto.set_z_order_relative_of(entry.zOrderRelativeOf);
+        layerProto.set_parent(entry.parent);
+        entry.bytes = std::make_shared<const std::string>(layerProto.SerializeAsString());
+    }
+    outLayers.push_back(entry.bytes);
+
+    for (const auto& [child, variant] : root.mChildren) {
+        // avoid visiting relative layers twice
+        if (variant == Variant::Detached) {
+            continue;
+        }
+        frontend::LayerHierarchy::ScopedAddToTraversalPath addChildToPath(path,
+                                                                          child->getLayer()->id,
+                                                                          variant);
+        if (!updateHierarchyFromCache(*child, path, cache, outLayers)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string LayerProtoFromSnapshotGenerator::serializeLayers(
+        const std::vector<std::shared_ptr<const std::string>>& layers) {
+    size_t size = 0;
+    for (const auto& layer : layers) {
+        // One byte of tag and at most five bytes of length.
+        size += layer->size() + 6;
+    }
+    std::string bytes;
+    bytes.reserve(size);
+    for (const auto& layer : layers) {
+        LayerProtoHelper::appendLengthDelimitedField(bytes,
+                                                     perfetto::protos::LayersProto::
+                                                             kLayersFieldNumber,
+                                                     *layer);
+    }
+    return bytes;
+}
+
+void LayerProtoHelper::appendLengthDelimitedField(std::string& bytes, uint32_t fieldNumber,
+                                                  const std::string& value) {
+    constexpr uint32_t kWireTypeLengthDelimited = 2;
+    auto appendVarint = [&bytes](uint64_t varint) {
+        while (varint >= 0x80) {
+            bytes.push_back(static_cast<char>((varint & 0x7f) | 0x80));
+            varint >>= 7;
+        }
+        bytes.push_back(static_cast<char>(varint));
+    };
+    appendVarint((fieldNumber << 3) | kWireTypeLengthDelimited);
+    appendVarint(value.size());
+    bytes.append(value);
+}
+
 void LayerProtoHelper::writeSnapshotToProto(perfetto::protos::LayerProto* layerInfo,
                                             const frontend::RequestedLayerState& requestedState,
                                             const frontend::LayerSnapshot& snapshot,
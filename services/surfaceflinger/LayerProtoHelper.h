@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#pragma once
+
 #include <layerproto/LayerProtoHeader.h>
 #include <renderengine/ExternalTexture.h>
 
@@ -26,6 +28,10 @@
 #include <ui/Region.h>
 #include <ui/Transform.h>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 #include "FrontEnd/DisplayInfo.h"
 #include "FrontEnd/LayerHierarchy.h"
@@ -76,6 +82,32 @@ public:
                                      const frontend::LayerSnapshot& snapshot, uint32_t traceFlags);
     static google::protobuf::RepeatedPtrField<perfetto::protos::DisplayProto>
     writeDisplayInfoToProto(const frontend::DisplayInfos&);
+    // Appends a serialized message, or bytes, field to a serialized message.
+    static void appendLengthDelimitedField(std::string& bytes, uint32_t fieldNumber,
+                                           const std::string& value);
+};
+
+// Encoded layers of the previous layers trace entry, kept by the caller between entries so that
+// LayerProtoFromSnapshotGenerator only encodes the layers that changed.
+class LayerProtoCache {
+private:
+    friend class LayerProtoFromSnapshotGenerator;
+    struct Entry {
+        std::shared_ptr<const std::string> bytes;
+        uint32_t uniqueSequence;
+        int32_t parent;
+        int32_t zOrderRelativeOf;
+        std::vector<uint32_t> children;
+        std::vector<uint32_t> relatives;
+    };
+    bool mValid = false;
+    const frontend::LayerSnapshotBuilder* mSnapshotBuilder = nullptr;
+    uint32_t mTraceFlags = 0;
+    // LayerSnapshotBuilder::getUpdateId when the layers were encoded.
+    uint64_t mUpdateId = 0;
+    std::unordered_map<frontend::LayerHierarchy::TraversalPath, Entry,
+                       frontend::LayerHierarchy::TraversalPathHash>
+            mEntries;
 };
 
 class LayerProtoFromSnapshotGenerator {
@@ -90,9 +122,28 @@ public:
             mTraceFlags(traceFlags) {}
     perfetto::protos::LayersProto generate(const frontend::LayerHierarchy& root);
 
+    // Same layers as generate, each one encoded as a LayerProto, in order. Only the layers whose
+    // snapshots changed since the cache was updated are encoded again, the others are shared
+    // with the cache. Falls back to generate when the hierarchy or the displays changed, when
+    // the snapshots were rebuilt, and when tracing composition state.
+    std::vector<std::shared_ptr<const std::string>> generateIncrementally(
+            const frontend::LayerHierarchy& root, LayerProtoCache& cache);
+    // Returns the encoded layers as a serialized LayersProto, byte for byte the same as
+    // generate(root).SerializeAsString().
+    static std::string serializeLayers(
+            const std::vector<std::shared_ptr<const std::string>>& layers);
+
 private:
+    std::unordered_set<uint64_t> getStackIdsToSkip() const;
     void writeHierarchyToProto(const frontend::LayerHierarchy& root,
                                frontend::LayerHierarchy::TraversalPath& path);
+    std::vector<std::shared_ptr<const std::string>> generateAndUpdateCache(
+            const frontend::LayerHierarchy& root, LayerProtoCache& cache);
+    // Returns false if the layer can't be updated from the cache.
+    bool updateHierarchyFromCache(const frontend::LayerHierarchy& root,
+                                  frontend::LayerHierarchy::TraversalPath& path,
+                                  LayerProtoCache& cache,
+                                  std::vector<std::shared_ptr<const std::string>>& outLayers);
     frontend::LayerSnapshot* getSnapshot(frontend::LayerHierarchy::TraversalPath& path,
                                          const frontend::RequestedLayerState& layer);
 
@@ -109,6 +160,8 @@ private:
             mChildToRelativeParent;
     std::unordered_map<uint32_t /* child unique seq*/, uint32_t /* parent unique seq*/>
             mChildToParent;
+    // Paths of the layers in mLayersProto, only recorded when updating a cache.
+    std::vector<frontend::LayerHierarchy::TraversalPath>* mLayerPaths = nullptr;
 };
 
 } // namespace surfaceflinger
@@ -62,6 +62,7 @@
 #include <ftl/unit.h>
 #include <gui/AidlStatusUtil.h>
 #include <gui/BufferQueue.h>
+#include <gui/BufferQueueStats.h>
 #include <gui/DebugEGLImageTracker.h>
 #include <gui/IProducerListener.h>
 #include <gui/LayerDebugInfo.h>
@@ -519,6 +520,13 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     mIgnoreHwcPhysicalDisplayOrientation =
             base::GetBoolProperty("debug.sf.ignore_hwc_physical_display_orientation"s, false);
 
+    mBatchDeviceCompositionChanges =
+            base::GetBoolProperty("debug.sf.hwc_batch_validate"s, false);
+
+    mLayerTraceIncremental = base::GetBoolProperty("debug.sf.layer_trace_incremental"s, false);
+    mLayerTraceAsyncSerialization =
+            base::GetBoolProperty("debug.sf.layer_trace_async_serialization"s, false);
+
     // We should be reading 'persist.sys.sf.color_saturation' here
     // but since /data may be encrypted, we need to wait until after vold
     // comes online to attempt to read the property. The property is
@@ -2755,6 +2763,7 @@ CompositeResultsPerDisplay SurfaceFlinger::composite(
     refreshArgs.scheduledFrameTime = mScheduler->getScheduledFrameTime();
     refreshArgs.expectedPresentTime = expectedPresentTime.ns();
     refreshArgs.hasTrustedPresentationListener = mNumTrustedPresentationListeners > 0;
+    refreshArgs.batchDeviceCompositionChanges = mBatchDeviceCompositionChanges;
     {
         auto& notifyExpectedPresentData = mNotifyExpectedPresentMap[pacesetterId];
         auto lastExpectedPresentTimestamp = TimePoint::fromNs(
@@ -6068,6 +6077,7 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
     }
 
     static const std::unordered_map<std::string, Dumper> dumpers = {
+            {"--buffer-stats"s, dumper(&SurfaceFlinger::dumpBufferStats)},
             {"--comp-displays"s, dumper(&SurfaceFlinger::dumpCompositionDisplays)},
             {"--display-id"s, dumper(&SurfaceFlinger::dumpDisplayIdentificationData)},
             {"--displays"s, dumper(&SurfaceFlinger::dumpDisplays)},
@@ -6197,6 +6207,12 @@ void SurfaceFlinger::dumpVsync(std::string& result) const {
     mScheduler->dumpVsync(result);
 }
 
+void SurfaceFlinger::dumpBufferStats(std::string& result) const {
+    // BufferQueues of apps live in their own processes since BLAST, so this covers the ones
+    // SurfaceFlinger hosts, e.g. for virtual displays and the framebuffer.
+    BufferQueueStats::dump(result);
+}
+
 void SurfaceFlinger::dumpPlannerInfo(const DumpArgs& args, std::string& result) const {
     for (const auto& [token, display] : mDisplays) {
         const auto compositionDisplay = display->getCompositionDisplay();
@@ -9118,14 +9134,52 @@ void SurfaceFlinger::doActiveLayersTracingIfNeeded(bool isCompositionComputed,
         !mLayerTracing.isActiveTracingFlagSet(LayerTracing::Flag::TRACE_BUFFERS)) {
         return;
     }
+    if (mLayerTraceIncremental && !mLegacyFrontEndEnabled) {
+        doIncrementalLayersTracing(mLayerTracing.getActiveTracingFlags(), time, vsyncId,
+                                   visibleRegionDirty);
+        return;
+    }
     auto snapshot = takeLayersSnapshotProto(mLayerTracing.getActiveTracingFlags(), time, vsyncId,
                                             visibleRegionDirty);
     mLayerTracing.addProtoSnapshotToOstream(std::move(snapshot), LayerTracing::Mode::MODE_ACTIVE);
 }
 
-perfetto::protos::LayersSnapshotProto SurfaceFlinger::takeLayersSnapshotProto(
-        uint32_t traceFlags, TimePoint time, VsyncId vsyncId, bool visibleRegionDirty) {
+void SurfaceFlinger::doIncrementalLayersTracing(uint32_t traceFlags, TimePoint time,
+                                                VsyncId vsyncId, bool visibleRegionDirty) {
     ATRACE_CALL();
+    if (!mLayerProtoCache) {
+        mLayerProtoCache = std::make_unique<LayerProtoCache>();
+    }
+    auto snapshot = createLayersSnapshotProto(traceFlags, time, vsyncId, visibleRegionDirty);
+    auto layers = LayerProtoFromSnapshotGenerator(mLayerSnapshotBuilder, mFrontEndDisplayInfos,
+                                                  mLegacyLayers, traceFlags)
+                          .generateIncrementally(mLayerHierarchyBuilder.getHierarchy(),
+                                                 *mLayerProtoCache);
+    std::string offscreenLayers;
+    if (traceFlags & LayerTracing::Flag::TRACE_EXTRA) {
+        perfetto::protos::LayersProto offscreenLayersProto;
+        dumpOffscreenLayersProto(offscreenLayersProto);
+        offscreenLayers = offscreenLayersProto.SerializeAsString();
+    }
+
+    auto writeSnapshot = [this, snapshot = std::move(snapshot), layers = std::move(layers),
+                          offscreenLayers = std::move(offscreenLayers)]() mutable {
+        ATRACE_NAME("writeIncrementalLayersSnapshot");
+        // Serialized LayersProtos concatenate into the LayersProto of all their layers.
+        std::string serializedLayers = LayerProtoFromSnapshotGenerator::serializeLayers(layers);
+        serializedLayers.append(offscreenLayers);
+        mLayerTracing.addProtoSnapshotToOstream(std::move(snapshot), serializedLayers,
+                                                LayerTracing::Mode::MODE_ACTIVE);
+    };
+    if (mLayerTraceAsyncSerialization) {
+        BackgroundExecutor::getInstance().sendCallbacks({std::move(writeSnapshot)});
+    } else {
+        writeSnapshot();
+    }
+}
+
+perfetto::protos::LayersSnapshotProto SurfaceFlinger::createLayersSnapshotProto(
+        uint32_t traceFlags, TimePoint time, VsyncId vsyncId, bool visibleRegionDirty) {
     perfetto::protos::LayersSnapshotProto snapshot;
     snapshot.set_elapsed_realtime_nanos(time.ns());
     snapshot.set_vsync_id(ftl::to_underlying(vsyncId));
@@ -9133,12 +9187,6 @@ perfetto::protos::LayersSnapshotProto SurfaceFlinger::takeLayersSnapshotProto(
     snapshot.set_excludes_composition_state((traceFlags & LayerTracing::Flag::TRACE_COMPOSITION) ==
                                             0);
 
-    auto layers = dumpDrawingStateProto(traceFlags);
-    if (traceFlags & LayerTracing::Flag::TRACE_EXTRA) {
-        dumpOffscreenLayersProto(layers);
-    }
-    *snapshot.mutable_layers() = std::move(layers);
-
     if (traceFlags & LayerTracing::Flag::TRACE_HWC) {
         std::string hwcDump;
         dumpHwc(hwcDump);
@@ -9150,6 +9198,20 @@ perfetto::protos::LayersSnapshotProto SurfaceFlinger::takeLayersSnapshotProto(
     return snapshot;
 }
 
+perfetto::protos::LayersSnapshotProto SurfaceFlinger::takeLayersSnapshotProto(
+        uint32_t traceFlags, TimePoint time, VsyncId vsyncId, bool visibleRegionDirty) {
+    ATRACE_CALL();
+    auto snapshot = createLayersSnapshotProto(traceFlags, time, vsyncId, visibleRegionDirty);
+
+    auto layers = dumpDrawingStateProto(traceFlags);
+    if (traceFlags & LayerTracing::Flag::TRACE_EXTRA) {
+        dumpOffscreenLayersProto(layers);
+    }
+    *snapshot.mutable_layers() = std::move(layers);
+
+    return snapshot;
+}
+
 // sfdo functions
 
 void SurfaceFlinger::sfdo_enableRefreshRateOverlay(bool active) {
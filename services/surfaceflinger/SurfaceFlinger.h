@@ -162,6 +162,10 @@ namespace renderengine {
 class RenderEngine;
 } // namespace renderengine
 
+namespace surfaceflinger {
+class LayerProtoCache;
+} // namespace surfaceflinger
+
 enum {
     eTransactionNeeded = 0x01,
     eTraversalNeeded = 0x02,
@@ -1120,6 +1124,7 @@ private:
     void clearStatsLocked(const DumpArgs& args, std::string& result);
     void dumpTimeStats(const DumpArgs& args, bool asProto, std::string& result) const;
     void dumpFrameTimeline(const DumpArgs& args, std::string& result) const;
+    void dumpBufferStats(std::string& result) const;
     void logFrameStats(TimePoint now) REQUIRES(kMainThreadContext);
 
     void dumpScheduler(std::string& result) const REQUIRES(mStateLock);
@@ -1144,6 +1149,12 @@ private:
     perfetto::protos::LayersSnapshotProto takeLayersSnapshotProto(uint32_t flags, TimePoint,
                                                                   VsyncId, bool visibleRegionDirty)
             REQUIRES(kMainThreadContext);
+    // Everything but the layers.
+    perfetto::protos::LayersSnapshotProto createLayersSnapshotProto(uint32_t flags, TimePoint,
+                                                                    VsyncId,
+                                                                    bool visibleRegionDirty);
+    void doIncrementalLayersTracing(uint32_t flags, TimePoint, VsyncId, bool visibleRegionDirty)
+            REQUIRES(kMainThreadContext);
 
     // Dumps state from HW Composer
     void dumpHwc(std::string& result) const;
@@ -1307,8 +1318,19 @@ private:
 
     bool mLayerCachingEnabled = false;
     bool mBackpressureGpuComposition = false;
+    // Set by debug.sf.hwc_batch_validate. The displays of a frame are validated by a single
+    // composer call, instead of one per display.
+    bool mBatchDeviceCompositionChanges = false;
 
     LayerTracing mLayerTracing;
+    // Set by debug.sf.layer_trace_incremental. Active layer tracing only encodes the layers that
+    // changed since the previous traced frame.
+    bool mLayerTraceIncremental = false;
+    // Set by debug.sf.layer_trace_async_serialization. Incremental layer traces are assembled and
+    // written on the background thread.
+    bool mLayerTraceAsyncSerialization = false;
+    std::unique_ptr<surfaceflinger::LayerProtoCache> mLayerProtoCache
+            GUARDED_BY(kMainThreadContext);
     std::optional<TransactionTracing> mTransactionTracing;
 
     const std::shared_ptr<TimeStats> mTimeStats;
@@ -21,6 +21,7 @@
 #include "LayerTracing.h"
 
 #include "LayerDataSource.h"
+#include "LayerProtoHelper.h"
 #include "Tracing/tools/LayerTraceGenerator.h"
 #include "TransactionTracing.h"
 
@@ -138,7 +139,26 @@ void LayerTracing::addProtoSnapshotToOstream(perfetto::protos::LayersSnapshotPro
     if (mOutStream) {
         writeSnapshotToStream(std::move(snapshot));
     } else {
-        writeSnapshotToPerfetto(snapshot, mode);
+        writeSnapshotToPerfetto(snapshot.SerializeAsString(), snapshot.elapsed_realtime_nanos(),
+                                snapshot.vsync_id(), mode);
+    }
+}
+
+void LayerTracing::addProtoSnapshotToOstream(perfetto::protos::LayersSnapshotProto&& snapshot,
+                                             const std::string& serializedLayers, Mode mode) {
+    ATRACE_CALL();
+    if (mOutStream) {
+        snapshot.mutable_layers()->MergeFromString(serializedLayers);
+        writeSnapshotToStream(std::move(snapshot));
+    } else {
+        // The layers field is merged with any layers already in the snapshot when parsed.
+        std::string snapshotBytes = snapshot.SerializeAsString();
+        LayerProtoHelper::appendLengthDelimitedField(snapshotBytes,
+                                                     perfetto::protos::LayersSnapshotProto::
+                                                             kLayersFieldNumber,
+                                                     serializedLayers);
+        writeSnapshotToPerfetto(snapshotBytes, snapshot.elapsed_realtime_nanos(),
+                                snapshot.vsync_id(), mode);
     }
 }
 
@@ -172,10 +192,9 @@ void LayerTracing::writeSnapshotToStream(perfetto::protos::LayersSnapshotProto&&
     mOutStream->get() << fileProto.SerializeAsString();
 }
 
-void LayerTracing::writeSnapshotToPerfetto(const perfetto::protos::LayersSnapshotProto& snapshot,
+void LayerTracing::writeSnapshotToPerfetto(const std::string& snapshotBytes,
+                                           std::int64_t timestamp, std::int64_t vsyncId,
                                            Mode srcMode) {
-    const auto snapshotBytes = snapshot.SerializeAsString();
-
     LayerDataSource::Trace([&](LayerDataSource::TraceContext context) {
         auto dstMode = context.GetCustomTlsState()->mMode;
         if (srcMode == Mode::MODE_GENERATED) {
@@ -189,12 +208,12 @@ void LayerTracing::writeSnapshotToPerfetto(const perfetto::protos::LayersSnapsho
             return;
         }
 
-        if (!checkAndUpdateLastVsyncIdWrittenToPerfetto(srcMode, snapshot.vsync_id())) {
+        if (!checkAndUpdateLastVsyncIdWrittenToPerfetto(srcMode, vsyncId)) {
             return;
         }
         {
             auto packet = context.NewTracePacket();
-            packet->set_timestamp(static_cast<uint64_t>(snapshot.elapsed_realtime_nanos()));
+            packet->set_timestamp(static_cast<uint64_t>(timestamp));
             packet->set_timestamp_clock_id(perfetto::protos::pbzero::BUILTIN_CLOCK_MONOTONIC);
             auto* snapshotProto = packet->set_surfaceflinger_layers_snapshot();
             snapshotProto->AppendRawProtoBytes(snapshotBytes.data(), snapshotBytes.size());
@@ -22,6 +22,7 @@
 #include <functional>
 #include <optional>
 #include <ostream>
+#include <string>
 
 namespace android {
 
@@ -113,6 +114,9 @@ public:
     void onStop(Mode mode);
 
     void addProtoSnapshotToOstream(perfetto::protos::LayersSnapshotProto&& snapshot, Mode mode);
+    // Same as above, for a snapshot whose layers are already serialized as a LayersProto.
+    void addProtoSnapshotToOstream(perfetto::protos::LayersSnapshotProto&& snapshot,
+                                   const std::string& serializedLayers, Mode mode);
     bool isActiveTracingStarted() const;
     uint32_t getActiveTracingFlags() const;
     bool isActiveTracingFlagSet(Flag flag) const;
@@ -120,7 +124,8 @@ public:
 
 private:
     void writeSnapshotToStream(perfetto::protos::LayersSnapshotProto&& snapshot) const;
-    void writeSnapshotToPerfetto(const perfetto::protos::LayersSnapshotProto& snapshot, Mode mode);
+    void writeSnapshotToPerfetto(const std::string& snapshotBytes, std::int64_t timestamp,
+                                 std::int64_t vsyncId, Mode mode);
     bool checkAndUpdateLastVsyncIdWrittenToPerfetto(Mode mode, std::int64_t vsyncId);
 
     std::function<perfetto::protos::LayersSnapshotProto(uint32_t)> mTakeLayersSnapshotProto;
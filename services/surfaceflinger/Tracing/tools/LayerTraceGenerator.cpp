@@ -42,7 +42,7 @@ using namespace ftl::flag_operators;
 
 bool LayerTraceGenerator::generate(const perfetto::protos::TransactionTraceFile& traceFile,
                                    std::uint32_t traceFlags, LayerTracing& layerTracing,
-                                   bool onlyLastEntry) {
+                                   bool onlyLastEntry, bool verifyIncremental) {
     if (traceFile.entry_size() == 0) {
         ALOGD("Trace file is empty");
         return false;
@@ -55,6 +55,7 @@ bool LayerTraceGenerator::generate(const perfetto::protos::TransactionTraceFile&
     frontend::LayerHierarchyBuilder hierarchyBuilder{{}};
     frontend::LayerSnapshotBuilder snapshotBuilder;
     ui::DisplayMap<ui::LayerStack, frontend::DisplayInfo> displayInfos;
+    surfaceflinger::LayerProtoCache layerProtoCache;
 
     ShadowSettings globalShadowSettings{.ambientColor = {1, 1, 1, 1}};
     char value[PROPERTY_VALUE_MAX];
@@ -150,6 +151,17 @@ bool LayerTraceGenerator::generate(const perfetto::protos::TransactionTraceFile&
         auto layersProto =
                 LayerProtoFromSnapshotGenerator(snapshotBuilder, displayInfos, {}, traceFlags)
                         .generate(hierarchyBuilder.getHierarchy());
+        if (verifyIncremental) {
+            const std::string incrementalLayers = LayerProtoFromSnapshotGenerator::serializeLayers(
+                    LayerProtoFromSnapshotGenerator(snapshotBuilder, displayInfos, {}, traceFlags)
+                            .generateIncrementally(hierarchyBuilder.getHierarchy(),
+                                                   layerProtoCache));
+            if (incrementalLayers != layersProto.SerializeAsString()) {
+                ALOGE("Entry %d for vsyncid=%" PRId64 " differs when generated incrementally", i,
+                      entry.vsync_id());
+                return false;
+            }
+        }
         auto displayProtos = LayerProtoHelper::writeDisplayInfoToProto(displayInfos);
         if (!onlyLastEntry || (i == traceFile.entry_size() - 1)) {
             perfetto::protos::LayersSnapshotProto snapshotProto{};
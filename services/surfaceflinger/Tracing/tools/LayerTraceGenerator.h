@@ -29,7 +29,10 @@ class LayerTracing;
 
 class LayerTraceGenerator {
 public:
+    // With verifyIncremental, also generates each entry incrementally from the previous one, and
+    // fails if it differs from the entry generated from scratch.
     bool generate(const perfetto::protos::TransactionTraceFile&, std::uint32_t traceFlags,
-                  LayerTracing& layerTracing, bool onlyLastEntry = false);
+                  LayerTracing& layerTracing, bool onlyLastEntry = false,
+                  bool verifyIncremental = false);
 };
 } // namespace android
@@ -0,0 +1,666 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "TransactionReplayer"
+//#define LOG_NDEBUG 0
+
+#include "TransactionReplayer.h"
+
+#include <android/gui/ISurfaceComposerClient.h>
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IGraphicBufferConsumer.h>
+#include <gui/LayerState.h>
+#include <gui/SurfaceComposerClient.h>
+#include <log/log.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/String8.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <condition_variable>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace android {
+
+namespace {
+
+using gui::ISurfaceComposerClient;
+
+// Layers of the replay are shown on this layer stack only, whatever their traced layer stack.
+constexpr ui::LayerStack kReplayLayerStack = ui::LayerStack::fromValue(0x7e5e7);
+
+// Traced in place of a layer id when there is none.
+constexpr uint32_t kUnassignedLayerId = std::numeric_limits<uint32_t>::max();
+
+// Buffers each layer cycles through, as a triple buffered app would.
+constexpr size_t kBuffersPerLayerSize = 3;
+
+// How long to wait for the callbacks of the last transactions, for a commit when too many
+// transactions are pending, or for a layer to release one of its buffers.
+constexpr std::chrono::seconds kCallbackTimeout{2};
+
+constexpr uint64_t kSkippedLayerChanges = layer_state_t::eLayerStackChanged |
+        layer_state_t::eInputInfoChanged | layer_state_t::eDropInputModeChanged |
+        layer_state_t::eTrustedOverlayChanged | layer_state_t::eSidebandStreamChanged |
+        layer_state_t::eAutoRefreshChanged;
+
+Rect toRect(const perfetto::protos::RectProto& proto) {
+    return Rect(proto.left(), proto.top(), proto.right(), proto.bottom());
+}
+
+half3 toColor(const perfetto::protos::LayerState_Color3& proto) {
+    return half3(proto.r(), proto.g(), proto.b());
+}
+
+void sleepUntil(nsecs_t time) {
+    std::this_thread::sleep_until(
+            std::chrono::steady_clock::time_point(std::chrono::nanoseconds(time)));
+}
+
+} // namespace
+
+// Keeps the virtual display composing by releasing every frame as soon as it is queued.
+class TransactionReplayer::DisplaySink : public BnConsumerListener {
+public:
+    explicit DisplaySink(const sp<IGraphicBufferConsumer>& consumer) : mConsumer(consumer) {}
+
+    void onFrameAvailable(const BufferItem&) override {
+        BufferItem item;
+        while (mConsumer->acquireBuffer(&item, 0) == NO_ERROR) {
+            mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY,
+                                     EGL_NO_SYNC_KHR, Fence::NO_FENCE);
+        }
+    }
+    void onBuffersReleased() override {}
+    void onSidebandStreamChanged() override {}
+
+private:
+    const sp<IGraphicBufferConsumer> mConsumer;
+};
+
+// One synthetic client, with its own connection to SurfaceFlinger and its own copy of the traced
+// layers under a root layer on the replay layer stack.
+class TransactionReplayer::Client : public RefBase {
+public:
+    Client(uint32_t index, const perfetto::protos::TransactionTraceFile& trace,
+           const Options& options)
+          : mIndex(index), mTrace(trace), mOptions(options) {}
+
+    status_t init();
+
+    // Replays the trace, with the first transaction applied at startTime.
+    void replay(nsecs_t startTime);
+
+    // Returns false if some callbacks did not arrive in time.
+    bool waitForCallbacks();
+
+    void collect(Report* report, std::vector<nsecs_t>* commitLatencies,
+                 std::vector<nsecs_t>* compositeLatencies);
+
+private:
+    struct Sample {
+        nsecs_t applyTime;
+        nsecs_t commitTime = -1;
+        bool completed = false;
+        sp<Fence> presentFence;
+    };
+
+    void addLayer(const perfetto::protos::LayerCreationArgs& args);
+    bool addLayerChange(const perfetto::protos::LayerState& change,
+                        SurfaceComposerClient::Transaction* t);
+    sp<GraphicBuffer> nextBuffer(uint32_t layerId, uint32_t width, uint32_t height,
+                                 int32_t format);
+    void apply(SurfaceComposerClient::Transaction* t);
+    void onCommitted(size_t sample);
+    void onCompleted(size_t sample, const sp<Fence>& presentFence);
+    void onBufferReleased(uint32_t layerId, uint64_t bufferId);
+
+    sp<SurfaceControl> findLayer(uint32_t layerId) const {
+        const auto it = mLayers.find(layerId);
+        return it != mLayers.end() ? it->second : nullptr;
+    }
+
+    const uint32_t mIndex;
+    const perfetto::protos::TransactionTraceFile& mTrace;
+    const Options& mOptions;
+
+    sp<SurfaceComposerClient> mComposerClient;
+    sp<SurfaceControl> mRoot;
+    // Parent of the layers that have no parent in the trace, which are offscreen.
+    sp<SurfaceControl> mOffscreenRoot;
+    std::unordered_map<uint32_t /* traced layer id */, sp<SurfaceControl>> mLayers;
+    size_t mSkipped = 0;
+
+    // The buffers of a layer, which are only reused once SurfaceFlinger released them.
+    struct BufferRing {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        int32_t format = 0;
+        std::array<sp<GraphicBuffer>, kBuffersPerLayerSize> buffers;
+        std::array<bool, kBuffersPerLayerSize> inUse{};
+        // Reused if no buffer is released in time.
+        size_t next = 0;
+    };
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    // Protected by mMutex, as the callbacks arrive on binder threads.
+    std::vector<Sample> mSamples;
+    size_t mPendingCommits = 0;
+    size_t mPendingCompletions = 0;
+    std::unordered_map<uint32_t /* traced layer id */, BufferRing> mBuffers;
+};
+
+status_t TransactionReplayer::Client::init() {
+    mComposerClient = sp<SurfaceComposerClient>::make();
+    status_t err = mComposerClient->initCheck();
+    if (err != NO_ERROR) {
+        ALOGE("Client %" PRIu32 ": could not connect to SurfaceFlinger (%d)", mIndex, err);
+        return err;
+    }
+
+    const std::string name = "TransactionReplayer#" + std::to_string(mIndex);
+    mRoot = mComposerClient->createSurface(String8(name.c_str()), 0, 0, PIXEL_FORMAT_RGBA_8888,
+                                           ISurfaceComposerClient::eFXSurfaceContainer);
+    if (mRoot == nullptr) {
+        ALOGE("Client %" PRIu32 ": could not create the root layer", mIndex);
+        return NO_INIT;
+    }
+    mOffscreenRoot = mComposerClient->createSurface(String8((name + " offscreen").c_str()), 0, 0,
+                                                    PIXEL_FORMAT_RGBA_8888,
+                                                    ISurfaceComposerClient::eFXSurfaceContainer |
+                                                            ISurfaceComposerClient::eHidden,
+                                                    mRoot->getHandle());
+    if (mOffscreenRoot == nullptr) {
+        ALOGE("Client %" PRIu32 ": could not create the offscreen root layer", mIndex);
+        return NO_INIT;
+    }
+    SurfaceComposerClient::Transaction()
+            .setLayerStack(mRoot, kReplayLayerStack)
+            .show(mRoot)
+            .apply(/*synchronous=*/true);
+    return NO_ERROR;
+}
+
+void TransactionReplayer::Client::addLayer(const perfetto::protos::LayerCreationArgs& args) {
+    sp<SurfaceControl> parent = findLayer(args.parent_id());
+    if (parent == nullptr) {
+        parent = args.add_to_root() ? mRoot : mOffscreenRoot;
+    }
+
+    // Mirrors are replayed as empty containers: the layers they mirror may not exist here.
+    const bool isMirror = (args.has_mirror_from_id() &&
+                           args.mirror_from_id() != kUnassignedLayerId) ||
+            (args.has_layer_stack_to_mirror() &&
+             args.layer_stack_to_mirror() != ui::INVALID_LAYER_STACK.id);
+    int32_t flags = static_cast<int32_t>(args.flags()) & ~ISurfaceComposerClient::eSecure;
+    if (isMirror) {
+        flags = (flags & ~ISurfaceComposerClient::eFXSurfaceMask) |
+                ISurfaceComposerClient::eFXSurfaceContainer;
+    } else if ((flags & ISurfaceComposerClient::eFXSurfaceMask) ==
+               ISurfaceComposerClient::eFXSurfaceBufferQueue) {
+        // Buffer queue layers have their buffers set through transactions nowadays.
+        flags |= ISurfaceComposerClient::eFXSurfaceBufferState;
+    }
+
+    sp<SurfaceControl> layer =
+            mComposerClient->createSurface(String8(args.name().c_str()), 0, 0,
+                                           PIXEL_FORMAT_RGBA_8888, flags, parent->getHandle());
+    if (layer == nullptr) {
+        ALOGW("Client %" PRIu32 ": could not create layer %s", mIndex, args.name().c_str());
+        return;
+    }
+    mLayers[args.layer_id()] = std::move(layer);
+}
+
+sp<GraphicBuffer> TransactionReplayer::Client::nextBuffer(uint32_t layerId, uint32_t width,
+                                                          uint32_t height, int32_t format) {
+    std::unique_lock lock(mMutex);
+    // Only this thread adds or removes rings, so ring stays valid while the lock is released.
+    BufferRing& ring = mBuffers[layerId];
+    if (ring.width != width || ring.height != height || ring.format != format) {
+        // The buffers still held by SurfaceFlinger are forgotten when they are released.
+        ring = {.width = width, .height = height, .format = format};
+    }
+
+    size_t slot = 0;
+    const auto findFreeSlot = [&] {
+        slot = static_cast<size_t>(std::find(ring.inUse.begin(), ring.inUse.end(), false) -
+                                   ring.inUse.begin());
+        return slot < kBuffersPerLayerSize;
+    };
+    if (!mCondition.wait_for(lock, kCallbackTimeout, findFreeSlot)) {
+        ALOGW("Client %" PRIu32 ": layer %" PRIu32 " released no buffer in %" PRId64
+              "s, reusing one anyway",
+              mIndex, layerId, static_cast<int64_t>(kCallbackTimeout.count()));
+        slot = ring.next;
+    }
+    ring.next = (slot + 1) % kBuffersPerLayerSize;
+    ring.inUse[slot] = true;
+    if (ring.buffers[slot] != nullptr) {
+        return ring.buffers[slot];
+    }
+
+    // Allocate without blocking the callbacks.
+    lock.unlock();
+    constexpr uint64_t kUsage = GraphicBuffer::USAGE_HW_COMPOSER |
+            GraphicBuffer::USAGE_HW_TEXTURE | GraphicBuffer::USAGE_SW_WRITE_RARELY;
+    sp<GraphicBuffer> buffer =
+            sp<GraphicBuffer>::make(width, height, format, 1, kUsage, "TransactionReplayer");
+    if (buffer->initCheck() != NO_ERROR) {
+        // The traced format may be private to the recording device.
+        buffer = sp<GraphicBuffer>::make(width, height, PIXEL_FORMAT_RGBA_8888, 1, kUsage,
+                                         "TransactionReplayer");
+    }
+    if (buffer->initCheck() != NO_ERROR) {
+        buffer.clear();
+    }
+    lock.lock();
+    ring.buffers[slot] = buffer;
+    ring.inUse[slot] = buffer != nullptr;
+    return buffer;
+}
+
+bool TransactionReplayer::Client::addLayerChange(const perfetto::protos::LayerState& change,
+                                                 SurfaceComposerClient::Transaction* t) {
+    const sp<SurfaceControl> layer = findLayer(change.layer_id());
+    const uint64_t what = change.what() & ~kSkippedLayerChanges;
+    if (layer == nullptr || what == 0) {
+        return false;
+    }
+
+    if (what & layer_state_t::ePositionChanged) {
+        t->setPosition(layer, change.x(), change.y());
+    }
+    if (what & layer_state_t::eLayerChanged) {
+        t->setLayer(layer, change.z());
+    }
+    if (what & layer_state_t::eFlagsChanged) {
+        t->setFlags(layer, change.flags(), change.mask());
+    }
+    if (what & layer_state_t::eMatrixChanged) {
+        const auto& matrix = change.matrix();
+        t->setMatrix(layer, matrix.dsdx(), matrix.dtdx(), matrix.dtdy(), matrix.dsdy());
+    }
+    if (what & layer_state_t::eCornerRadiusChanged) {
+        t->setCornerRadius(layer, change.corner_radius());
+    }
+    if (what & layer_state_t::eBackgroundBlurRadiusChanged) {
+        t->setBackgroundBlurRadius(layer, static_cast<int>(change.background_blur_radius()));
+    }
+    if (what & layer_state_t::eAlphaChanged) {
+        t->setAlpha(layer, change.alpha());
+    }
+    if (what & layer_state_t::eColorChanged) {
+        t->setColor(layer, toColor(change.color()));
+    }
+    if (what & layer_state_t::eBackgroundColorChanged) {
+        t->setBackgroundColor(layer, toColor(change.color()), change.bg_color_alpha(),
+                              static_cast<ui::Dataspace>(change.bg_color_dataspace()));
+    }
+    if (what & layer_state_t::eBufferTransformChanged) {
+        t->setTransform(layer, change.transform());
+    }
+    if (what & layer_state_t::eTransformToDisplayInverseChanged) {
+        t->setTransformToDisplayInverse(layer, change.transform_to_display_inverse());
+    }
+    if (what & layer_state_t::eCropChanged) {
+        t->setCrop(layer, toRect(change.crop()));
+    }
+    if (what & layer_state_t::eBufferCropChanged) {
+        t->setBufferCrop(layer, toRect(change.buffer_crop()));
+    }
+    if (what & layer_state_t::eDestinationFrameChanged) {
+        t->setDestinationFrame(layer, toRect(change.destination_frame()));
+    }
+    if (what & layer_state_t::eBufferChanged) {
+        const auto& bufferData = change.buffer_data();
+        if (bufferData.width() > 0 && bufferData.height() > 0) {
+            const uint32_t layerId = change.layer_id();
+            sp<GraphicBuffer> buffer =
+                    nextBuffer(layerId, bufferData.width(), bufferData.height(),
+                               static_cast<int32_t>(bufferData.pixel_format()));
+            if (buffer != nullptr) {
+                // Nothing is drawn into the buffers, so the release fence need not be waited for.
+                const wp<Client> weakThis = this;
+                const uint64_t bufferId = buffer->getId();
+                t->setBuffer(layer, buffer, std::nullopt, std::nullopt, 0,
+                             [weakThis, layerId, bufferId](const ReleaseCallbackId&,
+                                                           const sp<Fence>&,
+                                                           std::optional<uint32_t>) {
+                                 if (const sp<Client> client = weakThis.promote()) {
+                                     client->onBufferReleased(layerId, bufferId);
+                                 }
+                             });
+            }
+        }
+    }
+    if (what & layer_state_t::eColorSpaceAgnosticChanged) {
+        t->setColorSpaceAgnostic(layer, change.color_space_agnostic());
+    }
+    if (what & layer_state_t::eShadowRadiusChanged) {
+        t->setShadowRadius(layer, change.shadow_radius());
+    }
+    if (what & layer_state_t::eFrameRateSelectionPriority) {
+        t->setFrameRateSelectionPriority(layer, change.frame_rate_selection_priority());
+    }
+    if (what & layer_state_t::eFrameRateChanged) {
+        t->setFrameRate(layer, change.frame_rate(),
+                        static_cast<int8_t>(change.frame_rate_compatibility()),
+                        static_cast<int8_t>(change.change_frame_rate_strategy()));
+    }
+    if (what & layer_state_t::eFixedTransformHintChanged) {
+        t->setFixedTransformHint(layer, static_cast<int32_t>(change.fixed_transform_hint()));
+    }
+    if (what & layer_state_t::eReparent) {
+        sp<SurfaceControl> parent = findLayer(change.parent_id());
+        t->reparent(layer, parent != nullptr ? parent : mOffscreenRoot);
+    }
+    if (what & layer_state_t::eRelativeLayerChanged) {
+        sp<SurfaceControl> relativeTo = findLayer(change.relative_parent_id());
+        if (relativeTo != nullptr) {
+            t->setRelativeLayer(layer, relativeTo, change.z());
+        } else {
+            t->setLayer(layer, change.z());
+        }
+    }
+    return true;
+}
+
+void TransactionReplayer::Client::apply(SurfaceComposerClient::Transaction* t) {
+    size_t sample;
+    {
+        std::unique_lock lock(mMutex);
+        if (!mCondition.wait_for(lock, kCallbackTimeout, [&] {
+                return mPendingCommits < mOptions.maxPendingTransactions;
+            })) {
+            ALOGW("Client %" PRIu32 ": no commit in %" PRId64 "s, applying anyway", mIndex,
+                  static_cast<int64_t>(kCallbackTimeout.count()));
+        }
+        sample = mSamples.size();
+        mSamples.push_back({.applyTime = systemTime()});
+        mPendingCommits++;
+        mPendingCompletions++;
+    }
+
+    // The callbacks may outlive the client if they time out.
+    const wp<Client> weakThis = this;
+    t->addTransactionCommittedCallback(
+            [weakThis, sample](void*, nsecs_t, const sp<Fence>&,
+                               const std::vector<SurfaceControlStats>&) {
+                if (const sp<Client> client = weakThis.promote()) {
+                    client->onCommitted(sample);
+                }
+            },
+            nullptr);
+    t->addTransactionCompletedCallback(
+            [weakThis, sample](void*, nsecs_t, const sp<Fence>& presentFence,
+                               const std::vector<SurfaceControlStats>&) {
+                if (const sp<Client> client = weakThis.promote()) {
+                    client->onCompleted(sample, presentFence);
+                }
+            },
+            nullptr);
+    t->apply();
+}
+
+void TransactionReplayer::Client::onCommitted(size_t sample) {
+    const nsecs_t now = systemTime();
+    {
+        std::lock_guard lock(mMutex);
+        mSamples[sample].commitTime = now;
+        mPendingCommits--;
+    }
+    mCondition.notify_all();
+}
+
+void TransactionReplayer::Client::onCompleted(size_t sample, const sp<Fence>& presentFence) {
+    {
+        std::lock_guard lock(mMutex);
+        mSamples[sample].completed = true;
+        mSamples[sample].presentFence = presentFence;
+        mPendingCompletions--;
+    }
+    mCondition.notify_all();
+}
+
+void TransactionReplayer::Client::onBufferReleased(uint32_t layerId, uint64_t bufferId) {
+    {
+        std::lock_guard lock(mMutex);
+        const auto it = mBuffers.find(layerId);
+        if (it == mBuffers.end()) {
+            return;
+        }
+        BufferRing& ring = it->second;
+        for (size_t i = 0; i < kBuffersPerLayerSize; i++) {
+            if (ring.buffers[i] != nullptr && ring.buffers[i]->getId() == bufferId) {
+                ring.inUse[i] = false;
+            }
+        }
+    }
+    mCondition.notify_all();
+}
+
+void TransactionReplayer::Client::replay(nsecs_t startTime) {
+    // Transactions are paced by the time their client posted them.
+    nsecs_t traceStartTime = -1;
+    for (const auto& entry : mTrace.entry()) {
+        for (const auto& transaction : entry.transactions()) {
+            if (transaction.post_time() > 0) {
+                traceStartTime = transaction.post_time();
+                break;
+            }
+        }
+        if (traceStartTime >= 0) break;
+    }
+
+    for (const auto& entry : mTrace.entry()) {
+        for (const auto& args : entry.added_layers()) {
+            addLayer(args);
+        }
+
+        for (const auto& transaction : entry.transactions()) {
+            SurfaceComposerClient::Transaction t;
+            bool hasChanges = false;
+            for (const auto& change : transaction.layer_changes()) {
+                hasChanges |= addLayerChange(change, &t);
+            }
+            if (!hasChanges) {
+                mSkipped++;
+                continue;
+            }
+
+            if (mOptions.speed > 0 && transaction.post_time() > 0) {
+                const auto offset = static_cast<nsecs_t>(
+                        static_cast<double>(transaction.post_time() - traceStartTime) /
+                        mOptions.speed);
+                sleepUntil(startTime + offset);
+            }
+            apply(&t);
+        }
+
+        // The client released these handles, which lets SurfaceFlinger destroy the layers.
+        for (const uint32_t layerId : entry.destroyed_layer_handles()) {
+            mLayers.erase(layerId);
+            std::lock_guard lock(mMutex);
+            mBuffers.erase(layerId);
+        }
+    }
+}
+
+bool TransactionReplayer::Client::waitForCallbacks() {
+    std::unique_lock lock(mMutex);
+    return mCondition.wait_for(lock, kCallbackTimeout, [&] {
+        return mPendingCompletions == 0;
+    });
+}
+
+void TransactionReplayer::Client::collect(Report* report, std::vector<nsecs_t>* commitLatencies,
+                                          std::vector<nsecs_t>* compositeLatencies) {
+    std::lock_guard lock(mMutex);
+    report->applied += mSamples.size();
+    report->skipped += mSkipped;
+    for (const Sample& sample : mSamples) {
+        if (sample.commitTime >= 0) {
+            commitLatencies->push_back(sample.commitTime - sample.applyTime);
+        }
+        if (!sample.completed || sample.presentFence == nullptr) {
+            continue;
+        }
+        // The frame may not be presented yet when the callback arrives.
+        sample.presentFence->wait(static_cast<int>(
+                std::chrono::milliseconds(kCallbackTimeout).count()));
+        const nsecs_t presentTime = sample.presentFence->getSignalTime();
+        if (presentTime != Fence::SIGNAL_TIME_INVALID &&
+            presentTime != Fence::SIGNAL_TIME_PENDING) {
+            compositeLatencies->push_back(presentTime - sample.applyTime);
+        }
+    }
+}
+
+TransactionReplayer::Latencies TransactionReplayer::Latencies::fromSamples(
+        std::vector<nsecs_t> samples) {
+    Latencies latencies;
+    if (samples.empty()) {
+        return latencies;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        const auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())));
+        return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+    latencies.count = samples.size();
+    latencies.p50 = percentile(0.5);
+    latencies.p90 = percentile(0.9);
+    latencies.p99 = percentile(0.99);
+    latencies.max = samples.back();
+    return latencies;
+}
+
+void TransactionReplayer::Report::dump(std::ostream& out) const {
+    const double seconds = static_cast<double>(duration) / 1e9;
+    out << "Applied " << applied << " transactions from " << clients << " clients in "
+        << std::fixed << std::setprecision(2) << seconds << "s ("
+        << (seconds > 0 ? static_cast<double>(applied) / seconds : 0) << " per second), skipped "
+        << skipped << "\n";
+
+    auto dumpLatencies = [&out](const char* name, const Latencies& latencies) {
+        auto ms = [](nsecs_t ns) { return static_cast<double>(ns) / 1e6; };
+        out << name << " latency (ms): p50 " << ms(latencies.p50) << "  p90 " << ms(latencies.p90)
+            << "  p99 " << ms(latencies.p99) << "  max " << ms(latencies.max) << "  ("
+            << latencies.count << " samples)\n";
+    };
+    dumpLatencies("Commit", commit);
+    dumpLatencies("Composite", composite);
+}
+
+TransactionReplayer::TransactionReplayer(const perfetto::protos::TransactionTraceFile& trace,
+                                         Options options)
+      : mTrace(trace), mOptions(options) {}
+
+TransactionReplayer::~TransactionReplayer() {
+    if (mDisplay != nullptr) {
+        SurfaceComposerClient::destroyDisplay(mDisplay);
+    }
+}
+
+status_t TransactionReplayer::createDisplay() {
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&mDisplayProducer, &consumer);
+    consumer->setConsumerName(String8("TransactionReplayer display"));
+    consumer->setDefaultBufferSize(static_cast<uint32_t>(mOptions.displaySize.width),
+                                   static_cast<uint32_t>(mOptions.displaySize.height));
+    mDisplaySink = sp<DisplaySink>::make(consumer);
+    status_t err = consumer->consumerConnect(mDisplaySink, /*controlledByApp=*/false);
+    if (err != NO_ERROR) {
+        ALOGE("Could not connect to the virtual display buffer queue (%d)", err);
+        return err;
+    }
+
+    mDisplay = SurfaceComposerClient::createDisplay(String8("TransactionReplayer"),
+                                                    /*secure=*/false);
+    if (mDisplay == nullptr) {
+        ALOGE("Could not create the virtual display");
+        return NO_INIT;
+    }
+    const Rect bounds(mOptions.displaySize);
+    SurfaceComposerClient::Transaction t;
+    t.setDisplaySurface(mDisplay, mDisplayProducer);
+    t.setDisplayLayerStack(mDisplay, kReplayLayerStack);
+    t.setDisplayProjection(mDisplay, ui::ROTATION_0, bounds, bounds);
+    return t.apply(/*synchronous=*/true);
+}
+
+status_t TransactionReplayer::replay(Report* outReport) {
+    if (mTrace.entry_size() == 0) {
+        ALOGE("Trace file is empty");
+        return BAD_VALUE;
+    }
+    status_t err = createDisplay();
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    std::vector<sp<Client>> clients;
+    for (uint32_t i = 0; i < mOptions.clients; i++) {
+        clients.push_back(sp<Client>::make(i, mTrace, mOptions));
+        err = clients.back()->init();
+        if (err != NO_ERROR) {
+            return err;
+        }
+    }
+
+    ALOGD("Replaying %d entries from %" PRIu32 " clients at %.2fx", mTrace.entry_size(),
+          mOptions.clients, mOptions.speed);
+    // Leave time for all the threads to start, so that the clients are in step.
+    const nsecs_t startTime = systemTime() + ms2ns(100);
+    std::vector<std::thread> threads;
+    threads.reserve(clients.size());
+    for (const sp<Client>& client : clients) {
+        threads.emplace_back([client, startTime] { client->replay(startTime); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const nsecs_t endTime = systemTime();
+
+    std::vector<nsecs_t> commitLatencies;
+    std::vector<nsecs_t> compositeLatencies;
+    Report report;
+    report.clients = mOptions.clients;
+    report.duration = endTime - startTime;
+    for (const sp<Client>& client : clients) {
+        if (!client->waitForCallbacks()) {
+            ALOGW("Some transaction callbacks did not arrive");
+        }
+        client->collect(&report, &commitLatencies, &compositeLatencies);
+    }
+    report.commit = Latencies::fromSamples(std::move(commitLatencies));
+    report.composite = Latencies::fromSamples(std::move(compositeLatencies));
+    *outReport = report;
+    return NO_ERROR;
+}
+
+} // namespace android
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gui/IConsumerListener.h>
+#include <gui/IGraphicBufferProducer.h>
+#include <layerproto/TransactionProto.h>
+#include <ui/Size.h>
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+#include <utils/Timers.h>
+
+#include <ostream>
+#include <vector>
+
+namespace android {
+
+/**
+ * Replays a transaction trace against the running SurfaceFlinger, from any number of synthetic
+ * clients, and measures how long SurfaceFlinger takes to commit and to composite each
+ * transaction. Every client creates its own copy of the traced layers, shown on a virtual
+ * display, and applies the traced transactions to them with the recorded pacing, compressed in
+ * time, or as fast as SurfaceFlinger takes them.
+ */
+class TransactionReplayer {
+public:
+    struct Options {
+        // How much faster than recorded the trace is replayed. 0 applies every transaction as
+        // soon as the previous one is applied.
+        float speed = 1.f;
+        // Clients replaying the trace concurrently.
+        uint32_t clients = 1;
+        // Transactions a client applies before waiting for the oldest one to be committed, like
+        // an app running out of buffers.
+        uint32_t maxPendingTransactions = 8;
+        ui::Size displaySize{1920, 1080};
+    };
+
+    struct Latencies {
+        size_t count = 0;
+        nsecs_t p50 = 0;
+        nsecs_t p90 = 0;
+        nsecs_t p99 = 0;
+        nsecs_t max = 0;
+
+        static Latencies fromSamples(std::vector<nsecs_t> samples);
+    };
+
+    struct Report {
+        uint32_t clients = 0;
+        size_t applied = 0;
+        // Transactions left out because they only changed layers that could not be replayed.
+        size_t skipped = 0;
+        nsecs_t duration = 0;
+        // From apply to the committed callback.
+        Latencies commit;
+        // From apply to the present fence of the composited frame.
+        Latencies composite;
+
+        void dump(std::ostream& out) const;
+    };
+
+    TransactionReplayer(const perfetto::protos::TransactionTraceFile& trace, Options options);
+    ~TransactionReplayer();
+
+    // Replays the whole trace from every client, and returns once all the callbacks arrived or
+    // timed out.
+    status_t replay(Report* outReport);
+
+private:
+    class Client;
+    class DisplaySink;
+
+    status_t createDisplay();
+
+    const perfetto::protos::TransactionTraceFile& mTrace;
+    const Options mOptions;
+    sp<IBinder> mDisplay;
+    sp<IGraphicBufferProducer> mDisplayProducer;
+    sp<IConsumerListener> mDisplaySink;
+};
+
+} // namespace android
@@ -27,9 +27,10 @@
 using namespace android;
 
 int main(int argc, char** argv) {
-    if (argc > 4) {
+    if (argc > 5) {
         std::cout << "Usage: " << argv[0]
-                  << " [transaction-trace-path] [output-layers-trace-path] [--last-entry-only]\n";
+                  << " [transaction-trace-path] [output-layers-trace-path] [--last-entry-only]"
+                     " [--verify-incremental]\n";
         return -1;
     }
 
@@ -49,13 +50,17 @@ int main(int argc, char** argv) {
     }
 
     const auto* outputLayersTracePath =
-            (argc == 3) ? argv[2] : "/data/misc/wmtrace/layers_trace.winscope";
+            (argc >= 3) ? argv[2] : "/data/misc/wmtrace/layers_trace.winscope";
     auto outStream = std::ofstream{outputLayersTracePath, std::ios::binary | std::ios::out};
 
     auto layerTracing = LayerTracing{outStream};
 
-    const bool generateLastEntryOnly =
-            argc >= 4 && std::string_view(argv[3]) == "--last-entry-only";
+    bool generateLastEntryOnly = false;
+    bool verifyIncremental = false;
+    for (int i = 3; i < argc; i++) {
+        generateLastEntryOnly |= std::string_view(argv[i]) == "--last-entry-only";
+        verifyIncremental |= std::string_view(argv[i]) == "--verify-incremental";
+    }
 
     auto traceFlags = LayerTracing::Flag::TRACE_INPUT | LayerTracing::Flag::TRACE_BUFFERS;
 
@@ -63,7 +68,7 @@ int main(int argc, char** argv) {
     std::cout << "Generating " << outputLayersTracePath << "\n";
 
     if (!LayerTraceGenerator().generate(transactionTraceFile, traceFlags, layerTracing,
-                                        generateLastEntryOnly)) {
+                                        generateLastEntryOnly, verifyIncremental)) {
         std::cout << "Error: Failed to generate layers trace " << outputLayersTracePath << "\n";
         return -1;
     }
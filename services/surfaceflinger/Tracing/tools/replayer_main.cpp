@@ -0,0 +1,126 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "TransactionReplayer"
+
+#include <android-base/file.h>
+#include <android-base/parsedouble.h>
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <binder/ProcessState.h>
+#include <getopt.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TransactionReplayer.h"
+
+using namespace android;
+
+namespace {
+
+void usage(const char* name) {
+    std::cout << "Usage: " << name << " [options] [transaction-trace-path]\n"
+              << "  --speed <factor>      replay <factor> times faster than recorded (default 1)\n"
+              << "  --max-rate            apply transactions as fast as they are committed\n"
+              << "  --clients <count>     replay from <count> clients at once (default 1)\n"
+              << "  --max-pending <count> transactions a client applies ahead of commits"
+                 " (default 8)\n"
+              << "  --display <w>x<h>     size of the virtual display (default 1920x1080)\n";
+}
+
+bool parseSize(const std::string& arg, ui::Size* outSize) {
+    const std::vector<std::string> parts = base::Split(arg, "x");
+    return parts.size() == 2 && base::ParseInt(parts[0], &outSize->width, 1) &&
+            base::ParseInt(parts[1], &outSize->height, 1);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    TransactionReplayer::Options options;
+    const option longOptions[] = {
+            {"speed", required_argument, nullptr, 's'},
+            {"max-rate", no_argument, nullptr, 'r'},
+            {"clients", required_argument, nullptr, 'c'},
+            {"max-pending", required_argument, nullptr, 'p'},
+            {"display", required_argument, nullptr, 'd'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+        bool valid = true;
+        switch (opt) {
+            case 's':
+                valid = base::ParseFloat(optarg, &options.speed) && options.speed > 0;
+                break;
+            case 'r':
+                options.speed = 0;
+                break;
+            case 'c':
+                valid = base::ParseUint(optarg, &options.clients) && options.clients > 0;
+                break;
+            case 'p':
+                valid = base::ParseUint(optarg, &options.maxPendingTransactions) &&
+                        options.maxPendingTransactions > 0;
+                break;
+            case 'd':
+                valid = parseSize(optarg, &options.displaySize);
+                break;
+            default:
+                valid = false;
+                break;
+        }
+        if (!valid) {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (argc - optind > 1) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    const char* transactionTracePath = (optind < argc)
+            ? argv[optind]
+            : "/data/misc/wmtrace/transactions_trace.winscope";
+    std::cout << "Parsing " << transactionTracePath << "\n";
+    std::string input;
+    if (!base::ReadFileToString(transactionTracePath, &input)) {
+        std::cout << "Error: Could not open " << transactionTracePath << "\n";
+        return -1;
+    }
+    perfetto::protos::TransactionTraceFile transactionTraceFile;
+    if (!transactionTraceFile.ParseFromString(input)) {
+        std::cout << "Error: Failed to parse " << transactionTracePath << "\n";
+        return -1;
+    }
+
+    // Transaction callbacks and the virtual display's buffers arrive on binder threads.
+    ProcessState::self()->startThreadPool();
+
+    TransactionReplayer replayer(transactionTraceFile, options);
+    TransactionReplayer::Report report;
+    if (status_t err = replayer.replay(&report); err != NO_ERROR) {
+        std::cout << "Error: Replay failed (" << statusToString(err) << ")\n";
+        return -1;
+    }
+    report.dump(std::cout);
+    return 0;
+}
@@ -65,7 +65,8 @@ protected:
             std::ofstream outStream{actualLayersTracePath, std::ios::binary | std::ios::app};
             auto layerTracing = LayerTracing{outStream};
             EXPECT_TRUE(LayerTraceGenerator().generate(mTransactionTrace, traceFlags, layerTracing,
-                                                       /*onlyLastEntry=*/true))
+                                                       /*onlyLastEntry=*/true,
+                                                       /*verifyIncremental=*/true))
                     << "Failed to generate layers trace from " << transactionTracePath;
         }
 
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <aidl/android/hardware/graphics/composer3/IComposerClient.h>
+#include <common/test/FlagUtils.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <com_android_graphics_surfaceflinger_flags.h>
+
+#include "DisplayHardware/AidlComposerHal.h"
+
+namespace android {
+namespace {
+
+using namespace com::android::graphics::surfaceflinger;
+
+using aidl::android::hardware::graphics::composer3::ChangedCompositionLayer;
+using aidl::android::hardware::graphics::composer3::ChangedCompositionTypes;
+using aidl::android::hardware::graphics::composer3::CommandError;
+using aidl::android::hardware::graphics::composer3::CommandResultPayload;
+using aidl::android::hardware::graphics::composer3::Composition;
+using aidl::android::hardware::graphics::composer3::DisplayCapability;
+using aidl::android::hardware::graphics::composer3::DisplayCommand;
+using aidl::android::hardware::graphics::composer3::DisplayRequest;
+using aidl::android::hardware::graphics::composer3::IComposerClient;
+using aidl::android::hardware::graphics::composer3::IComposerClientDefault;
+using aidl::android::hardware::graphics::composer3::PresentOrValidate;
+
+using Hwc2::AidlComposer;
+using Hwc2::Composer;
+using hal::Error;
+
+constexpr nsecs_t kExpectedPresentTime = 16'666'666;
+constexpr int32_t kFrameIntervalNs = 16'666'666;
+
+// Validates every display it is asked to, each with one layer changed to client composition,
+// except for the displays set to fail.
+class FakeComposerClient : public IComposerClientDefault {
+public:
+    explicit FakeComposerClient(bool multiThreadedPresent)
+          : mMultiThreadedPresent(multiThreadedPresent) {}
+
+    ndk::ScopedAStatus getInterfaceVersion(int32_t* outVersion) override {
+        *outVersion = IComposerClient::version;
+        return ndk::ScopedAStatus::ok();
+    }
+
+    ndk::ScopedAStatus getDisplayCapabilities(int64_t,
+                                              std::vector<DisplayCapability>* outCaps) override {
+        outCaps->clear();
+        if (mMultiThreadedPresent) {
+            outCaps->push_back(DisplayCapability::MULTI_THREADED_PRESENT);
+        }
+        return ndk::ScopedAStatus::ok();
+    }
+
+    ndk::ScopedAStatus executeCommands(const std::vector<DisplayCommand>& commands,
+                                       std::vector<CommandResultPayload>* outResults) override {
+        mExecuteCount++;
+        outResults->clear();
+        for (size_t i = 0; i < commands.size(); i++) {
+            const DisplayCommand& command = commands[i];
+            if (!command.validateDisplay && !command.presentOrValidateDisplay) {
+                continue;
+            }
+            if (mFailingDisplays.count(command.display)) {
+                outResults->emplace_back(CommandError{static_cast<int32_t>(i),
+                                                      IComposerClient::EX_NO_RESOURCES});
+                continue;
+            }
+            if (command.presentOrValidateDisplay) {
+                outResults->emplace_back(
+                        PresentOrValidate{command.display, PresentOrValidate::Result::Validated});
+            }
+            ChangedCompositionTypes changedTypes;
+            changedTypes.display = command.display;
+            changedTypes.layers.push_back(ChangedCompositionLayer{1, Composition::CLIENT});
+            outResults->emplace_back(std::move(changedTypes));
+            DisplayRequest displayRequest;
+            displayRequest.display = command.display;
+            outResults->emplace_back(std::move(displayRequest));
+        }
+        return ndk::ScopedAStatus::ok();
+    }
+
+    void failDisplay(int64_t display) { mFailingDisplays.insert(display); }
+    size_t getExecuteCount() const { return mExecuteCount; }
+
+private:
+    const bool mMultiThreadedPresent;
+    std::set<int64_t> mFailingDisplays;
+    size_t mExecuteCount = 0;
+};
+
+class AidlComposerTest : public testing::TestWithParam<bool> {
+protected:
+    static constexpr size_t kDisplayCount = 3;
+
+    AidlComposerTest() {
+        SET_FLAG_FOR_TEST(flags::multithreaded_present, true);
+        mClient = ndk::SharedRefBase::make<FakeComposerClient>(GetParam());
+        mComposer = std::make_unique<AidlComposer>(mClient);
+        for (size_t i = 0; i < kDisplayCount; i++) {
+            mComposer->onHotplugConnect(static_cast<hal::HWDisplayId>(i + 1));
+        }
+    }
+
+    std::vector<Composer::PresentOrValidateRequest> makeRequests(bool canPresent) const {
+        std::vector<Composer::PresentOrValidateRequest> requests;
+        for (size_t i = 0; i < kDisplayCount; i++) {
+            requests.push_back({static_cast<hal::HWDisplayId>(i + 1), kExpectedPresentTime,
+                                kFrameIntervalNs, canPresent});
+        }
+        return requests;
+    }
+
+    std::shared_ptr<FakeComposerClient> mClient;
+    std::unique_ptr<AidlComposer> mComposer;
+};
+
+TEST_P(AidlComposerTest, presentOrValidateDisplaysExecutesOnce) {
+    const auto results = mComposer->presentOrValidateDisplays(makeRequests(true));
+
+    EXPECT_EQ(1u, mClient->getExecuteCount());
+    ASSERT_EQ(kDisplayCount, results.size());
+    for (const auto& result : results) {
+        EXPECT_EQ(Error::NONE, result.error);
+        EXPECT_EQ(0u, result.state);
+        EXPECT_EQ(1u, result.numTypes);
+        EXPECT_EQ(0u, result.numRequests);
+        EXPECT_EQ(-1, result.presentFence);
+    }
+}
+
+TEST_P(AidlComposerTest, presentOrValidateDisplaysMatchesPerDisplayCalls) {
+    const auto requests = makeRequests(true);
+    const auto results = mComposer->presentOrValidateDisplays(requests);
+    ASSERT_EQ(1u, mClient->getExecuteCount());
+
+    for (size_t i = 0; i < requests.size(); i++) {
+        uint32_t numTypes = 0;
+        uint32_t numRequests = 0;
+        int presentFence = -1;
+        uint32_t state = 0;
+        const Error error =
+                mComposer->presentOrValidateDisplay(requests[i].display, kExpectedPresentTime,
+                                                    kFrameIntervalNs, &numTypes, &numRequests,
+                                                    &presentFence, &state);
+        EXPECT_EQ(error, results[i].error);
+        EXPECT_EQ(numTypes, results[i].numTypes);
+        EXPECT_EQ(numRequests, results[i].numRequests);
+        EXPECT_EQ(state, results[i].state);
+    }
+    EXPECT_EQ(1u + requests.size(), mClient->getExecuteCount());
+}
+
+TEST_P(AidlComposerTest, validateDisplaysExecutesOnce) {
+    const auto results = mComposer->presentOrValidateDisplays(makeRequests(false));
+
+    EXPECT_EQ(1u, mClient->getExecuteCount());
+    ASSERT_EQ(kDisplayCount, results.size());
+    for (const auto& result : results) {
+        EXPECT_EQ(Error::NONE, result.error);
+        EXPECT_EQ(1u, result.numTypes);
+    }
+}
+
+TEST_P(AidlComposerTest, presentOrValidateDisplaysReportsErrorsPerDisplay) {
+    mClient->failDisplay(2);
+
+    const auto results = mComposer->presentOrValidateDisplays(makeRequests(true));
+
+    EXPECT_EQ(1u, mClient->getExecuteCount());
+    ASSERT_EQ(kDisplayCount, results.size());
+    EXPECT_EQ(Error::NONE, results[0].error);
+    EXPECT_EQ(Error::NO_RESOURCES, results[1].error);
+    EXPECT_EQ(Error::NONE, results[2].error);
+    EXPECT_EQ(1u, results[2].numTypes);
+}
+
+TEST_P(AidlComposerTest, presentOrValidateDisplaysRejectsUnknownDisplay) {
+    auto requests = makeRequests(true);
+    requests.push_back({kDisplayCount + 1, kExpectedPresentTime, kFrameIntervalNs, true});
+
+    const auto results = mComposer->presentOrValidateDisplays(requests);
+
+    EXPECT_EQ(1u, mClient->getExecuteCount());
+    ASSERT_EQ(requests.size(), results.size());
+    EXPECT_EQ(Error::NONE, results[0].error);
+    EXPECT_EQ(Error::BAD_DISPLAY, results.back().error);
+}
+
+// Whether the displays have the MULTI_THREADED_PRESENT capability, which gives each its own
+// command reader.
+INSTANTIATE_TEST_SUITE_P(AidlComposer, AidlComposerTest, testing::Bool());
+
+} // namespace
+} // namespace android
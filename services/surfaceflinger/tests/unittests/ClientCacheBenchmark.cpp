@@ -0,0 +1,89 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/Binder.h>
+#include <gmock/gmock.h>
+#include <renderengine/mock/RenderEngine.h>
+#include <ui/GraphicBuffer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "ClientCache.h"
+
+namespace android {
+namespace {
+
+// Client processes whose buffers the main thread resolves.
+constexpr size_t kProcessCount = 16;
+// Buffers each process keeps cached. The processes cache and uncache other buffers.
+constexpr uint64_t kCachedBufferCount = 64;
+
+// The main thread resolves the cached buffers of kProcessCount processes, round robin, while
+// state.range(0) client processes cache and uncache buffers on their own binder threads.
+void BM_getWhileCaching(benchmark::State& state) {
+    const size_t cachingProcessCount = static_cast<size_t>(state.range(0));
+
+    testing::NiceMock<renderengine::mock::RenderEngine> renderEngine;
+    ClientCache cache;
+    cache.setRenderEngine(&renderEngine);
+
+    // Buffers are never drawn, so they need no memory.
+    const sp<GraphicBuffer> buffer = sp<GraphicBuffer>::make();
+    std::vector<sp<IBinder>> processes;
+    for (size_t i = 0; i < std::max(kProcessCount, cachingProcessCount); i++) {
+        processes.push_back(sp<BBinder>::make());
+        for (uint64_t id = 0; id < kCachedBufferCount; id++) {
+            if (!cache.add({processes.back(), id}, buffer).ok()) {
+                state.SkipWithError("Failed to cache a buffer");
+                return;
+            }
+        }
+    }
+
+    std::atomic<bool> done = false;
+    std::vector<std::thread> cachingThreads;
+    for (size_t i = 0; i < cachingProcessCount; i++) {
+        cachingThreads.emplace_back([&, process = processes[i]] {
+            for (uint64_t n = 0; !done.load(std::memory_order_relaxed); n++) {
+                const client_cache_t cacheId{process, kCachedBufferCount + n % kCachedBufferCount};
+                cache.add(cacheId, buffer);
+                cache.erase(cacheId);
+            }
+        });
+    }
+
+    size_t n = 0;
+    for (auto _ : state) {
+        const client_cache_t cacheId{processes[n % kProcessCount],
+                                     (n / kProcessCount) % kCachedBufferCount};
+        benchmark::DoNotOptimize(cache.get(cacheId));
+        n++;
+    }
+
+    done = true;
+    for (std::thread& thread : cachingThreads) {
+        thread.join();
+    }
+}
+BENCHMARK(BM_getWhileCaching)->Arg(0)->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+} // namespace
+} // namespace android
@@ -0,0 +1,281 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "ClientCacheTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <binder/Binder.h>
+#include <renderengine/mock/RenderEngine.h>
+#include <ui/GraphicBuffer.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ClientCache.h"
+
+namespace android {
+
+class ClientCacheTest : public testing::Test {
+protected:
+    using IntMap = ClientCache::IdMap<int>;
+
+    class FakeErasedRecipient : public ClientCache::ErasedRecipient {
+    public:
+        void bufferErased(const client_cache_t& clientCacheId) override {
+            erasedIds.push_back(clientCacheId.id);
+        }
+
+        std::vector<uint64_t> erasedIds;
+    };
+
+    ClientCacheTest() { mCache.setRenderEngine(&mRenderEngine); }
+
+    static size_t homeOf(const IntMap& map, uint64_t key) { return map.homeOf(key); }
+
+    // Returns count keys, starting from firstKey, whose home slot in map is home.
+    static std::vector<uint64_t> keysWithHome(const IntMap& map, size_t home, size_t count,
+                                              uint64_t firstKey = 0) {
+        std::vector<uint64_t> keys;
+        for (uint64_t key = firstKey; keys.size() < count; key++) {
+            if (homeOf(map, key) == home) {
+                keys.push_back(key);
+            }
+        }
+        return keys;
+    }
+
+    testing::NiceMock<renderengine::mock::RenderEngine> mRenderEngine;
+    ClientCache mCache;
+    // Buffers are never drawn, so they need no memory.
+    const sp<GraphicBuffer> mBuffer = sp<GraphicBuffer>::make();
+    const sp<IBinder> mProcess = sp<BBinder>::make();
+};
+
+TEST_F(ClientCacheTest, idMapInsertsAndFindsKeys) {
+    IntMap map;
+    EXPECT_EQ(nullptr, map.find(1));
+    map[1] = 10;
+    map[2] = 20;
+    EXPECT_EQ(2u, map.size());
+    ASSERT_NE(nullptr, map.find(1));
+    EXPECT_EQ(10, *map.find(1));
+    ASSERT_NE(nullptr, map.find(2));
+    EXPECT_EQ(20, *map.find(2));
+    EXPECT_EQ(nullptr, map.find(3));
+
+    // An existing key is not inserted again.
+    map[1] = 11;
+    EXPECT_EQ(2u, map.size());
+    EXPECT_EQ(11, *map.find(1));
+}
+
+TEST_F(ClientCacheTest, idMapEraseReturnsTheValue) {
+    IntMap map;
+    map[7] = 70;
+    int value = 0;
+    EXPECT_TRUE(map.erase(7, &value));
+    EXPECT_EQ(70, value);
+    EXPECT_EQ(0u, map.size());
+    EXPECT_EQ(nullptr, map.find(7));
+    EXPECT_FALSE(map.erase(7));
+}
+
+TEST_F(ClientCacheTest, idMapEraseKeepsWrappedProbeRunsReachable) {
+    IntMap map;
+    map[0] = 0;
+    const size_t last = map.capacity() - 1;
+    // Three keys whose home is the last slot, so that the run wraps around to the first slots,
+    // then a key whose home is the first slot, probed past the wrapped keys.
+    const std::vector<uint64_t> lastKeys = keysWithHome(map, last, 3, 1);
+    const uint64_t firstKey = keysWithHome(map, 0, 1, 1)[0];
+    ASSERT_TRUE(map.erase(0));
+    for (uint64_t key : lastKeys) {
+        map[key] = static_cast<int>(key);
+    }
+    map[firstKey] = static_cast<int>(firstKey);
+    ASSERT_EQ(4u, map.size());
+
+    // Erasing the head of the run moves the others back across the end of the table.
+    EXPECT_TRUE(map.erase(lastKeys[0]));
+    for (uint64_t key : {lastKeys[1], lastKeys[2], firstKey}) {
+        ASSERT_NE(nullptr, map.find(key)) << key;
+        EXPECT_EQ(static_cast<int>(key), *map.find(key));
+    }
+
+    // Erasing from the middle of the run, after the wrap.
+    EXPECT_TRUE(map.erase(lastKeys[2]));
+    for (uint64_t key : {lastKeys[1], firstKey}) {
+        ASSERT_NE(nullptr, map.find(key)) << key;
+        EXPECT_EQ(static_cast<int>(key), *map.find(key));
+    }
+    EXPECT_EQ(nullptr, map.find(lastKeys[0]));
+    EXPECT_EQ(nullptr, map.find(lastKeys[2]));
+    EXPECT_EQ(2u, map.size());
+}
+
+TEST_F(ClientCacheTest, idMapGrowsAndKeepsItsKeys) {
+    IntMap map;
+    constexpr uint64_t kKeyCount = 1000;
+    for (uint64_t key = 0; key < kKeyCount; key++) {
+        map[key] = static_cast<int>(key);
+        // At most half full.
+        EXPECT_LE(map.size() * 2, map.capacity());
+    }
+    EXPECT_EQ(kKeyCount, map.size());
+    // The capacity stays a power of two, as slots are found by masking.
+    EXPECT_EQ(0u, map.capacity() & (map.capacity() - 1));
+
+    for (uint64_t key = 0; key < kKeyCount; key += 2) {
+        EXPECT_TRUE(map.erase(key));
+    }
+    for (uint64_t key = 0; key < kKeyCount; key++) {
+        if (key % 2 == 0) {
+            EXPECT_EQ(nullptr, map.find(key)) << key;
+        } else {
+            ASSERT_NE(nullptr, map.find(key)) << key;
+            EXPECT_EQ(static_cast<int>(key), *map.find(key));
+        }
+    }
+    EXPECT_EQ(kKeyCount / 2, map.size());
+
+    size_t visited = 0;
+    map.forEach([&](uint64_t key, int value) {
+        EXPECT_EQ(1u, key % 2);
+        EXPECT_EQ(static_cast<int>(key), value);
+        visited++;
+    });
+    EXPECT_EQ(kKeyCount / 2, visited);
+}
+
+TEST_F(ClientCacheTest, getReturnsTheAddedBuffer) {
+    const client_cache_t cacheId{mProcess, 1};
+    EXPECT_EQ(nullptr, mCache.get(cacheId));
+
+    auto texture = mCache.add(cacheId, mBuffer);
+    ASSERT_TRUE(texture.ok());
+    EXPECT_EQ(mBuffer, (*texture)->getBuffer());
+    EXPECT_EQ(*texture, mCache.get(cacheId));
+
+    // Buffers are cached per process.
+    EXPECT_EQ(nullptr, mCache.get({sp<BBinder>::make(), 1}));
+    EXPECT_EQ(nullptr, mCache.get({mProcess, 2}));
+}
+
+TEST_F(ClientCacheTest, addRejectsInvalidArguments) {
+    auto texture = mCache.add({nullptr, 1}, mBuffer);
+    ASSERT_FALSE(texture.ok());
+    EXPECT_EQ(ClientCache::AddError::Unspecified, texture.error());
+
+    texture = mCache.add({mProcess, 1}, nullptr);
+    ASSERT_FALSE(texture.ok());
+    EXPECT_EQ(ClientCache::AddError::Unspecified, texture.error());
+    EXPECT_EQ(nullptr, mCache.get({mProcess, 1}));
+}
+
+TEST_F(ClientCacheTest, addReplacesTheBufferOfAnId) {
+    const client_cache_t cacheId{mProcess, 1};
+    ASSERT_TRUE(mCache.add(cacheId, mBuffer).ok());
+
+    const sp<GraphicBuffer> otherBuffer = sp<GraphicBuffer>::make();
+    auto texture = mCache.add(cacheId, otherBuffer);
+    ASSERT_TRUE(texture.ok());
+    EXPECT_EQ(*texture, mCache.get(cacheId));
+    EXPECT_EQ(otherBuffer, mCache.get(cacheId)->getBuffer());
+    EXPECT_EQ(otherBuffer, mCache.erase(cacheId));
+    EXPECT_EQ(nullptr, mCache.get(cacheId));
+}
+
+TEST_F(ClientCacheTest, eraseNotifiesTheRecipientsOfTheBuffer) {
+    const client_cache_t cacheId{mProcess, 1};
+    const client_cache_t otherCacheId{mProcess, 2};
+    ASSERT_TRUE(mCache.add(cacheId, mBuffer).ok());
+    ASSERT_TRUE(mCache.add(otherCacheId, mBuffer).ok());
+
+    auto recipient = sp<FakeErasedRecipient>::make();
+    auto unregisteredRecipient = sp<FakeErasedRecipient>::make();
+    EXPECT_TRUE(mCache.registerErasedRecipient(cacheId, recipient));
+    // Registering twice notifies once.
+    EXPECT_TRUE(mCache.registerErasedRecipient(cacheId, recipient));
+    EXPECT_TRUE(mCache.registerErasedRecipient(cacheId, unregisteredRecipient));
+    mCache.unregisterErasedRecipient(cacheId, unregisteredRecipient);
+    EXPECT_FALSE(mCache.registerErasedRecipient({mProcess, 3}, recipient));
+
+    EXPECT_EQ(mBuffer, mCache.erase(cacheId));
+    EXPECT_EQ(std::vector<uint64_t>({1}), recipient->erasedIds);
+    EXPECT_TRUE(unregisteredRecipient->erasedIds.empty());
+    EXPECT_EQ(nullptr, mCache.get(cacheId));
+    EXPECT_NE(nullptr, mCache.get(otherCacheId));
+
+    // Already erased.
+    EXPECT_EQ(nullptr, mCache.erase(cacheId));
+    EXPECT_EQ(std::vector<uint64_t>({1}), recipient->erasedIds);
+}
+
+TEST_F(ClientCacheTest, addFailsOnceTheCacheOfTheProcessIsFull) {
+    // A cache holds one buffer more than BUFFER_CACHE_MAX_SIZE before it is full.
+    for (uint64_t id = 0; id <= BUFFER_CACHE_MAX_SIZE; id++) {
+        ASSERT_TRUE(mCache.add({mProcess, id}, mBuffer).ok()) << id;
+    }
+
+    auto texture = mCache.add({mProcess, BUFFER_CACHE_MAX_SIZE + 1}, mBuffer);
+    ASSERT_FALSE(texture.ok());
+    EXPECT_EQ(ClientCache::AddError::CacheFull, texture.error());
+    // Replacing a buffer is rejected too.
+    texture = mCache.add({mProcess, 0}, mBuffer);
+    ASSERT_FALSE(texture.ok());
+    EXPECT_EQ(ClientCache::AddError::CacheFull, texture.error());
+    EXPECT_EQ(nullptr, mCache.get({mProcess, BUFFER_CACHE_MAX_SIZE + 1}));
+
+    // Other processes have their own limit.
+    EXPECT_TRUE(mCache.add({sp<BBinder>::make(), 0}, mBuffer).ok());
+
+    // Erasing a buffer makes room again.
+    EXPECT_EQ(mBuffer, mCache.erase({mProcess, 0}));
+    EXPECT_TRUE(mCache.add({mProcess, BUFFER_CACHE_MAX_SIZE + 1}, mBuffer).ok());
+}
+
+TEST_F(ClientCacheTest, removeProcessForgetsItsBuffersAndNotifiesTheirRecipients) {
+    // What happens when the process dies: its binder death recipient removes it.
+    const sp<IBinder> otherProcess = sp<BBinder>::make();
+    ASSERT_TRUE(mCache.add({mProcess, 1}, mBuffer).ok());
+    ASSERT_TRUE(mCache.add({mProcess, 2}, mBuffer).ok());
+    ASSERT_TRUE(mCache.add({otherProcess, 1}, mBuffer).ok());
+
+    auto recipient = sp<FakeErasedRecipient>::make();
+    auto otherRecipient = sp<FakeErasedRecipient>::make();
+    ASSERT_TRUE(mCache.registerErasedRecipient({mProcess, 1}, recipient));
+    ASSERT_TRUE(mCache.registerErasedRecipient({mProcess, 2}, recipient));
+    ASSERT_TRUE(mCache.registerErasedRecipient({otherProcess, 1}, otherRecipient));
+
+    mCache.removeProcess(mProcess);
+    std::vector<uint64_t> erasedIds = recipient->erasedIds;
+    std::sort(erasedIds.begin(), erasedIds.end());
+    EXPECT_EQ(std::vector<uint64_t>({1, 2}), erasedIds);
+    EXPECT_TRUE(otherRecipient->erasedIds.empty());
+    EXPECT_EQ(nullptr, mCache.get({mProcess, 1}));
+    EXPECT_EQ(nullptr, mCache.get({mProcess, 2}));
+    EXPECT_NE(nullptr, mCache.get({otherProcess, 1}));
+
+    // The process starts over if it caches buffers again.
+    ASSERT_TRUE(mCache.add({mProcess, 1}, mBuffer).ok());
+    EXPECT_NE(nullptr, mCache.get({mProcess, 1}));
+    EXPECT_EQ(nullptr, mCache.get({mProcess, 2}));
+}
+
+} // namespace android
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ui/FenceTime.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FrameTracer/FrameTracer.h"
+
+namespace android {
+namespace {
+
+using FrameEvent = FrameTracer::FrameEvent;
+
+// A frame at 120Hz.
+constexpr nsecs_t kFramePeriod = 8'333'333;
+
+std::unique_ptr<perfetto::TracingSession> startTracingSession() {
+    static bool wasInitialized = false;
+    if (!wasInitialized) {
+        perfetto::TracingInitArgs args;
+        args.backends = perfetto::kInProcessBackend;
+        perfetto::Tracing::Initialize(args);
+        wasInitialized = true;
+    }
+
+    perfetto::TraceConfig cfg;
+    cfg.add_buffers()->set_size_kb(4096);
+    cfg.add_data_sources()->mutable_config()->set_name(FrameTracer::kFrameTracerDataSource);
+
+    auto tracingSession = perfetto::Tracing::NewTrace(perfetto::kInProcessBackend);
+    tracingSession->Setup(cfg);
+    tracingSession->StartBlocking();
+    return tracingSession;
+}
+
+// Traces the buffer events SurfaceFlinger traces for state.range(0) layers that each queue a
+// buffer every frame at 120Hz. Half of the acquire fences are still pending when traced.
+void BM_traceFrame(benchmark::State& state) {
+    const int32_t layerCount = static_cast<int32_t>(state.range(0));
+
+    FrameTracer frameTracer;
+    frameTracer.registerDataSource();
+    auto tracingSession = startTracingSession();
+
+    FenceToFenceTimeMap fenceFactory;
+    for (int32_t layerId = 0; layerId < layerCount; layerId++) {
+        frameTracer.traceNewLayer(layerId, "layer#" + std::to_string(layerId));
+    }
+
+    // Recent enough for the pending fences not to be discarded.
+    const nsecs_t startTime = systemTime();
+    uint64_t frameNumber = 0;
+    for (auto _ : state) {
+        const nsecs_t frameTime = startTime + static_cast<nsecs_t>(frameNumber) * kFramePeriod;
+        const uint64_t bufferID = frameNumber % 3;
+        for (int32_t layerId = 0; layerId < layerCount; layerId++) {
+            frameTracer.traceTimestamp(layerId, bufferID, frameNumber, frameTime,
+                                       FrameEvent::DEQUEUE);
+            frameTracer.traceTimestamp(layerId, bufferID, frameNumber, frameTime + 1'000'000,
+                                       FrameEvent::QUEUE);
+            // Pending fences are signalled at the end of the frame, and traced the next time
+            // their buffer is.
+            auto acquireFence = layerId % 2 == 0
+                    ? std::make_shared<FenceTime>(frameTime + 2'000'000)
+                    : fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+            frameTracer.traceFence(layerId, bufferID, frameNumber, acquireFence,
+                                   FrameEvent::ACQUIRE_FENCE, frameTime + 1'000'000);
+            frameTracer.traceTimestamp(layerId, bufferID, frameNumber, frameTime + 4'000'000,
+                                       FrameEvent::LATCH);
+            frameTracer.traceFence(layerId, bufferID, frameNumber,
+                                   std::make_shared<FenceTime>(frameTime + kFramePeriod),
+                                   FrameEvent::PRESENT_FENCE);
+        }
+        fenceFactory.signalAllForTest(Fence::NO_FENCE, frameTime + 3'000'000);
+        frameNumber++;
+    }
+
+    state.counters["events"] =
+            benchmark::Counter(static_cast<double>(state.iterations() * layerCount * 5),
+                               benchmark::Counter::kIsRate);
+    tracingSession->StopBlocking();
+}
+BENCHMARK(BM_traceFrame)->Arg(8)->Arg(32)->Arg(128);
+
+} // namespace
+} // namespace android
@@ -468,6 +468,40 @@ TEST_F(FrameTracerTest, traceFenceWithValidStartTime_ShouldHaveCorrectDuration)
                       FrameTracer::FrameEvent::UNSPECIFIED));
 }
 
+TEST_F(FrameTracerTest, tooManyPendingFences_ShouldDiscardTheOldest) {
+    const std::string layerName = "co.layername#0";
+    const int32_t layerId = 5;
+    const uint32_t bufferID = 4;
+    const auto type = FrameTracer::FrameEvent::ACQUIRE_FENCE;
+
+    auto tracingSession = getTracingSessionForTest();
+
+    tracingSession->StartBlocking();
+    mFrameTracer->traceNewLayer(layerId, layerName);
+    const uint64_t fenceCount = FrameTracer::kMaxPendingFences + 1;
+    for (uint64_t frameNumber = 0; frameNumber < fenceCount; frameNumber++) {
+        auto fence = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+        mFrameTracer->traceFence(layerId, bufferID, frameNumber, fence, type);
+    }
+    const nsecs_t timestamp = systemTime();
+    fenceFactory.signalAllForTest(Fence::NO_FENCE, timestamp);
+
+    // Create extra trace packet to trigger and finalize fence trace packets.
+    mFrameTracer->traceTimestamp(layerId, bufferID, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+    tracingSession->StopBlocking();
+
+    auto packets = readGraphicsFramePacketsBlocking(tracingSession.get());
+    ASSERT_EQ(packets.size(), FrameTracer::kMaxPendingFences + 1);
+    for (size_t i = 0; i < FrameTracer::kMaxPendingFences; i++) {
+        const auto& bufferEvent = packets[i].graphics_frame_event().buffer_event();
+        EXPECT_EQ(bufferEvent.frame_number(), i + 1);
+        EXPECT_EQ(bufferEvent.type(), perfetto::protos::GraphicsFrameEvent::BufferEventType(type));
+    }
+    EXPECT_EQ(packets.back().graphics_frame_event().buffer_event().type(),
+              perfetto::protos::GraphicsFrameEvent::BufferEventType(
+                      FrameTracer::FrameEvent::UNSPECIFIED));
+}
+
 } // namespace
 } // namespace android
 
@@ -61,7 +61,10 @@ using ::aidl::android::hardware::graphics::common::DisplayHotplugEvent;
 using ::aidl::android::hardware::graphics::composer3::RefreshRateChangedDebugData;
 using hal::IComposerClient;
 using ::testing::_;
+using ::testing::AllOf;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
+using ::testing::Field;
 using ::testing::Return;
 using ::testing::SetArgPointee;
 using ::testing::StrictMock;
@@ -408,6 +411,79 @@ TEST_F(HWComposerTest, onVsyncInvalid) {
     EXPECT_FALSE(displayIdOpt);
 }
 
+TEST_F(HWComposerTest, getDeviceCompositionChangesReturnsPrefetchedChanges) {
+    constexpr hal::HWDisplayId kHwcDisplayId = 1;
+    expectHotplugConnect(kHwcDisplayId);
+    const auto info = mHwc.onHotplug(kHwcDisplayId, hal::Connection::CONNECTED);
+    ASSERT_TRUE(info);
+
+    {
+        Hwc2::Composer::PresentOrValidateResult result;
+        result.state = 0; // Validated.
+        result.numTypes = 1;
+        EXPECT_CALL(*mHal,
+                    presentOrValidateDisplays(ElementsAre(
+                            AllOf(Field(&Hwc2::Composer::PresentOrValidateRequest::display,
+                                        kHwcDisplayId),
+                                  Field(&Hwc2::Composer::PresentOrValidateRequest::canPresent,
+                                        false)))))
+                .WillOnce(Return(std::vector{result}));
+        mHwc.prefetchDeviceCompositionChanges(
+                {{.displayId = info->id, .frameUsesClientComposition = true}});
+    }
+
+    // The display is not validated again.
+    EXPECT_CALL(*mHal, getChangedCompositionTypes(kHwcDisplayId, _, _))
+            .WillOnce(Return(HalError::NONE));
+    EXPECT_CALL(*mHal, getDisplayRequests(kHwcDisplayId, _, _, _))
+            .WillOnce(Return(HalError::NONE));
+    EXPECT_CALL(*mHal, getClientTargetProperty(kHwcDisplayId, _))
+            .WillOnce(Return(HalError::NONE));
+    EXPECT_CALL(*mHal, acceptDisplayChanges(kHwcDisplayId)).WillOnce(Return(HalError::NONE));
+
+    std::optional<HWComposer::DeviceRequestedChanges> changes;
+    EXPECT_EQ(NO_ERROR,
+              mHwc.getDeviceCompositionChanges(info->id, /*frameUsesClientComposition=*/true,
+                                               std::nullopt, 0, Fps(), &changes));
+    EXPECT_TRUE(changes);
+    EXPECT_FALSE(mHwc.getValidateSkipped(info->id));
+
+    // The prefetched changes are only used once.
+    EXPECT_CALL(*mHal, validateDisplay(kHwcDisplayId, _, _, _, _))
+            .WillOnce(Return(HalError::NO_RESOURCES));
+    EXPECT_NE(NO_ERROR,
+              mHwc.getDeviceCompositionChanges(info->id, /*frameUsesClientComposition=*/true,
+                                               std::nullopt, 0, Fps(), &changes));
+}
+
+TEST_F(HWComposerTest, getDeviceCompositionChangesReturnsPrefetchedPresent) {
+    constexpr hal::HWDisplayId kHwcDisplayId = 1;
+    expectHotplugConnect(kHwcDisplayId);
+    const auto info = mHwc.onHotplug(kHwcDisplayId, hal::Connection::CONNECTED);
+    ASSERT_TRUE(info);
+
+    {
+        Hwc2::Composer::PresentOrValidateResult result;
+        result.state = 1; // Presented.
+        EXPECT_CALL(*mHal,
+                    presentOrValidateDisplays(ElementsAre(
+                            Field(&Hwc2::Composer::PresentOrValidateRequest::canPresent, true))))
+                .WillOnce(Return(std::vector{result}));
+        mHwc.prefetchDeviceCompositionChanges(
+                {{.displayId = info->id, .frameUsesClientComposition = false}});
+    }
+
+    // The display is not presented again.
+    EXPECT_CALL(*mHal, getReleaseFences(kHwcDisplayId, _, _)).WillOnce(Return(HalError::NONE));
+
+    std::optional<HWComposer::DeviceRequestedChanges> changes;
+    EXPECT_EQ(NO_ERROR,
+              mHwc.getDeviceCompositionChanges(info->id, /*frameUsesClientComposition=*/false,
+                                               std::nullopt, 0, Fps(), &changes));
+    EXPECT_FALSE(changes);
+    EXPECT_TRUE(mHwc.getValidateSkipped(info->id));
+}
+
 struct MockHWC2ComposerCallback final : StrictMock<HWC2::ComposerCallback> {
     MOCK_METHOD(void, onComposerHalHotplugEvent, (hal::HWDisplayId, DisplayHotplugEvent),
                 (override));
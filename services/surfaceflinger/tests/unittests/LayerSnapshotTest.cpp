@@ -246,6 +246,28 @@ TEST_F(LayerSnapshotTest, FastPathClearsPreviousChangeStates) {
     EXPECT_EQ(getSnapshot(11)->changes.get(), 0u);
 }
 
+TEST_F(LayerSnapshotTest, UpdateIdTracksChangedSnapshots) {
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    const uint64_t updateId = mSnapshotBuilder.getUpdateId();
+    EXPECT_LE(mSnapshotBuilder.getLastGlobalChangeUpdateId(), updateId);
+
+    setColor(11, {1._hf, 0._hf, 0._hf});
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(mSnapshotBuilder.getUpdateId(), updateId + 1);
+    EXPECT_TRUE(getSnapshot(11)->hasChanges());
+    EXPECT_LE(mSnapshotBuilder.getLastGlobalChangeUpdateId(), updateId);
+
+    // Clearing the changes of a snapshot changes it too.
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_FALSE(getSnapshot(11)->hasChanges());
+    EXPECT_EQ(getSnapshot(11)->changedUpdateId, updateId + 2);
+    EXPECT_LE(getSnapshot(2)->changedUpdateId, updateId);
+
+    reparentLayer(2, UNASSIGNED_LAYER_ID);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 111, 12, 121, 122, 1221, 13});
+    EXPECT_EQ(mSnapshotBuilder.getLastGlobalChangeUpdateId(), mSnapshotBuilder.getUpdateId());
+}
+
 TEST_F(LayerSnapshotTest, FastPathSetsChangeFlagToContent) {
     setColor(1, {1._hf, 0._hf, 0._hf});
     UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
@@ -99,6 +99,8 @@ public:
     MOCK_METHOD(Error, validateDisplay, (Display, nsecs_t, int32_t, uint32_t*, uint32_t*));
     MOCK_METHOD(Error, presentOrValidateDisplay,
                 (Display, nsecs_t, int32_t, uint32_t*, uint32_t*, int*, uint32_t*));
+    MOCK_METHOD(std::vector<PresentOrValidateResult>, presentOrValidateDisplays,
+                (const std::vector<PresentOrValidateRequest>&));
     MOCK_METHOD4(setCursorPosition, Error(Display, Layer, int32_t, int32_t));
     MOCK_METHOD5(setLayerBuffer, Error(Display, Layer, uint32_t, const sp<GraphicBuffer>&, int));
     MOCK_METHOD4(setLayerBufferSlotsToClear,